@@ -0,0 +1,115 @@
+/**
+ * @file alarm.c
+ * @brief Threshold alarms with hysteresis, a buzzer output and an EXTI acknowledge input
+ */
+
+#include "alarm.h"
+#include "format.h"
+#include "main.h"
+
+typedef struct
+{
+    int32_t low;
+    int32_t high;
+    int32_t hyst;
+} alarm_limits;
+
+static alarm_limits limits[ALARM_CH_COUNT];
+static volatile uint8_t active;     // ALARM_BIT() per channel past its limit
+static volatile uint8_t muted;
+
+static void alarm_buzzer(uint8_t on)
+{
+    HAL_GPIO_WritePin(ALARM_BUZZER_PORT, ALARM_BUZZER_PIN, on ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+void alarm_init(void)
+{
+    GPIO_InitTypeDef gpio = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    HAL_GPIO_WritePin(ALARM_BUZZER_PORT, ALARM_BUZZER_PIN, GPIO_PIN_RESET);
+    gpio.Pin = ALARM_BUZZER_PIN;
+    gpio.Mode = GPIO_MODE_OUTPUT_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(ALARM_BUZZER_PORT, &gpio);
+
+    // EXTI lines stay armed in STOP, so a press wakes the core directly
+    gpio.Pin = ALARM_ACK_PIN;
+    gpio.Mode = GPIO_MODE_IT_FALLING;
+    gpio.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(ALARM_ACK_PORT, &gpio);
+    HAL_NVIC_SetPriority(ALARM_ACK_IRQn, IRQ_PRIO_ALARM, 0);
+    HAL_NVIC_EnableIRQ(ALARM_ACK_IRQn);
+
+    alarm_set_limits(ALARM_CH_TEMP, ALARM_TEMP_LOW, ALARM_TEMP_HIGH, ALARM_TEMP_HYST);
+    alarm_set_limits(ALARM_CH_HUMIDITY, ALARM_HUMIDITY_LOW, ALARM_HUMIDITY_HIGH, ALARM_HUMIDITY_HYST);
+    alarm_set_limits(ALARM_CH_PRESSURE, ALARM_OFF_LOW, ALARM_OFF_HIGH, 0);
+    active = 0;
+    muted = 0;
+}
+
+void alarm_set_limits(Alarm_Channel ch, int32_t low, int32_t high, int32_t hyst)
+{
+    limits[ch].low = low;
+    limits[ch].high = high;
+    limits[ch].hyst = hyst;
+}
+
+// Raised past a limit, cleared only once back inside by the margin; the
+// disabled sides sit at the ends of the range and can never be passed
+static uint8_t alarm_eval(const alarm_limits *l, int32_t value, uint8_t was_active)
+{
+    if (!was_active)
+        return value < l->low || value > l->high;
+    if (l->low != ALARM_OFF_LOW && value < l->low + l->hyst) return 1;
+    if (l->high != ALARM_OFF_HIGH && value > l->high - l->hyst) return 1;
+    return 0;
+}
+
+uint8_t alarm_check(const BME280_Measurement *m)
+{
+    int32_t value[ALARM_CH_COUNT];
+    uint8_t now = 0;
+
+    value[ALARM_CH_TEMP] = m->temperature;
+    value[ALARM_CH_HUMIDITY] = format_rh_centi(m->humidity);
+    value[ALARM_CH_PRESSURE] = format_hpa_centi(m->pressure);
+
+    for (uint8_t ch = 0; ch < ALARM_CH_COUNT; ch++)
+    {
+        if (alarm_eval(&limits[ch], value[ch], active & ALARM_BIT(ch)))
+            now |= ALARM_BIT(ch);
+    }
+
+    uint8_t raised = now & ~active;
+    __disable_irq();
+    active = now;
+    if (raised)
+        muted = 0;
+    alarm_buzzer(now && !muted);
+    __enable_irq();
+    return raised != 0;
+}
+
+uint8_t alarm_active(void)
+{
+    return active;
+}
+
+void alarm_acknowledge(void)
+{
+    muted = 1;
+    alarm_buzzer(0);
+}
+
+void alarm_irq_handler(void)
+{
+    if (__HAL_GPIO_EXTI_GET_IT(ALARM_ACK_PIN))
+    {
+        __HAL_GPIO_EXTI_CLEAR_IT(ALARM_ACK_PIN);
+        if (active)
+            alarm_acknowledge();
+    }
+}
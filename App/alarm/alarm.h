@@ -0,0 +1,116 @@
+/**
+ * @file alarm.h
+ * @brief Threshold alarms with hysteresis, a buzzer output and an EXTI acknowledge input
+ *
+ * The limits are checked on every sample straight after the conversion,
+ * before filtering and independent of the display, so an alarm fires on
+ * the first reading past its limit even while the panel is off. The
+ * buzzer line is driven from the check itself; the acknowledge button
+ * silences it from its EXTI interrupt, which also wakes the core from STOP.
+ */
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#include "bme280.h"
+
+/** Threshold alarms; needs the buzzer and the acknowledge button fitted */
+#ifndef ALARM
+#define ALARM 0
+#endif
+
+/** Buzzer output, active high (an active buzzer or a transistor driver) */
+#define ALARM_BUZZER_PORT   GPIOA
+#define ALARM_BUZZER_PIN    GPIO_PIN_1
+
+/** Acknowledge button to GND, internal pull-up, EXTI line 0 */
+#define ALARM_ACK_PORT      GPIOA
+#define ALARM_ACK_PIN       GPIO_PIN_0
+#define ALARM_ACK_IRQn      EXTI0_1_IRQn
+
+/** No limit on this side of the channel */
+#define ALARM_OFF_LOW       INT32_MIN
+#define ALARM_OFF_HIGH      INT32_MAX
+
+/** Default limits, in the units the display prints (0.01) */
+#ifndef ALARM_TEMP_LOW
+#define ALARM_TEMP_LOW      200             // 2.00 degC, freeze warning
+#endif
+#ifndef ALARM_TEMP_HIGH
+#define ALARM_TEMP_HIGH     ALARM_OFF_HIGH
+#endif
+#ifndef ALARM_TEMP_HYST
+#define ALARM_TEMP_HYST     50              // 0.5 degC
+#endif
+#ifndef ALARM_HUMIDITY_LOW
+#define ALARM_HUMIDITY_LOW  ALARM_OFF_LOW
+#endif
+#ifndef ALARM_HUMIDITY_HIGH
+#define ALARM_HUMIDITY_HIGH 7000            // 70 %RH
+#endif
+#ifndef ALARM_HUMIDITY_HYST
+#define ALARM_HUMIDITY_HYST 300             // 3 %RH
+#endif
+
+typedef enum
+{
+    ALARM_CH_TEMP = 0,      ///< 0.01 °C
+    ALARM_CH_HUMIDITY,      ///< 0.01 %RH
+    ALARM_CH_PRESSURE,      ///< 0.01 hPa, station pressure
+    ALARM_CH_COUNT
+} Alarm_Channel;
+
+/** Bit per channel in the alarm_active() mask */
+#define ALARM_BIT(ch)       (1U << (ch))
+
+/**
+ * @brief Configure the buzzer and acknowledge pins and load the default limits.
+ *
+ * The pressure channel starts disabled.
+ */
+void alarm_init(void);
+
+/**
+ * @brief Set the limits of one channel.
+ *
+ * An alarm raises once the reading goes past low or high and clears once
+ * it is back inside by more than hyst, so a reading sitting on a limit
+ * does not make the buzzer chatter.
+ *
+ * @param ch Channel
+ * @param low Lower limit, or ALARM_OFF_LOW
+ * @param high Upper limit, or ALARM_OFF_HIGH
+ * @param hyst Clearing margin, same units
+ */
+void alarm_set_limits(Alarm_Channel ch, int32_t low, int32_t high, int32_t hyst);
+
+/**
+ * @brief Check a sample against the limits and drive the buzzer.
+ *
+ * Call on each new sample, after calibration and before any smoothing.
+ * A newly raised alarm sounds the buzzer even if an earlier one was
+ * acknowledged; the buzzer stops once no alarm is left.
+ *
+ * @param m Sample just taken
+ * @return 1 if an alarm was raised by this sample, 0 otherwise
+ */
+uint8_t alarm_check(const BME280_Measurement *m);
+
+/**
+ * @brief Active alarms.
+ *
+ * @return Mask of ALARM_BIT() for every channel past its limit
+ */
+uint8_t alarm_active(void);
+
+/**
+ * @brief Silence the buzzer; the alarms stay active until they clear.
+ */
+void alarm_acknowledge(void);
+
+/**
+ * @brief Acknowledge button interrupt, called from EXTI0_1_IRQHandler.
+ */
+void alarm_irq_handler(void);
+
+#endif // ALARM_H
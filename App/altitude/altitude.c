@@ -0,0 +1,58 @@
+/**
+ * @file altitude.c
+ * @brief Barometric altitude from Q24.8 pressure, absolute and relative
+ *
+ * The table step is 2^18 in Q24.8, so the segment index and the position
+ * inside it are a shift and a mask. Each call costs three multiplies and no
+ * division; the temperature scale is computed once per reference.
+ */
+
+#include "altitude.h"
+
+#define ALTITUDE_STEP_SHIFT 18      // 1024 Pa in Q24.8
+#define ALTITUDE_FRAC_BITS  14
+
+// ISA altitude in mm at 68 .. 109 * 1024 Pa
+static const int32_t altitude_table[] = {
+    3053596, 2938784, 2825313, 2713146, 2602251, 2492597, 2384152,
+    2276888, 2170775, 2065787, 1961897, 1859080, 1757312, 1656569,
+    1556828, 1458066, 1360264, 1263400, 1167455, 1072408, 978243,
+    884939, 792481, 700851, 610033, 520010, 430768, 342291,
+    254566, 167577, 81311, -4244, -89103, -173278, -256780,
+    -339622, -421815, -503371, -584300, -664614, -744322, -823434,
+};
+
+static int32_t ref_mm;
+static int32_t ref_scale;           // Actual / ISA air temperature, Q14; 0 unset
+
+int32_t altitude_from_pressure(uint32_t pressure)
+{
+    if (pressure < (uint32_t)ALTITUDE_P_MIN << 8) pressure = (uint32_t)ALTITUDE_P_MIN << 8;
+    if (pressure >= (uint32_t)ALTITUDE_P_MAX << 8) pressure = ((uint32_t)ALTITUDE_P_MAX << 8) - 1;
+
+    uint32_t x = pressure - ((uint32_t)ALTITUDE_P_MIN << 8);
+    uint8_t i = x >> ALTITUDE_STEP_SHIFT;
+    int32_t f = (x & ((1UL << ALTITUDE_STEP_SHIFT) - 1)) >> (ALTITUDE_STEP_SHIFT - ALTITUDE_FRAC_BITS);
+
+    // Newton forward form: h0 + f * d1 + f * (f - 1) / 2 * d2
+    const int32_t *h = &altitude_table[i];
+    int32_t d1 = h[1] - h[0];
+    int32_t d2 = h[2] - 2 * h[1] + h[0];
+    int32_t q = (f * (f - (1L << ALTITUDE_FRAC_BITS))) >> (ALTITUDE_FRAC_BITS + 1);
+    return h[0] + ((f * d1) >> ALTITUDE_FRAC_BITS) + ((q * d2) >> ALTITUDE_FRAC_BITS);
+}
+
+void altitude_set_reference(uint32_t pressure, int32_t temperature)
+{
+    ref_mm = altitude_from_pressure(pressure);
+    // ISA temperature at the reference: 288.15 K - 6.5 K/km, in 0.01 K
+    int32_t isa = 28815 - ref_mm / 1000 * 65 / 100;
+    ref_scale = (temperature + 27315) * 16384 / isa;
+}
+
+int32_t altitude_relative(uint32_t pressure)
+{
+    if (!ref_scale) return 0;
+    int64_t d = altitude_from_pressure(pressure) - ref_mm;
+    return (int32_t)((d * ref_scale) >> 14);
+}
@@ -0,0 +1,48 @@
+/**
+ * @file altitude.h
+ * @brief Barometric altitude from Q24.8 pressure, absolute and relative
+ */
+
+#ifndef ALTITUDE_H
+#define ALTITUDE_H
+
+#include <stdint.h>
+
+/** Pressure range of the table, Pa (about -820 m to 3050 m ISA) */
+#define ALTITUDE_P_MIN  (68L * 1024)
+#define ALTITUDE_P_MAX  (108L * 1024)
+
+/**
+ * @brief ISA altitude of a pressure, 44330.77 m * (1 - (P / 101325 Pa)^0.190263).
+ *
+ * Quadratic interpolation over a table of the formula in 1024 Pa steps,
+ * at a resolution of 1/16 Pa (5 to 7 mm); within 1 cm of the formula.
+ * Pressures outside the table range are clamped to it.
+ *
+ * @param pressure Q24.8 Pa
+ * @return Altitude in mm
+ */
+int32_t altitude_from_pressure(uint32_t pressure);
+
+/**
+ * @brief Capture the reference for altitude_relative().
+ *
+ * The air temperature at capture scales later height differences from the
+ * ISA lapse profile to the actual air column, which matters more for
+ * floor-to-floor changes than the table error.
+ *
+ * @param pressure Reference pressure, Q24.8 Pa
+ * @param temperature Air temperature, 0.01 degC
+ */
+void altitude_set_reference(uint32_t pressure, int32_t temperature);
+
+/**
+ * @brief Height above the captured reference.
+ *
+ * @param pressure Q24.8 Pa
+ * @return Height difference in mm, positive above the reference; 0 before
+ *         altitude_set_reference()
+ */
+int32_t altitude_relative(uint32_t pressure);
+
+#endif // ALTITUDE_H
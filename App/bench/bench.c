@@ -0,0 +1,400 @@
+/**
+ * @file bench.c
+ * @brief On-target benchmark suite for the Bench build configuration
+ */
+
+#include "bench.h"
+
+#if BENCH
+
+#include "bme280.h"
+#include "clock.h"
+#include "format.h"
+#include "i2c_bus.h"
+#include "oled.h"
+#include "prof.h"
+#include "sched.h"
+#include "telemetry.h"
+#include "tick.h"
+
+#if !TELEMETRY
+#error "BENCH reports over the telemetry UART"
+#endif
+
+#define BENCH_N_MATH    100
+#define BENCH_N_IO      10
+#define BENCH_NOISE_SHIFT   5   // 32 results per noise case
+#define BENCH_NOISE_WARMUP  4   // Results dropped after a profile change
+
+typedef struct {
+    const char *name;
+    void (*fn)(void);
+    uint16_t n;
+} bench_case;
+
+// Datasheet example for T and P; typical humidity coefficients
+static const BME280_Calib calib = {
+    27504, 26435, -1000,
+    36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000,
+    75, 0, 370, 313, 50, 30
+};
+static BME280_Coeffs coeffs;
+static BME280_TfineTerms terms;    // For the cases with t_fine unchanged
+// Volatile so the compiler cannot fold the inputs or drop the results
+static volatile int32_t adc_T = 519888, adc_P = 415148, adc_H = 30000;
+static volatile int32_t t_fine = 128422;
+static volatile int32_t sink;
+static uint8_t toggle;
+
+// Bounds of the RAMFUNC routines in SRAM, from the linker script
+extern const uint8_t _sramfunc[], _eramfunc[];
+
+static void bench_comp_t(void)
+{
+    sink = BME280_comp_temperature(BME280_comp_t_fine(&coeffs, adc_T));
+}
+
+static void bench_comp_p(void)
+{
+    sink = BME280_comp_pressure(&coeffs, adc_P, t_fine);
+}
+
+static void bench_comp_h(void)
+{
+    sink = BME280_comp_humidity(&coeffs, adc_H, t_fine);
+}
+
+static void bench_comp_p_adc(void)
+{
+    sink = BME280_comp_pressure_adc(&coeffs, &terms, adc_P);
+}
+
+static void bench_comp_h_adc(void)
+{
+    sink = BME280_comp_humidity_adc(&coeffs, &terms, adc_H);
+}
+
+static void bench_nop(void)
+{
+}
+
+// One post and its dispatch to an empty handler: the per-event overhead
+static void bench_event(void)
+{
+    sched_post(SCHED_EV_COMMAND);
+    sched_dispatch();
+}
+
+static void bench_format(void)
+{
+    char buf[16];
+    format_fixed(buf, sink | 2345, 2, 7);
+    sink = buf[0];
+}
+
+// Reciprocal divide against the libgcc one it replaces
+static void bench_div100(void)
+{
+    sink = (int32_t)format_div100((uint32_t)sink | 123456);
+}
+
+static void bench_div100_lib(void)
+{
+    sink = (int32_t)(((uint32_t)sink | 123456) / 100);
+}
+
+#if !OLED_DIRECT
+// Last cell of the bottom page, repainted by the full-frame case after it
+static void bench_glyph(void)
+{
+    toggle ^= 1;
+    oled_blit_glyph(OLED_WIDTH - OLED_CELL_WIDTH, OLED_PAGES - 1, toggle ? '8' : '0');
+}
+
+static void bench_oled_full(void)
+{
+    oled_invalidate();
+    oled_display();
+}
+
+// One cell where the forecast glyph goes, redrawn by the first history task
+static void bench_oled_partial(void)
+{
+    toggle ^= 1;
+    oled_putc(122, 4, toggle ? '8' : ' ');
+    oled_display();
+}
+#endif
+
+#if !BME280_SPI
+static void bench_i2c_burst(void)
+{
+    uint8_t buf[8];
+    i2c_bus_mem_read(BME280_ADDRESS, 0xF7, buf, sizeof(buf));
+}
+#else
+// The sensor is off I2C1 then; its data burst is timed over SPI instead
+static void bench_spi_burst(void)
+{
+    uint8_t buf[8];
+    BME280_spi_read(0xF7, buf, sizeof(buf));
+}
+#endif
+
+static const bench_case cases[] = {
+    { "comp_t", bench_comp_t, BENCH_N_MATH },
+    { "comp_p", bench_comp_p, BENCH_N_MATH },
+    { "comp_h", bench_comp_h, BENCH_N_MATH },
+    { "comp_p_adc", bench_comp_p_adc, BENCH_N_MATH },
+    { "comp_h_adc", bench_comp_h_adc, BENCH_N_MATH },
+    { "format", bench_format, BENCH_N_MATH },
+    { "div100", bench_div100, BENCH_N_MATH },
+    { "div100_lib", bench_div100_lib, BENCH_N_MATH },
+    { "event", bench_event, BENCH_N_MATH },
+#if !OLED_DIRECT
+    { "glyph", bench_glyph, BENCH_N_MATH },
+    { "oled_full", bench_oled_full, BENCH_N_IO },
+    { "oled_partial", bench_oled_partial, BENCH_N_IO },
+#endif
+#if BME280_SPI
+    { "spi_burst", bench_spi_burst, BENCH_N_IO },
+#endif
+};
+
+// Sensor oversampling against firmware averaging of x1 conversions; the
+// first row is the init default (BME280_PROFILE_INDOOR_NAV)
+static const struct {
+    const char *name;
+    BME280_Profile profile;
+    uint8_t shift;      // 2^shift conversions averaged per result
+} noise_cases[] = {
+    { "hw_p16_iir16", { BME280_OS_X2, BME280_OS_X16, BME280_OS_X4, BME280_FILTER_16, BME280_STANDBY_0_5MS }, 0 },
+    { "hw_p16", { BME280_OS_X2, BME280_OS_X16, BME280_OS_X4, BME280_FILTER_OFF, BME280_STANDBY_0_5MS }, 0 },
+    { "hw_p4", { BME280_OS_X1, BME280_OS_X4, BME280_OS_X1, BME280_FILTER_OFF, BME280_STANDBY_0_5MS }, 0 },
+    { "hw_p1", { BME280_OS_X1, BME280_OS_X1, BME280_OS_X1, BME280_FILTER_OFF, BME280_STANDBY_0_5MS }, 0 },
+    { "avg_p1_k4", { BME280_OS_X1, BME280_OS_X1, BME280_OS_X1, BME280_FILTER_OFF, BME280_STANDBY_0_5MS }, 2 },
+    { "avg_p1_k16", { BME280_OS_X1, BME280_OS_X1, BME280_OS_X1, BME280_FILTER_OFF, BME280_STANDBY_0_5MS }, 4 },
+    { "avg_p4_k4", { BME280_OS_X1, BME280_OS_X4, BME280_OS_X1, BME280_FILTER_OFF, BME280_STANDBY_0_5MS }, 2 },
+};
+
+#if !BME280_SPI
+static const struct {
+    const char *name;
+    I2C_BusSpeed speed;
+} speeds[] = {
+    { "i2c_sm", I2C_BUS_SPEED_STANDARD },
+    { "i2c_fm", I2C_BUS_SPEED_FAST },
+    { "i2c_fmp", I2C_BUS_SPEED_FAST_PLUS },
+};
+#endif
+
+static void bench_send(const char *line, uint8_t len)
+{
+    telemetry_write_blocking(line, len, BENCH_LSE_WAIT_MS);
+}
+
+static void bench_report(const char *name, uint16_t n, uint32_t cycles)
+{
+    char line[48];
+    uint8_t len = format_str(line, name);
+    line[len++] = ',';
+    len += format_fixed(line + len, n, 0, 0);
+    line[len++] = ',';
+    len += format_fixed(line + len, (int32_t)(cycles / n), 0, 0);
+    line[len++] = ',';
+    // 0.01 µs per op
+    uint32_t us100 = (uint32_t)((uint64_t)cycles * 100000000U / SystemCoreClock / n);
+    len += format_fixed(line + len, (int32_t)us100, 2, 0);
+    line[len++] = '\r';
+    line[len++] = '\n';
+    bench_send(line, len);
+}
+
+static void bench_run_case(const char *name, void (*fn)(void), uint16_t n)
+{
+    uint32_t start = prof_now();
+    for (uint16_t i = 0; i < n; i++)
+        fn();
+    bench_report(name, n, prof_now() - start);
+}
+
+// The CPU-bound cases again with the flash wait state exposed on every
+// fetch; the cases up to the first I/O one
+static void bench_no_prefetch(void)
+{
+    char name[24];
+
+    __HAL_FLASH_PREFETCH_BUFFER_DISABLE();
+    for (uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && cases[i].n == BENCH_N_MATH; i++)
+    {
+        uint8_t len = format_str(name, cases[i].name);
+        format_str(name + len, "_nopf");
+        bench_run_case(name, cases[i].fn, cases[i].n);
+    }
+    __HAL_FLASH_PREFETCH_BUFFER_ENABLE();
+}
+
+static uint32_t bench_isqrt(uint64_t v)
+{
+    uint32_t r = 0;
+    if (v > 0xFFFFFFFFU) v = 0xFFFFFFFFU;
+    for (uint32_t bit = 1U << 30; bit; bit >>= 2)
+    {
+        if (v >= r + bit)
+        {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+    }
+    return r;
+}
+
+// Population variance of 2^BENCH_NOISE_SHIFT deviations from their sums
+static uint64_t bench_variance(int64_t sum, int64_t sum_sq)
+{
+    return (uint64_t)(sum_sq - ((sum * sum) >> BENCH_NOISE_SHIFT)) >> BENCH_NOISE_SHIFT;
+}
+
+// Back-to-back results of one setting, each the mean of 2^shift
+// conversions compensated once, as main.c does with BME280_AVERAGE_SHIFT.
+// Noise is the standard deviation around the mean of the run, latency the
+// time per result, charge the sensor's from BME280_profile_charge_nc().
+static void bench_noise_case(BME280_Dev *dev, uint8_t i)
+{
+    char line[64];
+    uint8_t shift = noise_cases[i].shift;
+    int64_t p_sum = 0, p_sq = 0, t_sum = 0, t_sq = 0;
+    int32_t p0 = 0, t0 = 0;
+    uint32_t start = 0;
+
+    BME280_set_profile(dev, &noise_cases[i].profile);
+    for (uint16_t r = 0; r < BENCH_NOISE_WARMUP + (1U << BENCH_NOISE_SHIFT); r++)
+    {
+        if (r == BENCH_NOISE_WARMUP) start = HAL_GetTick();
+
+        BME280_Raw sum = { 0, 0, 0 }, raw;
+        for (uint8_t k = 0; k < 1U << shift; k++)
+        {
+            if (BME280_read_raw(dev, &raw) != BME280_OK) return;
+            BME280_raw_add(&sum, &raw);
+        }
+        BME280_raw_mean(&sum, shift);
+        BME280_Measurement m;
+        BME280_compensate(dev, &sum, &m);
+        if (r < BENCH_NOISE_WARMUP)
+        {
+            p0 = (int32_t)m.pressure;
+            t0 = m.temperature;
+            continue;
+        }
+        int32_t dp = (int32_t)m.pressure - p0, dt = m.temperature - t0;
+        p_sum += dp;
+        p_sq += (int64_t)dp * dp;
+        t_sum += dt;
+        t_sq += (int64_t)dt * dt;
+    }
+    uint32_t elapsed_ms = HAL_GetTick() - start;
+
+    uint8_t len = format_str(line, "noise,");
+    len += format_str(line + len, noise_cases[i].name);
+    line[len++] = ',';
+    len += format_fixed(line + len, 1 << BENCH_NOISE_SHIFT, 0, 0);
+    line[len++] = ',';
+    // Q24.8 Pa squared to 0.01 Pa: x 100^2 / 256^2
+    len += format_fixed(line + len, (int32_t)bench_isqrt(bench_variance(p_sum, p_sq) * 625 / 4096), 2, 0);
+    line[len++] = ',';
+    // 0.01 degC squared to 0.001 degC: x 10^2
+    len += format_fixed(line + len, (int32_t)bench_isqrt(bench_variance(t_sum, t_sq) * 100), 3, 0);
+    line[len++] = ',';
+    len += format_fixed(line + len, (int32_t)((elapsed_ms * 1000U) >> BENCH_NOISE_SHIFT), 0, 0);
+    line[len++] = ',';
+    len += format_fixed(line + len, (int32_t)(BME280_profile_charge_nc(&noise_cases[i].profile) << shift), 0, 0);
+    len += format_str(line + len, "\r\n");
+    bench_send(line, len);
+}
+
+// A context of its own on the sensor main() already set up; it is left
+// at the default profile, which is what main()'s context expects
+static void bench_noise(void)
+{
+    static BME280_Dev dev;
+
+    BME280_setup(&dev, BME280_ADDRESS, 1);
+    if (!BME280_resume(&dev, BME280_MODE_FORCED)) return;
+    for (uint8_t i = 0; i < sizeof(noise_cases) / sizeof(noise_cases[0]); i++)
+        bench_noise_case(&dev, i);
+    BME280_set_profile(&dev, &BME280_DEFAULT_PROFILE);
+}
+
+// Same sequence as sched_idle(), woken by the LPTIM tick deadline
+static void bench_stop(void)
+{
+    uint32_t entry = 0, exit = 0;
+
+    for (uint8_t i = 0; i < BENCH_N_IO; i++)
+    {
+        tick_wakeup_at(HAL_GetTick() + 2);
+        __disable_irq();
+        uint32_t t0 = prof_now();
+        clock_prepare_stop();
+        HAL_SuspendTick();
+        uint32_t t1 = prof_now();
+        HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+        uint32_t t2 = prof_now();
+        __enable_irq();
+        clock_restore();
+        HAL_ResumeTick();
+        uint32_t t3 = prof_now();
+
+        entry += t1 - t0;
+        exit += t3 - t2;
+    }
+    bench_report("stop_entry", BENCH_N_IO, entry);
+    bench_report("stop_exit", BENCH_N_IO, exit);
+}
+
+void bench_run(void)
+{
+    char line[32];
+    uint8_t len;
+
+    BME280_coeffs_derive(&coeffs, &calib);
+    BME280_comp_pressure_terms(&coeffs, t_fine, &terms);
+    BME280_comp_humidity_terms(&coeffs, t_fine, &terms);
+    clock_set_profile(CLOCK_PROFILE_BURST);
+    len = format_str(line, "# bench 1 ");
+    len += format_fixed(line + len, (int32_t)SystemCoreClock, 0, 0);
+    len += format_str(line + len, "\r\n");
+    bench_send(line, len);
+    len = format_str(line, "# ramfunc ");
+    len += format_fixed(line + len, (int32_t)(_eramfunc - _sramfunc), 0, 0);
+    len += format_str(line + len, "\r\n");
+    bench_send(line, len);
+
+    // The event case borrows the command event; nothing else runs yet
+    sched_task_fn command = sched_on(SCHED_EV_COMMAND, bench_nop);
+    for (uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        bench_run_case(cases[i].name, cases[i].fn, cases[i].n);
+    bench_no_prefetch();
+    sched_on(SCHED_EV_COMMAND, command);
+
+#if !BME280_SPI
+    for (uint8_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+    {
+        // Speeds the current clock cannot reach are left out of the report
+        if (i2c_bus_set_speed(speeds[i].speed) == HAL_OK)
+            bench_run_case(speeds[i].name, bench_i2c_burst, BENCH_N_IO);
+    }
+    i2c_bus_set_speed(I2C_BUS_DEFAULT_SPEED);
+#endif
+
+    bench_stop();
+    bench_noise();
+    bench_send("# end\r\n", 7);
+}
+
+#endif
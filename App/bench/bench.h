@@ -0,0 +1,56 @@
+/**
+ * @file bench.h
+ * @brief On-target benchmark suite for the Bench build configuration
+ *
+ * The Bench configuration defines BENCH, which also turns on the
+ * profiling counter (prof.h). main() then runs the suite once after
+ * start-up, in the BURST clock profile, and reports over the telemetry
+ * UART before entering the scheduler. Tools/bench.py reads the report.
+ *
+ * Report, ASCII lines ending in CR LF:
+ *
+ *     # bench 1 <HCLK in Hz>
+ *     # ramfunc <bytes of code placed in SRAM by RAMFUNC (ramfunc.h)>
+ *     <case>,<iterations>,<cycles per op>,<µs per op, 2 decimals>
+ *     ...
+ *     noise,<setting>,<results>,<pressure noise, 0.01 Pa>,
+ *           <temperature noise, 0.001 degC>,<µs per result>,<nC per result>
+ *     ...
+ *     # end
+ *
+ * Cycle counts include the loop and an indirect call, a few cycles per
+ * op. The CPU-bound cases are repeated with the flash prefetch buffer
+ * off, with a _nopf suffix. Comparing a RAMFUNC build against a baseline
+ * one with Tools/bench.py gives the gain of each group for its bytes.
+ * The STOP rows only cover the software around the sleep: the
+ * counter halts in STOP itself, and stop_exit runs partly on the 16 MHz
+ * wake-up clock, so its µs figure is a lower bound.
+ *
+ * The noise rows, one line each in the report, compare the sensor's
+ * oversampling with BME280_AVERAGE_SHIFT style firmware averaging on the
+ * real sensor: the standard deviation of back-to-back results, the time
+ * per result and the modelled sensor charge per result. They include any
+ * real change of the air during the run, a few seconds.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifndef BENCH
+#define BENCH 0
+#endif
+
+#define BENCH_LSE_WAIT_MS   3000    // Crystal start-up allowance before the report
+
+#if BENCH
+/**
+ * @brief Run the suite and send the report.
+ *
+ * Needs telemetry_init(), sched_init() and an initialised display and
+ * sensor bus. Leaves the clock in BURST, the bus at the default speed and
+ * the sensor at BME280_DEFAULT_PROFILE.
+ */
+void bench_run(void);
+#endif
+
+#endif // BENCH_H
@@ -2,196 +2,593 @@
  * @file bme280.c
  * @brief Driver for Bosch BME280 environmental sensor (temperature, pressure, humidity)
  * 
- * This implementation provides support for I2C communication with the BME280 sensor.
+ * This implementation provides support for I2C communication with the BME280 sensor,
+ * or SPI with BME280_SPI (bme280_spi.c).
  * It performs initialization, data acquisition, and compensation using fixed-point 
  * arithmetic based on Bosch’s official datasheet (see section 4.2.3).
  * 
  * Key features:
- * - All measured values (temperature, pressure, humidity) are stored in a dedicated
- *   handler (`BME280_Data`) with integer and fractional parts separated. This avoids
- *   the use of floating-point numbers.
+ * - All measured values (temperature, pressure, humidity) are kept in one
+ *   `BME280_Measurement` in the native fixed-point formats; the integer/fraction
+ *   getters split them on demand. This avoids the use of floating-point numbers.
  * 
  * - The entire implementation is optimized for flash size — formulas and logic are 
  *   written in a compact and less verbose way to reduce memory footprint, even at the
  *   cost of some readability.
  * 
- * - Compensation algorithms follow Bosch-recommended fixed-point integer versions,
+ * - Compensation algorithms (bme280_comp.c) follow Bosch-recommended fixed-point integer versions,
  *   ensuring accuracy while remaining efficient on low-power MCUs.
  * 
- * - A manual pressure offset is applied to the 
- *   final pressure result. This was added during testing due to consistently high 
- *   readings from the sensor, which appeared to be ~200 hPa above expected values.
+ * - Pressure readings used to come out ~200 hPa high and were corrected with a
+ *   fixed offset. The cause was the 64-bit intermediates of the pressure
+ *   formula being stored in 32-bit variables; with proper int64 terms no
+ *   offset is needed.
+ * 
+ * - All per-sensor state is kept in a caller-owned BME280_Dev, so two sensors
+ *   (0x76 and 0x77) can run side by side; BME280_read_all() overlaps their
+ *   forced conversions so both cost a single conversion wait.
  * 
  * This driver is suitable for applications where memory and power efficiency are
  * prioritized over abstraction or extensibility.
  */
 
 #include "bme280.h"
+#include "eeprom.h"
+#include "format.h"
+#include "i2c_bus.h"
+#include "bme280_spi.h"
+#include "tick.h"
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+// Shared by all sensors: the energy accounting wants the total
+static uint32_t bme_conversions;
+static uint32_t bme_charge_nc;
+
+// Register access over the transport selected with BME280_SPI
+static HAL_StatusTypeDef BME280_reg_read(const BME280_Dev *dev, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+#if BME280_SPI
+    (void)dev;
+    return BME280_spi_read(reg, buf, len);
+#else
+    return i2c_bus_mem_read(dev->addr, reg, buf, len);
+#endif
+}
 
-#define PRESSURE_OFFSET 200
+static HAL_StatusTypeDef BME280_reg_write(const BME280_Dev *dev, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+#if BME280_SPI
+    (void)dev;
+    return BME280_spi_write(reg, buf, len);
+#else
+    return i2c_bus_mem_write(dev->addr, reg, buf, len);
+#endif
+}
+
+static const uint8_t os_factor[8] = { 0, 1, 2, 4, 8, 16, 16, 16 };
 
-static uint16_t dig_T1;
-static int16_t dig_T2, dig_T3;
-static uint16_t dig_P1;
-static int16_t dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
-static uint8_t dig_H1, dig_H3;
-static int16_t dig_H2, dig_H4, dig_H5;
-static int8_t dig_H6;
+const BME280_Profile BME280_PROFILE_WEATHER    = { BME280_OS_X1, BME280_OS_X1,   BME280_OS_X1,   BME280_FILTER_OFF, BME280_STANDBY_1000MS };
+const BME280_Profile BME280_PROFILE_HUMIDITY   = { BME280_OS_X1, BME280_OS_SKIP, BME280_OS_X1,   BME280_FILTER_OFF, BME280_STANDBY_1000MS };
+const BME280_Profile BME280_PROFILE_INDOOR_NAV = { BME280_OS_X2, BME280_OS_X16,  BME280_OS_X4,   BME280_FILTER_16,  BME280_STANDBY_0_5MS };
+const BME280_Profile BME280_PROFILE_GAMING     = { BME280_OS_X1, BME280_OS_X4,   BME280_OS_SKIP, BME280_FILTER_16,  BME280_STANDBY_0_5MS };
 
-static int32_t t_fine;
-static BME280_Data bme_data;
+uint32_t BME280_profile_measurement_us(const BME280_Profile *profile)
+{
+    // t = 1.25 + 2.3·T_os + (2.3·P_os + 0.575) + (2.3·H_os + 0.575) ms
+    uint32_t t_us = 1250 + 2300 * os_factor[profile->osrs_t & 7];
+    if (profile->osrs_p) t_us += 2300 * os_factor[profile->osrs_p & 7] + 575;
+    if (profile->osrs_h) t_us += 2300 * os_factor[profile->osrs_h & 7] + 575;
+    return t_us;
+}
+
+uint32_t BME280_profile_charge_nc(const BME280_Profile *profile)
+{
+    // Typical timing is 2 ms per oversampling step plus 0.5 ms per P/H channel
+    uint32_t q = 350 * (1 + 2 * os_factor[profile->osrs_t & 7]);
+    if (profile->osrs_p) q += 714 * (2 * os_factor[profile->osrs_p & 7]) + 714 / 2;
+    if (profile->osrs_h) q += 340 * (2 * os_factor[profile->osrs_h & 7]) + 340 / 2;
+    return q;
+}
+
+/**
+ * @brief Start a forced-mode conversion without waiting for it.
+ *
+ * @return BME280_OK or BME280_ERR_BUS
+ */
+static BME280_Status BME280_start_conversion(BME280_Dev *dev)
+{
+    uint8_t ctrl_meas = (dev->ctrl_meas & ~0x03) | BME280_MODE_FORCED;
+    if (BME280_reg_write(dev, 0xF4, &ctrl_meas, 1) != HAL_OK) return BME280_ERR_BUS;
+    bme_conversions++;
+    bme_charge_nc += dev->conv_nc;
+    return BME280_OK;
+}
+
+/**
+ * @brief Wait for a started conversion past its maximum measurement time.
+ *
+ * The `measuring` bit of the status register (0xF3, bit 3) is polled for a
+ * few more milliseconds before giving up.
+ *
+ * @return BME280_OK, BME280_ERR_BUS or BME280_ERR_TIMEOUT
+ */
+static BME280_Status BME280_finish_conversion(BME280_Dev *dev)
+{
+    uint8_t status;
+    for (uint8_t retry = 0; retry < 5; retry++)
+    {
+        if (BME280_reg_read(dev, 0xF3, &status, 1) != HAL_OK) return BME280_ERR_BUS;
+        if (!(status & 0x08)) return BME280_OK;
+        HAL_Delay(1);
+    }
+    return BME280_ERR_TIMEOUT;
+}
+
+/**
+ * @brief Raw calibration block as cached in data EEPROM.
+ *
+ * The CRC covers everything before it, including the I2C address, so a block
+ * written for a sensor at the other address is never used.
+ */
+typedef struct {
+    uint8_t calib1[BME280_CALIB1_LEN];  // 0x88 .. 0xA1
+    uint8_t calib2[BME280_CALIB2_LEN];  // 0xE1 .. 0xE7
+    uint8_t address;
+    uint16_t crc;
+} BME280_CalibCache;
 
 /**
  * @brief Read calibration coefficients from BME280 non-volatile memory.
  *
  * This function reads the factory-programmed calibration parameters from the
- * sensor's memory (addresses 0x88 to 0xA1 and 0xE1 to 0xE7) and stores them in
- * global static variables. These coefficients are later used to compute the
- * compensated temperature, pressure, and humidity values as described in
- * section 4.2.2 of the datasheet.
+ * sensor's memory (addresses 0x88 to 0xA1 and 0xE1 to 0xE7), decodes them
+ * and derives dev->coeffs from them. These coefficients are later used to
+ * compute the compensated temperature, pressure, and humidity values as
+ * described in section 4.2.2 of the datasheet.
+ *
+ * On warm starts the block is taken from the data EEPROM cache instead. The
+ * cache is accepted when its CRC and address match and dig_T1 read back from
+ * the sensor (a single 2-byte read) equals the cached value, which catches a
+ * swapped sensor. Otherwise the full block is read and the cache rewritten.
+ * There is room for one cached block; sensors set up without the cache
+ * always read the sensor.
  *
- * @param hi2c Pointer to HAL I2C handle
+ * @return 1 on success, 0 if the sensor could not be read
  */
-static void BME280_read_calibration(I2C_HandleTypeDef *hi2c)
+static void BME280_load_coeffs(BME280_Dev *dev, const uint8_t *calib1, const uint8_t *calib2)
 {
-    uint8_t calib1[26], calib2[7];
+    BME280_Calib c;
+    BME280_calib_parse(&c, calib1, calib2);
+    BME280_coeffs_derive(&dev->coeffs, &c);
+}
 
-    HAL_I2C_Mem_Read(hi2c, BME280_ADDRESS, 0x88, 1, calib1, 26, HAL_MAX_DELAY);
-    HAL_I2C_Mem_Read(hi2c, BME280_ADDRESS, 0xE1, 1, calib2, 7, HAL_MAX_DELAY);
+static uint8_t BME280_read_calibration(BME280_Dev *dev)
+{
+    const BME280_CalibCache *cached = eeprom_ptr(EEPROM_BME280_CALIB);
 
-    dig_T1 = (calib1[1] << 8) | calib1[0];
-    dig_T2 = (calib1[3] << 8) | calib1[2];
-    dig_T3 = (calib1[5] << 8) | calib1[4];
-    dig_P1 = (calib1[7] << 8) | calib1[6];
-    dig_P2 = (calib1[9] << 8) | calib1[8];
-    dig_P3 = (calib1[11] << 8) | calib1[10];
-    dig_P4 = (calib1[13] << 8) | calib1[12];
-    dig_P5 = (calib1[15] << 8) | calib1[14];
-    dig_P6 = (calib1[17] << 8) | calib1[16];
-    dig_P7 = (calib1[19] << 8) | calib1[18];
-    dig_P8 = (calib1[21] << 8) | calib1[20];
-    dig_P9 = (calib1[23] << 8) | calib1[22];
+    if (dev->cached && cached->address == dev->addr &&
+        cached->crc == eeprom_crc16(cached, offsetof(BME280_CalibCache, crc)))
+    {
+        uint8_t t1[2];
+        if (BME280_reg_read(dev, 0x88, t1, 2) != HAL_OK) return 0;
+        if (t1[0] == cached->calib1[0] && t1[1] == cached->calib1[1])
+        {
+            BME280_load_coeffs(dev, cached->calib1, cached->calib2);
+            return 1;
+        }
+    }
 
-    dig_H1 = calib1[25];
-    dig_H2 = (calib2[1] << 8) | calib2[0];
-    dig_H3 = calib2[2];
-    dig_H4 = (calib2[3] << 4) | (calib2[4] & 0x0F);
-    dig_H5 = (calib2[5] << 4) | (calib2[4] >> 4);
-    dig_H6 = (int8_t)calib2[6];
+    BME280_CalibCache c;
+    memset(&c, 0, sizeof(c));
+    // Never cache a partial block
+    if (BME280_reg_read(dev, 0x88, c.calib1, BME280_CALIB1_LEN) != HAL_OK ||
+        BME280_reg_read(dev, 0xE1, c.calib2, BME280_CALIB2_LEN) != HAL_OK)
+        return 0;
+    BME280_load_coeffs(dev, c.calib1, c.calib2);
+    if (!dev->cached) return 1;
+
+    c.address = dev->addr;
+    c.crc = eeprom_crc16(&c, offsetof(BME280_CalibCache, crc));
+    eeprom_write(EEPROM_BME280_CALIB, &c, sizeof(c));
+    return 1;
+}
+
+void BME280_setup(BME280_Dev *dev, uint8_t addr, uint8_t cached)
+{
+    memset(dev, 0, sizeof(*dev));
+    dev->addr = addr;
+    dev->cached = cached;
+    dev->channels = BME280_CHANNEL_ALL;
+    dev->last_adc_T = -1;
+#if BME280_SPI
+    BME280_spi_init();
+#else
+    i2c_bus_set_priority(addr, BME280_BUS_PRIO);
+#endif
 }
 
-uint8_t BME280_init(I2C_HandleTypeDef *hi2c)
+uint8_t BME280_reset(BME280_Dev *dev)
 {
     uint8_t id = 0;
-    HAL_I2C_Mem_Read(hi2c, BME280_ADDRESS, 0xD0, 1, &id, 1, HAL_MAX_DELAY);
+    BME280_reg_read(dev, 0xD0, &id, 1);
     if (id != 0x60) return 0;
 
     uint8_t reset_cmd = 0xB6;
-    HAL_I2C_Mem_Write(hi2c, BME280_ADDRESS, 0xE0, 1, &reset_cmd, 1, HAL_MAX_DELAY);
-    HAL_Delay(100);
+    if (BME280_reg_write(dev, 0xE0, &reset_cmd, 1) != HAL_OK) return 0;
+    dev->reset_pending = 1;
+    return 1;
+}
+
+/**
+ * @brief Wait until the sensor has copied its NVM after a soft reset.
+ *
+ * Polls `im_update` (status register 0xF3, bit 0). Reads that are NACKed
+ * while the sensor is still starting up are simply retried.
+ *
+ * @return 1 when ready, 0 on timeout
+ */
+static uint8_t BME280_wait_ready(BME280_Dev *dev)
+{
+    uint32_t start = HAL_GetTick();
+    do
+    {
+        uint8_t status;
+        if (BME280_reg_read(dev, 0xF3, &status, 1) == HAL_OK &&
+            !(status & 0x01))
+            return 1;
+    } while (HAL_GetTick() - start < BME280_RESET_TIMEOUT_MS);
+    return 0;
+}
 
-    // 1. Ustaw oversampling wilgotności ×4
-    uint8_t hum_ctrl = 0x03;  // osrs_h = 011
-    HAL_I2C_Mem_Write(hi2c, BME280_ADDRESS, 0xF2, 1, &hum_ctrl, 1, HAL_MAX_DELAY);
+uint8_t BME280_init(BME280_Dev *dev, BME280_Mode mode)
+{
+    if (!dev->reset_pending && !BME280_reset(dev)) return 0;
+    dev->reset_pending = 0;
+    if (!BME280_wait_ready(dev)) return 0;
 
-    // 2. Ustaw filtr IIR (coeff 16) i standby time 0.5ms
-    uint8_t config = 0x10;  // filter = 100, t_sb = 000
-    HAL_I2C_Mem_Write(hi2c, BME280_ADDRESS, 0xF5, 1, &config, 1, HAL_MAX_DELAY);
+    dev->mode = mode;
+    dev->last_adc_T = -1;
+    BME280_set_profile(dev, &BME280_DEFAULT_PROFILE);
 
-    // 3. Ustaw oversampling temp ×2, pressure ×16, tryb normalny
-    uint8_t ctrl_meas = 0x57;  // osrs_t = 010, osrs_p = 101, mode = 11
-    HAL_I2C_Mem_Write(hi2c, BME280_ADDRESS, 0xF4, 1, &ctrl_meas, 1, HAL_MAX_DELAY);
+    return BME280_read_calibration(dev);
+}
 
-    BME280_read_calibration(hi2c);
-    return 1;
+uint8_t BME280_resume(BME280_Dev *dev, BME280_Mode mode)
+{
+    uint8_t id = 0;
+    if (BME280_reg_read(dev, 0xD0, &id, 1) != HAL_OK || id != 0x60) return 0;
+
+    // The sensor may still be converting in normal mode from before the
+    // reset; treat it as running so the profile write puts it to sleep first
+    dev->ctrl_meas = BME280_MODE_NORMAL;
+    dev->mode = mode;
+    dev->last_adc_T = -1;
+    BME280_set_profile(dev, &BME280_DEFAULT_PROFILE);
+
+    return BME280_read_calibration(dev);
+}
+
+void BME280_set_profile(BME280_Dev *dev, const BME280_Profile *profile)
+{
+    dev->profile = *profile;
+
+    // Disabled channels are skipped whatever the profile asks for
+    BME280_Profile applied = *profile;
+    if (!(dev->channels & BME280_CHANNEL_PRESSURE)) applied.osrs_p = BME280_OS_SKIP;
+    if (!(dev->channels & BME280_CHANNEL_HUMIDITY)) applied.osrs_h = BME280_OS_SKIP;
+    profile = &applied;
+
+    // Config writes are only guaranteed in sleep mode; the mode last
+    // written counts, as BME280_set_mode() changes dev->mode ahead of this
+    uint8_t sleep = 0x00;
+    if ((dev->ctrl_meas & 0x03) == BME280_MODE_NORMAL)
+        BME280_reg_write(dev, 0xF4, &sleep, 1);
+
+    // ctrl_hum only takes effect after the following ctrl_meas write
+    uint8_t ctrl_hum = profile->osrs_h;
+    BME280_reg_write(dev, 0xF2, &ctrl_hum, 1);
+
+    uint8_t config = (profile->t_sb << 5) | (profile->filter << 2);
+    BME280_reg_write(dev, 0xF5, &config, 1);
+
+    // W trybie wymuszonym czujnik śpi aż do następnego odczytu (mode = 00)
+    uint8_t ctrl_meas = (profile->osrs_t << 5) | (profile->osrs_p << 2) |
+                        (dev->mode == BME280_MODE_NORMAL ? BME280_MODE_NORMAL : BME280_MODE_SLEEP);
+    BME280_reg_write(dev, 0xF4, &ctrl_meas, 1);
+
+    dev->ctrl_meas = ctrl_meas;
+    dev->meas_time_ms = (BME280_profile_measurement_us(profile) + 999) / 1000;
+    dev->conv_nc = BME280_profile_charge_nc(profile);
+    dev->conv_pending = 0;  // A started conversion was cut short by the sleep write
+}
+
+void BME280_set_mode(BME280_Dev *dev, BME280_Mode mode)
+{
+    dev->mode = mode;
+    BME280_set_profile(dev, &dev->profile);
+}
+
+const BME280_Profile *BME280_get_profile(const BME280_Dev *dev)
+{
+    return &dev->profile;
 }
 
-void BME280_read_data(I2C_HandleTypeDef *hi2c)
+uint32_t BME280_conversion_count(void)
 {
-    uint8_t buf[8];
-    HAL_I2C_Mem_Read(hi2c, BME280_ADDRESS, 0xF7, 1, buf, 8, HAL_MAX_DELAY);
+    return bme_conversions;
+}
 
-    int32_t adc_P = (buf[0] << 12) | (buf[1] << 4) | (buf[2] >> 4);
-    int32_t adc_T = (buf[3] << 12) | (buf[4] << 4) | (buf[5] >> 4);
-    int32_t adc_H = (buf[6] << 8) | buf[7];
+uint32_t BME280_conversion_charge_nc(void)
+{
+    return bme_charge_nc;
+}
 
-    int32_t var1, var2, T;
-    var1 = ((((adc_T >> 3) - ((int32_t)dig_T1 << 1))) * ((int32_t)dig_T2)) >> 11;
-    var2 = (((((adc_T >> 4) - ((int32_t)dig_T1)) * ((adc_T >> 4) - ((int32_t)dig_T1))) >> 12) *
-            ((int32_t)dig_T3)) >> 14;
-    t_fine = var1 + var2;
-    T = (t_fine * 5 + 128) >> 8;
-    bme_data.temp_integer = T / 100;
-    bme_data.temp_fraction = T % 100;
+void BME280_set_channels(BME280_Dev *dev, uint8_t channels)
+{
+    dev->channels = channels | BME280_CHANNEL_TEMPERATURE;
+    if (!(dev->channels & BME280_CHANNEL_PRESSURE)) dev->last.pressure = 0;
+    if (!(dev->channels & BME280_CHANNEL_HUMIDITY)) dev->last.humidity = 0;
+    dev->last_adc_T = -1;   // Recompensate everything that is still enabled
 
-    int64_t p;
-    var1 = ((int64_t)t_fine) - 128000;
-    var2 = var1 * var1 * (int64_t)dig_P6;
-    var2 = var2 + ((var1 * (int64_t)dig_P5) << 17);
-    var2 = var2 + (((int64_t)dig_P4) << 35);
-    var1 = ((var1 * var1 * (int64_t)dig_P3) >> 8) + ((var1 * (int64_t)dig_P2) << 12);
-    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)dig_P1) >> 33;
+    BME280_set_profile(dev, &dev->profile);
+}
 
-    if (var1 == 0)
+/**
+ * @brief Burst-read the data registers.
+ *
+ * @return BME280_OK or BME280_ERR_BUS
+ */
+static BME280_Status BME280_fetch(BME280_Dev *dev, BME280_Raw *raw)
+{
+    // 0xF7 press (3), 0xFA temp (3), 0xFD hum (2): read only the span needed
+    uint8_t has_p = dev->channels & BME280_CHANNEL_PRESSURE;
+    uint8_t has_h = dev->channels & BME280_CHANNEL_HUMIDITY;
+    uint8_t first = has_p ? 0 : 3;
+    uint8_t end = has_h ? 8 : 6;
+
+    uint8_t buf[8] = { 0 };
+    if (BME280_reg_read(dev, 0xF7 + first, buf + first, end - first) != HAL_OK)
+        return BME280_ERR_BUS;
+
+    raw->adc_P = (buf[0] << 12) | (buf[1] << 4) | (buf[2] >> 4);
+    raw->adc_T = (buf[3] << 12) | (buf[4] << 4) | (buf[5] >> 4);
+    raw->adc_H = (buf[6] << 8) | buf[7];
+    return BME280_OK;
+}
+
+static uint8_t BME280_step_ok(int32_t now, int32_t last, int32_t limit)
+{
+    return !limit || (now > last ? now - last : last - now) <= limit;
+}
+
+/**
+ * @brief Plausibility checks on a fresh burst, ahead of compensation.
+ *
+ * A few compares per channel: sentinels first, then the step limits
+ * against the last compensated values while they are known.
+ *
+ * @return BME280_OK or BME280_ERR_INVALID
+ */
+static BME280_Status BME280_check(BME280_Dev *dev, const BME280_Raw *raw)
+{
+    uint8_t has_p = dev->channels & BME280_CHANNEL_PRESSURE;
+    uint8_t has_h = dev->channels & BME280_CHANNEL_HUMIDITY;
+
+    // 0x80000 / 0x8000: skipped or not converted since reset; all ones
+    // or zeros: a bus that returned no data
+    if (raw->adc_T == 0x80000 || raw->adc_T == 0xFFFFF || raw->adc_T == 0)
+        return BME280_ERR_INVALID;
+    if (has_p && (raw->adc_P == 0x80000 || raw->adc_P == 0xFFFFF || raw->adc_P == 0))
+        return BME280_ERR_INVALID;
+    if (has_h && (raw->adc_H == 0x8000 || raw->adc_H == 0xFFFF))
+        return BME280_ERR_INVALID;
+
+    if (dev->last_adc_T < 0) return BME280_OK;     // Nothing to compare with
+    if (BME280_step_ok(raw->adc_T, dev->last_adc_T, BME280_STEP_T) &&
+        (!has_p || BME280_step_ok(raw->adc_P, dev->last_adc_P, BME280_STEP_P)) &&
+        (!has_h || BME280_step_ok(raw->adc_H, dev->last_adc_H, BME280_STEP_H)))
+    {
+        dev->rejects = 0;
+        return BME280_OK;
+    }
+    if (++dev->rejects < BME280_STEP_REJECTS) return BME280_ERR_INVALID;
+
+    // Still there after several reads: a real step. Drop the reference so
+    // the rest of an averaged sample passes too
+    dev->rejects = 0;
+    dev->last_adc_T = -1;
+    return BME280_OK;
+}
+
+void BME280_compensate(BME280_Dev *dev, const BME280_Raw *raw, BME280_Measurement *m)
+{
+    uint8_t has_p = dev->channels & BME280_CHANNEL_PRESSURE;
+    uint8_t has_h = dev->channels & BME280_CHANNEL_HUMIDITY;
+    int32_t adc_P = raw->adc_P;
+    int32_t adc_T = raw->adc_T;
+    int32_t adc_H = raw->adc_H;
+
+    // With the IIR filter the raw values often repeat between 1 Hz reads.
+    // t_fine feeds both pressure and humidity, so a new t_fine invalidates
+    // all; their t_fine-only terms are kept until it changes.
+    uint8_t t_changed = 0;
+    if (adc_T != dev->last_adc_T)
     {
-        bme_data.pressure_integer = 0;
-        bme_data.pressure_fraction = 0;
+        int32_t t_fine = BME280_comp_t_fine(&dev->coeffs, adc_T);
+        if (dev->last_adc_T < 0 || t_fine != dev->t_fine)
+        {
+            t_changed = 1;
+            dev->t_fine = t_fine;
+            dev->terms_valid = 0;
+            dev->last.temperature = BME280_comp_temperature(t_fine);
+        }
     }
-    else
+    uint8_t p_changed = has_p && (t_changed || adc_P != dev->last_adc_P);
+    uint8_t h_changed = has_h && (t_changed || adc_H != dev->last_adc_H);
+    dev->last_adc_T = adc_T;
+    dev->last_adc_P = adc_P;
+    dev->last_adc_H = adc_H;
+
+    if (p_changed)
     {
-        p = 1048576 - adc_P;
-        p = (((p << 31) - var2) * 3125) / var1;
-        var1 = (((int64_t)dig_P9) * (p >> 13) * (p >> 13)) >> 25;
-        var2 = (((int64_t)dig_P8) * p) >> 19;
-        p = ((p + var1 + var2) >> 8) + (((int64_t)dig_P7) << 4);
-        int32_t pressure_pa = (int32_t)(p / 256);
-        bme_data.pressure_integer = (pressure_pa / 100) - PRESSURE_OFFSET;
-        bme_data.pressure_fraction = pressure_pa % 100;
+        if (!(dev->terms_valid & BME280_CHANNEL_PRESSURE))
+            BME280_comp_pressure_terms(&dev->coeffs, dev->t_fine, &dev->terms);
+        dev->terms_valid |= BME280_CHANNEL_PRESSURE;
+        dev->last.pressure = BME280_comp_pressure_adc(&dev->coeffs, &dev->terms, adc_P);
     }
+    if (h_changed)
+    {
+        if (!(dev->terms_valid & BME280_CHANNEL_HUMIDITY))
+            BME280_comp_humidity_terms(&dev->coeffs, dev->t_fine, &dev->terms);
+        dev->terms_valid |= BME280_CHANNEL_HUMIDITY;
+        dev->last.humidity = BME280_comp_humidity_adc(&dev->coeffs, &dev->terms, adc_H);
+    }
+    if (m) *m = dev->last;
+}
 
-    int32_t v_x1_u32r;
-    v_x1_u32r = t_fine - ((int32_t)76800);
-    v_x1_u32r = (((((adc_H << 14) - (((int32_t)dig_H4) << 20) -
-                   (((int32_t)dig_H5) * v_x1_u32r)) + ((int32_t)16384)) >> 15) *
-                 (((((((v_x1_u32r * ((int32_t)dig_H6)) >> 10) *
-                      (((v_x1_u32r * ((int32_t)dig_H3)) >> 11) + ((int32_t)32768))) >> 10) +
-                    ((int32_t)2097152)) * ((int32_t)dig_H2) + 8192) >> 14));
+void BME280_raw_add(BME280_Raw *sum, const BME280_Raw *raw)
+{
+    sum->adc_T += raw->adc_T;
+    sum->adc_P += raw->adc_P;
+    sum->adc_H += raw->adc_H;
+}
 
-    v_x1_u32r = v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * ((int32_t)dig_H1)) >> 4);
-    v_x1_u32r = (v_x1_u32r < 0 ? 0 : v_x1_u32r);
-    v_x1_u32r = (v_x1_u32r > 419430400 ? 419430400 : v_x1_u32r);
-    int32_t humidity = v_x1_u32r >> 12; // in 1024ths of %RH
-    bme_data.humidity_integer = humidity / 1024;
-    bme_data.humidity_fraction = (humidity % 1024) * 100 / 1024;
+void BME280_raw_mean(BME280_Raw *sum, uint8_t shift)
+{
+    int32_t round = shift ? 1L << (shift - 1) : 0;
+    sum->adc_T = (sum->adc_T + round) >> shift;
+    sum->adc_P = (sum->adc_P + round) >> shift;
+    sum->adc_H = (sum->adc_H + round) >> shift;
+}
+
+BME280_Status BME280_start(BME280_Dev *dev)
+{
+    // A new trigger would restart the measurement in progress
+    if (dev->conv_pending && HAL_GetTick() - dev->conv_started < dev->meas_time_ms)
+        return BME280_OK;
+
+    BME280_Status st = BME280_start_conversion(dev);
+    dev->conv_pending = st == BME280_OK;
+    dev->conv_started = HAL_GetTick();
+    return st;
+}
+
+uint32_t BME280_ready_at(const BME280_Dev *dev)
+{
+    if (!dev->conv_pending) return HAL_GetTick();
+    return dev->conv_started + dev->meas_time_ms;
+}
+
+// Starts the forced conversions still needed and sleeps out the longest
+static void BME280_wait_all(BME280_Dev *devs, uint8_t n, BME280_Status *status)
+{
+    uint8_t wait_ms = 0;
+
+    // Every conversion starts before the first wait, so they all overlap
+    for (uint8_t i = 0; i < n; i++)
+    {
+        status[i] = BME280_OK;
+        if (devs[i].mode != BME280_MODE_FORCED) continue;
+
+        uint8_t left = devs[i].meas_time_ms;
+        if (devs[i].conv_pending)
+        {
+            // Started by BME280_start(); only the rest of its time is left
+            uint32_t ran = HAL_GetTick() - devs[i].conv_started;
+            left = ran >= left ? 0 : left - (uint8_t)ran;
+            devs[i].conv_pending = 0;
+        }
+        else
+        {
+            status[i] = BME280_start_conversion(&devs[i]);
+        }
+        if (status[i] == BME280_OK && left > wait_ms)
+            wait_ms = left;
+    }
+
+    uint32_t start = HAL_GetTick();
+    while (HAL_GetTick() - start < wait_ms)
+    {
+        tick_wakeup_at(start + wait_ms);
+        __WFI();
+    }
+}
+
+static BME280_Status BME280_acquire(BME280_Dev *dev, BME280_Status status, BME280_Raw *raw)
+{
+    if (status != BME280_OK) return status;
+    if (dev->mode == BME280_MODE_FORCED) status = BME280_finish_conversion(dev);
+    if (status == BME280_OK) status = BME280_fetch(dev, raw);
+    if (status == BME280_OK) status = BME280_check(dev, raw);
+    return status;
+}
+
+uint8_t BME280_read_all(BME280_Dev *devs, uint8_t n, BME280_Measurement *m, BME280_Status *status)
+{
+    uint8_t ok = 0;
+
+    BME280_wait_all(devs, n, status);
+    for (uint8_t i = 0; i < n; i++)
+    {
+        BME280_Raw raw;
+        status[i] = BME280_acquire(&devs[i], status[i], &raw);
+        if (status[i] != BME280_OK) continue;
+        BME280_compensate(&devs[i], &raw, m ? &m[i] : NULL);
+        ok++;
+    }
+    return ok;
+}
+
+BME280_Status BME280_read_raw(BME280_Dev *dev, BME280_Raw *raw)
+{
+    BME280_Status status;
+    BME280_wait_all(dev, 1, &status);
+    return BME280_acquire(dev, status, raw);
+}
+
+BME280_Status BME280_read(BME280_Dev *dev, BME280_Measurement *m)
+{
+    BME280_Status status;
+    BME280_read_all(dev, 1, m, &status);
+    return status;
+}
+
+uint8_t BME280_read_data(BME280_Dev *dev)
+{
+    return BME280_read(dev, NULL) == BME280_OK;
 }
 
-int16_t BME280_get_temperature_integer(void)
+int16_t BME280_get_temperature_integer(const BME280_Dev *dev)
 {
-    return bme_data.temp_integer;
+    return (int16_t)format_split100(dev->last.temperature, NULL);
 }
 
-int16_t BME280_get_temperature_fraction(void)
+int16_t BME280_get_temperature_fraction(const BME280_Dev *dev)
 {
-    return bme_data.temp_fraction;
+    int32_t frac;
+    format_split100(dev->last.temperature, &frac);
+    return (int16_t)frac;
 }
 
-int16_t BME280_get_pressure_integer(void)
+int16_t BME280_get_pressure_integer(const BME280_Dev *dev)
 {
-    return bme_data.pressure_integer;
+    return (int16_t)format_div100((uint32_t)format_hpa_centi(dev->last.pressure));
 }
 
-int16_t BME280_get_pressure_fraction(void)
+int16_t BME280_get_pressure_fraction(const BME280_Dev *dev)
 {
-    return bme_data.pressure_fraction;
+    uint32_t centi = (uint32_t)format_hpa_centi(dev->last.pressure);
+    return (int16_t)(centi - format_div100(centi) * 100);
 }
 
-int16_t BME280_get_humidity_integer(void)
+int16_t BME280_get_humidity_integer(const BME280_Dev *dev)
 {
-    return bme_data.humidity_integer;
+    return dev->last.humidity >> 10;
 }
 
-int16_t BME280_get_humidity_fraction(void)
+int16_t BME280_get_humidity_fraction(const BME280_Dev *dev)
 {
-    return bme_data.humidity_fraction;
+    return (int16_t)format_rh_centi(dev->last.humidity & 0x3FF);
 }
@@ -2,94 +2,509 @@
 #define BME280_H
 
 #include "stm32l0xx_hal.h"
+#include "bme280_comp.h"
+#include "bme280_spi.h"
 
+/** 8-bit bus address, override with -DBME280_ADDRESS="(0x76 << 1)" for SDO low */
+#ifndef BME280_ADDRESS
 #define BME280_ADDRESS (0x77 << 1)  // or 0x76 if cbs with pull down
+#endif
 
+/** The other address a second sensor on the bus answers at (SDO strapped the other way) */
+#define BME280_ADDRESS_ALT (BME280_ADDRESS ^ 0x02)
+
+/** Sensors read by main.c: 2 adds an outdoor sensor at BME280_ADDRESS_ALT */
+#ifndef BME280_SENSORS
+#define BME280_SENSORS 1
+#endif
+
+#if BME280_SPI && BME280_SENSORS > 1
+#error "The SPI transport has one chip select; BME280_SENSORS must be 1"
+#endif
+
+/** Queue priority of the sensor transfers on the shared I2C bus (i2c_bus.h) */
+#ifndef BME280_BUS_PRIO
+#define BME280_BUS_PRIO I2C_BUS_PRIO_SENSOR
+#endif
+
+/**
+ * Largest raw change between two reads that is taken as real, per channel
+ * (roughly 10 °C, 25 hPa and 25 %RH). A bigger jump reads as
+ * BME280_ERR_INVALID; after BME280_STEP_REJECTS of them in a row the new
+ * level is accepted, so a real step costs a few samples rather than
+ * locking the sensor out. 0 disables a limit.
+ */
+#ifndef BME280_STEP_T
+#define BME280_STEP_T       0x8000
+#endif
+#ifndef BME280_STEP_P
+#define BME280_STEP_P       0x8000
+#endif
+#ifndef BME280_STEP_H
+#define BME280_STEP_H       0x4000
+#endif
+#define BME280_STEP_REJECTS 3
+
+/** Upper bound for the post-reset NVM copy (typically ~2 ms) */
+#define BME280_RESET_TIMEOUT_MS 10
+
+/**
+ * @brief Sensor operating mode (ctrl_meas mode[1:0]).
+ *
+ * In normal mode the sensor converts continuously and BME280_read_data() only
+ * fetches the latest result. In forced mode every BME280_read_data() call
+ * triggers a single conversion, waits for it and leaves the sensor asleep,
+ * which brings the sensor supply current below 1 µA at 1 Hz sampling.
+ */
+typedef enum {
+    BME280_MODE_SLEEP  = 0x00,
+    BME280_MODE_FORCED = 0x01,
+    BME280_MODE_NORMAL = 0x03
+} BME280_Mode;
+
+/** Oversampling register codes (osrs_t / osrs_p / osrs_h) */
+#define BME280_OS_SKIP   0x00
+#define BME280_OS_X1     0x01
+#define BME280_OS_X2     0x02
+#define BME280_OS_X4     0x03
+#define BME280_OS_X8     0x04
+#define BME280_OS_X16    0x05
+
+/** IIR filter coefficient codes (config filter[2:0]) */
+#define BME280_FILTER_OFF 0x00
+#define BME280_FILTER_2   0x01
+#define BME280_FILTER_4   0x02
+#define BME280_FILTER_8   0x03
+#define BME280_FILTER_16  0x04
+
+/** Normal mode standby time codes (config t_sb[2:0]) */
+#define BME280_STANDBY_0_5MS  0x00
+#define BME280_STANDBY_62_5MS 0x01
+#define BME280_STANDBY_125MS  0x02
+#define BME280_STANDBY_250MS  0x03
+#define BME280_STANDBY_500MS  0x04
+#define BME280_STANDBY_1000MS 0x05
+
+/**
+ * @brief Oversampling / filter preset.
+ *
+ * Presets for the use cases of datasheet section 3.5 are provided as
+ * BME280_PROFILE_* constants. The operating mode is chosen separately in
+ * BME280_init(), so any profile can run in forced or normal mode.
+ */
+typedef struct {
+    uint8_t osrs_t;
+    uint8_t osrs_p;
+    uint8_t osrs_h;
+    uint8_t filter;
+    uint8_t t_sb;
+} BME280_Profile;
+
+/** Channel flags for BME280_set_channels() */
+#define BME280_CHANNEL_TEMPERATURE 0x01   // Always measured, P and H need its t_fine
+#define BME280_CHANNEL_PRESSURE    0x02
+#define BME280_CHANNEL_HUMIDITY    0x04
+#define BME280_CHANNEL_ALL         0x07
+
+extern const BME280_Profile BME280_PROFILE_WEATHER;     // T×1 P×1 H×1, filter off
+extern const BME280_Profile BME280_PROFILE_HUMIDITY;    // T×1 P skip H×1, filter off
+extern const BME280_Profile BME280_PROFILE_INDOOR_NAV;  // T×2 P×16 H×4, filter 16 (init default)
+extern const BME280_Profile BME280_PROFILE_GAMING;      // T×1 P×4 H skip, filter 16
+
+/**
+ * Firmware averaging: main.c takes 2^BME280_AVERAGE_SHIFT forced
+ * conversions per sample, spread across the sample period, and averages
+ * their raw values before one compensation (BME280_raw_add()). 0 leaves
+ * the noise reduction to the sensor's own oversampling.
+ */
+#ifndef BME280_AVERAGE_SHIFT
+#define BME280_AVERAGE_SHIFT 0
+#endif
+
+typedef char bme280_average_check[BME280_AVERAGE_SHIFT <= 4 ? 1 : -1];
+
+/** Profile applied by BME280_init() and on full supply */
+#ifndef BME280_DEFAULT_PROFILE
+#if BME280_AVERAGE_SHIFT
+#define BME280_DEFAULT_PROFILE BME280_PROFILE_WEATHER   // Short x1 conversions to average
+#else
+#define BME280_DEFAULT_PROFILE BME280_PROFILE_INDOOR_NAV
+#endif
+#endif
+
+/**
+ * @brief One compensated measurement, in the native Bosch fixed-point formats.
+ */
+typedef struct {
+    int32_t temperature;    // 0.01 °C
+    uint32_t pressure;      // Q24.8 Pa (fraction is 0 with BME280_PRESSURE_INT32)
+    uint32_t humidity;      // Q22.10 %RH
+} BME280_Measurement;
+
+/**
+ * @brief Raw ADC values of one conversion, or their sum or mean.
+ *
+ * 20 bits for temperature and pressure, 16 for humidity. With ×1
+ * oversampling the lowest four bits of T and P are 0; averaging 2^n
+ * conversions fills in n of them, as the sensor's own oversampling does.
+ */
 typedef struct {
-    int16_t temp_integer;
-    int16_t temp_fraction;
+    int32_t adc_T;
+    int32_t adc_P;
+    int32_t adc_H;
+} BME280_Raw;
 
-    int16_t pressure_integer;
-    int16_t pressure_fraction;
+/** Result of BME280_read() */
+typedef enum {
+    BME280_OK = 0,
+    BME280_ERR_BUS,         // I2C transfer failed
+    BME280_ERR_TIMEOUT,     // Forced conversion did not finish in time
+    BME280_ERR_INVALID      // Raw data failed the plausibility checks
+} BME280_Status;
 
-    int16_t humidity_integer;
-    int16_t humidity_fraction;
-} BME280_Data;
+/**
+ * @brief State of one sensor on the bus.
+ *
+ * Everything the driver keeps per sensor lives here, so several sensors
+ * can share the code; set up with BME280_setup() before any other call.
+ * The fields are private to the driver.
+ */
+typedef struct {
+    uint8_t addr;           // 8-bit bus address
+    uint8_t cached;         // Calibration cached in data EEPROM
+    uint8_t mode;           // BME280_Mode
+    uint8_t reset_pending;
+    uint8_t ctrl_meas;
+    uint8_t meas_time_ms;   // Maximum conversion time of the applied profile
+    uint8_t channels;
+    BME280_Profile profile;
+    uint16_t conv_nc;       // Charge of one conversion with the applied profile
+    uint8_t conv_pending;   // Forced conversion started by BME280_start()
+    uint32_t conv_started;  // HAL_GetTick() at that start
+    BME280_Coeffs coeffs;   // Derived from the calibration at init
+    int32_t t_fine;
+    uint8_t terms_valid;    // BME280_CHANNEL_* whose terms are up to date
+    BME280_TfineTerms terms;    // Kept while t_fine stays the same
+    // Raw values behind last; last_adc_T = -1 forces a recompute
+    int32_t last_adc_T, last_adc_P, last_adc_H;
+    uint8_t rejects;        // Step-limited reads in a row
+    BME280_Measurement last;
+} BME280_Dev;
+
+/**
+ * @brief Bind a context to a sensor address.
+ *
+ * Clears all state and gives the address BME280_BUS_PRIO on the I2C bus.
+ * Only one sensor may use the calibration cache in data EEPROM
+ * (EEPROM_BME280_CALIB); the others read their calibration from the
+ * sensor on every init.
+ *
+ * @param dev Context to set up
+ * @param addr 8-bit bus address (BME280_ADDRESS or BME280_ADDRESS_ALT)
+ * @param cached 1 to cache the calibration in data EEPROM
+ */
+void BME280_setup(BME280_Dev *dev, uint8_t addr, uint8_t cached);
+
+/**
+ * @brief Verify the sensor ID and issue a soft reset without waiting.
+ *
+ * Optional first half of BME280_init(); lets the caller do other start-up
+ * work (e.g. the OLED init sequence) while the sensor reloads its NVM.
+ *
+ * @param dev Sensor set up with BME280_setup()
+ * @return 1 if the ID matched and the reset was issued, 0 otherwise
+ */
+uint8_t BME280_reset(BME280_Dev *dev);
 
 /**
  * @brief Initialize the BME280 sensor with specific configuration.
  *
  * This function performs the following:
- * - Verifies the sensor's ID (should be 0x60)
- * - Issues a software reset
- * - Configures oversampling (temp ×2, pressure ×16, humidity ×4)
- * - Sets IIR filter coefficient = 16 and standby time = 0.5ms
- * - Activates normal mode operation
+ * - Verifies the sensor's ID (should be 0x60) and issues a software reset,
+ *   unless BME280_reset() was already called
+ * - Polls im_update until the reset completes (bounded by
+ *   BME280_RESET_TIMEOUT_MS) instead of a fixed delay
+ * - Applies BME280_DEFAULT_PROFILE, by default BME280_PROFILE_INDOOR_NAV:
+ *   oversampling (temp ×2, pressure ×16, humidity ×4), IIR filter
+ *   coefficient = 16 and standby time = 0.5ms
+ * - Activates the requested operating mode
  *
  * These settings correspond to indoor navigation mode, which provides
  * high resolution and low noise, suitable for altitude change detection.
  *
- * @param hi2c Pointer to HAL I2C handle
+ * @param dev Sensor set up with BME280_setup()
+ * @param mode BME280_MODE_NORMAL for continuous conversion or
+ *             BME280_MODE_FORCED for one conversion per read
  * @return 1 if initialization succeeded, 0 otherwise
  */
-uint8_t BME280_init(I2C_HandleTypeDef *hi2c);
+uint8_t BME280_init(BME280_Dev *dev, BME280_Mode mode);
+
+/**
+ * @brief Take over a sensor that kept its power across an MCU reset.
+ *
+ * Same end state as BME280_init(), without the soft reset and the wait for
+ * its NVM copy: the chip ID is checked, the default profile is applied
+ * and the calibration is loaded, from the EEPROM cache when the sensor
+ * was set up with it.
+ *
+ * @param dev Sensor set up with BME280_setup()
+ * @param mode Operating mode, as for BME280_init()
+ * @return 1 on success, 0 otherwise; BME280_init() then starts it over
+ */
+uint8_t BME280_resume(BME280_Dev *dev, BME280_Mode mode);
+
+/**
+ * @brief Switch the oversampling/filter profile at runtime.
+ *
+ * Only ctrl_hum, config and ctrl_meas are rewritten; the sensor is not reset
+ * and the calibration is not read again. In normal mode the sensor is briefly
+ * put to sleep so the config register write is not ignored.
+ *
+ * Oversampling of channels disabled with BME280_set_channels() is written
+ * as skipped regardless of the profile.
+ *
+ * @param dev Sensor
+ * @param profile Profile to apply
+ */
+void BME280_set_profile(BME280_Dev *dev, const BME280_Profile *profile);
+
+/**
+ * @brief Switch between forced and normal mode at runtime.
+ *
+ * Reapplies the current profile in the new mode. A forced conversion
+ * still pending is dropped, so the next read in forced mode starts one.
+ * In normal mode the sensor converts every measurement time plus t_sb,
+ * and reads only fetch the latest result.
+ *
+ * @param dev Sensor
+ * @param mode BME280_MODE_FORCED or BME280_MODE_NORMAL
+ */
+void BME280_set_mode(BME280_Dev *dev, BME280_Mode mode);
+
+/**
+ * @brief Profile last passed to BME280_set_profile().
+ *
+ * Channels disabled with BME280_set_channels() are still listed with the
+ * profile's oversampling here.
+ *
+ * @param dev Sensor
+ */
+const BME280_Profile *BME280_get_profile(const BME280_Dev *dev);
+
+/**
+ * @brief Number of forced conversions started since start-up, all sensors.
+ *
+ * Conversions the sensor runs on its own in normal mode are not counted.
+ */
+uint32_t BME280_conversion_count(void);
+
+/**
+ * @brief Typical charge of the conversions counted by BME280_conversion_count().
+ *
+ * Each conversion is charged BME280_profile_charge_nc() of the profile its
+ * sensor had applied, disabled channels skipped. Wraps at 2^32 nC.
+ *
+ * @return Accumulated charge in nC
+ */
+uint32_t BME280_conversion_charge_nc(void);
+
+/**
+ * @brief Select the channels that are converted, read and compensated.
+ *
+ * Disabled channels get their oversampling set to skipped, which shortens
+ * the conversion, and are left out of the data burst read (temperature
+ * alone reads 0xFA - 0xFC). Their fields in BME280_Measurement stay 0.
+ * The current profile is reapplied.
+ *
+ * @param dev Sensor
+ * @param channels BME280_CHANNEL_* flags; temperature is always included
+ */
+void BME280_set_channels(BME280_Dev *dev, uint8_t channels);
+
+/**
+ * @brief Maximum duration of one conversion with the given profile.
+ *
+ * @param profile Profile to evaluate
+ * @return Maximum measurement time in µs (datasheet section 9.1)
+ */
+uint32_t BME280_profile_measurement_us(const BME280_Profile *profile);
+
+/**
+ * @brief Typical charge drawn by one conversion with the given profile.
+ *
+ * Based on the typical per-channel measurement currents from datasheet
+ * section 9.1 (T 350 µA, P 714 µA, H 340 µA) and typical timing. The average
+ * sensor current at a sample rate f is charge × f plus the 0.1 µA sleep
+ * current, e.g. the weather profile (~3.7 µC) at one sample per minute
+ * averages about 0.06 µA + 0.1 µA.
+ *
+ * @param profile Profile to evaluate
+ * @return Charge per conversion in nC (µA·ms)
+ */
+uint32_t BME280_profile_charge_nc(const BME280_Profile *profile);
 
 /**
  * @brief Read and compensate temperature, pressure, and humidity data.
  *
  * This function performs the full measurement cycle:
- * - Reads raw ADC values from the data registers (0xF7 - 0xFE)
+ * - In forced mode, triggers one conversion and waits for its maximum
+ *   measurement time, then polls the status register until it completes
+ * - Reads raw ADC values from the data registers (0xF7 - 0xFE, or the part
+ *   of it that covers the enabled channels)
  * - Applies Bosch's compensation formulas (from section 4.2.3 in datasheet)
  *   - Temperature compensation produces a value in 0.01 °C resolution.
- *   - Pressure is calculated using a 64-bit integer algorithm and returned in Pa.
+ *   - Pressure is calculated using a 64-bit (or, with BME280_PRESSURE_INT32,
+ *     32-bit) integer algorithm and returned in Pa.
  *   - Humidity is computed in Q22.10 fixed-point format and returned in %RH.
  *
  * These formulas use the calibration coefficients retrieved earlier.
- * 
- * @param hi2c Pointer to HAL I2C handle
+ * A channel is only recompensated when its raw value (or, for pressure and
+ * humidity, the raw temperature) differs from the previous read.
+ *
+ * Before compensation the raw values are checked: the skipped-channel and
+ * reset pattern (0x80000, 0x8000 for humidity), a bus reading all ones or
+ * all zeros, and a jump beyond BME280_STEP_* against the previous read
+ * fail it with BME280_ERR_INVALID without touching the results.
+ *
+ * On a failure the previous values are kept.
+ *
+ * @param dev Sensor
+ * @return 1 if new raw data was read and passed the checks, 0 otherwise
+ */
+uint8_t BME280_read_data(BME280_Dev *dev);
+
+/**
+ * @brief Acquire and compensate one measurement.
+ *
+ * Same acquisition as BME280_read_data(), but the values are returned
+ * unsplit so filtering and logging code can work on exact numbers. On
+ * failure @p m is left untouched.
+ *
+ * @param dev Sensor
+ * @param m Destination, may be NULL to only update the getters
+ * @return BME280_OK or the failure reason
+ */
+BME280_Status BME280_read(BME280_Dev *dev, BME280_Measurement *m);
+
+/**
+ * @brief Acquire one conversion without compensating it.
+ *
+ * Same acquisition as BME280_read(), for averaging several conversions
+ * before a single BME280_compensate(). Channels that are disabled read
+ * as 0.
+ *
+ * @param dev Sensor
+ * @param raw Destination
+ * @return BME280_OK or the failure reason
+ */
+BME280_Status BME280_read_raw(BME280_Dev *dev, BME280_Raw *raw);
+
+/**
+ * @brief Compensate raw values, e.g. a mean from BME280_raw_mean().
+ *
+ * Updates the getters like a read does. Channels whose raw value did not
+ * change since the previous call are not recomputed.
+ *
+ * @param dev Sensor
+ * @param raw Raw values
+ * @param m Destination, may be NULL to only update the getters
+ */
+void BME280_compensate(BME280_Dev *dev, const BME280_Raw *raw, BME280_Measurement *m);
+
+/**
+ * @brief Add one conversion to a running sum (20 + 4 bits fit easily).
+ */
+void BME280_raw_add(BME280_Raw *sum, const BME280_Raw *raw);
+
+/**
+ * @brief Turn a sum of 2^shift conversions into their mean, rounded.
+ */
+void BME280_raw_mean(BME280_Raw *sum, uint8_t shift);
+
+/**
+ * @brief Start a forced conversion ahead of the next read.
+ *
+ * Returns without waiting. The next BME280_read() or BME280_read_all()
+ * takes this conversion instead of starting one, and only waits for what
+ * is left of its measurement time, so start-up work can run meanwhile.
+ * A conversion started earlier and still running is kept.
+ *
+ * @param dev Sensor in BME280_MODE_FORCED
+ * @return BME280_OK or BME280_ERR_BUS
+ */
+BME280_Status BME280_start(BME280_Dev *dev);
+
+/**
+ * @brief Time at which the conversion from BME280_start() is complete.
+ *
+ * @param dev Sensor
+ * @return Deadline on the HAL_GetTick() scale; now if none is pending
+ */
+uint32_t BME280_ready_at(const BME280_Dev *dev);
+
+/**
+ * @brief Acquire one measurement from each of several sensors at once.
+ *
+ * The forced conversions of all sensors are started back to back, the core
+ * sleeps once for the longest of their measurement times, then each sensor
+ * is polled and read. Two sensors thus cost one conversion wait, not two.
+ * Sensors in normal mode are only read. A failing sensor does not hold up
+ * the others; its measurement is left untouched.
+ *
+ * @param devs Array of n sensors
+ * @param n Number of sensors
+ * @param m Array of n destinations, may be NULL to only update the getters
+ * @param status Array of n results, one per sensor
+ * @return Number of sensors read successfully
  */
-void BME280_read_data(I2C_HandleTypeDef *hi2c);
+uint8_t BME280_read_all(BME280_Dev *devs, uint8_t n, BME280_Measurement *m, BME280_Status *status);
 
 /**
  * @brief Get integer part of the last measured temperature.
  * 
+ * @param dev Sensor
  * @return Temperature in °C (integer part only)
  */
-int16_t BME280_get_temperature_integer(void);
+int16_t BME280_get_temperature_integer(const BME280_Dev *dev);
 
 /**
  * @brief Get fractional part of the last measured temperature.
  * 
+ * @param dev Sensor
  * @return Temperature in °C (fractional part, 0–99)
  */
-int16_t BME280_get_temperature_fraction(void);
+int16_t BME280_get_temperature_fraction(const BME280_Dev *dev);
 
 /**
  * @brief Get integer part of the last measured pressure.
  * 
+ * @param dev Sensor
  * @return Pressure in hPa (integer part only)
  */
-int16_t BME280_get_pressure_integer(void);
+int16_t BME280_get_pressure_integer(const BME280_Dev *dev);
 
 /**
  * @brief Get fractional part of the last measured pressure.
  * 
+ * @param dev Sensor
  * @return Pressure in hPa (fractional part, 0–99)
  */
-int16_t BME280_get_pressure_fraction(void);
+int16_t BME280_get_pressure_fraction(const BME280_Dev *dev);
 
 /**
  * @brief Get integer part of the last measured humidity.
  * 
+ * @param dev Sensor
  * @return Relative humidity in % (integer part)
  */
-int16_t BME280_get_humidity_integer(void);
+int16_t BME280_get_humidity_integer(const BME280_Dev *dev);
 
 /**
  * @brief Get fractional part of the last measured humidity.
  * 
+ * @param dev Sensor
  * @return Relative humidity in % (fractional part, 0–99)
  */
-int16_t BME280_get_humidity_fraction(void);
+int16_t BME280_get_humidity_fraction(const BME280_Dev *dev);
 
 #endif // BME280_H
@@ -0,0 +1,171 @@
+/**
+ * @file bme280_comp.c
+ * @brief BME280 compensation formulas as pure functions
+ *
+ * The arithmetic is Bosch's fixed-point reference code, kept term for term
+ * so it can be compared against the datasheet; the terms that depend on
+ * the calibration only come precomputed from BME280_coeffs_derive(), and
+ * the results stay bit-exact with the reference.
+ */
+
+#include "bme280_comp.h"
+
+void BME280_calib_parse(BME280_Calib *c, const uint8_t *calib1, const uint8_t *calib2)
+{
+    c->dig_T1 = (calib1[1] << 8) | calib1[0];
+    c->dig_T2 = (calib1[3] << 8) | calib1[2];
+    c->dig_T3 = (calib1[5] << 8) | calib1[4];
+    c->dig_P1 = (calib1[7] << 8) | calib1[6];
+    c->dig_P2 = (calib1[9] << 8) | calib1[8];
+    c->dig_P3 = (calib1[11] << 8) | calib1[10];
+    c->dig_P4 = (calib1[13] << 8) | calib1[12];
+    c->dig_P5 = (calib1[15] << 8) | calib1[14];
+    c->dig_P6 = (calib1[17] << 8) | calib1[16];
+    c->dig_P7 = (calib1[19] << 8) | calib1[18];
+    c->dig_P8 = (calib1[21] << 8) | calib1[20];
+    c->dig_P9 = (calib1[23] << 8) | calib1[22];
+
+    c->dig_H1 = calib1[25];
+    c->dig_H2 = (calib2[1] << 8) | calib2[0];
+    c->dig_H3 = calib2[2];
+    c->dig_H4 = (calib2[3] << 4) | (calib2[4] & 0x0F);
+    c->dig_H5 = (calib2[5] << 4) | (calib2[4] >> 4);
+    c->dig_H6 = (int8_t)calib2[6];
+}
+
+// Constant shifts are done as multiplications: the coefficients are signed
+// and a left shift of a negative value is undefined
+void BME280_coeffs_derive(BME280_Coeffs *k, const BME280_Calib *c)
+{
+    k->t1 = c->dig_T1;
+    k->t1_x2 = (int32_t)c->dig_T1 * 2;
+    k->t2 = c->dig_T2;
+    k->t3 = c->dig_T3;
+
+    k->p1 = c->dig_P1;
+    k->p2 = c->dig_P2;
+    k->p3 = c->dig_P3;
+#if BME280_PRESSURE_INT32
+    k->p4_2p16 = (int32_t)c->dig_P4 * 65536;
+    k->p5_x2 = (int32_t)c->dig_P5 * 2;
+    k->p7 = c->dig_P7;
+#else
+    k->p4_2p35 = (int64_t)c->dig_P4 * ((int64_t)1 << 35);
+    k->p5 = c->dig_P5;
+    k->p7_x16 = (int32_t)c->dig_P7 * 16;
+#endif
+    k->p6 = c->dig_P6;
+    k->p8 = c->dig_P8;
+    k->p9 = c->dig_P9;
+
+    k->h1 = c->dig_H1;
+    k->h2 = c->dig_H2;
+    k->h3 = c->dig_H3;
+    k->h4_2p20 = (int32_t)c->dig_H4 * 1048576;
+    k->h5 = c->dig_H5;
+    k->h6 = c->dig_H6;
+}
+
+int32_t BME280_comp_t_fine(const BME280_Coeffs *k, int32_t adc_T)
+{
+    int32_t var1, var2, d;
+    var1 = (((adc_T >> 3) - k->t1_x2) * k->t2) >> 11;
+    d = (adc_T >> 4) - k->t1;
+    var2 = (((d * d) >> 12) * k->t3) >> 14;
+    return var1 + var2;
+}
+
+int32_t BME280_comp_temperature(int32_t t_fine)
+{
+    return (t_fine * 5 + 128) >> 8;
+}
+
+void BME280_comp_humidity_terms(const BME280_Coeffs *k, int32_t t_fine, BME280_TfineTerms *t)
+{
+    int32_t v_x1_u32r;
+    v_x1_u32r = t_fine - ((int32_t)76800);
+    t->h_offset = k->h4_2p20 + (k->h5 * v_x1_u32r);
+    t->h_scale = (((((((v_x1_u32r * k->h6) >> 10) *
+                      (((v_x1_u32r * k->h3) >> 11) + ((int32_t)32768))) >> 10) +
+                    ((int32_t)2097152)) * k->h2 + 8192) >> 14);
+}
+
+uint32_t BME280_comp_humidity_adc(const BME280_Coeffs *k, const BME280_TfineTerms *t, int32_t adc_H)
+{
+    int32_t v_x1_u32r;
+    v_x1_u32r = ((((adc_H << 14) - t->h_offset) + ((int32_t)16384)) >> 15) * t->h_scale;
+
+    v_x1_u32r = v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * k->h1) >> 4);
+    v_x1_u32r = (v_x1_u32r < 0 ? 0 : v_x1_u32r);
+    v_x1_u32r = (v_x1_u32r > 419430400 ? 419430400 : v_x1_u32r);
+    return v_x1_u32r >> 12;
+}
+
+uint32_t BME280_comp_humidity(const BME280_Coeffs *k, int32_t adc_H, int32_t t_fine)
+{
+    BME280_TfineTerms t;
+    BME280_comp_humidity_terms(k, t_fine, &t);
+    return BME280_comp_humidity_adc(k, &t, adc_H);
+}
+
+#if BME280_PRESSURE_INT32
+void BME280_comp_pressure_terms(const BME280_Coeffs *k, int32_t t_fine, BME280_TfineTerms *t)
+{
+    int32_t var1, var2;
+    var1 = (t_fine >> 1) - 64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * k->p6;
+    var2 = var2 + var1 * k->p5_x2;
+    var2 = (var2 >> 2) + k->p4_2p16;
+    var1 = (((k->p3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((k->p2 * var1) >> 1)) >> 18;
+    var1 = ((32768 + var1) * k->p1) >> 15;
+    t->p_offset = var2 >> 12;
+    t->p_divisor = var1;
+}
+
+uint32_t BME280_comp_pressure_adc(const BME280_Coeffs *k, const BME280_TfineTerms *t, int32_t adc_P)
+{
+    int32_t var1, var2;
+    uint32_t p;
+    if (t->p_divisor == 0) return 0;
+
+    p = ((uint32_t)(1048576 - adc_P) - t->p_offset) * 3125;
+    if (p < 0x80000000) p = (p << 1) / (uint32_t)t->p_divisor;
+    else p = (p / (uint32_t)t->p_divisor) * 2;
+    var1 = (k->p9 * (int32_t)(((p >> 3) * (p >> 3)) >> 13)) >> 12;
+    var2 = ((int32_t)(p >> 2) * k->p8) >> 13;
+    return (uint32_t)((int32_t)p + ((var1 + var2 + k->p7) >> 4)) << 8;
+}
+#else
+void BME280_comp_pressure_terms(const BME280_Coeffs *k, int32_t t_fine, BME280_TfineTerms *t)
+{
+    int64_t var1, var2;
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * k->p6;
+    var2 = var2 + ((var1 * k->p5) << 17);
+    var2 = var2 + k->p4_2p35;
+    var1 = ((var1 * var1 * k->p3) >> 8) + ((var1 * k->p2) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * k->p1 >> 33;
+    t->p_offset = var2;
+    t->p_divisor = var1;
+}
+
+uint32_t BME280_comp_pressure_adc(const BME280_Coeffs *k, const BME280_TfineTerms *t, int32_t adc_P)
+{
+    int64_t var1, var2, p;
+    if (t->p_divisor == 0) return 0;
+
+    p = 1048576 - adc_P;
+    p = (((p << 31) - t->p_offset) * 3125) / t->p_divisor;
+    var1 = (k->p9 * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (k->p8 * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + k->p7_x16;
+    return (uint32_t)p;
+}
+#endif
+
+uint32_t BME280_comp_pressure(const BME280_Coeffs *k, int32_t adc_P, int32_t t_fine)
+{
+    BME280_TfineTerms t;
+    BME280_comp_pressure_terms(k, t_fine, &t);
+    return BME280_comp_pressure_adc(k, &t, adc_P);
+}
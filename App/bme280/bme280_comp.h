@@ -0,0 +1,178 @@
+/**
+ * @file bme280_comp.h
+ * @brief BME280 compensation formulas as pure functions
+ *
+ * No I2C and no driver state: every function works on the raw ADC value
+ * and a derived coefficient record only, so the formulas build and run
+ * on a host as well as on the target (datasheet section 4.2.3).
+ */
+
+#ifndef BME280_COMP_H
+#define BME280_COMP_H
+
+#include <stdint.h>
+#include "ramfunc.h"
+
+/**
+ * Pressure compensation variant.
+ *
+ * 0: Bosch 64-bit integer formula (Q24.8 internally, highest accuracy).
+ * 1: Bosch 32-bit integer formula (datasheet 8.2). Avoids __aeabi_ldivmod and
+ *    the int64 multiplies on the Cortex-M0+; its result differs from the
+ *    64-bit formula by at most 8 Pa (0.08 hPa) over 300–1100 hPa and
+ *    -40–85 °C (Tools/compcheck/pressure32.c).
+ */
+#ifndef BME280_PRESSURE_INT32
+#define BME280_PRESSURE_INT32 0
+#endif
+
+#define BME280_CALIB1_LEN 26        // 0x88 - 0xA1
+#define BME280_CALIB2_LEN 7         // 0xE1 - 0xE7
+
+/** Calibration coefficients, named as in the datasheet */
+typedef struct {
+    uint16_t dig_T1;
+    int16_t dig_T2, dig_T3;
+    uint16_t dig_P1;
+    int16_t dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+    uint8_t dig_H1, dig_H3;
+    int16_t dig_H2, dig_H4, dig_H5;
+    int8_t dig_H6;
+} BME280_Calib;
+
+/**
+ * Coefficients in the form the formulas use them, derived once per sensor
+ * by BME280_coeffs_derive(). Every term is widened to 32 bits (the M0+
+ * loads halfwords only with a register offset, words with an immediate
+ * one), and the terms the reference code shifts by a constant are stored
+ * shifted, so each sample only does the work that depends on its ADC
+ * values. Field names give the datasheet coefficient and the factor it
+ * is stored with.
+ */
+typedef struct {
+#if !BME280_PRESSURE_INT32
+    int64_t p4_2p35;        // dig_P4 << 35; first, for the 8-byte alignment
+#endif
+    int32_t t1, t1_x2, t2, t3;
+    int32_t p1, p2, p3;
+#if BME280_PRESSURE_INT32
+    int32_t p4_2p16, p5_x2, p7;
+#else
+    int32_t p5, p7_x16;
+#endif
+    int32_t p6, p8, p9;
+    int32_t h1, h2, h3, h4_2p20, h5, h6;
+} BME280_Coeffs;
+
+/**
+ * Intermediate terms of the pressure and humidity formulas that depend on
+ * t_fine only, the int64 multiplies of the pressure formula included.
+ * Indoors t_fine often stays the same for many samples, so the driver
+ * keeps them and redoes only the second, ADC-dependent half.
+ */
+typedef struct {
+#if BME280_PRESSURE_INT32
+    int32_t p_offset;       // var2 >> 12
+    int32_t p_divisor;      // var1, 0 if the calibration would divide by zero
+#else
+    int64_t p_offset;       // var2
+    int64_t p_divisor;      // var1, 0 if the calibration would divide by zero
+#endif
+    int32_t h_offset;       // (dig_H4 << 20) + dig_H5 * (t_fine - 76800)
+    int32_t h_scale;        // The dig_H2/H3/H6 factor
+} BME280_TfineTerms;
+
+/**
+ * @brief Decode the coefficients from the two raw register blocks.
+ *
+ * @param c      Record to fill
+ * @param calib1 Registers 0x88 - 0xA1
+ * @param calib2 Registers 0xE1 - 0xE7
+ */
+void BME280_calib_parse(BME280_Calib *c, const uint8_t *calib1, const uint8_t *calib2);
+
+/**
+ * @brief Precompute the calibration-only terms of the formulas.
+ *
+ * @param k Record to fill
+ * @param c Decoded calibration
+ */
+void BME280_coeffs_derive(BME280_Coeffs *k, const BME280_Calib *c);
+
+/**
+ * @brief Fine temperature shared by all three formulas.
+ *
+ * @param k     Derived coefficients
+ * @param adc_T Raw 20-bit temperature ADC value
+ * @return t_fine
+ */
+RAMFUNC_COMP_FN int32_t BME280_comp_t_fine(const BME280_Coeffs *k, int32_t adc_T);
+
+/**
+ * @brief Temperature from t_fine.
+ *
+ * @param t_fine Result of BME280_comp_t_fine()
+ * @return Temperature in 0.01 °C
+ */
+int32_t BME280_comp_temperature(int32_t t_fine);
+
+/**
+ * @brief First, t_fine-only half of the pressure formula.
+ *
+ * @param k      Derived coefficients
+ * @param t_fine Result of BME280_comp_t_fine()
+ * @param t      Terms to fill (the p_ fields)
+ */
+RAMFUNC_COMP_FN void BME280_comp_pressure_terms(const BME280_Coeffs *k, int32_t t_fine, BME280_TfineTerms *t);
+
+/**
+ * @brief Second half of the pressure formula.
+ *
+ * @param k     Derived coefficients
+ * @param t     Terms from BME280_comp_pressure_terms()
+ * @param adc_P Raw 20-bit pressure ADC value
+ * @return As BME280_comp_pressure()
+ */
+RAMFUNC_COMP_FN uint32_t BME280_comp_pressure_adc(const BME280_Coeffs *k, const BME280_TfineTerms *t, int32_t adc_P);
+
+/**
+ * @brief First, t_fine-only half of the humidity formula.
+ *
+ * @param k      Derived coefficients
+ * @param t_fine Result of BME280_comp_t_fine()
+ * @param t      Terms to fill (the h_ fields)
+ */
+RAMFUNC_COMP_FN void BME280_comp_humidity_terms(const BME280_Coeffs *k, int32_t t_fine, BME280_TfineTerms *t);
+
+/**
+ * @brief Second half of the humidity formula.
+ *
+ * @param k     Derived coefficients
+ * @param t     Terms from BME280_comp_humidity_terms()
+ * @param adc_H Raw 16-bit humidity ADC value
+ * @return As BME280_comp_humidity()
+ */
+RAMFUNC_COMP_FN uint32_t BME280_comp_humidity_adc(const BME280_Coeffs *k, const BME280_TfineTerms *t, int32_t adc_H);
+
+/**
+ * @brief Compensate raw pressure; both halves in one call.
+ *
+ * @param k      Derived coefficients
+ * @param adc_P  Raw 20-bit pressure ADC value
+ * @param t_fine Result of BME280_comp_t_fine()
+ * @return Pressure in Q24.8 Pa (fraction always 0 with BME280_PRESSURE_INT32),
+ *         or 0 if the calibration would divide by zero
+ */
+uint32_t BME280_comp_pressure(const BME280_Coeffs *k, int32_t adc_P, int32_t t_fine);
+
+/**
+ * @brief Compensate raw humidity; both halves in one call.
+ *
+ * @param k      Derived coefficients
+ * @param adc_H  Raw 16-bit humidity ADC value
+ * @param t_fine Result of BME280_comp_t_fine()
+ * @return Relative humidity in Q22.10 %RH
+ */
+uint32_t BME280_comp_humidity(const BME280_Coeffs *k, int32_t adc_H, int32_t t_fine);
+
+#endif // BME280_COMP_H
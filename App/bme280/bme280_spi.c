@@ -0,0 +1,90 @@
+/**
+ * @file bme280_spi.c
+ * @brief 4-wire SPI transport for the BME280 (register-level SPI1)
+ *
+ * Polled full-duplex transfers in mode 0, MSB first. The bursts are at
+ * most 26 bytes, shorter than setting up DMA would take. The first CSB
+ * falling edge switches the sensor to SPI until its next power-on reset.
+ */
+
+#include "bme280_spi.h"
+#include "main.h"
+
+#if BME280_SPI
+
+// Smallest SCK divider (2^(BR+1)) that keeps SCK within the sensor limit
+static uint32_t BME280_spi_br(void)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+    uint32_t br = 0;
+    while (br < 7 && (pclk >> (br + 1)) > BME280_SPI_MAX_HZ) br++;
+    return br << SPI_CR1_BR_Pos;
+}
+
+void BME280_spi_init(void)
+{
+    GPIO_InitTypeDef gpio = {0};
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_SPI1_CLK_ENABLE();
+
+    gpio.Pin = BME280_SPI_SCK_PIN | BME280_SPI_MISO_PIN | BME280_SPI_MOSI_PIN;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    gpio.Alternate = GPIO_AF0_SPI1;
+    HAL_GPIO_Init(BME280_SPI_PORT, &gpio);
+
+    // TS_SDO was driven high to strap the I2C address; SDO is an output now
+    gpio.Pin = TS_SDO_Pin;
+    gpio.Mode = GPIO_MODE_ANALOG;
+    gpio.Alternate = 0;
+    HAL_GPIO_Init(TS_SDO_GPIO_Port, &gpio);
+
+    HAL_GPIO_WritePin(TS_CSB_GPIO_Port, TS_CSB_Pin, GPIO_PIN_SET);
+}
+
+static uint8_t BME280_spi_xfer(uint8_t out)
+{
+    while (!(SPI1->SR & SPI_SR_TXE));
+    *(volatile uint8_t *)&SPI1->DR = out;
+    while (!(SPI1->SR & SPI_SR_RXNE));
+    return (uint8_t)SPI1->DR;
+}
+
+static void BME280_spi_select(void)
+{
+    SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | BME280_spi_br();
+    SPI1->CR1 |= SPI_CR1_SPE;
+    HAL_GPIO_WritePin(TS_CSB_GPIO_Port, TS_CSB_Pin, GPIO_PIN_RESET);
+}
+
+static void BME280_spi_deselect(void)
+{
+    while (SPI1->SR & SPI_SR_BSY);
+    HAL_GPIO_WritePin(TS_CSB_GPIO_Port, TS_CSB_Pin, GPIO_PIN_SET);
+    SPI1->CR1 &= ~SPI_CR1_SPE;
+}
+
+HAL_StatusTypeDef BME280_spi_read(uint8_t reg, uint8_t *buf, uint16_t len)
+{
+    BME280_spi_select();
+    BME280_spi_xfer(reg | 0x80);
+    while (len--) *buf++ = BME280_spi_xfer(0xFF);
+    BME280_spi_deselect();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BME280_spi_write(uint8_t reg, const uint8_t *buf, uint16_t len)
+{
+    BME280_spi_select();
+    for (uint16_t i = 0; i < len; i++)
+    {
+        BME280_spi_xfer((reg + i) & 0x7F);
+        BME280_spi_xfer(buf[i]);
+    }
+    BME280_spi_deselect();
+    return HAL_OK;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * @file button.c
+ * @brief Debounced push buttons on EXTI lines, waking the core from STOP
+ */
+
+#include "button.h"
+#include "main.h"
+#include "sched.h"
+
+typedef struct
+{
+    GPIO_TypeDef *port;
+    uint16_t pin;
+} button_line;
+
+static const button_line lines[BUTTON_COUNT] = {
+    [BUTTON_NEXT] = { BUTTON_NEXT_PORT, BUTTON_NEXT_PIN },
+    [BUTTON_PREV] = { BUTTON_PREV_PORT, BUTTON_PREV_PIN },
+};
+
+static uint32_t last_edge[BUTTON_COUNT];
+static volatile uint8_t pressed;
+
+void button_init(void)
+{
+    GPIO_InitTypeDef gpio = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    // Both edges: the release restarts the quiet time, so its bounce is
+    // not taken for another press
+    gpio.Mode = GPIO_MODE_IT_RISING_FALLING;
+    gpio.Pull = GPIO_PULLUP;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    for (uint8_t id = 0; id < BUTTON_COUNT; id++)
+    {
+        gpio.Pin = lines[id].pin;
+        HAL_GPIO_Init(lines[id].port, &gpio);
+        last_edge[id] = HAL_GetTick() - BUTTON_DEBOUNCE_MS;
+    }
+    pressed = 0;
+
+    HAL_NVIC_SetPriority(BUTTON_IRQn, IRQ_PRIO_UI, 0);
+    HAL_NVIC_EnableIRQ(BUTTON_IRQn);
+}
+
+uint8_t button_take(void)
+{
+    __disable_irq();
+    uint8_t mask = pressed;
+    pressed = 0;
+    __enable_irq();
+    return mask;
+}
+
+void button_irq_handler(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    for (uint8_t id = 0; id < BUTTON_COUNT; id++)
+    {
+        if (!__HAL_GPIO_EXTI_GET_IT(lines[id].pin)) continue;
+        __HAL_GPIO_EXTI_CLEAR_IT(lines[id].pin);
+
+        uint8_t quiet = now - last_edge[id] >= BUTTON_DEBOUNCE_MS;
+        last_edge[id] = now;
+        if (quiet && HAL_GPIO_ReadPin(lines[id].port, lines[id].pin) == GPIO_PIN_RESET)
+        {
+            pressed |= BUTTON_BIT(id);
+            sched_post(SCHED_EV_BUTTON);
+        }
+    }
+}
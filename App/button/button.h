@@ -0,0 +1,58 @@
+/**
+ * @file button.h
+ * @brief Debounced push buttons on EXTI lines, waking the core from STOP
+ */
+
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#include "stm32l0xx_hal.h"
+
+/** Front-panel buttons and the view switching that needs them */
+#ifndef BUTTONS
+#define BUTTONS 0
+#endif
+
+typedef enum
+{
+    BUTTON_NEXT = 0,
+    BUTTON_PREV,
+    BUTTON_COUNT
+} Button_Id;
+
+/** Bit per button in the button_take() mask */
+#define BUTTON_BIT(id)      (1U << (id))
+
+/** Buttons to GND with the internal pull-ups, EXTI lines 5 and 9 */
+#define BUTTON_NEXT_PORT    GPIOA
+#define BUTTON_NEXT_PIN     GPIO_PIN_5
+#define BUTTON_PREV_PORT    GPIOA
+#define BUTTON_PREV_PIN     GPIO_PIN_9
+#define BUTTON_IRQn         EXTI4_15_IRQn
+
+/** A press only counts after this long without an edge on its line */
+#ifndef BUTTON_DEBOUNCE_MS
+#define BUTTON_DEBOUNCE_MS  30
+#endif
+
+/**
+ * @brief Configure the button pins and their EXTI lines.
+ */
+void button_init(void);
+
+/**
+ * @brief Take the presses recorded since the last call.
+ *
+ * @return Mask of BUTTON_BIT() for every button pressed
+ */
+uint8_t button_take(void);
+
+/**
+ * @brief Button interrupt, called from EXTI4_15_IRQHandler.
+ *
+ * Records a press and posts SCHED_EV_BUTTON, so it is handled right after
+ * the wake-up instead of on the next tick.
+ */
+void button_irq_handler(void);
+
+#endif // BUTTON_H
@@ -0,0 +1,118 @@
+/**
+ * @file calib.c
+ * @brief Per-device calibration record and sea-level pressure reduction
+ */
+
+#include "calib.h"
+#include "eeprom.h"
+#include <stddef.h>
+#include <string.h>
+
+#define CALIB_MAGIC     0xCA1C
+#define CALIB_MAGIC_V1  0xCA1B      // Offsets and altitude only
+#define CALIB_STEP      125         // Table step, m
+
+typedef struct
+{
+    uint16_t magic;
+    Calib_Record rec;
+    uint16_t crc;
+} Calib_Stored;
+
+typedef struct
+{
+    uint16_t magic;
+    int16_t offsets[4];             // Calib_Record up to the altitude
+    uint16_t crc;
+} Calib_Stored_V1;
+
+typedef char calib_fits_region[sizeof(Calib_Stored) <= EEPROM_CONFIG - EEPROM_CALIB ? 1 : -1];
+
+// (1 - 2.25577e-5 h)^-5.25588 for h = -500 .. 4500 m, Q15
+static const uint16_t sea_level_table[] = {
+    30892, 31349, 31814, 32287, 32768, 33258, 33757, 34264, 34781, 35307,
+    35842, 36388, 36943, 37508, 38084, 38670, 39266, 39874, 40493, 41124,
+    41766, 42421, 43087, 43766, 44458, 45163, 45881, 46613, 47358, 48118,
+    48893, 49682, 50487, 51307, 52143, 52995, 53864, 54750, 55654, 56575,
+    57515
+};
+
+static Calib_Record calib;
+static uint16_t sea_level_factor = 32768;   // Q15, for calib.altitude
+
+static void calib_update_factor(void)
+{
+    if (calib.altitude < CALIB_ALTITUDE_MIN) calib.altitude = CALIB_ALTITUDE_MIN;
+    if (calib.altitude > CALIB_ALTITUDE_MAX) calib.altitude = CALIB_ALTITUDE_MAX;
+
+    uint16_t h = (uint16_t)(calib.altitude - CALIB_ALTITUDE_MIN);
+    uint8_t i = h / CALIB_STEP;
+    uint8_t frac = h % CALIB_STEP;
+    if (i == sizeof(sea_level_table) / sizeof(sea_level_table[0]) - 1)
+    {
+        sea_level_factor = sea_level_table[i];
+        return;
+    }
+    sea_level_factor = sea_level_table[i] +
+        (uint16_t)((uint32_t)(sea_level_table[i + 1] - sea_level_table[i]) * frac / CALIB_STEP);
+}
+
+uint8_t calib_load(void)
+{
+    const Calib_Stored *stored = eeprom_ptr(EEPROM_CALIB);
+    const Calib_Stored_V1 *v1 = eeprom_ptr(EEPROM_CALIB);
+    uint8_t ok = stored->magic == CALIB_MAGIC &&
+                 stored->crc == eeprom_crc16(stored, offsetof(Calib_Stored, crc));
+
+    memset(&calib, 0, sizeof(calib));
+    if (ok)
+        calib = stored->rec;
+    else if (v1->magic == CALIB_MAGIC_V1 &&
+             v1->crc == eeprom_crc16(v1, offsetof(Calib_Stored_V1, crc)))
+    {
+        memcpy(&calib, v1->offsets, sizeof(v1->offsets));
+        ok = 1;
+    }
+    calib_update_factor();
+    return ok;
+}
+
+const Calib_Record *calib_get(void)
+{
+    return &calib;
+}
+
+uint8_t calib_set(const Calib_Record *rec)
+{
+    Calib_Stored s;
+
+    calib = *rec;
+    calib_update_factor();
+    s.magic = CALIB_MAGIC;
+    s.rec = calib;
+    s.crc = eeprom_crc16(&s, offsetof(Calib_Stored, crc));
+    return eeprom_write(EEPROM_CALIB, &s, sizeof(s));
+}
+
+void calib_apply(BME280_Measurement *m)
+{
+    int32_t t = m->temperature;
+    int32_t h = (int32_t)m->humidity;
+    int32_t p = (int32_t)m->pressure;
+
+    // Products stay within int32: the pressure slope works from whole Pa
+    // and lands in Q24.8 with the 8 bits of shift it has left
+    t += calib.temperature + (((t - CALIB_PIVOT_T) * calib.temperature_slope) >> CALIB_SLOPE_SHIFT);
+    h += calib.humidity + (((h - CALIB_PIVOT_H) * calib.humidity_slope) >> CALIB_SLOPE_SHIFT);
+    p += calib.pressure * 256 +
+         ((((p >> 8) - CALIB_PIVOT_P) * calib.pressure_slope) >> (CALIB_SLOPE_SHIFT - 8));
+
+    m->temperature = t;
+    m->humidity = h < 0 ? 0 : h > 100 * 1024 ? 100 * 1024 : (uint32_t)h;
+    m->pressure = p < 0 ? 0 : (uint32_t)p;
+}
+
+uint32_t calib_sea_level(uint32_t pressure)
+{
+    return (uint32_t)(((uint64_t)pressure * sea_level_factor) >> 15);
+}
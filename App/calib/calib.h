@@ -0,0 +1,97 @@
+/**
+ * @file calib.h
+ * @brief Per-device calibration record and sea-level pressure reduction
+ */
+
+#ifndef CALIB_H
+#define CALIB_H
+
+#include "bme280.h"
+
+/** Station altitude range covered by the reduction table, m */
+#define CALIB_ALTITUDE_MIN  -500
+#define CALIB_ALTITUDE_MAX  4500
+
+/**
+ * Readings the slopes turn around: a slope changes the correction away
+ * from these points, the offset is the correction at them. 0.01 °C,
+ * Q22.10 %RH and Pa.
+ */
+#define CALIB_PIVOT_T       2500
+#define CALIB_PIVOT_H       (50 * 1024)
+#define CALIB_PIVOT_P       101325
+
+/** Slope unit: a slope of 1 corrects by 2^-12 (244 ppm) of the distance from the pivot */
+#define CALIB_SLOPE_SHIFT   12
+
+/** Calib_Record.fitted bits: channels set by the factory calibration (factory.h) */
+#define CALIB_FIT_T         0x01
+#define CALIB_FIT_H         0x02
+#define CALIB_FIT_P         0x04
+
+/**
+ * Correction of every reading, in the BME280_Measurement units: the
+ * offset plus slope * (reading - pivot) >> CALIB_SLOPE_SHIFT, so a slope
+ * covers a gain error of up to +-3.1 %.
+ */
+typedef struct
+{
+    int16_t temperature;    ///< 0.01 °C
+    int16_t humidity;       ///< 1/1024 %RH (Q22.10)
+    int16_t pressure;       ///< Pa
+    int16_t altitude;       ///< Station altitude in m, 0 reports station pressure
+    int8_t temperature_slope;
+    int8_t humidity_slope;
+    int8_t pressure_slope;
+    uint8_t fitted;         ///< CALIB_FIT_* bits, 0 for a hand-made record
+} Calib_Record;
+
+/**
+ * @brief Load the record from data EEPROM.
+ *
+ * A missing or corrupt record leaves all offsets, slopes and the altitude
+ * at 0. A record from before the slopes keeps its offsets and altitude.
+ *
+ * @return 1 if a valid record was found, 0 if the defaults are in use
+ */
+uint8_t calib_load(void);
+
+/**
+ * @brief Current calibration.
+ */
+const Calib_Record *calib_get(void);
+
+/**
+ * @brief Replace the calibration and store it in data EEPROM.
+ *
+ * The altitude is clamped to CALIB_ALTITUDE_MIN..CALIB_ALTITUDE_MAX.
+ *
+ * @param rec New record
+ * @return 1 on success, 0 if the EEPROM write failed (the new values
+ *         still apply until the next reset)
+ */
+uint8_t calib_set(const Calib_Record *rec);
+
+/**
+ * @brief Apply the offsets and slopes to a compensated measurement.
+ *
+ * Humidity is kept within 0..100 %RH and pressure above 0.
+ *
+ * @param m Measurement, modified in place
+ */
+void calib_apply(BME280_Measurement *m);
+
+/**
+ * @brief Reduce station pressure to sea level (QNH).
+ *
+ * Uses the ISA barometric formula P0 = P * (1 - 2.25577e-5 h)^-5.25588,
+ * which depends on the altitude only. The factor is interpolated from a
+ * 125 m step table when the record is loaded or set (within 0.05 hPa of
+ * the formula), so each call is one multiply.
+ *
+ * @param pressure Station pressure, Q24.8 Pa
+ * @return Sea-level pressure, Q24.8 Pa
+ */
+uint32_t calib_sea_level(uint32_t pressure);
+
+#endif // CALIB_H
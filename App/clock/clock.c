@@ -0,0 +1,187 @@
+/**
+ * @file clock.c
+ * @brief System clock profiles (PLL burst / MSI bus / MSI low-power run)
+ *
+ * The awake window is a few ms of I2C traffic and fixed-point math per
+ * second, much of it spent waiting on the bus or the sensor. Running those
+ * waits from MSI at voltage range 3 instead of the 32 MHz PLL at range 1
+ * cuts the run current by roughly an order of magnitude.
+ *
+ * Going up, the regulator is raised before the clock; going down, the clock
+ * is lowered before the regulator. Low-power run needs range 2/3 and a
+ * system clock below 131 kHz, so it is only used with MSI range 0.
+ *
+ * The core leaves reset on MSI, which SystemClock_Config() keeps; the PLL
+ * and HSI16 only come up with the first switch to the burst profile.
+ *
+ * The flash prefetch buffer is only on in the burst profile: it hides the
+ * wait state on sequential fetches there, and at zero wait states it only
+ * adds flash reads.
+ */
+
+#include "clock.h"
+#include "i2c_bus.h"
+#include "main.h"
+#include "trace.h"
+
+static Clock_Profile current = CLOCK_PROFILE_BUS;
+static uint32_t profile_ms[CLOCK_PROFILE_COUNT];
+static uint32_t profile_since;
+
+static void clock_voltage_range(uint32_t scale)
+{
+    __HAL_PWR_VOLTAGESCALING_CONFIG(scale);
+    while (__HAL_PWR_GET_FLAG(PWR_FLAG_VOS));
+}
+
+static HAL_StatusTypeDef clock_config_msi(uint32_t range)
+{
+    RCC_OscInitTypeDef osc = {0};
+    RCC_ClkInitTypeDef clk = {0};
+
+    osc.OscillatorType = RCC_OSCILLATORTYPE_MSI;
+    osc.MSIState = RCC_MSI_ON;
+    osc.MSICalibrationValue = RCC_MSICALIBRATION_DEFAULT;
+    osc.MSIClockRange = range;
+    osc.PLL.PLLState = RCC_PLL_NONE;
+    if (HAL_RCC_OscConfig(&osc) != HAL_OK) return HAL_ERROR;
+
+    clk.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource = RCC_SYSCLKSOURCE_MSI;
+    clk.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = RCC_HCLK_DIV1;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+    if (HAL_RCC_ClockConfig(&clk, FLASH_LATENCY_0) != HAL_OK) return HAL_ERROR;
+    __HAL_FLASH_PREFETCH_BUFFER_DISABLE();
+
+    // PLL first, then its HSI16 source
+    osc.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+    osc.PLL.PLLState = RCC_PLL_OFF;
+    HAL_RCC_OscConfig(&osc);
+    osc.OscillatorType = RCC_OSCILLATORTYPE_HSI;
+    osc.HSIState = RCC_HSI_OFF;
+    osc.PLL.PLLState = RCC_PLL_NONE;
+    HAL_RCC_OscConfig(&osc);
+
+    clock_voltage_range(PWR_REGULATOR_VOLTAGE_SCALE3);
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef clock_config_pll(void)
+{
+    RCC_OscInitTypeDef osc = {0};
+    RCC_ClkInitTypeDef clk = {0};
+
+    clock_voltage_range(PWR_REGULATOR_VOLTAGE_SCALE1);
+
+    // HSI16 x4 / 2 = 32 MHz
+    osc.OscillatorType = RCC_OSCILLATORTYPE_HSI;
+    osc.HSIState = RCC_HSI_ON;
+    osc.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
+    osc.PLL.PLLState = RCC_PLL_ON;
+    osc.PLL.PLLSource = RCC_PLLSOURCE_HSI;
+    osc.PLL.PLLMUL = RCC_PLLMUL_4;
+    osc.PLL.PLLDIV = RCC_PLLDIV_2;
+    if (HAL_RCC_OscConfig(&osc) != HAL_OK) return HAL_ERROR;
+
+    clk.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+    clk.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = RCC_HCLK_DIV1;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+    if (HAL_RCC_ClockConfig(&clk, FLASH_LATENCY_1) != HAL_OK) return HAL_ERROR;
+    __HAL_FLASH_PREFETCH_BUFFER_ENABLE();
+    return HAL_OK;
+}
+
+// Bring up the clocks of a profile, without I2C retune or accounting
+static HAL_StatusTypeDef clock_apply(Clock_Profile profile)
+{
+    if (READ_BIT(PWR->CR, PWR_CR_LPRUN) && HAL_PWREx_DisableLowPowerRunMode() != HAL_OK)
+        return HAL_ERROR;
+
+    switch (profile)
+    {
+    case CLOCK_PROFILE_BURST:
+        return clock_config_pll();
+
+    case CLOCK_PROFILE_BUS:
+        return clock_config_msi(RCC_MSIRANGE_5);
+
+    case CLOCK_PROFILE_IDLE:
+        if (clock_config_msi(RCC_MSIRANGE_0) != HAL_OK) return HAL_ERROR;
+        HAL_PWREx_EnableLowPowerRunMode();
+        return HAL_OK;
+
+    default:
+        return HAL_ERROR;
+    }
+}
+
+void clock_init(void)
+{
+    current = CLOCK_PROFILE_BUS;
+    for (uint8_t i = 0; i < CLOCK_PROFILE_COUNT; i++)
+        profile_ms[i] = 0;
+    profile_since = HAL_GetTick();
+}
+
+HAL_StatusTypeDef clock_set_profile(Clock_Profile profile)
+{
+    if (profile >= CLOCK_PROFILE_COUNT) return HAL_ERROR;
+    if (profile == current) return HAL_OK;
+
+    // TIMINGR must not change under a transfer
+    while (i2c_bus_busy()) __WFI();
+
+    uint32_t now = HAL_GetTick();
+    profile_ms[current] += now - profile_since;
+    profile_since = now;
+
+    HAL_StatusTypeDef st = clock_apply(profile);
+    if (st != HAL_OK)
+    {
+        // Fall back to the reset clock, which is known to work
+        clock_apply(CLOCK_PROFILE_BUS);
+        profile = CLOCK_PROFILE_BUS;
+    }
+    current = profile;
+    i2c_bus_retune();
+    TRACE_VALUE(TRACE_CLOCK, SystemCoreClock / 1000U);
+    return st;
+}
+
+Clock_Profile clock_get_profile(void)
+{
+    return current;
+}
+
+void clock_prepare_stop(void)
+{
+    // HAL_GetTick() keeps running in STOP; only awake time is accounted
+    profile_ms[current] += HAL_GetTick() - profile_since;
+
+    if (current == CLOCK_PROFILE_BURST)
+        __HAL_RCC_WAKEUPSTOP_CLK_CONFIG(RCC_STOP_WAKEUPCLOCK_HSI);
+    else
+        __HAL_RCC_WAKEUPSTOP_CLK_CONFIG(RCC_STOP_WAKEUPCLOCK_MSI);
+}
+
+void clock_restore(void)
+{
+    if (clock_apply(current) != HAL_OK)
+    {
+        clock_apply(CLOCK_PROFILE_BUS);
+        current = CLOCK_PROFILE_BUS;
+        i2c_bus_retune();
+    }
+    profile_since = HAL_GetTick();
+}
+
+uint32_t clock_profile_time_ms(Clock_Profile profile)
+{
+    if (profile >= CLOCK_PROFILE_COUNT) return 0;
+    uint32_t t = profile_ms[profile];
+    if (profile == current) t += HAL_GetTick() - profile_since;
+    return t;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file clock.h
+ * @brief System clock profiles (PLL burst / MSI bus / MSI low-power run)
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "stm32l0xx_hal.h"
+
+/** Clock profiles, from fastest to slowest */
+typedef enum {
+    CLOCK_PROFILE_BURST = 0,    // PLL 32 MHz, range 1, 1 wait state
+    CLOCK_PROFILE_BUS,          // MSI 2.097 MHz, range 3; I2C limited to Sm (100 kHz) (SystemClock_Config)
+    CLOCK_PROFILE_IDLE,         // MSI 65.5 kHz, range 3, Low-power run; no I2C
+    CLOCK_PROFILE_COUNT
+} Clock_Profile;
+
+/**
+ * @brief Start accounting; the clock must be in the BUS profile.
+ *
+ * Call once after SystemClock_Config() and i2c_bus_init().
+ */
+void clock_init(void);
+
+/**
+ * @brief Switch the system clock to another profile.
+ *
+ * Waits for the I2C queue to drain, then reconfigures oscillators, flash
+ * latency, voltage range and Low-power run in the order the reference
+ * manual requires. HAL_RCC_ClockConfig() reloads SysTick, and the I2C
+ * timing is recomputed through i2c_bus_retune(), so drivers keep working
+ * (in CLOCK_PROFILE_IDLE the bus is down and transfers fail immediately).
+ *
+ * @param profile Target profile
+ * @return HAL_OK, or HAL_ERROR if an oscillator failed to start (the
+ *         clock is then back in CLOCK_PROFILE_BUS)
+ */
+HAL_StatusTypeDef clock_set_profile(Clock_Profile profile);
+
+/**
+ * @brief Current profile.
+ *
+ * @return Active profile
+ */
+Clock_Profile clock_get_profile(void);
+
+/**
+ * @brief Select the STOP wake-up clock for the current profile.
+ *
+ * HSI16 for BURST (the PLL source), MSI for the range 3
+ * profiles, where HSI16 is above the range 3 frequency limit. Call right
+ * before entering STOP.
+ */
+void clock_prepare_stop(void);
+
+/**
+ * @brief Reapply the current profile after STOP mode.
+ *
+ * Brings back the clocks of the profile that was active before STOP. I2C
+ * timing is unchanged since PCLK1 is restored.
+ */
+void clock_restore(void);
+
+/**
+ * @brief Awake time spent in a profile since clock_init().
+ *
+ * Counted from HAL_GetTick() between clock_restore() and clock_prepare_stop(),
+ * so time asleep is not included.
+ *
+ * @param profile Profile to query
+ * @return Time in ms
+ */
+uint32_t clock_profile_time_ms(Clock_Profile profile);
+
+#endif // CLOCK_H
@@ -0,0 +1,108 @@
+/**
+ * @file config.c
+ * @brief Runtime configuration block in data EEPROM
+ */
+
+#include "config.h"
+#include "eeprom.h"
+#include "alarm.h"
+#include "oled_power.h"
+#include "sampler.h"
+#include <stddef.h>
+
+#define CONFIG_MAGIC    0xC0F1
+
+// Alarm macro limits are int32; the disabled sides map to the int16 ends
+#define CONFIG_LIMIT(v) ((v) <= INT16_MIN ? INT16_MIN : (v) >= INT16_MAX ? INT16_MAX : (int16_t)(v))
+
+typedef struct
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t size;           ///< sizeof(Config_Record) when written
+    Config_Record rec;
+    uint16_t crc;
+} Config_Stored;
+
+typedef char config_record_size_check[sizeof(Config_Record) == CONFIG_RECORD_BYTES ? 1 : -1];
+typedef char config_region_check[sizeof(Config_Stored) <= EEPROM_CONFIG_SIZE ? 1 : -1];
+
+static const Config_Record defaults = {
+    .profile = CONFIG_PROFILE_DEFAULT,
+    .sample_min = 1,
+    .sample_max = SAMPLER_MAX_PERIOD,
+    .contrast = OLED_CONTRAST,
+    .dim_ticks = OLED_POWER_DIM_TICKS,
+    .off_ticks = OLED_POWER_OFF_TICKS,
+    .alarm_temp_low = CONFIG_LIMIT(ALARM_TEMP_LOW),
+    .alarm_temp_high = CONFIG_LIMIT(ALARM_TEMP_HIGH),
+    .alarm_temp_hyst = ALARM_TEMP_HYST,
+    .alarm_humidity_low = CONFIG_LIMIT(ALARM_HUMIDITY_LOW),
+    .alarm_humidity_high = CONFIG_LIMIT(ALARM_HUMIDITY_HIGH),
+    .alarm_humidity_hyst = ALARM_HUMIDITY_HYST,
+};
+
+static const BME280_Profile *const profiles[CONFIG_PROFILE_COUNT] = {
+    [CONFIG_PROFILE_DEFAULT] = &BME280_DEFAULT_PROFILE,
+    [CONFIG_PROFILE_WEATHER] = &BME280_PROFILE_WEATHER,
+    [CONFIG_PROFILE_HUMIDITY] = &BME280_PROFILE_HUMIDITY,
+    [CONFIG_PROFILE_INDOOR_NAV] = &BME280_PROFILE_INDOOR_NAV,
+    [CONFIG_PROFILE_GAMING] = &BME280_PROFILE_GAMING,
+};
+
+static const Config_Record *config = &defaults;
+
+static uint8_t config_valid(const Config_Stored *s)
+{
+    return s->magic == CONFIG_MAGIC && s->version == CONFIG_VERSION &&
+           s->size == sizeof(Config_Record) &&
+           s->crc == eeprom_crc16(s, offsetof(Config_Stored, crc));
+}
+
+uint8_t config_load(void)
+{
+    const Config_Stored *stored = eeprom_ptr(EEPROM_CONFIG);
+
+    config = config_valid(stored) ? &stored->rec : &defaults;
+    return config != &defaults;
+}
+
+const Config_Record *config_get(void)
+{
+    return config;
+}
+
+uint8_t config_stored(void)
+{
+    return config != &defaults;
+}
+
+uint8_t config_set(const Config_Record *rec)
+{
+    Config_Stored s;
+
+    s.magic = CONFIG_MAGIC;
+    s.version = CONFIG_VERSION;
+    s.size = sizeof(Config_Record);
+    s.rec = *rec;
+    if (s.rec.profile >= CONFIG_PROFILE_COUNT) s.rec.profile = CONFIG_PROFILE_DEFAULT;
+    if (s.rec.sample_min == 0) s.rec.sample_min = 1;
+    if (s.rec.sample_max < s.rec.sample_min) s.rec.sample_max = s.rec.sample_min;
+    if (s.rec.off_ticks < s.rec.dim_ticks) s.rec.off_ticks = s.rec.dim_ticks;
+    if (s.rec.alarm_temp_hyst < 0) s.rec.alarm_temp_hyst = 0;
+    if (s.rec.alarm_humidity_hyst < 0) s.rec.alarm_humidity_hyst = 0;
+    s.crc = eeprom_crc16(&s, offsetof(Config_Stored, crc));
+
+    // A failed write may leave a torn block; it fails the CRC at the next boot
+    if (!eeprom_write(EEPROM_CONFIG, &s, sizeof(s)))
+    {
+        config = &defaults;
+        return 0;
+    }
+    return config_load();
+}
+
+const BME280_Profile *config_profile(void)
+{
+    return profiles[config->profile < CONFIG_PROFILE_COUNT ? config->profile : CONFIG_PROFILE_DEFAULT];
+}
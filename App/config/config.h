@@ -0,0 +1,94 @@
+/**
+ * @file config.h
+ * @brief Runtime configuration block in data EEPROM
+ *
+ * The tunables of the performance/power tradeoff, loaded at boot and
+ * replaced over the telemetry link (TELEMETRY_CMD_CONFIG, Tools/config.py)
+ * without a rebuild. Compile-time constants remain the defaults used while
+ * no valid block is stored.
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "bme280.h"
+
+/** Layout version; a stored block of another version is ignored */
+#define CONFIG_VERSION      1
+
+/** Alarm limit that disables its side, in Config_Record.alarm_* */
+#define CONFIG_ALARM_OFF_LOW    INT16_MIN
+#define CONFIG_ALARM_OFF_HIGH   INT16_MAX
+
+/** Sensor profile choices */
+typedef enum {
+    CONFIG_PROFILE_DEFAULT = 0,     // BME280_DEFAULT_PROFILE
+    CONFIG_PROFILE_WEATHER,
+    CONFIG_PROFILE_HUMIDITY,
+    CONFIG_PROFILE_INDOOR_NAV,
+    CONFIG_PROFILE_GAMING,
+    CONFIG_PROFILE_COUNT
+} Config_Profile;
+
+/**
+ * The configuration, little endian and without padding: it is stored and
+ * sent over the link as is
+ */
+typedef struct {
+    uint8_t profile;            ///< Config_Profile at full supply
+    uint8_t sample_min;         ///< Shortest sample interval, ticks
+    uint8_t sample_max;         ///< Longest sample interval, ticks
+    uint8_t contrast;           ///< Panel contrast at full supply, 0 keeps it off
+    uint16_t dim_ticks;         ///< Idle ticks before the panel dims
+    uint16_t off_ticks;         ///< Idle ticks before the panel sleeps
+    int16_t alarm_temp_low;     ///< 0.01 °C, or CONFIG_ALARM_OFF_LOW
+    int16_t alarm_temp_high;    ///< 0.01 °C, or CONFIG_ALARM_OFF_HIGH
+    int16_t alarm_temp_hyst;    ///< 0.01 °C
+    int16_t alarm_humidity_low; ///< 0.01 %RH, or CONFIG_ALARM_OFF_LOW
+    int16_t alarm_humidity_high;///< 0.01 %RH, or CONFIG_ALARM_OFF_HIGH
+    int16_t alarm_humidity_hyst;///< 0.01 %RH
+} Config_Record;
+
+#define CONFIG_RECORD_BYTES 20
+
+/**
+ * @brief Validate the stored block.
+ *
+ * Data EEPROM is memory mapped, so a valid block is used in place rather
+ * than copied to RAM; a missing, corrupt or other-version block selects
+ * the compile-time defaults.
+ *
+ * @return 1 if a valid block was found, 0 if the defaults are in use
+ */
+uint8_t config_load(void);
+
+/**
+ * @brief Configuration in use.
+ */
+const Config_Record *config_get(void);
+
+/**
+ * @brief Report whether config_get() comes from EEPROM.
+ */
+uint8_t config_stored(void);
+
+/**
+ * @brief Store a new configuration.
+ *
+ * Out-of-range fields are brought into range first: an unknown profile
+ * becomes CONFIG_PROFILE_DEFAULT, the sample interval is at least one
+ * tick wide, the panel sleeps no earlier than it dims and hysteresis is
+ * not negative. The caller applies the result to the modules.
+ *
+ * @param rec New configuration
+ * @return 1 on success, 0 if the EEPROM write failed (the defaults are
+ *         in use until a write succeeds)
+ */
+uint8_t config_set(const Config_Record *rec);
+
+/**
+ * @brief Sensor profile selected by the configuration.
+ */
+const BME280_Profile *config_profile(void);
+
+#endif // CONFIG_H
@@ -0,0 +1,158 @@
+/**
+ * @file derived.c
+ * @brief Dew point, absolute humidity and heat index in fixed point
+ *
+ * Logarithms and powers are kept in base 2: log2 and 2^x only need a
+ * normalisation shift plus one table step, and the natural-log constants
+ * are folded into fixed multipliers.
+ */
+
+#include "derived.h"
+
+#define MAGNUS_B_Q13    144343      // 17.62
+#define MAGNUS_B_Q12    72172
+#define MAGNUS_C        24312       // 243.12 degC in 0.01 degC
+#define LN2_Q12         2839
+#define LOG2E_FRAC_Q13  3627        // log2(e) - 1
+#define LOG2_RH_FULL    1090772     // log2(100 %RH in Q22.10), Q16
+
+#define T_MIN           -4000       // Sensor range, 0.01 degC
+#define T_MAX           8500
+#define RH_MIN          1024        // 1 %RH, Q22.10
+
+// log2(1 + i / 16) and 2^(i / 16), Q16
+static const uint32_t log2_table[17] = {
+    0, 5732, 11136, 16248, 21098, 25711, 30109, 34312, 38336,
+    42196, 45904, 49472, 52911, 56229, 59434, 62534, 65536
+};
+static const uint32_t exp2_table[17] = {
+    65536, 68438, 71468, 74632, 77936, 81386, 84990, 88752, 92682,
+    96785, 101070, 105545, 110218, 115098, 120194, 125515, 131072
+};
+
+static int32_t derived_clamp_t(int32_t t)
+{
+    return t < T_MIN ? T_MIN : t > T_MAX ? T_MAX : t;
+}
+
+// log2(x) for x >= 1, Q16
+static int32_t derived_log2(uint32_t x)
+{
+    int32_t e = 31;
+
+    while (!(x & 0x80000000UL))
+    {
+        x <<= 1;
+        e--;
+    }
+    uint8_t i = (x >> 27) & 0x0F;
+    uint32_t f = (x >> 11) & 0xFFFF;
+    return e * 65536 + log2_table[i] + (int32_t)(((log2_table[i + 1] - log2_table[i]) * f) >> 16);
+}
+
+// 2^x for x in Q16 below 15.0, Q16
+static uint32_t derived_exp2(int32_t x)
+{
+    int32_t k = x >> 16;            // Floor, also for negative x
+    uint32_t f = (uint32_t)x & 0xFFFF;
+    uint8_t i = f >> 12;
+    uint32_t m = exp2_table[i] + (((exp2_table[i + 1] - exp2_table[i]) * (f & 0x0FFF)) >> 12);
+    return k >= 0 ? m << k : m >> -k;
+}
+
+// b * T / (c + T): ln of the saturation vapour pressure over 6.112 hPa, Q16
+static int32_t derived_magnus(int32_t t)
+{
+    return t * MAGNUS_B_Q13 / (MAGNUS_C + t) * 8;
+}
+
+int32_t derived_dew_point(const BME280_Measurement *m)
+{
+    int32_t t = derived_clamp_t(m->temperature);
+    uint32_t h = m->humidity < RH_MIN ? RH_MIN : m->humidity;
+
+    int32_t ln_rh = (derived_log2(h) - LOG2_RH_FULL) * LN2_Q12 / 4096;
+    int32_t gamma = (ln_rh + derived_magnus(t) + 8) >> 4;      // Q12
+    return MAGNUS_C * gamma / (MAGNUS_B_Q12 - gamma);
+}
+
+uint32_t derived_absolute_humidity(const BME280_Measurement *m)
+{
+    int32_t t = derived_clamp_t(m->temperature);
+    int32_t y = derived_magnus(t);
+
+    // es = 6.112 hPa * e^y = 611.2 Pa * 2^(y * log2(e)), in Pa Q4
+    uint32_t es = (uint32_t)(((uint64_t)derived_exp2(y + ((y * LOG2E_FRAC_Q13) >> 13)) * 2445) >> 14);
+    // Vapour pressure scaled by 256, over the temperature in 0.01 K / 16
+    uint32_t e = (uint32_t)(((uint64_t)es * m->humidity) >> 6);
+    uint32_t q = e / ((uint32_t)(t + 27315) >> 4);
+    // rho = e / (Rv * T) = e * 216.685 / T in 0.01 g/m^3
+    return (q * 3467) >> 16;
+}
+
+// Rothfusz coefficients scaled by 2^32
+#define HI_C0   (-182016419037LL)  // -42.379
+#define HI_C1   8800453402LL       // 2.04901523
+#define HI_C2   43565276077LL      // 10.14333127
+#define HI_C3   (-965317136LL)     // -0.22475541
+#define HI_C4   (-29368256LL)      // -6.83783e-3
+#define HI_C5   (-235437952LL)     // -5.481717e-2
+#define HI_C6   5277398LL          // 1.22874e-3
+#define HI_C7   3662834LL          // 8.5282e-4
+#define HI_C8   (-8547LL)          // -1.99e-6
+
+// k0 + k1 * r + k2 * r^2 with r in Q8, Q32
+static int64_t derived_poly(int64_t k0, int64_t k1, int64_t k2, int32_t r)
+{
+    return k0 + ((k1 * r) >> 8) + ((((k2 * r) >> 8) * r) >> 8);
+}
+
+static uint32_t derived_isqrt(uint32_t x)
+{
+    uint32_t root = 0, bit = 1UL << 30;
+
+    while (bit > x) bit >>= 2;
+    while (bit)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+int32_t derived_heat_index(const BME280_Measurement *m)
+{
+    int32_t t = ((derived_clamp_t(m->temperature) * 18874) >> 12) + 32 * 256;  // degF, Q8
+    int32_t r = (int32_t)(m->humidity >> 2);                                   // %RH, Q8
+    int32_t hi;
+
+    // Steadman: 0.5 * (T + 61 + 1.2 * (T - 68) + 0.094 * RH)
+    hi = (t + 61 * 256 + (((t - 68 * 256) * 1229) >> 10) + ((r * 385) >> 12)) / 2;
+    if (hi + t >= 2 * 80 * 256)
+    {
+        int64_t a = derived_poly(HI_C0, HI_C2, HI_C5, r);
+        int64_t b = derived_poly(HI_C1, HI_C3, HI_C7, r);
+        int64_t c = derived_poly(HI_C4, HI_C6, HI_C8, r);
+        hi = (int32_t)((a + (((b + ((c * t) >> 8)) * t) >> 8)) >> 24);
+
+        if (r < 13 * 256 && t >= 80 * 256 && t <= 112 * 256)
+        {
+            // - (13 - RH) / 4 * sqrt((17 - |T - 95|) / 17)
+            int32_t d = t - 95 * 256;
+            uint32_t ratio = ((uint32_t)(17 * 256 - (d < 0 ? -d : d)) * 3855) >> 16;   // / 17
+            hi -= (int32_t)(((uint32_t)(13 * 256 - r) / 4 * derived_isqrt(ratio << 8)) >> 8);
+        }
+        else if (r > 85 * 256 && t >= 80 * 256 && t <= 87 * 256)
+        {
+            // + (RH - 85) / 10 * (87 - T) / 5
+            hi += ((((r - 85 * 256) * (87 * 256 - t)) >> 8) * 1311) >> 16;
+        }
+    }
+    return ((hi - 32 * 256) * 3556) >> 14;      // degF Q8 -> 0.01 degC
+}
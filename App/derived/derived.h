@@ -0,0 +1,58 @@
+/**
+ * @file derived.h
+ * @brief Dew point, absolute humidity and heat index in fixed point
+ *
+ * All functions take a compensated measurement as returned by
+ * BME280_read() and use no floating point. Logarithms and exponentials go
+ * through 17-entry flash tables with linear interpolation.
+ *
+ * Accuracy against double precision evaluation of the same formulas, over
+ * -40..85 degC and 1..100 %RH:
+ * - dew point: within 0.03 degC (the Magnus fit itself is good to about
+ *   0.1 degC over that range)
+ * - absolute humidity: within 0.5 % above 2 g/m^3, 0.02 g/m^3 below
+ * - heat index: within 0.1 degC, except right at the 80 degF switch between
+ *   the two NOAA fits, where rounding may pick the other one
+ *
+ * Cost is set by the libgcc helpers, as the M0+ has no divider: the dew
+ * point and absolute humidity take two 32-bit divisions each (some 100
+ * cycles apiece), the heat index about a dozen 64-bit multiplies and no
+ * division. These are estimates, not cycle-counted on the target.
+ */
+
+#ifndef DERIVED_H
+#define DERIVED_H
+
+#include "bme280.h"
+
+/**
+ * @brief Dew point by the Magnus formula (b = 17.62, c = 243.12 degC).
+ *
+ * Humidity below 1 %RH is clamped to 1 %RH.
+ *
+ * @param m Compensated measurement
+ * @return Dew point in 0.01 degC
+ */
+int32_t derived_dew_point(const BME280_Measurement *m);
+
+/**
+ * @brief Absolute humidity, from the Magnus saturation vapour pressure.
+ *
+ * @param m Compensated measurement
+ * @return Water vapour density in 0.01 g/m^3
+ */
+uint32_t derived_absolute_humidity(const BME280_Measurement *m);
+
+/**
+ * @brief Heat index by the NOAA algorithm (Rothfusz regression with its
+ * low- and high-humidity adjustments).
+ *
+ * Below about 27 degC this is the simple Steadman fit and stays close to
+ * the air temperature.
+ *
+ * @param m Compensated measurement
+ * @return Apparent temperature in 0.01 degC
+ */
+int32_t derived_heat_index(const BME280_Measurement *m);
+
+#endif // DERIVED_H
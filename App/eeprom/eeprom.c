@@ -0,0 +1,52 @@
+/**
+ * @file eeprom.c
+ * @brief Data EEPROM access for the STM32L011 (512 B at DATA_EEPROM_BASE)
+ *
+ * Thin wrapper around the HAL FLASHEx DATAEEPROM functions. Reads go straight
+ * through the memory-mapped EEPROM (see eeprom_ptr()); writes are done per
+ * word and skip words whose contents would not change.
+ */
+
+#include "eeprom.h"
+#include <string.h>
+
+uint8_t eeprom_write(uint16_t offset, const void *data, uint16_t len)
+{
+    if ((offset & 3) || offset + len > EEPROM_SIZE) return 0;
+
+    const uint8_t *src = data;
+    volatile const uint32_t *dst = (volatile const uint32_t *)(DATA_EEPROM_BASE + offset);
+    uint8_t ok = 1;
+
+    HAL_FLASHEx_DATAEEPROM_Unlock();
+    for (uint16_t i = 0; i < len; i += 4, dst++)
+    {
+        uint32_t word = *dst;
+        memcpy(&word, src + i, (len - i) < 4 ? (len - i) : 4);
+        if (word == *dst) continue;
+        if (HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_WORD, (uint32_t)dst, word) != HAL_OK)
+        {
+            ok = 0;
+            break;
+        }
+    }
+    HAL_FLASHEx_DATAEEPROM_Lock();
+    return ok;
+}
+
+uint16_t eeprom_crc16(const void *data, uint16_t len)
+{
+    return eeprom_crc16_update(0xFFFF, data, len);
+}
+
+uint16_t eeprom_crc16_update(uint16_t crc, const void *data, uint16_t len)
+{
+    const uint8_t *p = data;
+    while (len--)
+    {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
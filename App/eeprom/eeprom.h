@@ -0,0 +1,68 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include "stm32l0xx_hal.h"
+
+#define EEPROM_SIZE            (DATA_EEPROM_END - DATA_EEPROM_BASE + 1)   // 512 B
+
+/*
+ * Data EEPROM layout. Every region starts on a word boundary.
+ */
+#define EEPROM_BME280_CALIB    0x000   // 64 B: cached BME280 calibration block
+#define EEPROM_CALIB           0x040   // 16 B: per-device offsets, slopes and altitude
+#define EEPROM_CONFIG          0x050   // 32 B: runtime configuration block
+#define EEPROM_CONFIG_SIZE     0x020
+#define EEPROM_LOG             0x080   // 384 B: wear-leveled measurement log
+#define EEPROM_LOG_SIZE        0x180
+
+/**
+ * @brief Get a read pointer into data EEPROM.
+ *
+ * Data EEPROM is memory mapped, so reads need no driver call.
+ *
+ * @param offset Byte offset inside data EEPROM
+ * @return Pointer to the EEPROM contents at @p offset
+ */
+static inline const void *eeprom_ptr(uint16_t offset)
+{
+    return (const void *)(DATA_EEPROM_BASE + offset);
+}
+
+/**
+ * @brief Write a block to data EEPROM.
+ *
+ * The block is programmed word by word; words that already hold the new
+ * value are skipped, which saves the ~3.2 ms program time and wear for them.
+ *
+ * @param offset Word-aligned byte offset inside data EEPROM
+ * @param data Source data
+ * @param len Number of bytes (rounded up to whole words)
+ * @return 1 on success, 0 on bad arguments or a programming error
+ */
+uint8_t eeprom_write(uint16_t offset, const void *data, uint16_t len);
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over a buffer.
+ *
+ * Bitwise implementation without lookup table, used to validate records.
+ *
+ * @param data Buffer
+ * @param len Length in bytes
+ * @return CRC value
+ */
+uint16_t eeprom_crc16(const void *data, uint16_t len);
+
+/**
+ * @brief Continue a CRC-16/CCITT-FALSE over another buffer.
+ *
+ * eeprom_crc16(a) followed by eeprom_crc16_update() over b gives the CRC
+ * of a and b back to back, for data that is not contiguous in memory.
+ *
+ * @param crc CRC so far (0xFFFF to start)
+ * @param data Buffer
+ * @param len Length in bytes
+ * @return CRC value
+ */
+uint16_t eeprom_crc16_update(uint16_t crc, const void *data, uint16_t len);
+
+#endif // EEPROM_H
@@ -0,0 +1,115 @@
+/**
+ * @file energy.c
+ * @brief Firmware-side energy accounting per subsystem
+ *
+ * Charge is summed in nC (µA·ms) and carried into whole µAh (3.6e6 nC)
+ * on every update, so no fraction is lost between updates.
+ */
+
+#include "energy.h"
+#include "bme280.h"
+#include "i2c_bus.h"
+#include "oled_power.h"
+
+#define NC_PER_UAH  3600000U
+
+static const uint16_t profile_ua[CLOCK_PROFILE_COUNT] = {
+    ENERGY_BURST_UA, ENERGY_BUS_UA, ENERGY_IDLE_UA
+};
+
+static Energy_Counters counters;
+static uint32_t last_tick, last_run_ms[CLOCK_PROFILE_COUNT], last_i2c_us, last_conversions, last_conv_nc;
+static uint32_t start_tick;
+#if RADIO
+static uint32_t last_radio_us;
+#endif
+static uint32_t charge_uah, charge_nc;
+
+void energy_init(void)
+{
+    start_tick = last_tick = HAL_GetTick();
+    for (uint8_t p = 0; p < CLOCK_PROFILE_COUNT; p++)
+        last_run_ms[p] = clock_profile_time_ms(p);
+    last_i2c_us = i2c_bus_wire_us();
+    last_conversions = BME280_conversion_count();
+    last_conv_nc = BME280_conversion_charge_nc();
+#if RADIO
+    last_radio_us = radio_get_stats()->on_us;
+#endif
+}
+
+static void energy_add(uint32_t nc)
+{
+    charge_nc += nc;
+    if (charge_nc >= NC_PER_UAH)
+    {
+        charge_uah += charge_nc / NC_PER_UAH;
+        charge_nc %= NC_PER_UAH;
+    }
+}
+
+void energy_update(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t dt = now - last_tick;
+    uint32_t awake = 0;
+    last_tick = now;
+
+    for (uint8_t p = 0; p < CLOCK_PROFILE_COUNT; p++)
+    {
+        uint32_t t = clock_profile_time_ms(p);
+        uint32_t d = t - last_run_ms[p];
+        last_run_ms[p] = t;
+        counters.run_ms[p] += d;
+        awake += d;
+        energy_add(d * profile_ua[p]);
+    }
+    uint32_t stop = dt > awake ? dt - awake : 0;
+    counters.stop_ms += stop;
+    energy_add(stop * ENERGY_STOP_UA + dt * ENERGY_BASE_UA);
+
+    uint32_t wire = i2c_bus_wire_us();
+    uint32_t d_us = wire - last_i2c_us;
+    last_i2c_us = wire;
+    counters.i2c_us += d_us;
+    energy_add(d_us * ENERGY_I2C_UA / 1000U);
+
+    if (oled_is_awake())
+    {
+        counters.oled_on_ms += dt;
+        energy_add(dt * ENERGY_OLED_UA);
+    }
+
+    uint32_t conv = BME280_conversion_count();
+    uint32_t d_conv = conv - last_conversions;
+    last_conversions = conv;
+    counters.conversions += d_conv;
+    uint32_t conv_nc = BME280_conversion_charge_nc();
+    energy_add(conv_nc - last_conv_nc);
+    last_conv_nc = conv_nc;
+
+#if RADIO
+    uint32_t radio = radio_get_stats()->on_us;
+    d_us = radio - last_radio_us;
+    last_radio_us = radio;
+    counters.radio_us += d_us;
+    energy_add(d_us * ENERGY_RADIO_UA / 1000U);
+#endif
+}
+
+uint32_t energy_charge_uah(void)
+{
+    return charge_uah;
+}
+
+uint32_t energy_average_ua(void)
+{
+    uint32_t ms = HAL_GetTick() - start_tick;
+    if (ms == 0) return 0;
+    return (uint32_t)(((uint64_t)charge_uah * NC_PER_UAH + charge_nc) / ms);
+}
+
+const Energy_Counters *energy_get_counters(void)
+{
+    return &counters;
+}
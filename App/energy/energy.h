@@ -0,0 +1,88 @@
+/**
+ * @file energy.h
+ * @brief Firmware-side energy accounting per subsystem
+ *
+ * Time in each clock profile (clock.h), STOP time, I2C wire time, panel
+ * on-time, radio on-time and the number of sensor conversions are turned
+ * into charge with the per-board current table below and summed into a
+ * running estimate. Nothing is measured: the figures are only as good as the
+ * table, so calibrate it once against a meter for a new board.
+ *
+ * WFI sleep inside a clock profile is charged as run time at that
+ * profile, which overestimates a little. The panel is charged at one
+ * current whatever its contrast and content.
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include "clock.h"
+#include "radio.h"
+
+/** Per-board supply currents, µA (typical datasheet figures at 3 V) */
+#ifndef ENERGY_BURST_UA
+#define ENERGY_BURST_UA     3600    // Run, PLL 32 MHz, range 1
+#endif
+#ifndef ENERGY_BUS_UA
+#define ENERGY_BUS_UA       250     // Run, MSI 2.1 MHz, range 3
+#endif
+#ifndef ENERGY_IDLE_UA
+#define ENERGY_IDLE_UA      15      // Low-power run, MSI 65.5 kHz
+#endif
+#ifndef ENERGY_STOP_UA
+#define ENERGY_STOP_UA      1       // STOP with the RTC and LPTIM running
+#endif
+#ifndef ENERGY_BASE_UA
+#define ENERGY_BASE_UA      5       // Always: sleeping panel controller, sensor, LSE
+#endif
+#ifndef ENERGY_I2C_UA
+#define ENERGY_I2C_UA       700     // Extra while on the wire: 4.7 kΩ pull-ups
+#endif
+#ifndef ENERGY_OLED_UA
+#define ENERGY_OLED_UA      8000    // Extra while the panel is on
+#endif
+#ifndef ENERGY_RADIO_UA
+#define ENERGY_RADIO_UA     12500   // Extra while the radio is on air or listening
+#endif
+
+/** Cumulative counters since energy_init() */
+typedef struct {
+    uint32_t run_ms[CLOCK_PROFILE_COUNT];  // Awake time per profile
+    uint32_t stop_ms;
+    uint32_t i2c_us;        // Wire time
+    uint32_t oled_on_ms;
+    uint32_t conversions;   // Forced BME280 conversions
+#if RADIO
+    uint32_t radio_us;      // RF on-time (radio.h)
+#endif
+} Energy_Counters;
+
+/**
+ * @brief Take the baselines; call after clock_init().
+ */
+void energy_init(void);
+
+/**
+ * @brief Account for the time since the previous call.
+ *
+ * Call about once a second; the panel state is sampled here, and one
+ * interval of the charge terms must stay below ~500 s to fit 32 bits.
+ */
+void energy_update(void);
+
+/**
+ * @brief Estimated charge drawn since energy_init(), in µAh.
+ */
+uint32_t energy_charge_uah(void);
+
+/**
+ * @brief Average current since energy_init(), in µA.
+ */
+uint32_t energy_average_ua(void);
+
+/**
+ * @brief Live counters behind the estimate.
+ */
+const Energy_Counters *energy_get_counters(void);
+
+#endif // ENERGY_H
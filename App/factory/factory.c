@@ -0,0 +1,235 @@
+/**
+ * @file factory.c
+ * @brief Batch calibration against a reference sensor, for the Factory
+ *        build configuration
+ *
+ * Per channel the fit keeps the pair count and the sums of x, e, x^2 and
+ * x * e, with x the unit's reading relative to the pivot and e the
+ * reference minus the unit. At the end the slope is
+ * (n Sxe - Sx Se) / (n Sxx - Sx^2) and the offset (Se - slope Sx) / n,
+ * each rounded to the units of Calib_Record.
+ */
+
+#include "factory.h"
+
+#if FACTORY
+
+#include "calib.h"
+#include "eeprom.h"
+#include "telemetry.h"
+#include <string.h>
+
+#define FACTORY_CHANNELS    3       // Calib_Record order: T, H, P
+#define FACTORY_RESULT_LEN  10
+
+typedef struct {
+    uint16_t n;
+    int32_t min, max;               // Unit readings, for the span
+    int32_t sx, se;
+    int64_t sxx, sxe;
+} factory_fit;
+
+// Unit readings since the last reference
+typedef struct {
+    uint8_t n;
+    int32_t sum[FACTORY_CHANNELS];
+} factory_mean;
+
+static const int32_t pivot[FACTORY_CHANNELS] = { CALIB_PIVOT_T, CALIB_PIVOT_H, CALIB_PIVOT_P };
+static const int32_t span[FACTORY_CHANNELS] = { FACTORY_SPAN_T, FACTORY_SPAN_H, FACTORY_SPAN_P };
+
+static volatile uint8_t active;
+static volatile uint8_t write_requested;
+static volatile uint8_t ref_ready;      // ref[] holds a frame not yet taken
+static uint8_t ref_len;                 // Bytes of the frame coming in
+static uint8_t ref_rx[FACTORY_REF_LEN];
+static uint8_t ref[FACTORY_REF_LEN];
+
+static uint32_t factory_get32(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 0.01 degC, Q22.10 %RH and whole Pa, as Calib_Record counts them
+static void factory_values(int32_t *v, int32_t t, uint32_t p, uint32_t h)
+{
+    v[0] = t;
+    v[1] = (int32_t)h;
+    v[2] = (int32_t)(p >> 8);
+}
+
+uint8_t factory_rx(uint8_t c)
+{
+    if (!active) return 0;
+    if (ref_len == 0)
+    {
+        // Anything else between frames is noise
+        if (c == FACTORY_CMD_WRITE) write_requested = 1;
+        else if (c == FACTORY_REF_SYNC) ref_rx[ref_len++] = c;
+        return 1;
+    }
+    ref_rx[ref_len++] = c;
+    if (ref_len < FACTORY_REF_LEN) return 1;
+    ref_len = 0;
+    // The main loop takes a frame within one conversion, well inside a
+    // frame time; one arriving before that is dropped
+    if (!ref_ready)
+    {
+        memcpy(ref, ref_rx, sizeof(ref));
+        ref_ready = 1;
+    }
+    return 1;
+}
+
+static void factory_sample(factory_mean *mean, const BME280_Measurement *m)
+{
+    int32_t v[FACTORY_CHANNELS];
+
+    if (mean->n == UINT8_MAX) return;
+    factory_values(v, m->temperature, m->pressure, m->humidity);
+    for (uint8_t ch = 0; ch < FACTORY_CHANNELS; ch++)
+        mean->sum[ch] += v[ch];
+    mean->n++;
+}
+
+// Pair the reference in ref[] with the unit's mean since the last one;
+// 0 while there is no reading to pair it with yet
+static uint8_t factory_pair(factory_fit *fit, factory_mean *mean)
+{
+    int32_t v[FACTORY_CHANNELS];
+
+    if (eeprom_crc16(ref, FACTORY_REF_LEN - 2) != (uint16_t)(ref[14] | (ref[15] << 8))) return 1;
+    if (mean->n == 0) return 0;
+    factory_values(v, (int32_t)factory_get32(&ref[2]), factory_get32(&ref[6]), factory_get32(&ref[10]));
+
+    for (uint8_t ch = 0; ch < FACTORY_CHANNELS; ch++)
+    {
+        factory_fit *f = &fit[ch];
+        int32_t x = mean->sum[ch] / mean->n;
+        int32_t e = v[ch] - x;
+
+        if (!(ref[1] & (1U << ch)) || f->n >= FACTORY_MAX_POINTS) continue;
+        if (e < INT16_MIN || e > INT16_MAX) continue;   // Beyond any offset
+        if (f->n == 0 || x < f->min) f->min = x;
+        if (f->n == 0 || x > f->max) f->max = x;
+        x -= pivot[ch];
+        f->n++;
+        f->sx += x;
+        f->se += e;
+        f->sxx += (int64_t)x * x;
+        f->sxe += (int64_t)x * e;
+    }
+    memset(mean, 0, sizeof(*mean));
+    return 1;
+}
+
+static int64_t factory_div_round(int64_t num, int64_t den)
+{
+    return (num + (num < 0 ? -den : den) / 2) / den;
+}
+
+// Offset and slope of one channel; 0 if it has too few pairs or a result
+// out of the record's range
+static uint8_t factory_solve(const factory_fit *f, uint8_t ch, int16_t *offset, int8_t *slope)
+{
+    int64_t b = 0;
+
+    if (f->n < FACTORY_MIN_POINTS) return 0;
+    if (f->max - f->min >= span[ch])
+    {
+        int64_t num = (int64_t)f->n * f->sxe - (int64_t)f->sx * f->se;
+        int64_t den = (int64_t)f->n * f->sxx - (int64_t)f->sx * f->sx;
+        // Both halved until the scaled numerator fits
+        while (num > INT64_MAX >> (CALIB_SLOPE_SHIFT + 1) || num < -(INT64_MAX >> (CALIB_SLOPE_SHIFT + 1)))
+        {
+            num /= 2;
+            den /= 2;
+        }
+        if (den <= 0) return 0;
+        b = factory_div_round(num * (1 << CALIB_SLOPE_SHIFT), den);
+        if (b < INT8_MIN || b > INT8_MAX) return 0;
+    }
+    int64_t a = factory_div_round((int64_t)f->se * (1 << CALIB_SLOPE_SHIFT) - b * f->sx,
+                                  (int64_t)f->n << CALIB_SLOPE_SHIFT);
+    if (a < INT16_MIN || a > INT16_MAX) return 0;
+    *offset = (int16_t)a;
+    *slope = (int8_t)b;
+    return 1;
+}
+
+static void factory_finish(const factory_fit *fit)
+{
+    Calib_Record rec = *calib_get();
+    int16_t offset[FACTORY_CHANNELS];
+    int8_t slope[FACTORY_CHANNELS];
+    uint8_t head[FACTORY_RESULT_LEN], crc[2];
+    uint8_t fitted = 0;
+
+    for (uint8_t ch = 0; ch < FACTORY_CHANNELS; ch++)
+        if (factory_solve(&fit[ch], ch, &offset[ch], &slope[ch])) fitted |= 1U << ch;
+    if (fitted & CALIB_FIT_T)
+    {
+        rec.temperature = offset[0];
+        rec.temperature_slope = slope[0];
+    }
+    if (fitted & CALIB_FIT_H)
+    {
+        rec.humidity = offset[1];
+        rec.humidity_slope = slope[1];
+    }
+    if (fitted & CALIB_FIT_P)
+    {
+        rec.pressure = offset[2];
+        rec.pressure_slope = slope[2];
+    }
+    rec.fitted |= fitted;
+
+    head[0] = FACTORY_RESULT_SYNC;
+    head[1] = fitted;
+    head[2] = fitted ? calib_set(&rec) : 0;
+    head[3] = sizeof(Calib_Record);
+    for (uint8_t ch = 0; ch < FACTORY_CHANNELS; ch++)
+    {
+        head[4 + 2 * ch] = (uint8_t)fit[ch].n;
+        head[5 + 2 * ch] = (uint8_t)(fit[ch].n >> 8);
+    }
+    uint16_t c = eeprom_crc16(head, sizeof(head));
+    c = eeprom_crc16_update(c, calib_get(), sizeof(Calib_Record));
+    crc[0] = (uint8_t)c;
+    crc[1] = (uint8_t)(c >> 8);
+
+    // The crystal runs, or no reference would have come in
+    telemetry_write_blocking(head, sizeof(head), 0);
+    telemetry_write_blocking(calib_get(), sizeof(Calib_Record), 0);
+    telemetry_write_blocking(crc, sizeof(crc), 0);
+}
+
+void factory_run(BME280_Dev *dev)
+{
+    // On the stack: the scheduler's deeper paths have not started yet
+    factory_fit fit[FACTORY_CHANNELS];
+    factory_mean mean;
+    uint32_t start = HAL_GetTick();
+    uint8_t seen = 0;
+
+    memset(fit, 0, sizeof(fit));
+    memset(&mean, 0, sizeof(mean));
+    BME280_set_profile(dev, &BME280_PROFILE_WEATHER);
+    active = 1;
+    while (!write_requested)
+    {
+        BME280_Measurement m;
+        if (BME280_read(dev, &m) == BME280_OK) factory_sample(&mean, &m);
+        if (ref_ready && factory_pair(fit, &mean))
+        {
+            seen = 1;
+            ref_ready = 0;
+        }
+        else if (!seen && HAL_GetTick() - start >= FACTORY_WAIT_MS) break;
+    }
+    active = 0;
+    if (write_requested) factory_finish(fit);
+    BME280_set_profile(dev, &BME280_DEFAULT_PROFILE);
+}
+
+#endif // FACTORY
@@ -0,0 +1,104 @@
+/**
+ * @file factory.h
+ * @brief Batch calibration against a reference sensor, for the Factory
+ *        build configuration
+ *
+ * The Factory configuration defines FACTORY. main() then runs one
+ * calibration session after start-up, before the scheduler: the sensor
+ * converts back to back in forced mode at BME280_PROFILE_WEATHER (x1
+ * everywhere, about 100 results a second) while a host streams readings
+ * of a reference sensor next to it over the telemetry UART. Each
+ * reference is paired with the mean of the unit's readings since the one
+ * before, and the pair goes into running sums per channel; nothing is
+ * kept per pair, so a session can run as long as the host likes. With
+ * one reference every frame time, a few seconds give a few hundred pairs.
+ *
+ * FACTORY_CMD_WRITE ('W') between frames ends the session: each channel
+ * with at least FACTORY_MIN_POINTS pairs gets a least-squares fit of the
+ * error (reference minus unit) against the unit's reading. The offset is
+ * the fitted error at the CALIB_PIVOT_* point (calib.h); the slope is only
+ * fitted when the unit's readings span FACTORY_SPAN_* or more, otherwise
+ * it is 0. The result replaces those channels of the calibration record,
+ * keeps the rest and the altitude, and is stored with calib_set().
+ *
+ * Reference frame, host to unit, little endian:
+ *
+ * | Offset | Size | Field                                           |
+ * |--------|------|-------------------------------------------------|
+ * | 0      | 1    | Sync, FACTORY_REF_SYNC (0xA6)                   |
+ * | 1      | 1    | Channels the reference covers, CALIB_FIT_* bits |
+ * | 2      | 4    | Temperature, int32, 0.01 degC                   |
+ * | 6      | 4    | Pressure, uint32, Q24.8 Pa                      |
+ * | 10     | 4    | Humidity, uint32, Q22.10 %RH                    |
+ * | 14     | 2    | CRC-16/CCITT-FALSE over bytes 0..13             |
+ *
+ * The fields are those of the telemetry frame (telemetry.h). Frames with
+ * a bad CRC are dropped.
+ *
+ * Answer to 'W', unit to host:
+ *
+ * | Offset | Size | Field                                           |
+ * |--------|------|-------------------------------------------------|
+ * | 0      | 1    | Sync, FACTORY_RESULT_SYNC (0x5E)                |
+ * | 1      | 1    | Channels fitted, CALIB_FIT_* bits               |
+ * | 2      | 1    | 1 if the record is stored in EEPROM             |
+ * | 3      | 1    | Record size R                                   |
+ * | 4      | 6    | Pairs per channel, uint16: T, H, P              |
+ * | 10     | R    | The Calib_Record now in use (calib.h)           |
+ * | 10 + R | 2    | CRC-16/CCITT-FALSE over bytes 0 .. 9 + R        |
+ *
+ * Without a reference frame within FACTORY_WAIT_MS of start-up the
+ * session ends with nothing changed, so a Factory build off the jig runs
+ * as usual. After the answer, too, the unit goes on to normal operation,
+ * with the new calibration. Tools/factory.py drives a session.
+ */
+
+#ifndef FACTORY_H
+#define FACTORY_H
+
+#include "bme280.h"
+
+#ifndef FACTORY
+#define FACTORY 0
+#endif
+
+#define FACTORY_REF_SYNC        0xA6
+#define FACTORY_REF_LEN         16
+#define FACTORY_RESULT_SYNC     0x5E
+#define FACTORY_CMD_WRITE       'W'
+
+#define FACTORY_WAIT_MS         3000    // For the first reference frame
+#define FACTORY_MIN_POINTS      8       // Pairs a channel needs to be fitted
+#define FACTORY_MAX_POINTS      4096    // Further pairs are ignored; keeps the sums in range
+
+/** Smallest span of the unit's readings that fits a slope, per channel */
+#define FACTORY_SPAN_T          500             // 5 degC
+#define FACTORY_SPAN_H          (20 * 1024)     // 20 %RH
+#define FACTORY_SPAN_P          2000            // 20 hPa
+
+#if FACTORY
+#if MODBUS
+#error "FACTORY takes references over the command link, which MODBUS replaces"
+#endif
+
+/**
+ * @brief Run the session and send the answer.
+ *
+ * Needs telemetry_init() and calib_load(). Leaves the sensor at
+ * BME280_DEFAULT_PROFILE in forced mode.
+ *
+ * @param dev Initialised sensor
+ */
+void factory_run(BME280_Dev *dev);
+
+/**
+ * @brief Take a received byte while a session runs; called from the
+ *        LPUART interrupt.
+ *
+ * @return 1 if the byte belongs to the session, 0 if it is a command for
+ *         the telemetry link
+ */
+uint8_t factory_rx(uint8_t c);
+#endif
+
+#endif // FACTORY_H
@@ -0,0 +1,77 @@
+/**
+ * @file filter.c
+ * @brief Integer median + exponential moving average for sensor readings
+ */
+
+#include "filter.h"
+
+void filter_init(filter_value *f, uint8_t shift)
+{
+    f->shift = shift;
+    filter_reset(f);
+}
+
+void filter_reset(filter_value *f)
+{
+    f->pos = 0;
+    f->valid = 0;
+}
+
+#if FILTER_MEDIAN_TAPS > 1
+static void filter_order(int32_t *a, int32_t *b)
+{
+    if (*a > *b)
+    {
+        int32_t t = *a;
+        *a = *b;
+        *b = t;
+    }
+}
+
+// Sorting networks: three compare-exchanges for 3 taps, seven for 5
+static int32_t filter_median(const int32_t *taps)
+{
+    int32_t v[FILTER_MEDIAN_TAPS];
+
+    for (uint8_t i = 0; i < FILTER_MEDIAN_TAPS; i++)
+        v[i] = taps[i];
+#if FILTER_MEDIAN_TAPS == 3
+    filter_order(&v[0], &v[1]);
+    filter_order(&v[1], &v[2]);
+    filter_order(&v[0], &v[1]);
+    return v[1];
+#else
+    filter_order(&v[0], &v[1]);
+    filter_order(&v[3], &v[4]);
+    filter_order(&v[0], &v[3]);
+    filter_order(&v[1], &v[4]);
+    filter_order(&v[1], &v[2]);
+    filter_order(&v[2], &v[3]);
+    filter_order(&v[1], &v[2]);
+    return v[2];
+#endif
+}
+#endif
+
+int32_t filter_update(filter_value *f, int32_t x)
+{
+    if (!f->valid)
+    {
+        for (uint8_t i = 0; i < FILTER_MEDIAN_TAPS; i++)
+            f->taps[i] = x;
+        f->acc = x * (1L << f->shift);
+        f->valid = 1;
+        return x;
+    }
+
+    f->taps[f->pos] = x;
+    if (++f->pos == FILTER_MEDIAN_TAPS) f->pos = 0;
+#if FILTER_MEDIAN_TAPS > 1
+    x = filter_median(f->taps);
+#endif
+
+    // acc += x - acc / 2^shift, with the division rounded to nearest
+    int32_t round = f->shift ? 1L << (f->shift - 1) : 0;
+    f->acc += x - ((f->acc + round) >> f->shift);
+    return (f->acc + round) >> f->shift;
+}
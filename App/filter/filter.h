@@ -0,0 +1,61 @@
+/**
+ * @file filter.h
+ * @brief Integer median + exponential moving average for sensor readings
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+
+/** Median window: 1 (off), 3 or 5 samples */
+#ifndef FILTER_MEDIAN_TAPS
+#define FILTER_MEDIAN_TAPS  3
+#endif
+
+#if FILTER_MEDIAN_TAPS != 1 && FILTER_MEDIAN_TAPS != 3 && FILTER_MEDIAN_TAPS != 5
+#error "FILTER_MEDIAN_TAPS must be 1, 3 or 5"
+#endif
+
+/** Filter state of one value */
+typedef struct
+{
+    int32_t taps[FILTER_MEDIAN_TAPS];   ///< Last raw readings, ring
+    int32_t acc;        ///< EMA output scaled by 2^shift
+    uint8_t pos;        ///< Next tap to overwrite
+    uint8_t shift;      ///< EMA alpha = 1 / 2^shift
+    uint8_t valid;      ///< 0 until the first filter_update()
+} filter_value;
+
+/**
+ * @brief Initialize a value with its EMA weight.
+ *
+ * The accumulator holds the output scaled by 2^shift, so the raw value
+ * must fit in 31 - shift bits: up to 6 for Q24.8 pressure.
+ *
+ * @param f Value to set up
+ * @param shift EMA alpha as a power of two, 0 disables the average
+ */
+void filter_init(filter_value *f, uint8_t shift);
+
+/**
+ * @brief Feed a raw reading and get the filtered one.
+ *
+ * The median drops single-sample spikes before they reach the average.
+ * The first reading after filter_init() or filter_reset() fills the whole
+ * state, so the output starts at the reading instead of ramping up from 0.
+ *
+ * @param f Value to update
+ * @param x Raw reading, in the caller's units
+ * @return Filtered reading, in the same units
+ */
+int32_t filter_update(filter_value *f, int32_t x);
+
+/**
+ * @brief Forget the history, e.g. after the sensor was reinitialized.
+ *
+ * @param f Value to reset
+ */
+void filter_reset(filter_value *f);
+
+#endif // FILTER_H
@@ -0,0 +1,93 @@
+/**
+ * @file forecast.c
+ * @brief Pressure tendency from a sliding least-squares slope
+ *
+ * Samples sit at x = 0 (oldest) .. n - 1 (newest). The slope of the fit is
+ * (n Sxy - Sx Sy) / (n Sxx - Sx^2); Sx and Sxx only depend on n and are
+ * accumulated while the window fills.
+ */
+
+#include "forecast.h"
+#include "history.h"
+
+static int16_t window[FORECAST_SAMPLES];    // 0.1 hPa
+static uint8_t pos;                         // Slot of the oldest sample
+static uint8_t n;
+static int32_t sum_x, sum_xx;
+static int32_t sum_y, sum_xy;
+static Forecast_Trend trend;
+
+void forecast_init(void)
+{
+    pos = 0;
+    n = 0;
+    sum_x = sum_xx = 0;
+    sum_y = sum_xy = 0;
+    trend = FORECAST_UNKNOWN;
+}
+
+// Change over FORECAST_SAMPLES samples at the fitted slope, compared with
+// a threshold in 0.1 hPa: sign of slope * FORECAST_SAMPLES - limit
+static int8_t forecast_above(int32_t num, int32_t den, int16_t limit)
+{
+    int32_t lhs = num * FORECAST_SAMPLES;
+    int32_t rhs = limit * den;
+    return lhs > rhs ? 1 : lhs < rhs ? -1 : 0;
+}
+
+static Forecast_Trend forecast_classify(int32_t num, int32_t den)
+{
+    // Thresholds move by the band away from the current tendency, so a
+    // slope sitting on a boundary does not flicker
+    int16_t band = trend == FORECAST_UNKNOWN ? 0 : FORECAST_BAND;
+    int16_t fast = FORECAST_FAST_MIN - (trend == FORECAST_RISING_FAST ? band : -band);
+    int16_t rise = FORECAST_STEADY_MAX - (trend >= FORECAST_RISING ? band : -band);
+    int16_t fall = -FORECAST_STEADY_MAX + (trend != FORECAST_UNKNOWN && trend <= FORECAST_FALLING ? band : -band);
+    int16_t fall_fast = -FORECAST_FAST_MIN + (trend == FORECAST_FALLING_FAST ? band : -band);
+
+    if (forecast_above(num, den, fast) >= 0) return FORECAST_RISING_FAST;
+    if (forecast_above(num, den, rise) >= 0) return FORECAST_RISING;
+    if (forecast_above(num, den, fall_fast) <= 0) return FORECAST_FALLING_FAST;
+    if (forecast_above(num, den, fall) <= 0) return FORECAST_FALLING;
+    return FORECAST_STEADY;
+}
+
+Forecast_Trend forecast_add(const BME280_Measurement *m)
+{
+    int16_t q[HISTORY_CHANNELS];
+    history_quantize(m, q);
+    int16_t y = q[HISTORY_PRESSURE];
+
+    if (n < FORECAST_SAMPLES)
+    {
+        window[n] = y;
+        sum_x += n;
+        sum_xx += (int32_t)n * n;
+        sum_xy += (int32_t)n * y;
+        sum_y += y;
+        n++;
+    }
+    else
+    {
+        int16_t old = window[pos];
+        window[pos] = y;
+        if (++pos == FORECAST_SAMPLES) pos = 0;
+        sum_xy += (int32_t)(FORECAST_SAMPLES - 1) * y - (sum_y - old);
+        sum_y += y - old;
+    }
+
+    if (n >= FORECAST_MIN_SAMPLES)
+        trend = forecast_classify(n * sum_xy - sum_x * sum_y, n * sum_xx - sum_x * sum_x);
+    return trend;
+}
+
+Forecast_Trend forecast_trend(void)
+{
+    return trend;
+}
+
+char forecast_glyph(Forecast_Trend t)
+{
+    static const char glyphs[] = " v\\-/^";
+    return glyphs[t];
+}
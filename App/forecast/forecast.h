@@ -0,0 +1,67 @@
+/**
+ * @file forecast.h
+ * @brief Pressure tendency from a sliding least-squares slope
+ */
+
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#include "bme280.h"
+
+/** Window length in samples: 3 h of 10-minute history records */
+#ifndef FORECAST_SAMPLES
+#define FORECAST_SAMPLES    18
+#endif
+
+/** Samples needed before a tendency is reported (1 h) */
+#ifndef FORECAST_MIN_SAMPLES
+#define FORECAST_MIN_SAMPLES 6
+#endif
+
+/** Tendency thresholds, change per window in 0.1 hPa */
+#define FORECAST_STEADY_MAX 16      // Below 1.6 hPa / 3 h
+#define FORECAST_FAST_MIN   36      // 3.6 hPa / 3 h and more
+#define FORECAST_BAND       2       // Hysteresis on both thresholds
+
+typedef enum {
+    FORECAST_UNKNOWN = 0,   // Not enough samples yet
+    FORECAST_FALLING_FAST,
+    FORECAST_FALLING,
+    FORECAST_STEADY,
+    FORECAST_RISING,
+    FORECAST_RISING_FAST
+} Forecast_Trend;
+
+/**
+ * @brief Drop all samples.
+ */
+void forecast_init(void);
+
+/**
+ * @brief Add a pressure sample and update the tendency.
+ *
+ * The sums behind the slope slide with the window in O(1): the newest
+ * sample enters, the oldest leaves and every other one moves back by one
+ * position, which shifts the weighted sum by the plain sum. Classifying
+ * compares the scaled numerator with the scaled thresholds, so no division
+ * is needed either.
+ *
+ * @param m Measurement; only the pressure is used
+ * @return Current tendency
+ */
+Forecast_Trend forecast_add(const BME280_Measurement *m);
+
+/**
+ * @brief Current tendency.
+ */
+Forecast_Trend forecast_trend(void);
+
+/**
+ * @brief Glyph for a tendency on the OLED font.
+ *
+ * @param t Tendency
+ * @return '^' '/' '-' '\\' 'v' from rising fast to falling fast, ' ' if unknown
+ */
+char forecast_glyph(Forecast_Trend t);
+
+#endif // FORECAST_H
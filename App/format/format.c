@@ -0,0 +1,76 @@
+/**
+ * @file format.c
+ * @brief Division-free fixed-point to text conversion
+ *
+ * The Cortex-M0+ has no divide instruction, so every `/ 10` or `% 10` is a
+ * call into the libgcc bit-serial divider. Here the quotient comes from a
+ * shift-and-add reciprocal sequence and the remainder from one multiply.
+ */
+
+#include "format.h"
+
+uint32_t format_div10(uint32_t n)
+{
+    // q ~= n * 0.8, then / 8; off by at most one, fixed with the remainder
+    uint32_t q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q += q >> 16;
+    q >>= 3;
+    uint32_t r = n - q * 10;
+    return q + (r > 9);
+}
+
+uint32_t format_div100(uint32_t n)
+{
+    return format_div10(format_div10(n));
+}
+
+int32_t format_split100(int32_t value, int32_t *frac)
+{
+    uint32_t mag = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+    uint32_t q = format_div100(mag);
+    int32_t r = (int32_t)(mag - q * 100);
+    if (frac) *frac = value < 0 ? -r : r;
+    return value < 0 ? -(int32_t)q : (int32_t)q;
+}
+
+int32_t format_round10(int32_t value)
+{
+    uint32_t mag = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+    mag = format_div10(mag + 5);
+    return value < 0 ? -(int32_t)mag : (int32_t)mag;
+}
+
+uint8_t format_fixed(char *out, int32_t value, uint8_t decimals, uint8_t width)
+{
+    char digits[10];
+    uint8_t n = 0, pos = 0;
+    uint32_t mag = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+
+    // Least significant digit first, down to at least one integer digit
+    do
+    {
+        uint32_t q = format_div10(mag);
+        digits[n++] = '0' + (char)(mag - q * 10);
+        mag = q;
+    } while (mag || n <= decimals);
+
+    uint8_t len = n + (decimals ? 1 : 0) + (value < 0);
+    while (len + pos < width) out[pos++] = ' ';
+    if (value < 0) out[pos++] = '-';
+    while (n)
+    {
+        if (n == decimals) out[pos++] = '.';
+        out[pos++] = digits[--n];
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+uint8_t format_str(char *out, const char *str)
+{
+    uint8_t n = 0;
+    while ((out[n] = str[n]) != '\0') n++;
+    return n;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file format.h
+ * @brief Division-free fixed-point to text conversion
+ */
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+#include "ramfunc.h"
+
+/**
+ * @brief Render a fixed-point value as decimal text.
+ *
+ * The value is an integer scaled by 10^decimals (e.g. 2345 with 2 decimals
+ * is "23.45"). At least one integer digit is printed ("0.05"), a '-' is
+ * prepended for any negative value including those between -1 and 0, and the
+ * text is right-aligned with spaces to @p width so glyph positions stay put
+ * between updates and only changed digits are redrawn.
+ *
+ * Digits are extracted with a shift-and-add divide by 10; no library
+ * division is called.
+ *
+ * @param out Destination, at least max(width, 12) + 1 bytes
+ * @param value Scaled value
+ * @param decimals Number of fraction digits (0 = no decimal point)
+ * @param width Minimum field width; longer results are not truncated
+ * @return Number of characters written, excluding the terminating NUL
+ */
+RAMFUNC_FORMAT_FN uint8_t format_fixed(char *out, int32_t value, uint8_t decimals, uint8_t width);
+
+/**
+ * @brief Copy a NUL-terminated string (for units after format_fixed()).
+ *
+ * @param out Destination
+ * @param str Source
+ * @return Number of characters written, excluding the terminating NUL
+ */
+uint8_t format_str(char *out, const char *str);
+
+/**
+ * @brief Unsigned divide by 10 using shifts and adds only.
+ *
+ * Exact for the whole 32-bit range.
+ *
+ * @param n Dividend
+ * @return n / 10
+ */
+uint32_t format_div10(uint32_t n);
+
+/**
+ * @brief Unsigned divide by 100, as two steps of format_div10().
+ *
+ * Exact for the whole 32-bit range, since floor(floor(n / 10) / 10) is
+ * floor(n / 100).
+ *
+ * @param n Dividend
+ * @return n / 100
+ */
+uint32_t format_div100(uint32_t n);
+
+/**
+ * @brief Split a value in hundredths into whole units and hundredths.
+ *
+ * Both parts round toward zero and carry the sign of @p value, exactly as
+ * `value / 100` and `value % 100` would.
+ *
+ * @param value Value in hundredths
+ * @param frac Set to the hundredths left over; may be NULL
+ * @return Whole units
+ */
+int32_t format_split100(int32_t value, int32_t *frac);
+
+/**
+ * @brief Hundredths to tenths, rounded half away from zero.
+ *
+ * @param value Value in hundredths, any sign
+ * @return Value in tenths
+ */
+int32_t format_round10(int32_t value);
+
+/*
+ * Sensor Q formats (bme280.h) to the decimal units the views, alarms and
+ * history work in. The binary scales take a shift, or a multiply by a
+ * small constant and a shift: (h * 100) >> 10 is the same number as
+ * h / 1024 * 100 + h % 1024 * 100 / 1024 for every h.
+ */
+
+/** Humidity, Q22.10 %RH to 0.01 %RH, truncated */
+static inline int32_t format_rh_centi(uint32_t humidity)
+{
+    return (int32_t)((humidity * 100) >> 10);
+}
+
+/** Humidity, Q22.10 %RH to 0.1 %RH, truncated */
+static inline int32_t format_rh_deci(uint32_t humidity)
+{
+    return (int32_t)((humidity * 10) >> 10);
+}
+
+/** Pressure, Q24.8 Pa to 0.01 hPa, truncated */
+static inline int32_t format_hpa_centi(uint32_t pressure)
+{
+    return (int32_t)(pressure >> 8);
+}
+
+/** Pressure, Q24.8 Pa to 0.1 hPa, truncated */
+static inline int32_t format_hpa_deci(uint32_t pressure)
+{
+    return (int32_t)format_div10(pressure >> 8);
+}
+
+#endif // FORMAT_H
@@ -0,0 +1,177 @@
+/**
+ * @file graph.c
+ * @brief History sparkline and bucket bars in the bottom pages of the panel
+ *
+ * Rows count up from the bottom of the chart. The scale maps values to rows
+ * with a Q16 factor computed once per rescale, so plotting a sample costs a
+ * multiply instead of a software division.
+ */
+
+#include "graph.h"
+
+static const uint8_t blank[GRAPH_PAGES];
+
+static History_Channel channel;
+static uint8_t cursor;          // Column of the next sample
+static uint8_t last_row;        // Row of the previous sample
+static uint8_t drawn;           // Set once last_row is valid
+static int32_t scale_lo;
+static int32_t scale_span;      // 0 until the first scale is set
+static uint32_t scale_mul;      // (GRAPH_ROWS - 1) / scale_span, Q16
+
+static uint8_t graph_row(int16_t v)
+{
+    int32_t d = v - scale_lo;
+    if (d < 0) d = 0;
+    if (d > scale_span) d = scale_span;
+    return (uint8_t)(((uint32_t)d * scale_mul + 0x8000) >> 16);
+}
+
+static void graph_segment(uint8_t *bytes, uint8_t from, uint8_t to)
+{
+    if (from > to)
+    {
+        uint8_t t = from;
+        from = to;
+        to = t;
+    }
+    for (uint8_t r = from; r <= to; r++)
+    {
+        uint8_t row = GRAPH_ROWS - 1 - r;   // Panel rows count from the top
+        bytes[row >> 3] |= 1 << (row & 7);
+    }
+}
+
+// Vertical segment between two rows, so steps between samples stay joined
+static void graph_column(uint8_t x, uint8_t from, uint8_t to)
+{
+    uint8_t bytes[GRAPH_PAGES] = { 0 };
+
+    graph_segment(bytes, from, to);
+    oled_put_column(x, GRAPH_FIRST_PAGE, bytes, GRAPH_PAGES);
+}
+
+static void graph_plot(int16_t v)
+{
+    uint8_t row = graph_row(v);
+
+    graph_column(cursor, drawn ? last_row : row, row);
+    last_row = row;
+    drawn = 1;
+    if (++cursor == OLED_WIDTH) cursor = 0;
+    oled_put_column(cursor, GRAPH_FIRST_PAGE, blank, GRAPH_PAGES);
+}
+
+// Span for a value range, with a quarter of headroom on either side
+static int32_t graph_span(int32_t range)
+{
+    int32_t span = range + 2 * ((range >> 2) + 1);
+    return span < GRAPH_MIN_SPAN ? GRAPH_MIN_SPAN : span;
+}
+
+static void graph_scale(int16_t lo, int16_t hi)
+{
+    int32_t range = (int32_t)hi - lo;
+
+    scale_span = graph_span(range);
+    scale_lo = lo - ((scale_span - range) >> 1);
+    scale_mul = ((uint32_t)(GRAPH_ROWS - 1) << 16) / (uint32_t)scale_span;
+}
+
+static void graph_walk(const int16_t *values, void *ctx)
+{
+    uint16_t *skip = ctx;
+
+    if (*skip)
+    {
+        (*skip)--;
+        return;
+    }
+    graph_plot(values[channel]);
+}
+
+void graph_init(History_Channel ch)
+{
+    channel = ch;
+    graph_redraw();
+}
+
+void graph_redraw(void)
+{
+    History_Stats st;
+    uint16_t count = history_count();
+    // One column is the gap, so the chart shows OLED_WIDTH - 1 samples
+    uint16_t skip = count > OLED_WIDTH - 1 ? count - (OLED_WIDTH - 1) : 0;
+
+    cursor = 0;
+    drawn = 0;
+    scale_span = 0;
+    if (history_stats(channel, &st))
+    {
+        graph_scale(st.min, st.max);
+        history_walk(graph_walk, &skip);
+    }
+    // Plotted columns overwrite the old chart; clear whatever lies past them
+    for (uint8_t x = cursor + 1; x < OLED_WIDTH; x++)
+        oled_put_column(x, GRAPH_FIRST_PAGE, blank, GRAPH_PAGES);
+    if (!drawn)
+        oled_put_column(0, GRAPH_FIRST_PAGE, blank, GRAPH_PAGES);
+}
+
+void graph_add(const BME280_Measurement *m)
+{
+    int16_t q[HISTORY_CHANNELS];
+    History_Stats st;
+
+    history_quantize(m, q);
+    int16_t v = q[channel];
+    if (!scale_span || v < scale_lo || v > scale_lo + scale_span ||
+        (history_stats(channel, &st) && graph_span((int32_t)st.max - st.min) * 2 < scale_span))
+    {
+        graph_redraw();
+        return;
+    }
+    graph_plot(v);
+}
+
+// Range bar in the middle column, mean tick across the others but the gap
+static void graph_bar(uint8_t x, const Pyramid_Span *b)
+{
+    uint8_t mean = graph_row(b->mean);
+
+    for (uint8_t i = 0; i < GRAPH_BAR_WIDTH - 1; i++)
+    {
+        if (i == (GRAPH_BAR_WIDTH - 1) / 2)
+        {
+            graph_column(x + i, graph_row(pyramid_min(b)), graph_row(pyramid_max(b)));
+            continue;
+        }
+        graph_column(x + i, mean, mean);
+    }
+    oled_put_column(x + GRAPH_BAR_WIDTH - 1, GRAPH_FIRST_PAGE, blank, GRAPH_PAGES);
+}
+
+void graph_buckets(History_Channel ch, Pyramid_Tier tier)
+{
+    Pyramid_Bucket b;
+    uint16_t count = pyramid_count(tier);
+    uint16_t bars = OLED_WIDTH / GRAPH_BAR_WIDTH;
+    uint16_t first = count > bars ? count - bars : 0;
+    int16_t lo = INT16_MAX, hi = INT16_MIN;
+    uint8_t x = 0;
+
+    channel = ch;
+    for (uint16_t i = first; i < count && pyramid_read(tier, i, &b); i++)
+    {
+        if (pyramid_min(&b.ch[ch]) < lo) lo = pyramid_min(&b.ch[ch]);
+        if (pyramid_max(&b.ch[ch]) > hi) hi = pyramid_max(&b.ch[ch]);
+    }
+    if (lo <= hi)
+    {
+        graph_scale(lo, hi);
+        for (uint16_t i = first; i < count && pyramid_read(tier, i, &b); i++, x += GRAPH_BAR_WIDTH)
+            graph_bar(x, &b.ch[ch]);
+    }
+    for (; x < OLED_WIDTH; x++)
+        oled_put_column(x, GRAPH_FIRST_PAGE, blank, GRAPH_PAGES);
+}
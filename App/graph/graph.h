@@ -0,0 +1,71 @@
+/**
+ * @file graph.h
+ * @brief History sparkline and bucket bars in the bottom pages of the panel
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "history.h"
+#include "pyramid.h"
+#include "oled.h"
+
+/** First page of the chart and its height in pages */
+#ifndef GRAPH_FIRST_PAGE
+#define GRAPH_FIRST_PAGE    5
+#endif
+#ifndef GRAPH_PAGES
+#define GRAPH_PAGES         3
+#endif
+
+#define GRAPH_ROWS          (GRAPH_PAGES * 8)
+
+/** Columns per bucket in graph_buckets(), the last one left blank */
+#ifndef GRAPH_BAR_WIDTH
+#define GRAPH_BAR_WIDTH     5
+#endif
+
+/** Smallest vertical span, in the channel's stored units (1.0) */
+#ifndef GRAPH_MIN_SPAN
+#define GRAPH_MIN_SPAN      10
+#endif
+
+/**
+ * @brief Select the charted channel and draw it from the history.
+ *
+ * @param ch History channel
+ */
+void graph_init(History_Channel ch);
+
+/**
+ * @brief Chart the sample just added to the history.
+ *
+ * The chart is a sweep: each sample draws one column at the cursor and
+ * blanks the next one as the gap between newest and oldest, so a quiet
+ * sample dirties two columns. The scale is rebuilt, and the chart redrawn
+ * from the history, only when the sample falls outside it or the history
+ * range shrinks to less than half of it.
+ *
+ * @param m Measurement passed to history_add()
+ */
+void graph_add(const BME280_Measurement *m);
+
+/**
+ * @brief Rebuild the scale and redraw the whole chart from the history.
+ */
+void graph_redraw(void);
+
+/**
+ * @brief Draw the newest buckets of a pyramid tier as bars.
+ *
+ * Each bucket is a thin bar from its minimum to its maximum with a tick
+ * across at the mean, oldest on the left, OLED_WIDTH / GRAPH_BAR_WIDTH of
+ * them at most. The chart is static: redraw it when the tier gains a
+ * bucket, and do not mix it with graph_add().
+ *
+ * @param ch History channel
+ * @param tier Pyramid tier to read
+ */
+void graph_buckets(History_Channel ch, Pyramid_Tier tier);
+
+#endif // GRAPH_H
@@ -0,0 +1,239 @@
+/**
+ * @file history.c
+ * @brief Delta-encoded measurement history with incremental aggregates
+ *
+ * The ring is a stream of 4-bit codes, three per record. Code 0x8 escapes
+ * to a full value in the next four codes; every other code is a delta in
+ * -7..7. At 1-minute records the default ring holds about 100 minutes of
+ * indoor data.
+ */
+
+#include "history.h"
+#include "format.h"
+#include "rtc.h"
+
+#define HISTORY_CODES   (HISTORY_BYTES * 2)
+#define HISTORY_ESCAPE  0x8
+
+static uint8_t ring[HISTORY_BYTES];
+static uint16_t head;           // Next code to write
+static uint16_t used;           // Codes in the ring
+static uint32_t newest_time;
+static History_Aggregates agg;
+
+static uint16_t history_wrap(uint16_t i)
+{
+    return i >= HISTORY_CODES ? i - HISTORY_CODES : i;
+}
+
+static uint8_t history_get(uint16_t i)
+{
+    uint8_t b = ring[i >> 1];
+    return (i & 1) ? b >> 4 : b & 0x0F;
+}
+
+static void history_put(uint16_t i, uint8_t code)
+{
+    uint8_t *b = &ring[i >> 1];
+    *b = (i & 1) ? (*b & 0x0F) | (code << 4) : (*b & 0xF0) | code;
+}
+
+// Decode the record at *pos on top of values[]; returns its length in codes
+static uint8_t history_decode(uint16_t *pos, int16_t *values)
+{
+    uint16_t p = *pos;
+    uint8_t len = 0;
+
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+        uint8_t code = history_get(p);
+        p = history_wrap(p + 1);
+        len++;
+        if (code == HISTORY_ESCAPE)
+        {
+            uint16_t v = 0;
+            for (uint8_t k = 0; k < 4; k++)
+            {
+                v = (v << 4) | history_get(p);
+                p = history_wrap(p + 1);
+            }
+            values[ch] = (int16_t)v;
+            len += 4;
+        }
+        else
+        {
+            values[ch] += (int16_t)(code & 0x7) - (int16_t)(code & 0x8);
+        }
+    }
+    *pos = p;
+    return len;
+}
+
+static void history_scan_extremes(void)
+{
+    int16_t v[HISTORY_CHANNELS];
+    uint16_t pos = history_wrap(head + HISTORY_CODES - used);
+
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+        v[ch] = agg.oldest[ch];
+        agg.min[ch] = agg.max[ch] = v[ch];
+    }
+    for (uint16_t n = 1; n < agg.count; n++)
+    {
+        history_decode(&pos, v);
+        for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        {
+            if (v[ch] < agg.min[ch]) agg.min[ch] = v[ch];
+            if (v[ch] > agg.max[ch]) agg.max[ch] = v[ch];
+        }
+    }
+}
+
+// Advance the base to the first ring record; returns 1 if an extreme left
+static uint8_t history_drop_oldest(void)
+{
+    int16_t v[HISTORY_CHANNELS];
+    uint16_t pos = history_wrap(head + HISTORY_CODES - used);
+    uint8_t stale = 0;
+
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+        v[ch] = agg.oldest[ch];
+        agg.sum[ch] -= agg.oldest[ch];
+        if (agg.oldest[ch] == agg.min[ch] || agg.oldest[ch] == agg.max[ch]) stale = 1;
+    }
+    used -= history_decode(&pos, v);
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        agg.oldest[ch] = v[ch];
+    agg.count--;
+    return stale;
+}
+
+void history_quantize(const BME280_Measurement *m, int16_t *q)
+{
+    q[HISTORY_TEMPERATURE] = (int16_t)format_round10(m->temperature);  // 0.01 -> 0.1 °C, rounded
+    q[HISTORY_HUMIDITY] = (int16_t)format_rh_deci(m->humidity);
+    q[HISTORY_PRESSURE] = (int16_t)format_hpa_deci(m->pressure);
+}
+
+void history_init(uint16_t period_s)
+{
+    agg.period_s = period_s;
+    head = 0;
+    used = 0;
+    agg.count = 0;
+}
+
+void history_add(const BME280_Measurement *m)
+{
+    int16_t q[HISTORY_CHANNELS];
+    history_quantize(m, q);
+    newest_time = rtc_time();
+
+    if (agg.count == 0)
+    {
+        for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        {
+            agg.oldest[ch] = agg.newest[ch] = agg.min[ch] = agg.max[ch] = q[ch];
+            agg.sum[ch] = q[ch];
+        }
+        agg.count = 1;
+        return;
+    }
+
+    uint8_t codes[HISTORY_CHANNELS * 5];
+    uint8_t len = 0;
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+        int16_t d = q[ch] - agg.newest[ch];
+        if (d >= -7 && d <= 7)
+        {
+            codes[len++] = (uint8_t)d & 0x0F;
+        }
+        else
+        {
+            codes[len++] = HISTORY_ESCAPE;
+            for (int8_t shift = 12; shift >= 0; shift -= 4)
+                codes[len++] = ((uint16_t)q[ch] >> shift) & 0x0F;
+        }
+    }
+
+    uint8_t stale = 0;
+    while (HISTORY_CODES - used < len)
+        stale |= history_drop_oldest();
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        history_put(head, codes[i]);
+        head = history_wrap(head + 1);
+    }
+    used += len;
+    agg.count++;
+
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+        agg.newest[ch] = q[ch];
+        agg.sum[ch] += q[ch];
+    }
+    if (stale)
+    {
+        history_scan_extremes();
+    }
+    else
+    {
+        for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        {
+            if (q[ch] < agg.min[ch]) agg.min[ch] = q[ch];
+            if (q[ch] > agg.max[ch]) agg.max[ch] = q[ch];
+        }
+    }
+}
+
+uint16_t history_count(void)
+{
+    return agg.count;
+}
+
+uint8_t history_stats(History_Channel ch, History_Stats *out)
+{
+    if (agg.count == 0 || ch >= HISTORY_CHANNELS) return 0;
+    out->min = agg.min[ch];
+    out->max = agg.max[ch];
+    out->mean = (int16_t)(agg.sum[ch] / (int32_t)agg.count);   // The only division here, per query
+    out->trend = agg.newest[ch] - agg.oldest[ch];
+    return 1;
+}
+
+void history_walk(void (*fn)(const int16_t *values, void *ctx), void *ctx)
+{
+    int16_t v[HISTORY_CHANNELS];
+    uint16_t pos = history_wrap(head + HISTORY_CODES - used);
+
+    if (agg.count == 0) return;
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        v[ch] = agg.oldest[ch];
+    fn(v, ctx);
+    for (uint16_t n = 1; n < agg.count; n++)
+    {
+        history_decode(&pos, v);
+        fn(v, ctx);
+    }
+}
+
+const History_Aggregates *history_aggregates(void)
+{
+    return &agg;
+}
+
+void history_image(History_Image *img)
+{
+    img->ring = ring;
+    img->head = head;
+    img->used = used;
+    img->count = agg.count;
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        img->oldest[ch] = agg.oldest[ch];
+    img->newest_time = newest_time;
+    img->period_s = agg.period_s;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file history.h
+ * @brief Delta-encoded measurement history with incremental aggregates
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "bme280.h"
+
+/**
+ * Ring size in bytes; a quiet sample takes 1.5 bytes. Longer windows are
+ * the pyramid's buckets (pyramid.h), not a larger ring
+ */
+#ifndef HISTORY_BYTES
+#define HISTORY_BYTES   160
+#endif
+
+/** History channels and their stored units */
+typedef enum {
+    HISTORY_TEMPERATURE = 0,    // 0.1 °C
+    HISTORY_HUMIDITY,           // 0.1 %RH
+    HISTORY_PRESSURE,           // 0.1 hPa
+    HISTORY_CHANNELS
+} History_Channel;
+
+/** Window aggregates of one channel, in the channel's stored units */
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+    int16_t trend;      // Newest minus oldest sample
+} History_Stats;
+
+/** Running window aggregates, kept in place for zero-copy readers */
+typedef struct {
+    int16_t oldest[HISTORY_CHANNELS];   // Base of the first ring record
+    int16_t newest[HISTORY_CHANNELS];
+    int16_t min[HISTORY_CHANNELS];
+    int16_t max[HISTORY_CHANNELS];
+    int32_t sum[HISTORY_CHANNELS];
+    uint16_t count;             // Samples, including the base
+    uint16_t period_s;
+} History_Aggregates;
+
+/** Raw ring state, for bulk dumps that decode on the host */
+typedef struct {
+    const uint8_t *ring;        // HISTORY_BYTES of 4-bit codes, low nibble first
+    uint16_t head;              // Next code to write
+    uint16_t used;              // Codes in the ring, ending before head
+    uint16_t count;             // Samples, including the base
+    int16_t oldest[HISTORY_CHANNELS];   // Base, decoded
+    uint32_t newest_time;       // Unix time of the newest sample
+    uint16_t period_s;          // Spacing of the samples before it
+} History_Image;
+
+/**
+ * @brief Convert a measurement to the stored channel units.
+ *
+ * @param m Measurement
+ * @param q Destination, HISTORY_CHANNELS values
+ */
+void history_quantize(const BME280_Measurement *m, int16_t *q);
+
+/**
+ * @brief Drop all samples.
+ *
+ * Samples carry no timestamp of their own: only the time of the newest
+ * one is kept, the others are @p period_s apart before it.
+ *
+ * @param period_s Interval history_add() is called at, in seconds
+ */
+void history_init(uint16_t period_s);
+
+/**
+ * @brief Append a sample, dropping the oldest ones when the ring is full.
+ *
+ * Each channel is stored as a signed 4-bit delta to the previous sample;
+ * larger steps are escaped and stored as a full 16-bit value. The oldest
+ * sample is kept decoded outside the ring as the base of the deltas. The
+ * sample is stamped with rtc_time().
+ *
+ * @param m Measurement to record
+ */
+void history_add(const BME280_Measurement *m);
+
+/**
+ * @brief Number of samples in the window.
+ */
+uint16_t history_count(void);
+
+/**
+ * @brief Aggregates over the whole window.
+ *
+ * Sums and extremes are maintained in history_add(), so this does not scan
+ * the ring. Extremes are recomputed there only when the sample holding one
+ * of them is dropped.
+ *
+ * @param ch Channel
+ * @param out Destination
+ * @return 1 on success, 0 if the history is empty
+ */
+uint8_t history_stats(History_Channel ch, History_Stats *out);
+
+/**
+ * @brief Decode samples from oldest to newest.
+ *
+ * Calls @p fn once per sample with the values of all channels. Cost is
+ * linear in the window; meant for charts and dumps, not for aggregates.
+ *
+ * @param fn Callback receiving HISTORY_CHANNELS values
+ * @param ctx Passed through to @p fn
+ */
+void history_walk(void (*fn)(const int16_t *values, void *ctx), void *ctx);
+
+/**
+ * @brief Describe the ring in place, without decoding it.
+ *
+ * @param img Destination; img->ring points at the live ring
+ */
+void history_image(History_Image *img);
+
+/**
+ * @brief The live aggregates the stats are computed from.
+ *
+ * Fields change in history_add(); the mean is sum / count.
+ */
+const History_Aggregates *history_aggregates(void);
+
+#endif // HISTORY_H
@@ -0,0 +1,28 @@
+/**
+ * @file hyst.c
+ * @brief Per-value hysteresis for displayed readings
+ */
+
+#include "hyst.h"
+
+void hyst_init(hyst_value *v, int32_t band)
+{
+    v->shown = 0;
+    v->band = band;
+    v->valid = 0;
+}
+
+uint8_t hyst_update(hyst_value *v, int32_t value)
+{
+    int32_t diff = value - v->shown;
+    if (v->valid && diff >= -v->band && diff <= v->band) return 0;
+
+    v->shown = value;
+    v->valid = 1;
+    return 1;
+}
+
+void hyst_invalidate(hyst_value *v)
+{
+    v->valid = 0;
+}
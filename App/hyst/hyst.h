@@ -0,0 +1,46 @@
+/**
+ * @file hyst.h
+ * @brief Per-value hysteresis for displayed readings
+ */
+
+#ifndef HYST_H
+#define HYST_H
+
+#include <stdint.h>
+
+/** One displayed value and the band it has to leave before it changes */
+typedef struct
+{
+    int32_t shown;  ///< Value currently on screen
+    int32_t band;   ///< Changes of at most this much are ignored
+    uint8_t valid;  ///< 0 until the first hyst_update()
+} hyst_value;
+
+/**
+ * @brief Initialize a value with its band.
+ *
+ * @param v Value to set up
+ * @param band Hysteresis in the caller's units
+ */
+void hyst_init(hyst_value *v, int32_t band);
+
+/**
+ * @brief Feed a new reading.
+ *
+ * The shown value follows the reading only once it differs by more than
+ * the band, which keeps noise in the last digit off the display.
+ *
+ * @param v Value to update
+ * @param value New reading
+ * @return 1 if the shown value changed, 0 otherwise
+ */
+uint8_t hyst_update(hyst_value *v, int32_t value);
+
+/**
+ * @brief Force the next hyst_update() to report a change.
+ *
+ * @param v Value to invalidate, e.g. after the screen was cleared
+ */
+void hyst_invalidate(hyst_value *v);
+
+#endif // HYST_H
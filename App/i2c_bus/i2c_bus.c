@@ -0,0 +1,672 @@
+/**
+ * @file i2c_bus.c
+ * @brief Shared I2C1 bus layer (speed configuration, transaction queue)
+ *
+ * Both the SSD1306 and the BME280 sit on I2C1. This module owns the bus
+ * level settings so the drivers do not have to know the kernel clock, and
+ * serializes their transfers through a small statically allocated ring that
+ * is advanced from the HAL completion callbacks. The ring is kept sorted by
+ * device priority, so a sensor read overtakes the queued chunks of a frame
+ * push and only waits for the chunk on the wire.
+ *
+ * Every transfer gets a deadline derived from its length and the bus speed.
+ * A transfer that overruns it, or a bus error, triggers the recovery
+ * sequence (9 SCL pulses, STOP, peripheral reinit), so no caller can hang
+ * on a stuck SDA line.
+ *
+ * With I2C_BUS_LL set the transfers are driven straight from the I2C1
+ * and DMA registers instead of the HAL state machines: a write sends the
+ * register byte from the TXIS interrupt and DMA feeds the data, a read
+ * sends the register byte, restarts in read mode on TC and drains RXDR
+ * from RXNE. Transfers longer than the 8-bit NBYTES field are continued
+ * from TCR with RELOAD, the last chunk ends with AUTOEND, and STOPF
+ * retires the transfer.
+ *
+ * All timing math is done in picoseconds with 32-bit integers; it only runs
+ * when the speed or the system clock changes.
+ */
+
+#include "i2c_bus.h"
+#include "tick.h"
+#include "trace.h"
+
+#define PS_PER_NS        1000U
+#define AF_MIN_PS        (50U * PS_PER_NS)   // Analog filter minimum delay
+
+typedef struct {
+    uint32_t low_min_ps;
+    uint32_t high_min_ps;
+    uint32_t sudat_min_ps;
+    uint32_t vddat_max_ps;
+} i2c_mode_spec;
+
+// I2C specification minimums per mode (UM10204 table 10)
+static const i2c_mode_spec spec_std  = { 4700000U, 4000000U, 250000U, 3450000U };
+static const i2c_mode_spec spec_fast = { 1300000U,  600000U, 100000U,  900000U };
+static const i2c_mode_spec spec_fmp  = {  500000U,  260000U,  50000U,  450000U };
+
+static I2C_BusSpeed bus_speed = I2C_BUS_SPEED_STANDARD;   // Applied
+static I2C_BusSpeed bus_target = I2C_BUS_SPEED_STANDARD;  // Requested
+static uint8_t bus_down;    // No speed reachable from the current PCLK1
+static I2C_HandleTypeDef *bus;
+
+// Ring of pending transfers; queue[head] is the one on the wire when active
+static i2c_bus_xfer queue[I2C_BUS_QUEUE_LEN];
+static uint8_t queue_prio[I2C_BUS_QUEUE_LEN];
+static uint8_t head, count;
+static struct {
+    uint8_t addr;
+    uint8_t prio;
+} prios[I2C_BUS_PRIO_CLIENTS];
+static volatile uint8_t active;
+static volatile uint8_t dma_lent;
+static uint32_t active_since, active_timeout;
+static i2c_bus_counters counters;
+static uint32_t wire_us;
+static i2c_bus_device_stats device_stats[I2C_BUS_STAT_DEVICES + 1];
+
+#define COUNT(c) do { if ((c) != 0xFFFF) (c)++; } while (0)
+
+// Slot of addr, claiming a free one on first use
+static i2c_bus_device_stats *i2c_bus_device_slot(uint8_t addr)
+{
+    for (uint8_t i = 0; i < I2C_BUS_STAT_DEVICES; i++)
+    {
+        if (device_stats[i].addr == addr) return &device_stats[i];
+        if (device_stats[i].addr == 0)
+        {
+            device_stats[i].addr = addr;
+            return &device_stats[i];
+        }
+    }
+    return &device_stats[I2C_BUS_STAT_DEVICES];
+}
+
+// Classify a failed transfer; code holds HAL_I2C_ERROR_* bits
+static void i2c_bus_count_error(uint32_t code)
+{
+    COUNT(counters.errors);
+    if (code & HAL_I2C_ERROR_AF) COUNT(counters.nacks);
+    if (code & HAL_I2C_ERROR_ARLO) COUNT(counters.arb_lost);
+    if (code & HAL_I2C_ERROR_BERR) COUNT(counters.bus_errors);
+}
+
+typedef struct {
+    volatile uint8_t done;
+    HAL_StatusTypeDef status;
+} i2c_bus_wait;
+
+static uint32_t div_ceil(uint32_t a, uint32_t b)
+{
+    return (a + b - 1) / b;
+}
+
+uint32_t i2c_bus_timing(uint32_t i2c_clk_hz, I2C_BusSpeed speed)
+{
+    const i2c_mode_spec *spec = speed > I2C_BUS_SPEED_FAST ? &spec_fmp :
+                                speed > I2C_BUS_SPEED_STANDARD ? &spec_fast : &spec_std;
+    const uint32_t t_r = I2C_BUS_RISE_NS * PS_PER_NS;
+    const uint32_t t_f = I2C_BUS_FALL_NS * PS_PER_NS;
+    const uint32_t t_clk = 1000000000U / (i2c_clk_hz / 1000U);
+    const uint32_t t_scl = 1000000000U / (speed / 1000U);
+
+    // tSYNC1 + tSYNC2: edges plus analog filter and 2 I2CCLK resampling each
+    uint32_t t_sync = t_r + t_f + 2 * (AF_MIN_PS + 2 * t_clk);
+    if (t_sync >= t_scl) return 0;
+
+    for (uint32_t presc = 0; presc < 16; presc++)
+    {
+        uint32_t t_presc = (presc + 1) * t_clk;
+
+        uint32_t scldel = div_ceil(t_r + spec->sudat_min_ps, t_presc);
+        scldel = scldel ? scldel - 1 : 0;
+        if (scldel > 15) continue;
+
+        uint32_t sdadel_min = t_f > AF_MIN_PS + 3 * t_clk ? t_f - AF_MIN_PS - 3 * t_clk : 0;
+        uint32_t sdadel = div_ceil(sdadel_min, t_presc);
+        if (sdadel > 15 || sdadel * t_presc + t_r + 4 * t_clk > spec->vddat_max_ps) continue;
+
+        uint32_t n = (t_scl - t_sync) / t_presc;
+        uint32_t low = spec->low_min_ps > t_sync / 2 ? div_ceil(spec->low_min_ps - t_sync / 2, t_presc) : 1;
+        uint32_t high = spec->high_min_ps > t_sync / 2 ? div_ceil(spec->high_min_ps - t_sync / 2, t_presc) : 1;
+        if (n < low + high) return 0;   // A larger prescaler will not help
+
+        uint32_t extra = n - low - high;
+        low += extra - extra / 2;
+        high += extra / 2;
+        if (low > 256 || high > 256) continue;
+
+        return (presc << I2C_TIMINGR_PRESC_Pos) | (scldel << I2C_TIMINGR_SCLDEL_Pos) |
+               (sdadel << I2C_TIMINGR_SDADEL_Pos) | ((high - 1) << I2C_TIMINGR_SCLH_Pos) |
+               ((low - 1) << I2C_TIMINGR_SCLL_Pos);
+    }
+    return 0;
+}
+
+static HAL_StatusTypeDef i2c_bus_apply(I2C_BusSpeed speed)
+{
+    uint32_t timing = i2c_bus_timing(HAL_RCC_GetPCLK1Freq(), speed);
+    if (timing == 0) return HAL_ERROR;
+
+    while (i2c_bus_busy()) __WFI();
+    __HAL_I2C_DISABLE(bus);
+    bus->Init.Timing = timing;
+    bus->Instance->TIMINGR = timing;
+    if (speed > I2C_BUS_SPEED_FAST)
+        SYSCFG->CFGR2 |= SYSCFG_CFGR2_I2C1_FMP;
+    else
+        SYSCFG->CFGR2 &= ~SYSCFG_CFGR2_I2C1_FMP;
+    __HAL_I2C_ENABLE(bus);
+
+    bus_speed = speed;
+    bus_down = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef i2c_bus_set_speed(I2C_BusSpeed speed)
+{
+    bus_target = speed;
+    return i2c_bus_apply(speed);
+}
+
+HAL_StatusTypeDef i2c_bus_retune(void)
+{
+    static const I2C_BusSpeed speeds[] = {
+        I2C_BUS_SPEED_FAST_PLUS, I2C_BUS_SPEED_FAST, I2C_BUS_SPEED_STANDARD
+    };
+
+    for (uint8_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+    {
+        if (speeds[i] <= bus_target && i2c_bus_apply(speeds[i]) == HAL_OK)
+            return HAL_OK;
+    }
+    bus_down = 1;
+    return HAL_ERROR;
+}
+
+I2C_BusSpeed i2c_bus_get_speed(void)
+{
+    return bus_speed;
+}
+
+void i2c_bus_init(I2C_HandleTypeDef *hi2c)
+{
+    bus = hi2c;
+    head = count = active = 0;
+}
+
+#if I2C_BUS_LL
+#define LL_IRQS (I2C_CR1_TXIE | I2C_CR1_RXIE | I2C_CR1_TCIE | I2C_CR1_STOPIE | \
+                 I2C_CR1_NACKIE | I2C_CR1_ERRIE)
+
+static uint8_t *ll_ptr;             // Next byte to read
+static uint16_t ll_left;            // Bytes not yet covered by an NBYTES chunk
+static uint8_t ll_reg_sent;
+static HAL_StatusTypeDef ll_status;
+
+// NBYTES/RELOAD/AUTOEND for the next chunk of at most 255 bytes
+static uint32_t i2c_bus_ll_chunk(void)
+{
+    uint32_t n = ll_left > 255 ? 255 : ll_left;
+    ll_left -= n;
+    return (n << I2C_CR2_NBYTES_Pos) | (ll_left ? I2C_CR2_RELOAD : I2C_CR2_AUTOEND);
+}
+
+// Put the register byte on the wire; the data phase follows from the ISR
+static HAL_StatusTypeDef i2c_bus_ll_start(const i2c_bus_xfer *x)
+{
+    I2C_TypeDef *i2c = bus->Instance;
+
+    if (i2c->ISR & I2C_ISR_BUSY) return HAL_ERROR;
+    ll_reg_sent = 0;
+    ll_status = HAL_OK;
+    i2c->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+
+    if (x->dir == I2C_BUS_READ)
+    {
+        ll_ptr = x->buf;
+        i2c->CR1 |= LL_IRQS & ~I2C_CR1_RXIE;
+        i2c->CR2 = (x->addr & I2C_CR2_SADD) | (1U << I2C_CR2_NBYTES_Pos) | I2C_CR2_START;
+        return HAL_OK;
+    }
+
+    if (x->len)
+    {
+        DMA1_Channel2->CCR = 0;
+        DMA1_Channel2->CPAR = (uint32_t)&i2c->TXDR;
+        DMA1_Channel2->CMAR = (uint32_t)x->buf;
+        DMA1_Channel2->CNDTR = x->len;
+        DMA1_Channel2->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+    }
+    ll_left = x->len + 1;
+    i2c->CR1 |= LL_IRQS & ~I2C_CR1_RXIE;
+    i2c->CR2 = (x->addr & I2C_CR2_SADD) | i2c_bus_ll_chunk() | I2C_CR2_START;
+    return HAL_OK;
+}
+
+// Return the peripheral and the DMA channel to idle after a transfer
+static void i2c_bus_ll_stop(void)
+{
+    I2C_TypeDef *i2c = bus->Instance;
+
+    i2c->CR1 &= ~(LL_IRQS | I2C_CR1_TXDMAEN);
+    DMA1_Channel2->CCR = 0;
+    DMA1->IFCR = DMA_IFCR_CGIF2;
+    i2c->ISR = I2C_ISR_TXE;     // Flush a byte left behind by a NACK
+}
+#endif
+
+// Start queue[head] if nothing is on the wire. Transfers the HAL refuses
+// to start are completed with an error and the next one is tried.
+// Called with interrupts masked.
+static void i2c_bus_start(void)
+{
+    while (!active && !dma_lent && count)
+    {
+        i2c_bus_xfer *x = &queue[head];
+#if I2C_BUS_LL
+        HAL_StatusTypeDef st = bus_down ? HAL_ERROR : i2c_bus_ll_start(x);
+#else
+        HAL_StatusTypeDef st = bus_down ? HAL_ERROR : x->dir == I2C_BUS_READ ?
+            HAL_I2C_Mem_Read_IT(bus, x->addr, x->reg, I2C_MEMADD_SIZE_8BIT, x->buf, x->len) :
+            HAL_I2C_Mem_Write_DMA(bus, x->addr, x->reg, I2C_MEMADD_SIZE_8BIT, x->buf, x->len);
+#endif
+        if (st == HAL_OK)
+        {
+            TRACE_POINT(TRACE_I2C_START);
+            active = 1;
+            active_since = HAL_GetTick();
+            active_timeout = i2c_bus_timeout_ms(x->len);
+            wire_us += ((uint32_t)x->len + 2) * 9 * 1000U / (bus_speed / 1000U);
+            i2c_bus_device_stats *d = i2c_bus_device_slot(x->addr);
+            d->transfers++;
+            d->bytes += x->len;
+            return;
+        }
+
+        i2c_bus_callback cb = x->cb;
+        void *ctx = x->ctx;
+        head = (head + 1) % I2C_BUS_QUEUE_LEN;
+        count--;
+        if (cb) cb(HAL_ERROR, ctx);
+    }
+}
+
+// Retire the transfer on the wire and start the next one (IRQ context)
+static void i2c_bus_complete(HAL_StatusTypeDef status)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!active)
+    {
+        __set_PRIMASK(primask);
+        return;
+    }
+    TRACE_POINT(status == HAL_OK ? TRACE_I2C_DONE : TRACE_I2C_ERROR);
+    i2c_bus_callback cb = queue[head].cb;
+    void *ctx = queue[head].ctx;
+    head = (head + 1) % I2C_BUS_QUEUE_LEN;
+    count--;
+    active = 0;
+    __set_PRIMASK(primask);
+
+    // The callback may submit follow-up work; it lands behind what is queued
+    if (cb) cb(status, ctx);
+
+    __disable_irq();
+    i2c_bus_start();
+    __set_PRIMASK(primask);
+}
+
+#if I2C_BUS_LL
+void i2c_bus_irq(void)
+{
+    I2C_TypeDef *i2c = bus->Instance;
+    uint32_t isr = i2c->ISR;
+
+    if (isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR))
+    {
+        i2c->ICR = I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+        i2c_bus_ll_stop();
+        i2c_bus_count_error((isr & I2C_ISR_BERR ? HAL_I2C_ERROR_BERR : 0) |
+                            (isr & I2C_ISR_ARLO ? HAL_I2C_ERROR_ARLO : 0) |
+                            (isr & I2C_ISR_OVR ? HAL_I2C_ERROR_OVR : 0));
+        if (isr & (I2C_ISR_BERR | I2C_ISR_ARLO)) i2c_bus_recover();
+        i2c_bus_complete(HAL_ERROR);
+        return;
+    }
+
+    if (isr & I2C_ISR_RXNE) *ll_ptr++ = (uint8_t)i2c->RXDR;
+
+    if ((isr & I2C_ISR_TXIS) && !ll_reg_sent)
+    {
+        i2c->TXDR = queue[head].reg;
+        ll_reg_sent = 1;
+        // A write continues on DMA, a read waits for TC to restart
+        i2c->CR1 = (i2c->CR1 & ~I2C_CR1_TXIE) |
+                   (queue[head].dir == I2C_BUS_WRITE && queue[head].len ? I2C_CR1_TXDMAEN : 0);
+    }
+
+    if (isr & I2C_ISR_TCR)
+    {
+        // Writing NBYTES releases the stretched SCL
+        i2c->CR2 = (i2c->CR2 & ~(I2C_CR2_NBYTES | I2C_CR2_RELOAD | I2C_CR2_AUTOEND)) | i2c_bus_ll_chunk();
+    }
+    else if (isr & I2C_ISR_TC)
+    {
+        // Register byte of a read is out: repeated START in read mode
+        ll_left = queue[head].len;
+        i2c->CR1 |= I2C_CR1_RXIE;
+        i2c->CR2 = (queue[head].addr & I2C_CR2_SADD) | I2C_CR2_RD_WRN | i2c_bus_ll_chunk() | I2C_CR2_START;
+    }
+
+    if (isr & I2C_ISR_NACKF)
+    {
+        i2c->ICR = I2C_ICR_NACKCF;
+        i2c_bus_count_error(HAL_I2C_ERROR_AF);
+        ll_status = HAL_ERROR;
+        if (!(i2c->CR2 & I2C_CR2_AUTOEND)) i2c->CR2 |= I2C_CR2_STOP;
+    }
+
+    if (isr & I2C_ISR_STOPF)
+    {
+        i2c->ICR = I2C_ICR_STOPCF;
+        i2c_bus_ll_stop();
+        i2c_bus_complete(ll_status);
+    }
+}
+
+// Address-only write: ACK or NACK, then STOP. Polled, the bus is idle.
+static HAL_StatusTypeDef i2c_bus_ll_probe(uint8_t addr)
+{
+    I2C_TypeDef *i2c = bus->Instance;
+    uint32_t start = HAL_GetTick();
+
+    i2c->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+    i2c->CR2 = (addr & I2C_CR2_SADD) | I2C_CR2_AUTOEND | I2C_CR2_START;
+    while (!(i2c->ISR & I2C_ISR_STOPF))
+    {
+        if (HAL_GetTick() - start > i2c_bus_timeout_ms(0))
+        {
+            COUNT(counters.timeouts);
+            i2c_bus_recover();
+            return HAL_TIMEOUT;
+        }
+    }
+    HAL_StatusTypeDef st = i2c->ISR & I2C_ISR_NACKF ? HAL_ERROR : HAL_OK;
+    i2c->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+    return st;
+}
+#endif
+
+uint8_t i2c_bus_set_priority(uint8_t addr, uint8_t prio)
+{
+    for (uint8_t i = 0; i < I2C_BUS_PRIO_CLIENTS; i++)
+    {
+        if (prios[i].addr == addr || prios[i].addr == 0)
+        {
+            prios[i].addr = addr;
+            prios[i].prio = prio;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint8_t i2c_bus_priority(uint8_t addr)
+{
+    for (uint8_t i = 0; i < I2C_BUS_PRIO_CLIENTS && prios[i].addr; i++)
+        if (prios[i].addr == addr) return prios[i].prio;
+    return I2C_BUS_PRIO_BULK;
+}
+
+uint8_t i2c_bus_submit(const i2c_bus_xfer *xfer)
+{
+    uint8_t prio = i2c_bus_priority(xfer->addr);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (count >= I2C_BUS_QUEUE_LEN)
+    {
+        __set_PRIMASK(primask);
+        return 0;
+    }
+    // Move waiting lower-priority transfers back by one; the one on the
+    // wire stays at head
+    uint8_t pos = count;
+    while (pos > active && queue_prio[(head + pos - 1) % I2C_BUS_QUEUE_LEN] < prio)
+    {
+        uint8_t to = (head + pos) % I2C_BUS_QUEUE_LEN;
+        uint8_t from = (head + pos - 1) % I2C_BUS_QUEUE_LEN;
+        queue[to] = queue[from];
+        queue_prio[to] = queue_prio[from];
+        pos--;
+    }
+    queue[(head + pos) % I2C_BUS_QUEUE_LEN] = *xfer;
+    queue_prio[(head + pos) % I2C_BUS_QUEUE_LEN] = prio;
+    count++;
+    i2c_bus_start();
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+// Fail the transfer on the wire if it has overrun its deadline
+static void i2c_bus_watchdog(void)
+{
+    if (!active) return;
+    if (HAL_GetTick() - active_since <= active_timeout)
+    {
+        // Waiters sleep in __WFI(); make sure a hung transfer wakes them
+        tick_wakeup_at(active_since + active_timeout + 1);
+        return;
+    }
+
+    // Keep the completion IRQ out while the peripheral is torn down;
+    // HAL_I2C_Init() in the recovery enables it again
+    HAL_NVIC_DisableIRQ(I2C1_IRQn);
+    if (!active)
+    {
+        HAL_NVIC_EnableIRQ(I2C1_IRQn);  // The completion won the race
+        return;
+    }
+
+    COUNT(counters.timeouts);
+    i2c_bus_recover();
+    i2c_bus_complete(HAL_TIMEOUT);
+}
+
+uint8_t i2c_bus_busy(void)
+{
+    i2c_bus_watchdog();
+    return count != 0;
+}
+
+uint8_t i2c_bus_lend_dma(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t ok = !active && !count && !dma_lent;
+    if (ok) dma_lent = 1;
+    __set_PRIMASK(primask);
+    return ok;
+}
+
+void i2c_bus_return_dma(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    // The borrower reprograms the request line; HAL_DMA_Start_IT() does not
+    // touch CSELR, so the I2C selection has to be put back here
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C2S) |
+                        (bus->hdmatx->Init.Request << DMA_CSELR_C2S_Pos);
+    dma_lent = 0;
+    i2c_bus_start();
+    __set_PRIMASK(primask);
+}
+
+static void i2c_bus_wait_cb(HAL_StatusTypeDef status, void *ctx)
+{
+    i2c_bus_wait *w = ctx;
+    w->status = status;
+    w->done = 1;
+}
+
+static HAL_StatusTypeDef i2c_bus_transfer(uint8_t addr, uint8_t reg, uint8_t dir, uint8_t *buf, uint16_t len)
+{
+    i2c_bus_wait w = { 0, HAL_ERROR };
+    i2c_bus_xfer x = { addr, reg, dir, buf, len, i2c_bus_wait_cb, &w };
+
+    while (!i2c_bus_submit(&x))
+    {
+        if (i2c_bus_busy()) __WFI();
+    }
+    while (!w.done)
+    {
+        if (i2c_bus_busy()) __WFI();
+    }
+    return w.status;
+}
+
+static HAL_StatusTypeDef i2c_bus_transfer_retry(uint8_t addr, uint8_t reg, uint8_t dir, uint8_t *buf, uint16_t len)
+{
+    HAL_StatusTypeDef st = i2c_bus_transfer(addr, reg, dir, buf, len);
+    for (uint8_t attempt = 0; st != HAL_OK && attempt < I2C_BUS_RETRIES; attempt++)
+    {
+        COUNT(counters.retries);
+        HAL_Delay(1U << attempt);
+        st = i2c_bus_transfer(addr, reg, dir, buf, len);
+    }
+    return st;
+}
+
+HAL_StatusTypeDef i2c_bus_mem_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+    return i2c_bus_transfer_retry(addr, reg, I2C_BUS_READ, buf, len);
+}
+
+HAL_StatusTypeDef i2c_bus_mem_write(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+    return i2c_bus_transfer_retry(addr, reg, I2C_BUS_WRITE, buf, len);
+}
+
+HAL_StatusTypeDef i2c_bus_probe(uint8_t addr)
+{
+    while (i2c_bus_busy()) __WFI();
+#if I2C_BUS_LL
+    // Hold the queue off the bus while polling
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (active || count || bus_down)
+    {
+        __set_PRIMASK(primask);
+        return HAL_ERROR;
+    }
+    active = 1;
+    active_since = HAL_GetTick();
+    active_timeout = i2c_bus_timeout_ms(0);
+    __set_PRIMASK(primask);
+
+    HAL_StatusTypeDef st = i2c_bus_ll_probe(addr);
+
+    __disable_irq();
+    active = 0;
+    i2c_bus_start();
+    __set_PRIMASK(primask);
+    return st;
+#else
+    return HAL_I2C_IsDeviceReady(bus, addr, 1, 2);
+#endif
+}
+
+#if !I2C_BUS_LL
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    if (hi2c == bus) i2c_bus_complete(HAL_OK);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    if (hi2c == bus) i2c_bus_complete(HAL_OK);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    if (hi2c != bus) return;
+
+    i2c_bus_count_error(hi2c->ErrorCode);
+    // A plain NACK leaves the bus idle; anything else may leave it stuck
+    if (hi2c->ErrorCode & (HAL_I2C_ERROR_BERR | HAL_I2C_ERROR_ARLO | HAL_I2C_ERROR_TIMEOUT))
+        i2c_bus_recover();
+    i2c_bus_complete(HAL_ERROR);
+}
+#endif
+
+// A few µs at any system clock, so the bit-banged SCL stays below 100 kHz
+static void i2c_bus_delay(void)
+{
+    for (volatile uint32_t n = SystemCoreClock / 1000000U + 1; n; n--);
+}
+
+void i2c_bus_recover(void)
+{
+    GPIO_InitTypeDef gpio = {0};
+
+    COUNT(counters.recoveries);
+    HAL_I2C_DeInit(bus);
+
+    // Both lines as open-drain outputs, released (high) by default
+    HAL_GPIO_WritePin(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_SET);
+    HAL_GPIO_WritePin(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PIN, GPIO_PIN_SET);
+    gpio.Mode = GPIO_MODE_OUTPUT_OD;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    gpio.Pin = I2C_BUS_SCL_PIN;
+    HAL_GPIO_Init(I2C_BUS_SCL_PORT, &gpio);
+    gpio.Pin = I2C_BUS_SDA_PIN;
+    HAL_GPIO_Init(I2C_BUS_SDA_PORT, &gpio);
+
+    // A slave in the middle of a read shifts out at most 8 more bits + ACK
+    for (uint8_t i = 0; i < 9 && HAL_GPIO_ReadPin(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PIN) == GPIO_PIN_RESET; i++)
+    {
+        HAL_GPIO_WritePin(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_RESET);
+        i2c_bus_delay();
+        HAL_GPIO_WritePin(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_SET);
+        i2c_bus_delay();
+    }
+
+    // STOP: SDA rises while SCL is high
+    HAL_GPIO_WritePin(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_RESET);
+    i2c_bus_delay();
+    HAL_GPIO_WritePin(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PIN, GPIO_PIN_RESET);
+    i2c_bus_delay();
+    HAL_GPIO_WritePin(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_SET);
+    i2c_bus_delay();
+    HAL_GPIO_WritePin(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PIN, GPIO_PIN_SET);
+    i2c_bus_delay();
+
+    // MspInit restores the pins, DMA and NVIC; Init.Timing holds the current speed
+    HAL_I2C_Init(bus);
+    HAL_I2CEx_ConfigAnalogFilter(bus, I2C_ANALOGFILTER_ENABLE);
+}
+
+uint32_t i2c_bus_timeout_ms(uint16_t len)
+{
+    uint32_t bits = ((uint32_t)len + 2) * 9;
+    return (bits * 1000U + bus_speed - 1) / bus_speed + I2C_BUS_TIMEOUT_MARGIN_MS;
+}
+
+const i2c_bus_counters *i2c_bus_get_counters(void)
+{
+    return &counters;
+}
+
+uint32_t i2c_bus_wire_us(void)
+{
+    return wire_us;
+}
+
+const i2c_bus_device_stats *i2c_bus_get_device_stats(uint8_t addr)
+{
+    for (uint8_t i = 0; addr && i < I2C_BUS_STAT_DEVICES; i++)
+        if (device_stats[i].addr == addr) return &device_stats[i];
+    return &device_stats[I2C_BUS_STAT_DEVICES];
+}
@@ -0,0 +1,322 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "stm32l0xx_hal.h"
+
+/** Bus speed profiles (SCL frequency in Hz) */
+typedef enum {
+    I2C_BUS_SPEED_STANDARD  = 100000,   // Sm,  100 kHz
+    I2C_BUS_SPEED_FAST      = 400000,   // Fm,  400 kHz (SSD1306 and BME280 max)
+    I2C_BUS_SPEED_FAST_PLUS = 1000000   // Fm+, 1 MHz (needs I2C1_FMP drive)
+} I2C_BusSpeed;
+
+/** Speed applied at start-up; both devices on the bus support Fm */
+#ifndef I2C_BUS_DEFAULT_SPEED
+#define I2C_BUS_DEFAULT_SPEED I2C_BUS_SPEED_FAST
+#endif
+
+/** Board SCL/SDA edge times assumed by the timing calculation, in ns */
+#ifndef I2C_BUS_RISE_NS
+#define I2C_BUS_RISE_NS 100
+#endif
+#ifndef I2C_BUS_FALL_NS
+#define I2C_BUS_FALL_NS 10
+#endif
+
+/** Depth of the transaction queue (one slot per concurrent requester is enough) */
+#ifndef I2C_BUS_QUEUE_LEN
+#define I2C_BUS_QUEUE_LEN 4
+#endif
+
+/** Clients with a priority of their own (i2c_bus_set_priority()) */
+#ifndef I2C_BUS_PRIO_CLIENTS
+#define I2C_BUS_PRIO_CLIENTS 2
+#endif
+
+/** Queue priorities; transfers of a higher one are started first */
+#define I2C_BUS_PRIO_BULK   0   // Default: frame pushes and anything not configured
+#define I2C_BUS_PRIO_SENSOR 1   // Short sensor reads on the sampling path
+
+/** Attempts after the first for the blocking helpers; backoff doubles from 1 ms */
+#ifndef I2C_BUS_RETRIES
+#define I2C_BUS_RETRIES 2
+#endif
+
+/** Slack added to the computed wire time of every transfer, in ms */
+#ifndef I2C_BUS_TIMEOUT_MARGIN_MS
+#define I2C_BUS_TIMEOUT_MARGIN_MS 2
+#endif
+
+/**
+ * Transfer engine: 0 drives I2C1 through the HAL IT/DMA state machines,
+ * 1 through the register-level master in i2c_bus.c, which leaves only the
+ * HAL init/deinit code of the I2C module in the image.
+ */
+#ifndef I2C_BUS_LL
+#define I2C_BUS_LL 0
+#endif
+
+/** I2C1 pins, driven as GPIO during bus recovery (see stm32l0xx_hal_msp.c) */
+#define I2C_BUS_SCL_PORT GPIOA
+#define I2C_BUS_SCL_PIN  GPIO_PIN_4
+#define I2C_BUS_SDA_PORT GPIOA
+#define I2C_BUS_SDA_PIN  GPIO_PIN_10
+
+/** Transfer direction for i2c_bus_xfer */
+#define I2C_BUS_WRITE 0
+#define I2C_BUS_READ  1
+
+/**
+ * @brief Completion callback, run from the I2C/DMA interrupt.
+ *
+ * @param status HAL_OK on success, HAL_ERROR on NACK/bus error,
+ *               HAL_TIMEOUT if the transfer overran its deadline
+ * @param ctx Pointer passed in i2c_bus_xfer::ctx
+ */
+typedef void (*i2c_bus_callback)(HAL_StatusTypeDef status, void *ctx);
+
+/** One queued register-addressed transfer */
+typedef struct {
+    uint8_t addr;           // 8-bit (shifted) device address
+    uint8_t reg;            // Register / control byte sent before the data
+    uint8_t dir;            // I2C_BUS_WRITE or I2C_BUS_READ
+    uint8_t *buf;           // Must stay valid until the callback runs
+    uint16_t len;
+    i2c_bus_callback cb;    // May be NULL
+    void *ctx;
+} i2c_bus_xfer;
+
+/** Bus error counters, saturating at 0xFFFF */
+typedef struct {
+    uint16_t errors;        // NACK, bus error or arbitration loss reported by HAL
+    uint16_t nacks;         // ... of which address or data NACKs
+    uint16_t arb_lost;      // ... of which arbitration losses
+    uint16_t bus_errors;    // ... of which misplaced START/STOP
+    uint16_t timeouts;      // Transfers that exceeded their deadline
+    uint16_t recoveries;    // Bus recovery sequences run
+    uint16_t retries;       // Repeated attempts by the blocking helpers
+} i2c_bus_counters;
+
+/** Devices with traffic statistics of their own; the rest share one more slot */
+#ifndef I2C_BUS_STAT_DEVICES
+#define I2C_BUS_STAT_DEVICES 2
+#endif
+
+/** Traffic of one device, counted when a transfer starts */
+typedef struct {
+    uint8_t addr;           // 8-bit address, 0 for the shared slot
+    uint32_t transfers;
+    uint32_t bytes;         // Data bytes, without address and register
+} i2c_bus_device_stats;
+
+/**
+ * @brief Bind the bus layer to the HAL handle of I2C1.
+ *
+ * Must be called after MX_I2C1_Init() and before any other i2c_bus_* call.
+ *
+ * @param hi2c Pointer to HAL I2C handle
+ */
+void i2c_bus_init(I2C_HandleTypeDef *hi2c);
+
+#if I2C_BUS_LL
+/**
+ * @brief I2C1 event and error interrupt of the register-level engine.
+ *
+ * Called from I2C1_IRQHandler() in place of the HAL handlers.
+ */
+void i2c_bus_irq(void);
+#endif
+
+/**
+ * @brief Set the queue priority of a device.
+ *
+ * A transfer is queued ahead of every waiting transfer of a lower
+ * priority, never ahead of the one on the wire, and in submission order
+ * among its own priority. A high-priority transfer therefore waits for
+ * at most one transfer on the wire, which is what bounds its latency:
+ * long pushes are to be split into short transfers (the OLED flush sends
+ * OLED_CHUNK bytes at a time). A device's own transfers keep their order.
+ *
+ * @param addr 8-bit device address
+ * @param prio I2C_BUS_PRIO_* or any higher value
+ * @return 1 if set, 0 if all I2C_BUS_PRIO_CLIENTS slots are taken
+ */
+uint8_t i2c_bus_set_priority(uint8_t addr, uint8_t prio);
+
+/**
+ * @brief Queue a transfer and return immediately.
+ *
+ * Transfers run in priority order (i2c_bus_set_priority()), in submission
+ * order within a priority; writes use DMA, reads use the I2C
+ * interrupt. Bursts above 255 bytes are split with the NBYTES reload. The descriptor is copied, only the data buffer has to outlive
+ * the call. Safe to call from interrupt context, including from a callback.
+ *
+ * @param xfer Transfer descriptor
+ * @return 1 if queued, 0 if the queue is full
+ */
+uint8_t i2c_bus_submit(const i2c_bus_xfer *xfer);
+
+/**
+ * @brief Check whether any transfer is queued or in progress.
+ *
+ * Also enforces the deadline of the transfer on the wire: one that has
+ * overrun is failed with HAL_TIMEOUT and the bus is recovered, so a loop
+ * polling this function always terminates.
+ *
+ * @return 1 if busy, 0 if idle
+ */
+uint8_t i2c_bus_busy(void);
+
+/**
+ * @brief Lend the I2C1 TX DMA channel to another peripheral.
+ *
+ * On the STM32L011 DMA1 channel 2 is the only channel serving both the
+ * I2C1 TX and the LPUART1 TX requests. The channel is lent only while no
+ * transfer is queued or on the wire; transfers submitted while it is out
+ * stay queued and start from i2c_bus_return_dma().
+ *
+ * @return 1 if the channel is now the caller's, 0 if the bus is busy
+ */
+uint8_t i2c_bus_lend_dma(void);
+
+/**
+ * @brief Give the channel back: restore its I2C1 TX request selection and
+ * start whatever was queued meanwhile. May be called from interrupt context.
+ */
+void i2c_bus_return_dma(void);
+
+/**
+ * @brief Blocking register read through the queue (sleeps in WFI).
+ *
+ * Failed attempts are repeated up to I2C_BUS_RETRIES times with a 1, 2, 4 ...
+ * ms backoff. Not for use from interrupt context.
+ *
+ * @param addr 8-bit device address
+ * @param reg First register
+ * @param buf Destination buffer
+ * @param len Number of bytes
+ * @return HAL_OK, HAL_ERROR or HAL_TIMEOUT
+ */
+HAL_StatusTypeDef i2c_bus_mem_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len);
+
+/**
+ * @brief Blocking register write through the queue (sleeps in WFI).
+ *
+ * Retried like i2c_bus_mem_read(). Not for use from interrupt context.
+ *
+ * @param addr 8-bit device address
+ * @param reg First register
+ * @param buf Source buffer
+ * @param len Number of bytes
+ * @return HAL_OK, HAL_ERROR or HAL_TIMEOUT
+ */
+HAL_StatusTypeDef i2c_bus_mem_write(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len);
+
+/**
+ * @brief Check whether a device ACKs its address.
+ *
+ * Waits for the queue to drain first. Not for use from interrupt context.
+ *
+ * @param addr 8-bit device address
+ * @return HAL_OK if the device answered
+ */
+HAL_StatusTypeDef i2c_bus_probe(uint8_t addr);
+
+/**
+ * @brief Free a stuck bus and reinitialize I2C1.
+ *
+ * Clocks up to 9 SCL pulses on the SCL pin until a slave holding SDA low
+ * lets go, generates a STOP, then re-runs HAL_I2C_Init() with the current
+ * timing. The transfer on the wire, if any, is not completed here.
+ */
+void i2c_bus_recover(void);
+
+/**
+ * @brief Deadline for a transfer at the current bus speed.
+ *
+ * Wire time of address, register and data bytes (9 bits each) plus
+ * I2C_BUS_TIMEOUT_MARGIN_MS.
+ *
+ * @param len Number of data bytes
+ * @return Timeout in ms
+ */
+uint32_t i2c_bus_timeout_ms(uint16_t len);
+
+/**
+ * @brief Bus error counters since start-up.
+ *
+ * @return Pointer to the live counters
+ */
+const i2c_bus_counters *i2c_bus_get_counters(void);
+
+/**
+ * @brief Wire time of the transfers started since start-up.
+ *
+ * Address, register and data bytes at 9 bits each and the speed the
+ * transfer started at, so the bus busy time without clock stretching.
+ * Every retry counts as a transfer of its own. Wraps after about 71
+ * minutes of traffic.
+ *
+ * @return Accumulated wire time in µs
+ */
+uint32_t i2c_bus_wire_us(void);
+
+/**
+ * @brief Traffic of one device since start-up.
+ *
+ * The first I2C_BUS_STAT_DEVICES addresses seen get a slot each; any
+ * later address is counted in the shared slot (addr 0).
+ *
+ * @param addr 8-bit device address
+ * @return The device slot, the shared slot for an address without one
+ */
+const i2c_bus_device_stats *i2c_bus_get_device_stats(uint8_t addr);
+
+/**
+ * @brief Compute the TIMINGR value for a given kernel clock and bus speed.
+ *
+ * Follows the timing model from the reference manual (I2C timings section):
+ * SCLL/SCLH are sized to meet the minimum low/high times of the selected
+ * mode, including the synchronization delays of the analog filter and the
+ * I2CCLK resampling, and the remaining period is split between them.
+ * SCLDEL covers rise time plus data setup, SDADEL the fall time. The
+ * smallest prescaler that fits the 8-bit SCLL/SCLH fields is used.
+ *
+ * @param i2c_clk_hz I2C kernel clock (PCLK1 in this project)
+ * @param speed Target bus speed
+ * @return TIMINGR value, or 0 if the speed is not reachable from this clock
+ */
+uint32_t i2c_bus_timing(uint32_t i2c_clk_hz, I2C_BusSpeed speed);
+
+/**
+ * @brief Reprogram the bus for a new speed using the current PCLK1.
+ *
+ * The peripheral is briefly disabled to load TIMINGR. Fm+ drive on the I2C1
+ * pins is enabled only for I2C_BUS_SPEED_FAST_PLUS.
+ *
+ * @param speed Target bus speed
+ * @return HAL_OK, or HAL_ERROR if the speed is not reachable
+ */
+HAL_StatusTypeDef i2c_bus_set_speed(I2C_BusSpeed speed);
+
+/**
+ * @brief Recompute TIMINGR after a PCLK1 change.
+ *
+ * Applies the speed last passed to i2c_bus_set_speed(), or the fastest slower
+ * one this clock can reach. If none is reachable the bus is marked down and
+ * every transfer fails immediately with HAL_ERROR until a retune succeeds.
+ *
+ * @return HAL_OK, or HAL_ERROR if the bus is down
+ */
+HAL_StatusTypeDef i2c_bus_retune(void);
+
+/**
+ * @brief Currently applied bus speed.
+ *
+ * May be below the requested one after i2c_bus_retune().
+ *
+ * @return SCL frequency in Hz
+ */
+I2C_BusSpeed i2c_bus_get_speed(void);
+
+#endif // I2C_BUS_H
@@ -0,0 +1,183 @@
+/**
+ * @file logger.c
+ * @brief Wear-leveled measurement log in data EEPROM
+ *
+ * The log region is a ring of LOGGER_BLOCK_BYTES blocks (32 bytes with
+ * the default batch), each written in one pass: the time of the first
+ * record, sequence number, LOGGER_RECORDS_PER_BLOCK hour buckets and CRC.
+ * New blocks always go to the slot after the newest one, so every word of the region
+ * wears at the same rate. Records are batched in RAM, which spreads the
+ * ~3.2 ms word program time and current over several samples; a slot
+ * holding a partial batch is not reused, a flushed partial block simply
+ * carries fewer valid records.
+ */
+
+#include "logger.h"
+#include "eeprom.h"
+#include "rtc.h"
+#include <stddef.h>
+
+#define LOGGER_BLOCKS  (EEPROM_LOG_SIZE / sizeof(Logger_Block))
+#define LOGGER_UNUSED  INT16_MIN    // Temperature mean of an empty record slot
+
+typedef struct {
+    uint32_t time;          // Unix time of records[0]
+    uint16_t seq;
+    Logger_Record records[LOGGER_RECORDS_PER_BLOCK];
+    uint16_t crc;
+} Logger_Block;
+
+typedef char logger_block_size_check[sizeof(Logger_Block) == LOGGER_BLOCK_BYTES ? 1 : -1];
+
+static uint16_t head;           // Slot the next block goes to
+static uint16_t tail;           // Oldest valid slot
+static uint16_t blocks;         // Valid blocks from tail up to head
+static uint16_t next_seq;
+static Logger_Block pending;
+static uint8_t pending_count;
+static uint16_t period;
+
+static uint16_t logger_next(uint16_t slot)
+{
+    return slot + 1 == LOGGER_BLOCKS ? 0 : slot + 1;
+}
+
+static const Logger_Block *logger_block(uint16_t slot)
+{
+    return eeprom_ptr(EEPROM_LOG + slot * sizeof(Logger_Block));
+}
+
+static uint8_t logger_valid(uint16_t slot)
+{
+    const Logger_Block *b = logger_block(slot);
+    return b->crc == eeprom_crc16(b, offsetof(Logger_Block, crc));
+}
+
+void logger_init(uint16_t period_s)
+{
+    period = period_s;
+    pending_count = 0;
+    head = tail = blocks = 0;
+    next_seq = 0;
+
+    if (!logger_valid(0))
+    {
+        // Empty log, or a torn write right after wrapping around
+        if (logger_valid(LOGGER_BLOCKS - 1))
+        {
+            next_seq = logger_block(LOGGER_BLOCKS - 1)->seq + 1;
+            tail = 1;
+            blocks = LOGGER_BLOCKS - 1;
+        }
+        return;
+    }
+
+    // Slots 0..head-1 continue the sequence of slot 0; the first slot that
+    // does not is older (previous pass), erased or torn
+    uint16_t seq0 = logger_block(0)->seq;
+    uint16_t lo = 0, hi = LOGGER_BLOCKS;    // Holds at lo, fails at hi
+    while (hi - lo > 1)
+    {
+        uint16_t mid = (lo + hi) >> 1;
+        if (logger_valid(mid) && logger_block(mid)->seq == (uint16_t)(seq0 + mid)) lo = mid;
+        else hi = mid;
+    }
+    next_seq = seq0 + hi;
+
+    if (hi == LOGGER_BLOCKS)
+    {
+        blocks = LOGGER_BLOCKS;             // Full, slot 0 is the oldest
+    }
+    else if (logger_valid(LOGGER_BLOCKS - 1))
+    {
+        // The previous pass continues after the head, minus a torn slot
+        head = hi;
+        tail = logger_valid(hi) ? hi : logger_next(hi);
+        blocks = logger_valid(hi) ? LOGGER_BLOCKS : LOGGER_BLOCKS - 1;
+    }
+    else
+    {
+        head = hi;                          // First pass
+        blocks = hi;
+    }
+}
+
+static uint8_t logger_write_pending(void)
+{
+    for (uint8_t i = pending_count; i < LOGGER_RECORDS_PER_BLOCK; i++)
+        pending.records[i].ch[HISTORY_TEMPERATURE].mean = LOGGER_UNUSED;
+    pending.seq = next_seq;
+    pending.crc = eeprom_crc16(&pending, offsetof(Logger_Block, crc));
+
+    if (!eeprom_write(EEPROM_LOG + head * sizeof(Logger_Block), &pending, sizeof(pending)))
+    {
+        // A full ring just lost its oldest block to the failed write
+        if (blocks == LOGGER_BLOCKS)
+        {
+            tail = logger_next(tail);
+            blocks--;
+        }
+        return 0;
+    }
+
+    if (blocks == LOGGER_BLOCKS) tail = logger_next(tail);  // Oldest block overwritten
+    else blocks++;
+    head = logger_next(head);
+    next_seq++;
+    pending_count = 0;
+    return 1;
+}
+
+uint8_t logger_add(const Logger_Record *r)
+{
+    if (pending_count == LOGGER_RECORDS_PER_BLOCK && !logger_write_pending()) return 0;
+    if (pending_count == 0) pending.time = rtc_time();
+    pending.records[pending_count] = *r;
+    pending_count++;
+    if (pending_count < LOGGER_RECORDS_PER_BLOCK) return 1;
+    return logger_write_pending();
+}
+
+uint8_t logger_flush(void)
+{
+    return pending_count ? logger_write_pending() : 1;
+}
+
+static uint16_t logger_block_records(const Logger_Block *b)
+{
+    uint16_t n = 0;
+    while (n < LOGGER_RECORDS_PER_BLOCK && b->records[n].ch[HISTORY_TEMPERATURE].mean != LOGGER_UNUSED)
+        n++;
+    return n;
+}
+
+uint16_t logger_period(void)
+{
+    return period;
+}
+
+uint16_t logger_count(void)
+{
+    // Blocks written by logger_flush() may hold fewer records
+    uint16_t n = 0;
+    for (uint16_t b = 0, slot = tail; b < blocks; b++, slot = logger_next(slot))
+        n += logger_block_records(logger_block(slot));
+    return n;
+}
+
+uint8_t logger_read(uint16_t index, Logger_Record *out, uint32_t *time)
+{
+    for (uint16_t b = 0, slot = tail; b < blocks; b++, slot = logger_next(slot))
+    {
+        const Logger_Block *blk = logger_block(slot);
+        uint16_t n = logger_block_records(blk);
+        if (index < n)
+        {
+            *out = blk->records[index];
+            if (time) *time = blk->time + (uint32_t)index * period;
+            return 1;
+        }
+        index -= n;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file logger.h
+ * @brief Wear-leveled measurement log in data EEPROM
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "pyramid.h"
+
+/**
+ * Records collected in RAM before one block is programmed. Larger batches
+ * spend less EEPROM on block headers and fewer wake-ups on writes, at 12
+ * bytes of RAM per record; with SUPPLY_PVD a falling supply flushes the
+ * batch, so its size does not decide what a power loss costs
+ */
+#ifndef LOGGER_RECORDS_PER_BLOCK
+#define LOGGER_RECORDS_PER_BLOCK 2
+#endif
+
+/** Block size in EEPROM: time, sequence, records, CRC-16 over the rest */
+#define LOGGER_BLOCK_BYTES (8 + sizeof(Pyramid_Bucket) * LOGGER_RECORDS_PER_BLOCK)
+
+/**
+ * One logged record: an hour bucket of the pyramid (pyramid.h), in the
+ * history channel units (0.1 °C, %RH, hPa)
+ */
+typedef Pyramid_Bucket Logger_Record;
+
+/**
+ * @brief Find the log head.
+ *
+ * Blocks carry consecutive sequence numbers, so the head is located with a
+ * binary search over the block ring: about log2(blocks) + 1 block reads
+ * instead of a scan. A torn block from a power loss ends the log and is
+ * overwritten next.
+ *
+ * @param period_s Interval logger_add() is called at, in seconds; a
+ *        block stores the time its first record was added and the others
+ *        follow at this spacing
+ */
+void logger_init(uint16_t period_s);
+
+/**
+ * @brief Queue a record; a full batch is written as one block.
+ *
+ * @param r Record to log
+ * @return 1 if nothing needed writing or the block was written, 0 on a
+ *         programming error (the batch is kept and retried)
+ */
+uint8_t logger_add(const Logger_Record *r);
+
+/**
+ * @brief Write a partially filled batch now, e.g. before power goes away.
+ *
+ * @return 1 on success or if nothing was pending, 0 on a programming error
+ */
+uint8_t logger_flush(void);
+
+/**
+ * @brief Record spacing given to logger_init(), in seconds.
+ */
+uint16_t logger_period(void);
+
+/**
+ * @brief Number of records stored in EEPROM.
+ */
+uint16_t logger_count(void);
+
+/**
+ * @brief Read a stored record.
+ *
+ * @param index 0 for the oldest record, logger_count() - 1 for the newest
+ * @param out Destination
+ * @param time Unix time of the record, or NULL
+ * @return 1 on success, 0 if @p index is out of range
+ */
+uint8_t logger_read(uint16_t index, Logger_Record *out, uint32_t *time);
+
+#endif // LOGGER_H
@@ -0,0 +1,296 @@
+/**
+ * @file modbus.c
+ * @brief Modbus-RTU style register responder on the telemetry link
+ *
+ * Requests are framed by length rather than by the 3.5-character silence:
+ * function codes 0x03, 0x04 and 0x06 are 8 bytes, 0x10 carries its byte
+ * count, and any other code is taken as 8 bytes and answered with
+ * exception 0x01. A pause longer than MODBUS_GAP_MS drops the partial
+ * request, which resynchronises the parser after noise or a frame meant
+ * for another slave. The reply is a three-segment DMA chain: header built
+ * here, the register bytes where they live, CRC.
+ */
+
+#include "modbus.h"
+
+#if MODBUS
+
+#include "sched.h"
+#include "telemetry.h"
+#include <string.h>
+
+#define MODBUS_FC_READ_HOLDING  0x03
+#define MODBUS_FC_READ_INPUT    0x04
+#define MODBUS_FC_WRITE_SINGLE  0x06
+#define MODBUS_FC_WRITE_MULTI   0x10
+
+#define MODBUS_EX_FUNCTION      0x01
+#define MODBUS_EX_ADDRESS       0x02
+#define MODBUS_EX_VALUE         0x03
+
+#define MODBUS_READ_MAX         125     // Registers per read, as the spec allows
+#define MODBUS_CONFIG_REGS      (uint16_t)(sizeof(Config_Record) / 2)
+#define MODBUS_STATS_REGS       (uint16_t)(sizeof(Modbus_Stats) / 2)
+
+typedef char modbus_config_words[sizeof(Config_Record) % 2 == 0 ? 1 : -1];
+typedef char modbus_stats_words[sizeof(Modbus_Stats) % 2 == 0 ? 1 : -1];
+
+static const Modbus_Block *map;
+static uint8_t map_count;
+static Modbus_Stats stats;
+
+static uint8_t rx[MODBUS_RX_MAX];
+static volatile uint8_t rx_len;
+static uint32_t rx_last;                // HAL_GetTick() of the last byte
+static uint32_t request_end;
+
+// The reply chain; tx[] is only rebuilt while nothing is on the wire
+static uint8_t tx[6];
+static uint8_t tx_crc[2];
+static telemetry_segment reply[3];
+static uint8_t reply_count;
+static volatile uint8_t reply_pending;
+
+static Config_Record pending_cfg;
+static volatile uint8_t cfg_written;
+
+// CRC-16/MODBUS (reflected 0x8005), one table lookup per nibble
+static const uint16_t modbus_crc_table[16] = {
+    0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+    0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+static uint16_t modbus_crc(uint16_t crc, const uint8_t *p, uint16_t len)
+{
+    while (len--)
+    {
+        uint8_t b = *p++;
+        crc = (crc >> 4) ^ modbus_crc_table[(crc ^ b) & 0x0F];
+        crc = (crc >> 4) ^ modbus_crc_table[(crc ^ (b >> 4)) & 0x0F];
+    }
+    return crc;
+}
+
+static uint16_t modbus_get16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+void modbus_init(const Modbus_Block *blocks, uint8_t count)
+{
+    map = blocks;
+    map_count = count;
+}
+
+// Bytes behind registers start .. start + n - 1, NULL unless one block
+// holds all of them
+static const uint8_t *modbus_lookup(uint8_t fc, uint16_t start, uint16_t n)
+{
+    if (fc != MODBUS_FC_READ_INPUT)
+    {
+        if (start + n > MODBUS_CONFIG_REGS) return NULL;
+        return (const uint8_t *)config_get() + 2 * start;
+    }
+    for (uint8_t i = 0; i < map_count; i++)
+    {
+        const Modbus_Block *b = &map[i];
+        if (start >= b->base && start - b->base + n <= b->regs)
+            return (const uint8_t *)b->data() + 2 * (start - b->base);
+    }
+    if (start >= MODBUS_STATS_BASE && start - MODBUS_STATS_BASE + n <= MODBUS_STATS_REGS)
+        return (const uint8_t *)&stats + 2 * (start - MODBUS_STATS_BASE);
+    return NULL;
+}
+
+// CRC over the chain as it is now, then hand it to the link
+static uint8_t modbus_start(void)
+{
+    uint16_t latency = (uint16_t)(HAL_GetTick() - request_end);
+    stats.latency_ms = latency;
+    if (latency > stats.latency_max_ms) stats.latency_max_ms = latency;
+
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < reply_count - 1; i++)
+        crc = modbus_crc(crc, reply[i].data, reply[i].len);
+    tx_crc[0] = (uint8_t)crc;           // Low byte first, unlike the fields
+    tx_crc[1] = (uint8_t)(crc >> 8);
+    return telemetry_send(reply, reply_count);
+}
+
+static void modbus_reply(uint8_t head_len, const uint8_t *data, uint8_t len)
+{
+    reply[0].data = tx;
+    reply[0].len = head_len;
+    reply_count = 1;
+    if (len)
+    {
+        reply[1].data = data;
+        reply[1].len = len;
+        reply_count = 2;
+    }
+    reply[reply_count].data = tx_crc;
+    reply[reply_count].len = sizeof(tx_crc);
+    reply_count++;
+
+    if (modbus_start()) return;
+    stats.deferred++;
+    reply_pending = 1;
+    sched_post(SCHED_EV_COMMAND);
+}
+
+static void modbus_exception(uint8_t code)
+{
+    tx[1] |= 0x80;
+    tx[2] = code;
+    stats.exceptions++;
+    modbus_reply(3, NULL, 0);
+}
+
+static void modbus_write(uint16_t start, const uint8_t *data, uint8_t regs)
+{
+    // Writes in a row patch the same copy until the main loop takes it
+    if (!cfg_written) pending_cfg = *config_get();
+    memcpy((uint8_t *)&pending_cfg + 2 * start, data, 2 * regs);
+    cfg_written = 1;
+    sched_post(SCHED_EV_COMMAND);
+}
+
+static void modbus_request(void)
+{
+    uint8_t fc = rx[1];
+    uint16_t start = modbus_get16(&rx[2]);
+    uint16_t n = modbus_get16(&rx[4]);
+    uint8_t broadcast = rx[0] == 0;
+    const uint8_t *p;
+
+    // Master sent again before the last reply ended; it has given up on it
+    if (telemetry_busy()) return;
+    reply_pending = 0;
+    tx[0] = rx[0];
+    tx[1] = fc;
+
+    switch (fc)
+    {
+    case MODBUS_FC_READ_HOLDING:
+    case MODBUS_FC_READ_INPUT:
+        if (broadcast) return;
+        if (n == 0 || n > MODBUS_READ_MAX)
+        {
+            modbus_exception(MODBUS_EX_VALUE);
+            return;
+        }
+        p = modbus_lookup(fc, start, n);
+        if (!p)
+        {
+            modbus_exception(MODBUS_EX_ADDRESS);
+            return;
+        }
+        tx[2] = (uint8_t)(2 * n);
+        modbus_reply(3, p, tx[2]);
+        return;
+
+    case MODBUS_FC_WRITE_SINGLE:
+        if (start >= MODBUS_CONFIG_REGS)
+        {
+            if (!broadcast) modbus_exception(MODBUS_EX_ADDRESS);
+            return;
+        }
+        modbus_write(start, &rx[4], 1);
+        break;
+
+    case MODBUS_FC_WRITE_MULTI:
+        if (n == 0 || rx[6] != 2 * n)
+        {
+            if (!broadcast) modbus_exception(MODBUS_EX_VALUE);
+            return;
+        }
+        if (start + n > MODBUS_CONFIG_REGS)
+        {
+            if (!broadcast) modbus_exception(MODBUS_EX_ADDRESS);
+            return;
+        }
+        modbus_write(start, &rx[7], (uint8_t)n);
+        break;
+
+    default:
+        if (!broadcast) modbus_exception(MODBUS_EX_FUNCTION);
+        return;
+    }
+
+    // Both writes answer with the address and count or value they got
+    if (broadcast) return;
+    memcpy(&tx[2], &rx[2], 4);
+    modbus_reply(6, NULL, 0);
+}
+
+void modbus_rx(uint8_t c)
+{
+    uint32_t now = HAL_GetTick();
+    uint16_t len;
+
+    if (rx_len && now - rx_last > MODBUS_GAP_MS)
+    {
+        stats.crc_errors++;
+        rx_len = 0;
+    }
+    rx_last = now;
+    rx[rx_len++] = c;
+
+    if (rx_len < 2) return;
+    if (rx[1] == MODBUS_FC_WRITE_MULTI)
+    {
+        if (rx_len < 7) return;
+        len = 9 + rx[6];
+    }
+    else len = 8;
+    if (len > MODBUS_RX_MAX)
+    {
+        // Longer than any write we accept: drop it, the gap resyncs
+        stats.crc_errors++;
+        rx_len = 0;
+        return;
+    }
+    if (rx_len < len) return;
+    rx_len = 0;
+
+    if (rx[0] != MODBUS_ADDRESS && rx[0] != 0) return;
+    if (modbus_crc(0xFFFF, rx, len - 2) != (uint16_t)(rx[len - 2] | (rx[len - 1] << 8)))
+    {
+        stats.crc_errors++;
+        return;
+    }
+    stats.requests++;
+    request_end = now;
+    modbus_request();
+}
+
+void modbus_poll(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (rx_len && HAL_GetTick() - rx_last > MODBUS_GAP_MS)
+    {
+        stats.crc_errors++;
+        rx_len = 0;
+    }
+    if (reply_pending && modbus_start()) reply_pending = 0;
+    __set_PRIMASK(primask);
+}
+
+uint8_t modbus_receiving(void)
+{
+    return rx_len != 0;
+}
+
+uint8_t modbus_take_config(Config_Record *out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t ok = cfg_written;
+    if (ok) *out = pending_cfg;
+    cfg_written = 0;
+    __set_PRIMASK(primask);
+    return ok;
+}
+
+#endif // MODBUS
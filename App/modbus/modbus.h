@@ -0,0 +1,109 @@
+/**
+ * @file modbus.h
+ * @brief Modbus-RTU style register responder on the telemetry link
+ *
+ * With MODBUS at 1 the LPUART stops streaming frames and answers polls
+ * instead. Requests are parsed byte by byte in the LPUART interrupt and
+ * the reply starts from there too, while the main loop sleeps: its DMA
+ * chain points straight at the structs behind the registers, so only the
+ * 3-byte header and the CRC are built per request. If the bus DMA channel
+ * is busy the reply waits for the next telemetry_poll().
+ *
+ * Function codes:
+ * - 0x03 read holding registers: the runtime configuration (config.h)
+ * - 0x04 read input registers: the blocks registered with modbus_init(),
+ *   then the responder statistics (Modbus_Stats) at MODBUS_STATS_BASE
+ * - 0x06 / 0x10 write single / multiple holding registers: patch the
+ *   configuration, which the main loop then stores and applies
+ *
+ * Register N of a block is bytes 2N and 2N + 1 of its struct, sent in
+ * memory order: the words are little endian, and int32 fields take two
+ * registers, low word first. Set the master to swapped bytes. A read or
+ * write has to stay inside one block; anything else gets exception 0x02.
+ * Frame CRCs are CRC-16/MODBUS as usual. As with the dumps, a struct that
+ * changes while its reply is on the wire shows as a CRC error and the
+ * master asks again.
+ */
+
+#ifndef MODBUS_H
+#define MODBUS_H
+
+#include "config.h"
+
+// 1: the telemetry link speaks Modbus instead of frames and commands
+#ifndef MODBUS
+#define MODBUS 0
+#endif
+
+// Slave address; 0 (broadcast) is accepted for writes, without a reply
+#ifndef MODBUS_ADDRESS
+#define MODBUS_ADDRESS      1
+#endif
+
+// Largest request: a write of the whole configuration, with room to spare
+#define MODBUS_RX_MAX       (9 + CONFIG_RECORD_BYTES + 4)
+
+// A pause this long inside a request drops it, as the 3.5-character
+// RTU gap would
+#define MODBUS_GAP_MS       4
+
+#define MODBUS_STATS_BASE   0xF000
+
+/** One block of input registers */
+typedef struct {
+    uint16_t base;                  // First register number
+    uint16_t regs;                  // Registers, half the struct size
+    const void *(*data)(void);      // Struct behind them
+} Modbus_Block;
+
+/** Responder statistics, input registers at MODBUS_STATS_BASE */
+typedef struct {
+    uint16_t requests;      // Frames addressed to us
+    uint16_t crc_errors;    // Frames dropped for a bad CRC or a gap
+    uint16_t exceptions;    // Exception replies sent
+    uint16_t deferred;      // Replies that had to wait for the DMA channel
+    uint16_t latency_ms;    // Last request end to reply start, ms
+    uint16_t latency_max_ms;
+} Modbus_Stats;
+
+#if MODBUS
+/**
+ * @brief Set the input register map.
+ *
+ * @param blocks Blocks in any order, not overlapping; kept by reference
+ * @param count Number of blocks
+ */
+void modbus_init(const Modbus_Block *blocks, uint8_t count);
+
+/**
+ * @brief Feed one received byte; called from the LPUART interrupt.
+ */
+void modbus_rx(uint8_t c);
+
+/**
+ * @brief Start a reply that found the DMA channel busy, and drop a request
+ *        that stopped half way.
+ */
+void modbus_poll(void);
+
+/**
+ * @brief Check whether a request is coming in.
+ *
+ * The inter-byte gap is timed with HAL_GetTick(). On the SysTick
+ * timebase (TICK_LPTIM=0) that stops in STOP mode, so telemetry_busy()
+ * holds the scheduler out of STOP while this returns 1. The LPTIM1
+ * timebase keeps counting in STOP, and the LSE-clocked LPUART wakes the
+ * core for each byte.
+ */
+uint8_t modbus_receiving(void);
+
+/**
+ * @brief Take a configuration written with 0x06 or 0x10.
+ *
+ * @param out Destination
+ * @return 1 if a new configuration was waiting
+ */
+uint8_t modbus_take_config(Config_Record *out);
+#endif
+
+#endif // MODBUS_H
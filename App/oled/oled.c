@@ -1,111 +1,688 @@
 #include "oled.h"
 #include "font.h"
+#include "i2c_bus.h"
+#include "oled_spi.h"
 
-#define SSD1306_I2C_ADDR (0x3C << 1)
 #define SSD1306_CMD      0x00
 #define SSD1306_DATA     0x40
 
-#define OLED_WIDTH       128
-#define OLED_HEIGHT      64
-#define OLED_PAGES       (OLED_HEIGHT / 8)
+#define OLED_READY_TIMEOUT_MS 100
 
-extern I2C_HandleTypeDef hi2c1;
+// Panel column x in controller GRAM, for the 0x21 column window
+#define OLED_COL(x)      ((x) + OLED_COL_OFFSET)
 
+#if !OLED_DIRECT
 static uint8_t buffer[OLED_WIDTH * OLED_PAGES];
 
-static void oled_send_cmd(uint8_t cmd) {
-    uint8_t data[2] = { SSD1306_CMD, cmd };
-    HAL_I2C_Master_Transmit(&hi2c1, SSD1306_I2C_ADDR, data, 2, HAL_MAX_DELAY);
+// Per-page column span [dirty_lo, dirty_hi] that differs from panel GRAM.
+// A page is clean when dirty_lo > dirty_hi.
+static uint8_t dirty_lo[OLED_PAGES];
+static uint8_t dirty_hi[OLED_PAGES];
+
+// Bit n set: GRAM page n is known to be all zero on the panel, so zero
+// bytes in a dirty span of that page need not be sent.
+static uint8_t panel_blank;
+
+// Zero runs at least this long in a blank page start a new region; shorter
+// ones are cheaper to send than the address and window bytes (10) it costs.
+#define OLED_ZERO_GAP    10
+
+// A dirty region: columns lo..hi of pages first..last. Horizontal regions
+// are contiguous in buffer[] (one page, or full-width pages); vertical ones
+// cover narrow multi-page cells such as scaled digits and go out column by
+// column, so the whole cell is one window and one burst.
+typedef struct {
+    uint8_t first, last;
+    uint8_t lo, hi;
+    uint8_t vertical;
+    uint8_t col, page;      // Next byte of a vertical region
+    uint16_t pos;           // Next byte of a horizontal region
+} oled_region;
+
+// GRAM addressing mode on the panel: 0x00 horizontal, 0x01 vertical, 0xFF
+// unknown. Single-page windows behave the same in both modes, so the mode is
+// only switched for multi-page regions that need the other one.
+static uint8_t gram_mode;
+
+// Asynchronous flush state, advanced from the bus completion callbacks.
+// Region data goes out through two small banks instead of DMA straight from
+// buffer[], so drawing can go on while a flush is in flight: one bank is on
+// the bus while the other is filled and queued behind it.
+static volatile uint8_t async_busy;
+static uint8_t async_page;
+static uint8_t async_failed;
+static uint8_t async_cmd[8];
+static oled_region async_region;
+static uint8_t bank[2][OLED_CHUNK];
+static uint8_t async_bank;          // Next bank to fill
+static uint8_t async_inflight;      // Banks queued on the bus
+static uint16_t async_left;         // Region bytes not yet copied to a bank
+#endif
+
+// SSD1306 power-up configuration, sent as one command stream
+static const uint8_t init_cmds[] = {
+    0xAE,       // Display off
+    0x20, 0x00, // Horizontal addressing mode
+    0xB0,       // Page start
+    0xC8,
+    0x00,
+    0x10,
+    0x40,
+    0x81, OLED_CONTRAST,
+    0xA1,
+    0xA6,
+    0xA8, OLED_HEIGHT - 1,          // Multiplex ratio
+    0xA4,
+    0xD3, 0x00,
+    0xD5, 0x80,
+    0xD9, 0xF1,
+    0xDA, OLED_COM_PINS,
+    0xDB, 0x40,
+    0x8D, 0x14,
+    0xAF        // Display on
+};
+
+// Transport: the control byte goes out after the I2C address, or sets D/C on SPI
+#if OLED_SPI
+#define oled_bus_write(ctrl, buf, len)  oled_spi_write(ctrl, buf, len)
+#define oled_bus_submit(xfer)           oled_spi_submit(xfer)
+#else
+#define oled_bus_write(ctrl, buf, len)  i2c_bus_mem_write(SSD1306_I2C_ADDR, ctrl, buf, len)
+#define oled_bus_submit(xfer)           i2c_bus_submit(xfer)
+#endif
+
+void oled_send_cmds(const uint8_t *cmds, uint8_t len) {
+    oled_bus_write(SSD1306_CMD, (uint8_t *)cmds, len);
 }
 
 static void oled_send_data(uint8_t *data, uint16_t size) {
-    HAL_I2C_Mem_Write(&hi2c1, SSD1306_I2C_ADDR, SSD1306_DATA, I2C_MEMADD_SIZE_8BIT, data, size, HAL_MAX_DELAY);
+    oled_bus_write(SSD1306_DATA, data, size);
 }
 
+#if !OLED_DIRECT
+static void oled_mark_dirty(uint8_t page, uint8_t col) {
+    if (col < dirty_lo[page]) dirty_lo[page] = col;
+    if (col > dirty_hi[page]) dirty_hi[page] = col;
+}
+
+// Mark columns lo..hi of a page dirty after buffer[] was written there.
+// The flush takes regions from interrupt context, hence the critical section.
+static void oled_touch(uint8_t page, uint8_t lo, uint8_t hi) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    oled_mark_dirty(page, lo);
+    oled_mark_dirty(page, hi);
+    // A taken region is copied out chunk by chunk, so GRAM may receive the
+    // new bytes while the page is still flagged blank from older contents
+    if (async_busy) panel_blank &= ~(1 << page);
+    __set_PRIMASK(primask);
+}
+
+static void oled_write(uint16_t index, uint8_t value) {
+    if (buffer[index] == value) return;
+    buffer[index] = value;
+    uint8_t col = index % OLED_WIDTH;
+    oled_touch(index / OLED_WIDTH, col, col);
+}
+
+void oled_invalidate(void) {
+    for (uint8_t page = 0; page < OLED_PAGES; page++) {
+        dirty_lo[page] = 0;
+        dirty_hi[page] = OLED_WIDTH - 1;
+    }
+    panel_blank = 0;
+}
+#else
+void oled_invalidate(void) {
+    // Nothing is kept to repaint from in direct mode
+}
+#endif
+
+#if !OLED_SPI
+// The controller ACKs its address once it is out of reset; poll for that
+// instead of waiting a fixed 100 ms.
+static void oled_wait_ready(void) {
+    uint32_t start = HAL_GetTick();
+    while (i2c_bus_probe(SSD1306_I2C_ADDR) != HAL_OK &&
+           HAL_GetTick() - start < OLED_READY_TIMEOUT_MS);
+}
+#endif
+
+#if OLED_ORBIT_ROWS && OLED_PAGES < 8
+static void oled_clear_spare(void);
+#endif
+
 void oled_init(void) {
-    HAL_Delay(100);
-    oled_send_cmd(0xAE); // Display off
-    oled_send_cmd(0x20); oled_send_cmd(0x00); // Horizontal addressing mode
-    oled_send_cmd(0xB0); // Page start
-    oled_send_cmd(0xC8);
-    oled_send_cmd(0x00);
-    oled_send_cmd(0x10);
-    oled_send_cmd(0x40);
-    oled_send_cmd(0x81); oled_send_cmd(0x7F);
-    oled_send_cmd(0xA1);
-    oled_send_cmd(0xA6);
-    oled_send_cmd(0xA8); oled_send_cmd(0x3F);
-    oled_send_cmd(0xA4);
-    oled_send_cmd(0xD3); oled_send_cmd(0x00);
-    oled_send_cmd(0xD5); oled_send_cmd(0x80);
-    oled_send_cmd(0xD9); oled_send_cmd(0xF1);
-    oled_send_cmd(0xDA); oled_send_cmd(0x12);
-    oled_send_cmd(0xDB); oled_send_cmd(0x40);
-    oled_send_cmd(0x8D); oled_send_cmd(0x14);
-    oled_send_cmd(0xAF); // Display on
+#if OLED_SPI
+    oled_spi_init(1);
+#else
+    oled_wait_ready();
+#endif
+    oled_send_cmds(init_cmds, sizeof(init_cmds));
 
+    // No flush of its own: the whole frame is left dirty and the first
+    // flush clears what it does not draw over
     oled_clear();
-    oled_display();
+    oled_invalidate();
+#if OLED_ORBIT_ROWS && OLED_PAGES < 8
+    oled_clear_spare();
+#endif
 }
 
+// Only what oled_sleep(), oled_set_contrast() and the burn-in orbit may
+// have changed
+static const uint8_t resume_cmds[] = {
+    0x8D, 0x14,             // Charge pump on
+    0x81, OLED_CONTRAST,
+    0xD3, 0x00,             // Display offset
+    0xAF                    // Display on
+};
+
+void oled_resume(void) {
+#if OLED_SPI
+    oled_spi_init(0);
+#endif
+    oled_send_cmds(resume_cmds, sizeof(resume_cmds));
+#if !OLED_DIRECT
+    // GRAM still shows the last frame, but not what buffer[] now holds; the
+    // first flush overwrites all of it, in whichever mode it was left
+    gram_mode = 0xFF;
+    oled_invalidate();
+#else
+    oled_clear();
+#endif
+}
+
+#if !OLED_DIRECT
 void oled_clear(void) {
     for (uint16_t i = 0; i < sizeof(buffer); i++)
-        buffer[i] = 0x00;
+        oled_write(i, 0x00);
+}
+#else
+// Zeros streamed from flash, one page per transfer
+static const uint8_t zero_page[OLED_WIDTH];
+static const uint8_t full_window[] = { 0x20, 0x00, 0x21, OLED_COL(0), OLED_COL(OLED_WIDTH - 1), 0x22, 0, OLED_PAGES - 1 };
+
+void oled_clear(void) {
+    oled_send_cmds(full_window, sizeof(full_window));
+    for (uint8_t page = 0; page < OLED_PAGES; page++)
+        oled_send_data((uint8_t *)zero_page, sizeof(zero_page));
+}
+#endif
+
+#if OLED_ORBIT_ROWS && OLED_PAGES < 8
+// A panel shorter than 64 rows shows GRAM page 7 above the picture while it
+// is moved down; GRAM is not cleared at reset, so blank that page once
+static void oled_clear_spare(void) {
+    static const uint8_t window[] = {
+        0x20, 0x00, 0x21, OLED_COL(0), OLED_COL(OLED_WIDTH - 1), 0x22, 7, 7
+    };
+    oled_send_cmds(window, sizeof(window));
+#if !OLED_DIRECT
+    oled_send_data(buffer, OLED_WIDTH);     // Page 0, just cleared
+#else
+    oled_send_data((uint8_t *)zero_page, sizeof(zero_page));
+#endif
+}
+#endif
+
+#if !OLED_DIRECT
+// Mark a page clean; the panel now matches buffer[] for the whole page.
+static void oled_page_clean(uint8_t page) {
+    const uint8_t *row = &buffer[OLED_WIDTH * page];
+    uint8_t col = 0;
+
+    dirty_lo[page] = 0xFF;
+    dirty_hi[page] = 0;
+    while (col < OLED_WIDTH && !row[col]) col++;
+    if (col == OLED_WIDTH) panel_blank |= 1 << page;
+    else panel_blank &= ~(1 << page);
+}
+
+// Narrow the dirty span [*lo, *hi] of a blank page to its first nonzero
+// run and mark that part clean. Returns 0 if only zeros were left.
+static uint8_t oled_take_run(uint8_t page, uint8_t *lo, uint8_t *hi) {
+    const uint8_t *row = &buffer[OLED_WIDTH * page];
+    uint8_t start = *lo, end;
+
+    while (start <= *hi && !row[start]) start++;
+    if (start > *hi) {
+        oled_page_clean(page);      // The panel already holds these zeros
+        return 0;
+    }
+
+    end = start;
+    for (uint8_t col = start + 1, zeros = 0; col <= *hi && zeros < OLED_ZERO_GAP; col++) {
+        if (row[col]) {
+            end = col;
+            zeros = 0;
+        } else {
+            zeros++;
+        }
+    }
+
+    if (end < *hi) dirty_lo[page] = end + 1;   // Rest goes in a later region
+    else oled_page_clean(page);
+    *lo = start;
+    *hi = end;
+    return 1;
+}
+
+// Take the next dirty region at or after *page and mark it clean.
+// Consecutive pages dirty across the full width are merged into one
+// horizontal region: horizontal addressing wraps into the next page and the
+// buffer rows are contiguous, so a full repaint is one window and one 1 KiB
+// burst. Narrow spans stacked on consecutive pages are merged into one
+// vertical region when that sends fewer bytes than a region per page.
+// In a blank page only the nonzero runs are taken, one per call.
+// Returns the data length (0 = none).
+static uint16_t oled_take_region(uint8_t *page, oled_region *r) {
+    uint8_t p = *page, lo, hi, last, vertical = 0;
+
+    for (;; p++) {
+        while (p < OLED_PAGES && dirty_lo[p] > dirty_hi[p]) p++;
+        if (p >= OLED_PAGES) {
+            *page = p;
+            return 0;
+        }
+
+        lo = dirty_lo[p];
+        hi = dirty_hi[p];
+        last = p;
+        if (panel_blank & (1 << p)) {
+            if (oled_take_run(p, &lo, &hi)) break;
+            continue;
+        }
+
+        if (lo == 0 && hi == OLED_WIDTH - 1) {
+            while (last + 1 < OLED_PAGES && !(panel_blank & (1 << (last + 1))) &&
+                   dirty_lo[last + 1] == 0 && dirty_hi[last + 1] == OLED_WIDTH - 1)
+                last++;
+        } else {
+            // Cost of a region: its bytes plus about OLED_ZERO_GAP of window
+            // and addressing overhead
+            uint16_t separate = hi - lo + 1 + OLED_ZERO_GAP;
+            while (last + 1 < OLED_PAGES && !(panel_blank & (1 << (last + 1))) &&
+                   dirty_lo[last + 1] <= dirty_hi[last + 1]) {
+                uint8_t next_lo = dirty_lo[last + 1] < lo ? dirty_lo[last + 1] : lo;
+                uint8_t next_hi = dirty_hi[last + 1] > hi ? dirty_hi[last + 1] : hi;
+                uint16_t split = separate + dirty_hi[last + 1] - dirty_lo[last + 1] + 1 + OLED_ZERO_GAP;
+                uint16_t merged = (uint16_t)(next_hi - next_lo + 1) * (last + 2 - p) + OLED_ZERO_GAP;
+                if (merged > split) break;
+                lo = next_lo;
+                hi = next_hi;
+                separate = split;
+                last++;
+            }
+            vertical = last > p;
+        }
+        for (uint8_t i = p; i <= last; i++)
+            oled_page_clean(i);
+        break;
+    }
+
+    r->first = p;
+    r->last = last;
+    r->lo = lo;
+    r->hi = hi;
+    r->vertical = vertical;
+    r->col = lo;
+    r->page = p;
+    r->pos = OLED_WIDTH * p + lo;
+    *page = p;
+    return (uint16_t)(last - p + 1) * (hi - lo + 1);
+}
+
+// Window command for a region, preceded by an addressing mode switch when a
+// multi-page region needs the other mode. Returns the command length.
+static uint8_t oled_region_cmd(const oled_region *r, uint8_t *cmd) {
+    uint8_t n = 0;
+    if (r->last > r->first && gram_mode != r->vertical) {
+        cmd[n++] = 0x20;
+        cmd[n++] = r->vertical;
+        gram_mode = r->vertical;
+    }
+    cmd[n++] = 0x21; cmd[n++] = OLED_COL(r->lo); cmd[n++] = OLED_COL(r->hi);  // Column window
+    cmd[n++] = 0x22; cmd[n++] = r->first; cmd[n++] = r->last;   // Page window
+    return n;
+}
+
+// Copy the next n bytes of a region, in the order GRAM expects them
+static void oled_region_read(oled_region *r, uint8_t *dst, uint16_t n) {
+    if (!r->vertical) {
+        for (uint16_t i = 0; i < n; i++)
+            dst[i] = buffer[r->pos + i];
+        r->pos += n;
+        return;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        dst[i] = buffer[OLED_WIDTH * r->page + r->col];
+        if (++r->page > r->last) {
+            r->page = r->first;
+            r->col++;
+        }
+    }
 }
 
 void oled_display(void) {
+    oled_region r;
+    uint8_t cmd[8];
+    uint8_t page = 0;
+    uint16_t len;
+
+    while ((len = oled_take_region(&page, &r)) != 0) {
+        oled_send_cmds(cmd, oled_region_cmd(&r, cmd));
+        // Row-major data goes straight from buffer[], column-major data is
+        // gathered through a bank; both in chunks, so other clients get the
+        // bus in between
+        while (len) {
+            uint16_t n = len < OLED_CHUNK ? len : OLED_CHUNK;
+            if (!r.vertical) {
+                oled_send_data(&buffer[r.pos], n);
+                r.pos += n;
+            } else {
+                oled_region_read(&r, bank[0], n);
+                oled_send_data(bank[0], n);
+            }
+            len -= n;
+        }
+    }
+}
+
+// Pages that matched the panel when the frame began, and their CRCs
+static uint8_t frame_pages;
+static uint16_t frame_crc[OLED_PAGES];
+
+// CRC-16/CCITT of one buffer page
+static uint16_t oled_page_crc(uint8_t page) {
+    const uint8_t *row = &buffer[OLED_WIDTH * page];
+    uint16_t crc = 0xFFFF;
+    for (uint8_t col = 0; col < OLED_WIDTH; col++) {
+        crc ^= (uint16_t)row[col] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+void oled_frame_begin(void) {
+    frame_pages = 0;
+    if (async_busy) return;     // Pages may be half sent
     for (uint8_t page = 0; page < OLED_PAGES; page++) {
-        oled_send_cmd(0xB0 + page);
-        oled_send_cmd(0x00);
-        oled_send_cmd(0x10);
-        oled_send_data(&buffer[OLED_WIDTH * page], OLED_WIDTH);
+        if (dirty_lo[page] <= dirty_hi[page]) continue;
+        frame_pages |= 1 << page;
+        frame_crc[page] = oled_page_crc(page);
+    }
+}
+
+void oled_frame_end(void) {
+    if (async_busy) return;
+    for (uint8_t page = 0; page < OLED_PAGES; page++)
+        if ((frame_pages & (1 << page)) && oled_page_crc(page) == frame_crc[page])
+            oled_page_clean(page);
+    frame_pages = 0;
+}
+#endif
+
+__weak void oled_flush_cplt_callback(void) {
+}
+
+#if !OLED_DIRECT
+static void oled_async_finish(void) {
+    // Panel content is unknown after an error, repaint everything next time
+    if (async_failed) {
+        oled_invalidate();
+        gram_mode = 0xFF;
+    }
+    async_busy = 0;
+    oled_flush_cplt_callback();
+}
+
+static void oled_async_next_page(void);
+static void oled_async_fill(void);
+
+static void oled_async_window_done(HAL_StatusTypeDef status, void *ctx) {
+    (void)ctx;
+    if (status != HAL_OK) async_failed = 1;
+}
+
+static void oled_async_data_done(HAL_StatusTypeDef status, void *ctx) {
+    (void)ctx;
+    async_inflight--;
+    if (status != HAL_OK) async_failed = 1;
+    if (async_failed) {
+        // Let the chunks already queued drain before finishing
+        if (async_inflight == 0) oled_async_finish();
+        return;
     }
+    if (async_left) oled_async_fill();
+    else if (async_inflight == 0) oled_async_next_page();
+}
+
+// Copy the next chunks of the region into free banks and queue them. A
+// full queue is retried on the next data completion.
+static void oled_async_fill(void) {
+    while (async_left && async_inflight < 2) {
+        uint16_t n = async_left < OLED_CHUNK ? async_left : OLED_CHUNK;
+        uint8_t *dst = bank[async_bank];
+        oled_region saved = async_region;
+        oled_region_read(&async_region, dst, n);
+
+        i2c_bus_xfer data = { SSD1306_I2C_ADDR, SSD1306_DATA, I2C_BUS_WRITE,
+                              dst, n, oled_async_data_done, 0 };
+        if (!oled_bus_submit(&data)) {
+            async_region = saved;
+            break;
+        }
+        async_inflight++;
+        async_bank ^= 1;
+        async_left -= n;
+    }
+    if (async_inflight == 0) {
+        async_failed = 1;
+        oled_async_finish();
+    }
+}
+
+// Queue the window command and the first data chunks for the next dirty
+// region at or after async_page, or finish the frame when there is none left.
+static void oled_async_next_page(void) {
+    uint16_t len = oled_take_region(&async_page, &async_region);
+    if (len == 0) {
+        oled_async_finish();
+        return;
+    }
+
+    uint8_t cmd_len = oled_region_cmd(&async_region, async_cmd);
+    i2c_bus_xfer window = { SSD1306_I2C_ADDR, SSD1306_CMD, I2C_BUS_WRITE,
+                            async_cmd, cmd_len, oled_async_window_done, 0 };
+    if (!oled_bus_submit(&window)) {
+        async_failed = 1;
+        oled_async_finish();
+        return;
+    }
+    // GRAM auto-increments, chunks of one window can be sent separately
+    async_left = len;
+    oled_async_fill();
+}
+
+uint8_t oled_display_async(void) {
+    if (async_busy) return 0;
+    async_busy = 1;
+    async_failed = 0;
+    async_page = 0;
+    async_inflight = 0;
+
+    // The first chunk may complete before the rest is queued
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    oled_async_next_page();
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+uint8_t oled_is_busy(void) {
+    return async_busy;
+}
+#else
+void oled_display(void) {
+    // Glyphs are already on the panel
+}
+
+void oled_frame_begin(void) {
+}
+
+void oled_frame_end(void) {
+}
+
+uint8_t oled_display_async(void) {
+    oled_flush_cplt_callback();
+    return 1;
+}
+
+uint8_t oled_is_busy(void) {
+    return 0;
+}
+#endif
+
+// Font columns for a character, or NULL if the font has no glyph for it.
+// A packed font returns its row in flash; an RLE font (Tools/fontgen.py
+// --rle) is decoded into cols, 5 bytes
+static const uint8_t *oled_glyph(char c, uint8_t *cols) {
+    uint8_t code = (uint8_t)c;
+    if (code == 0xB0) code = '`';   // Latin-1 degree sign
+    if (code < FONT5X8_FIRST || code > FONT5X8_LAST) return 0;
+
+    uint8_t index = font5x8_map[code - FONT5X8_FIRST];
+    if (index == FONT5X8_NONE) return 0;
+#if FONT5X8_RLE
+    // Mask bit i: column i repeats the previous one, else it is stored next
+    const uint8_t *p = &font5x8_rle[font5x8_offset[index]];
+    uint8_t mask = *p++, prev = 0;
+    for (uint8_t i = 0; i < 5; i++, mask >>= 1)
+        cols[i] = prev = (mask & 1) ? prev : *p++;
+    return cols;
+#else
+    (void)cols;
+    return font5x8[index];
+#endif
+}
+
+void oled_blit_glyph(uint8_t x, uint8_t page, char c) {
+    uint8_t cols[5];
+    const uint8_t *glyph = oled_glyph(c, cols);
+    if (!glyph) return;
+
+#if !OLED_DIRECT
+    uint8_t *dst = &buffer[OLED_WIDTH * page + x];
+    uint8_t diff = dst[5];
+    dst[5] = 0x00;
+    for (uint8_t i = 0; i < 5; i++) {
+        diff |= dst[i] ^ glyph[i];
+        dst[i] = glyph[i];
+    }
+    if (diff) oled_touch(page, x, x + OLED_CELL_WIDTH - 1);
+#else
+    // One window per cell, then the glyph and its spacing column
+    uint8_t cmd[6] = { 0x21, OLED_COL(x), OLED_COL(x + OLED_CELL_WIDTH - 1), 0x22, page, page };
+    uint8_t cell[OLED_CELL_WIDTH];
+    for (uint8_t i = 0; i < 5; i++)
+        cell[i] = glyph[i];
+    cell[5] = 0x00;
+    oled_send_cmds(cmd, sizeof(cmd));
+    oled_send_data(cell, sizeof(cell));
+#endif
 }
 
 void oled_putc(uint8_t x, uint8_t y, char c) {
     if (x >= OLED_WIDTH || y >= OLED_PAGES) return;
+    if (x <= OLED_WIDTH - OLED_CELL_WIDTH) {
+        oled_blit_glyph(x, y, c);
+        return;
+    }
 
-    uint8_t index;
-    switch (c) {
-        case ' ': index = 0; break;
-        case '.': index = 1; break;
-        case ',': index = 2; break;
-        case '0': index = 3; break;
-        case '1': index = 4; break;
-        case '2': index = 5; break;
-        case '3': index = 6; break;
-        case '4': index = 7; break;
-        case '5': index = 8; break;
-        case '6': index = 9; break;
-        case '7': index = 10; break;
-        case '8': index = 11; break;
-        case '9': index = 12; break;
-        case '%': index = 13; break;
-        case 'h': index = 14; break;
-        case 'P': index = 15; break;
-        case 'a': index = 16; break;
-        case 'R': index = 17; break;
-        case 'C': index = 18; break;
-        case 'H': index = 19; break;
-        case '\x60':
-        case 0xB0:
-            index = 20; break;
-        default:
-            return;
-    }
-
-    uint16_t buf_index = y * OLED_WIDTH + x;
-    for (uint8_t i = 0; i < 5; i++) {
-        if (buf_index + i < sizeof(buffer))
-            buffer[buf_index + i] = font5x8[index][i];
+    // Cell clipped by the right edge
+    uint8_t cols[5];
+    const uint8_t *glyph = oled_glyph(c, cols);
+    if (!glyph) return;
+#if !OLED_DIRECT
+    for (uint8_t i = 0; x + i < OLED_WIDTH; i++)
+        oled_write(y * OLED_WIDTH + x + i, glyph[i]);
+#else
+    uint8_t cmd[6] = { 0x21, OLED_COL(x), OLED_COL(OLED_WIDTH - 1), 0x22, y, y };
+    oled_send_cmds(cmd, sizeof(cmd));
+    oled_send_data((uint8_t *)glyph, OLED_WIDTH - x);
+#endif
+}
+
+// Spread the 8 rows of a glyph column over 8 * scale rows
+static uint32_t oled_scale_column(uint8_t col, uint8_t scale) {
+    uint32_t out = 0, unit = (1U << scale) - 1;
+    for (uint8_t bit = 0; bit < 8; bit++)
+        if (col & (1 << bit)) out |= unit << (bit * scale);
+    return out;
+}
+
+void oled_putc_scaled(uint8_t x, uint8_t page, char c, uint8_t scale) {
+    if (scale <= 1) {
+        oled_putc(x, page, c);
+        return;
     }
-    if (buf_index + 5 < sizeof(buffer))
-        buffer[buf_index + 5] = 0x00;
+    if (scale > OLED_MAX_SCALE || x + OLED_CELL_WIDTH * scale > OLED_WIDTH ||
+        page + scale > OLED_PAGES) return;
+
+    uint8_t cols[5];
+    const uint8_t *glyph = oled_glyph(c, cols);
+    if (!glyph) return;
+
+#if !OLED_DIRECT
+    for (uint8_t i = 0; i < OLED_CELL_WIDTH; i++) {
+        uint32_t bits = i < 5 ? oled_scale_column(glyph[i], scale) : 0;
+        uint16_t index = OLED_WIDTH * page + x + i * scale;
+        for (uint8_t k = 0; k < scale; k++, bits >>= 8, index += OLED_WIDTH)
+            for (uint8_t r = 0; r < scale; r++)
+                oled_write(index + r, (uint8_t)bits);
+    }
+#else
+    // One vertical window over the whole cell, sent column by column in a
+    // single burst; oled_clear() and single-page windows do not care about
+    // the addressing mode
+    uint8_t w = OLED_CELL_WIDTH * scale;
+    uint8_t cmd[8] = { 0x20, 0x01, 0x21, OLED_COL(x), OLED_COL(x + w - 1), 0x22, page, page + scale - 1 };
+    uint8_t cell[OLED_CELL_WIDTH * OLED_MAX_SCALE * OLED_MAX_SCALE];
+    uint8_t n = 0;
+    oled_send_cmds(cmd, sizeof(cmd));
+    for (uint8_t i = 0; i < OLED_CELL_WIDTH; i++) {
+        uint32_t bits = i < 5 ? oled_scale_column(glyph[i], scale) : 0;
+        for (uint8_t r = 0; r < scale; r++)
+            for (uint8_t k = 0; k < scale; k++)
+                cell[n++] = (uint8_t)(bits >> (8 * k));
+    }
+    oled_send_data(cell, n);
+#endif
+}
+
+void oled_put_column(uint8_t x, uint8_t page, const uint8_t *bytes, uint8_t pages) {
+    if (x >= OLED_WIDTH || page >= OLED_PAGES) return;
+    if (pages > OLED_PAGES - page) pages = OLED_PAGES - page;
+    if (!pages) return;
+
+#if !OLED_DIRECT
+    uint16_t index = OLED_WIDTH * page + x;
+    for (uint8_t k = 0; k < pages; k++, index += OLED_WIDTH)
+        oled_write(index, bytes[k]);
+#else
+    // A one-column window fills top to bottom in either addressing mode
+    uint8_t cmd[6] = { 0x21, OLED_COL(x), OLED_COL(x), 0x22, page, page + pages - 1 };
+    oled_send_cmds(cmd, sizeof(cmd));
+    oled_send_data((uint8_t *)bytes, pages);
+#endif
 }
 
 void oled_print(uint8_t x, uint8_t y, const char *str) {
-    while (*str && x < (OLED_WIDTH - 6)) {
-        oled_putc(x, y, *str++);
-        x += 6;
+    if (y >= OLED_PAGES) return;
+    while (*str && x <= OLED_WIDTH - OLED_CELL_WIDTH) {
+        oled_blit_glyph(x, y, *str++);
+        x += OLED_CELL_WIDTH;
     }
 }
@@ -2,11 +2,121 @@
 #define OLED_H
 
 #include "stm32l0xx_hal.h"
+#include "ramfunc.h"
 
+// Panel variant, fixed at build time (e.g. -DOLED_HEIGHT=32 for a 128x32
+// module, -DOLED_WIDTH=72 -DOLED_HEIGHT=40 for a 0.42" 72x40 one,
+// -DSSD1306_I2C_ADDR="(0x3D << 1)" with SA0 high). Everything below is
+// derived from these as constants, so a variant costs nothing at runtime
+// and a smaller panel gets a smaller frame buffer and shorter flushes.
+#ifndef OLED_WIDTH
+#define OLED_WIDTH       128
+#endif
+#ifndef OLED_HEIGHT
+#define OLED_HEIGHT      64
+#endif
+#ifndef SSD1306_I2C_ADDR
+#define SSD1306_I2C_ADDR (0x3C << 1)
+#endif
+#define OLED_PAGES       (OLED_HEIGHT / 8)
+
+// First controller column wired to the panel: narrow modules sit in the
+// middle of the 128 SSD1306 columns (28 on 72x40, 32 on 64x48)
+#ifndef OLED_COL_OFFSET
+#define OLED_COL_OFFSET  ((128 - OLED_WIDTH) / 2)
+#endif
+// COM pin configuration (0xDA): sequential on 128x32 modules, alternative
+// on the others
+#ifndef OLED_COM_PINS
+#define OLED_COM_PINS    (OLED_WIDTH == 128 && OLED_HEIGHT == 32 ? 0x02 : 0x12)
+#endif
+
+// Burn-in orbit (oled_power.h): the picture moves down by up to this many
+// pixel rows with the display offset. At the largest offset the bottom
+// rows of the layout leave the panel and blank rows (or, on 64-row panels,
+// those bottom rows) show at the top; 1 only costs the spacing row under
+// the last line of text. 0 keeps the picture still.
+#ifndef OLED_ORBIT_ROWS
+#define OLED_ORBIT_ROWS  1
+#endif
+
+// The SSD1306 drives up to 128 columns and 64 rows, in whole pages
+typedef char oled_width_check[OLED_WIDTH + OLED_COL_OFFSET <= 128 ? 1 : -1];
+typedef char oled_height_check[OLED_HEIGHT % 8 == 0 && OLED_HEIGHT >= 16 && OLED_HEIGHT <= 64 ? 1 : -1];
+#define OLED_CELL_WIDTH  6      // 5x8 glyph plus one spacing column
+#define OLED_MAX_SCALE   4      // Largest oled_putc_scaled() factor
+#define OLED_CONTRAST    0x7F   // Contrast set by oled_init()
+
+// 1: no framebuffer, oled_putc() writes each glyph cell straight to panel
+// GRAM (text-only layouts, frees 1 KiB of RAM). oled_display*() are then
+// no-ops and oled_invalidate() has nothing to repaint.
+#ifndef OLED_DIRECT
+#define OLED_DIRECT 0
+#endif
+
+// 1: the panel is a 4-wire SPI module on SPI1 with DMA (oled_spi.h) instead
+// of an I2C one; the API below is the same for both.
+#ifndef OLED_SPI
+#define OLED_SPI 0
+#endif
+
+// Largest data transfer of a flush, in bytes. The bus serves a waiting
+// higher-priority client (i2c_bus_set_priority()) between two transfers, so
+// this bounds the time a sensor read waits behind a frame push: with 32,
+// 34 bytes on the wire or 0.8 ms at 400 kHz. Each transfer adds the address and
+// control bytes, and the asynchronous flush holds two of these in RAM.
+#ifndef OLED_CHUNK
+#define OLED_CHUNK       32
+#endif
+
+// Configures the panel and clears the frame buffer, leaving all of it
+// dirty; what the first flush does not draw over is blanked then, so that
+// flush is the only full-frame transfer at start-up. Direct mode clears the
+// panel right away.
 void oled_init(void);
+// Warm-boot alternative to oled_init() for a panel that stayed powered and
+// configured over an MCU reset: no init sequence and no clear. The panel is
+// switched on at OLED_CONTRAST and the whole frame is flagged dirty, so the
+// old picture stays up until the first flush replaces it, without a blank
+// frame in between. Direct mode has no frame to flag and clears instead.
+void oled_resume(void);
 void oled_clear(void);
 void oled_putc(uint8_t x, uint8_t y, char c);
+// Fast path for a cell known to be on screen: x <= OLED_WIDTH - OLED_CELL_WIDTH,
+// page < OLED_PAGES. Characters missing from the font draw nothing.
+RAMFUNC_RENDER_FN void oled_blit_glyph(uint8_t x, uint8_t page, char c);
+// Draw the 5x8 glyph magnified scale times: a cell of OLED_CELL_WIDTH * scale
+// columns by scale pages with its top-left at (x, page). Goes through the
+// dirty tracker byte by byte, so redrawing an unchanged digit costs nothing.
+// Cells that do not fit on screen are not drawn.
+void oled_putc_scaled(uint8_t x, uint8_t page, char c, uint8_t scale);
+// Write one column of `pages` bytes from the top of page `page` down, LSB
+// topmost. Meant for charts that change a column at a time; pages past the
+// bottom of the panel are dropped.
+void oled_put_column(uint8_t x, uint8_t page, const uint8_t *bytes, uint8_t pages);
 void oled_print(uint8_t x, uint8_t y, const char *str);
 void oled_display(void);
+void oled_invalidate(void);
+
+// Send a stream of SSD1306 command bytes in a single I2C transaction
+void oled_send_cmds(const uint8_t *cmds, uint8_t len);
+
+// Non-blocking flush of the dirty regions through I2C1 TX DMA.
+// Returns 0 if a previous flush is still in flight. Data is staged through
+// two 64-byte banks (128 B of RAM next to the 1 KiB frame buffer), so
+// drawing may continue during the flush; whatever changes behind it is
+// picked up by the next one. oled_flush_cplt_callback() is called from
+// interrupt context when the frame is out.
+uint8_t oled_display_async(void);
+uint8_t oled_is_busy(void);
+void oled_flush_cplt_callback(void);
+
+// Bracket a redraw of the whole screen (oled_clear() and drawing a new
+// layout). Pages that were flushed before oled_frame_begin() and end up
+// with the same content are flagged clean again by oled_frame_end(), so
+// the next flush sends only the pages that actually differ. Compares a
+// CRC-16 per page; no-ops in direct mode.
+void oled_frame_begin(void);
+void oled_frame_end(void);
 
 #endif
@@ -0,0 +1,124 @@
+#include "oled_power.h"
+
+static uint8_t awake = 1;           // oled_init() leaves the panel on
+static uint8_t contrast = OLED_CONTRAST;
+static uint8_t target = OLED_CONTRAST;
+static uint8_t limit = OLED_CONTRAST;
+static uint16_t idle_ticks;
+static uint16_t dim_after = OLED_POWER_DIM_TICKS;
+static uint16_t off_after = OLED_POWER_OFF_TICKS;
+#if OLED_ORBIT_TICKS && OLED_ORBIT_ROWS
+static uint16_t orbit_ticks;
+static uint8_t orbit_phase;         // 0 .. 2 * OLED_ORBIT_ROWS - 1
+#endif
+static uint8_t orbit_rows;          // Current downward shift
+
+static const uint8_t sleep_cmds[] = {
+    0xAE,       // Display off
+    0x8D, 0x10  // Charge pump off
+};
+
+static const uint8_t wake_cmds[] = {
+    0x8D, 0x14, // Charge pump on
+    0xAF        // Display on
+};
+
+void oled_sleep(void) {
+    if (!awake) return;
+    oled_send_cmds(sleep_cmds, sizeof(sleep_cmds));
+    awake = 0;
+}
+
+void oled_wake(void) {
+    if (awake) return;
+    oled_send_cmds(wake_cmds, sizeof(wake_cmds));
+    awake = 1;
+}
+
+uint8_t oled_is_awake(void) {
+    return awake;
+}
+
+void oled_set_contrast(uint8_t value) {
+    uint8_t cmd[2] = { 0x81, value };
+    oled_send_cmds(cmd, sizeof(cmd));
+    contrast = value;
+    target = value;
+}
+
+void oled_power_activity(void) {
+    if (limit == 0) return;
+    idle_ticks = 0;
+    target = limit;
+    if (!awake) {
+        // Come back dim and let the ramp bring it up
+        contrast = OLED_POWER_CONTRAST_DIM < limit ? OLED_POWER_CONTRAST_DIM : limit;
+        uint8_t cmd[2] = { 0x81, contrast };
+        oled_send_cmds(cmd, sizeof(cmd));
+        oled_wake();
+    }
+}
+
+#if OLED_ORBIT_TICKS && OLED_ORBIT_ROWS
+// Down one row at a time to OLED_ORBIT_ROWS, then back up to 0
+static void oled_orbit_step(void) {
+    if (++orbit_phase == 2 * OLED_ORBIT_ROWS) orbit_phase = 0;
+    orbit_rows = orbit_phase <= OLED_ORBIT_ROWS ? orbit_phase : 2 * OLED_ORBIT_ROWS - orbit_phase;
+
+    // COM0 shows GRAM row -rows: the picture moves down, GRAM stays put
+    uint8_t cmd[2] = { 0xD3, (uint8_t)(64 - orbit_rows) & 0x3F };
+    oled_send_cmds(cmd, sizeof(cmd));
+}
+#endif
+
+void oled_power_tick(void) {
+    if (idle_ticks < off_after && ++idle_ticks == dim_after)
+        target = OLED_POWER_CONTRAST_DIM;
+    if (target > limit)
+        target = limit;
+
+    if (awake && contrast != target) {
+        uint8_t next;
+        if (contrast < target)
+            next = target - contrast > OLED_POWER_RAMP_STEP ? contrast + OLED_POWER_RAMP_STEP : target;
+        else
+            next = contrast - target > OLED_POWER_RAMP_STEP ? contrast - OLED_POWER_RAMP_STEP : target;
+        uint8_t cmd[2] = { 0x81, next };
+        oled_send_cmds(cmd, sizeof(cmd));
+        contrast = next;
+    }
+
+    if (idle_ticks >= off_after)
+        oled_sleep();
+
+#if OLED_ORBIT_TICKS && OLED_ORBIT_ROWS
+    // Asleep the panel shows nothing to burn; the count waits with it
+    if (awake && ++orbit_ticks >= OLED_ORBIT_TICKS) {
+        orbit_ticks = 0;
+        oled_orbit_step();
+    }
+#endif
+}
+
+uint8_t oled_orbit_offset(void) {
+    return orbit_rows;
+}
+
+void oled_power_set_limit(uint8_t value) {
+    limit = value;
+    if (limit == 0) {
+        oled_sleep();
+        idle_ticks = off_after;
+    } else if (target > limit || idle_ticks < dim_after) {
+        target = limit;     // Ramp there from the next tick
+    }
+}
+
+void oled_power_set_timeouts(uint16_t dim_ticks, uint16_t off_ticks) {
+    dim_after = dim_ticks;
+    off_after = off_ticks < dim_ticks ? dim_ticks : off_ticks;
+    if (idle_ticks > off_after)
+        idle_ticks = off_after;
+    if (idle_ticks >= dim_after)
+        target = OLED_POWER_CONTRAST_DIM;
+}
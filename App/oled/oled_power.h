@@ -0,0 +1,57 @@
+#ifndef OLED_POWER_H
+#define OLED_POWER_H
+
+#include "oled.h"
+
+// Default policy timing, in oled_power_tick() calls (scheduler ticks)
+#ifndef OLED_POWER_DIM_TICKS
+#define OLED_POWER_DIM_TICKS  30
+#endif
+#ifndef OLED_POWER_OFF_TICKS
+#define OLED_POWER_OFF_TICKS  120
+#endif
+
+// Ticks between burn-in orbit steps (OLED_ORBIT_ROWS in oled.h); 0 stops
+// the orbit
+#ifndef OLED_ORBIT_TICKS
+#define OLED_ORBIT_TICKS      300
+#endif
+
+#define OLED_POWER_CONTRAST_DIM  0x08
+#define OLED_POWER_RAMP_STEP     0x20   // Contrast change per tick
+
+// Panel off (0xAE) and charge pump off: only the controller logic draws
+// current. GRAM is retained, so oled_wake() shows the last frame again
+// without a transfer. Flushes may continue while asleep.
+void oled_sleep(void);
+void oled_wake(void);
+uint8_t oled_is_awake(void);
+
+// Immediate contrast change
+void oled_set_contrast(uint8_t contrast);
+
+// Auto-off policy. Report significant changes with oled_power_activity();
+// without one for the dim time (OLED_POWER_DIM_TICKS) the contrast ramps
+// down to OLED_POWER_CONTRAST_DIM, after the off time
+// (OLED_POWER_OFF_TICKS) the panel sleeps.
+// Activity wakes the panel and ramps back to OLED_CONTRAST.
+void oled_power_activity(void);
+void oled_power_tick(void);
+
+// Burn-in orbit, run from oled_power_tick(): every OLED_ORBIT_TICKS while
+// the panel is awake the picture moves one row, down to OLED_ORBIT_ROWS and
+// back, with the display offset (0xD3). That is two command bytes: GRAM,
+// buffer[] and the dirty tracker keep the unshifted layout, so drawing and
+// partial flushes go on as before. oled_init() and oled_resume() put the
+// offset back to 0.
+uint8_t oled_orbit_offset(void);
+
+// Replace the dim and off times; off is raised to dim if below it. Counts
+// from the last activity, so a shorter time can take effect on the next tick.
+void oled_power_set_timeouts(uint16_t dim_ticks, uint16_t off_ticks);
+
+// Highest contrast the policy ramps to (default OLED_CONTRAST). 0 keeps the
+// panel asleep: it is put to sleep now and activity no longer wakes it.
+void oled_power_set_limit(uint8_t contrast);
+
+#endif
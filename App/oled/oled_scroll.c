@@ -0,0 +1,44 @@
+#include "oled_scroll.h"
+
+static uint8_t scrolling;
+static uint8_t start_line;
+
+void oled_scroll_start(uint8_t first, uint8_t last, uint8_t left, uint8_t interval) {
+    if (first > last || last >= OLED_PAGES) return;
+
+    // Setup is only accepted while scrolling is off
+    uint8_t cmd[] = {
+        0x2E,
+        left ? 0x27 : 0x26,
+        0x00,                   // Dummy
+        first,
+        interval & 0x07,
+        last,
+        0x00, 0xFF,             // Dummy
+        0x2F                    // Activate
+    };
+    oled_send_cmds(cmd, sizeof(cmd));
+    scrolling = 1;
+}
+
+void oled_scroll_stop(void) {
+    static const uint8_t cmd[] = { 0x2E };
+    if (!scrolling) return;
+    oled_send_cmds(cmd, sizeof(cmd));
+    scrolling = 0;
+    oled_invalidate();
+}
+
+uint8_t oled_is_scrolling(void) {
+    return scrolling;
+}
+
+void oled_set_start_line(uint8_t line) {
+    uint8_t cmd[] = { 0x40 | (line % OLED_HEIGHT) };
+    oled_send_cmds(cmd, sizeof(cmd));
+    start_line = cmd[0] & 0x3F;
+}
+
+uint8_t oled_get_start_line(void) {
+    return start_line;
+}
@@ -0,0 +1,32 @@
+#ifndef OLED_SCROLL_H
+#define OLED_SCROLL_H
+
+#include "oled.h"
+
+// Frames between scroll steps (SSD1306 interval codes)
+#define OLED_SCROLL_FRAMES_2    0x07
+#define OLED_SCROLL_FRAMES_3    0x04
+#define OLED_SCROLL_FRAMES_4    0x05
+#define OLED_SCROLL_FRAMES_5    0x00
+#define OLED_SCROLL_FRAMES_25   0x06
+#define OLED_SCROLL_FRAMES_64   0x01
+#define OLED_SCROLL_FRAMES_128  0x02
+#define OLED_SCROLL_FRAMES_256  0x03
+
+// Continuous horizontal scroll of pages first..last, run by the controller
+// itself: the MCU may sleep while the panel animates. The SSD1306 must not
+// be written to the scrolled pages while it runs; keep drawing elsewhere.
+void oled_scroll_start(uint8_t first, uint8_t last, uint8_t left, uint8_t interval);
+// Stop scrolling. The controller leaves GRAM rotated, so the whole panel is
+// invalidated and the next flush rewrites it from the buffer (with
+// OLED_DIRECT the caller has to redraw).
+void oled_scroll_stop(void);
+uint8_t oled_is_scrolling(void);
+
+// Map GRAM row `line` to the top of the panel (0x40-0x7F). View offsets
+// cost one command byte: a vertically rolling view can draw each new row
+// into the GRAM row that just scrolled off instead of resending the frame.
+void oled_set_start_line(uint8_t line);
+uint8_t oled_get_start_line(void);
+
+#endif
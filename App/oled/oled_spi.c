@@ -0,0 +1,134 @@
+#include "oled_spi.h"
+#include "bme280_spi.h"
+
+#if OLED_SPI
+
+// Both transports would own SPI1 without any arbitration between them
+#if BME280_SPI
+#error "OLED_SPI and BME280_SPI both use SPI1"
+#endif
+
+#define OLED_SPI_DATA    0x40   // Control byte of GRAM data, D/C high
+#define OLED_SPI_DMA_REQ 1      // DMA1 channel 3 request for SPI1_TX
+
+static i2c_bus_xfer queue[OLED_SPI_QUEUE_LEN];
+static uint8_t head, count;
+static volatile uint8_t active;
+
+// Smallest SCK divider (2^(BR+1)) that keeps SCK within the panel limit
+static uint32_t oled_spi_br(void) {
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+    uint32_t br = 0;
+    while (br < 7 && (pclk >> (br + 1)) > OLED_SPI_MAX_HZ) br++;
+    return br << SPI_CR1_BR_Pos;
+}
+
+void oled_spi_init(uint8_t reset) {
+    GPIO_InitTypeDef gpio = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_SPI1_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    gpio.Pin = OLED_SPI_SCK_PIN | OLED_SPI_MOSI_PIN;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    gpio.Alternate = GPIO_AF0_SPI1;
+    HAL_GPIO_Init(OLED_SPI_PORT, &gpio);
+
+    HAL_GPIO_WritePin(OLED_SPI_CTRL_PORT, OLED_SPI_CS_PIN | OLED_SPI_RES_PIN, GPIO_PIN_SET);
+    gpio.Pin = OLED_SPI_DC_PIN | OLED_SPI_CS_PIN | OLED_SPI_RES_PIN;
+    gpio.Mode = GPIO_MODE_OUTPUT_PP;
+    gpio.Alternate = 0;
+    HAL_GPIO_Init(OLED_SPI_CTRL_PORT, &gpio);
+
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C3S) |
+                        (OLED_SPI_DMA_REQ << DMA_CSELR_C3S_Pos);
+    DMA1_Channel3->CPAR = (uint32_t)&SPI1->DR;
+
+    if (!reset) return;
+    // RES low for at least 3 us, then the controller takes commands
+    HAL_GPIO_WritePin(OLED_SPI_CTRL_PORT, OLED_SPI_RES_PIN, GPIO_PIN_RESET);
+    HAL_Delay(1);
+    HAL_GPIO_WritePin(OLED_SPI_CTRL_PORT, OLED_SPI_RES_PIN, GPIO_PIN_SET);
+    HAL_Delay(1);
+}
+
+// Start queue[head] if nothing is on the wire. Called with interrupts masked.
+static void oled_spi_start(void) {
+    if (active || !count) return;
+    const i2c_bus_xfer *x = &queue[head];
+
+    // SCK follows PCLK2 across clock profile switches
+    SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | oled_spi_br();
+    SPI1->CR2 = SPI_CR2_TXDMAEN;
+    SPI1->CR1 |= SPI_CR1_SPE;
+    HAL_GPIO_WritePin(OLED_SPI_CTRL_PORT, OLED_SPI_DC_PIN,
+                      x->reg == OLED_SPI_DATA ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(OLED_SPI_CTRL_PORT, OLED_SPI_CS_PIN, GPIO_PIN_RESET);
+
+    DMA1_Channel3->CCR = 0;
+    DMA1_Channel3->CMAR = (uint32_t)x->buf;
+    DMA1_Channel3->CNDTR = x->len;
+    DMA1_Channel3->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_EN;
+    active = 1;
+}
+
+void oled_spi_dma_irq(void) {
+    if (!(DMA1->ISR & DMA_ISR_TCIF3)) return;
+    DMA1->IFCR = DMA_IFCR_CGIF3;
+    DMA1_Channel3->CCR = 0;
+
+    // TC only means the last byte reached DR; let it leave the shifter
+    while (SPI1->SR & SPI_SR_BSY);
+    HAL_GPIO_WritePin(OLED_SPI_CTRL_PORT, OLED_SPI_CS_PIN, GPIO_PIN_SET);
+    SPI1->CR1 &= ~SPI_CR1_SPE;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    i2c_bus_callback cb = queue[head].cb;
+    void *ctx = queue[head].ctx;
+    head = (head + 1) % OLED_SPI_QUEUE_LEN;
+    count--;
+    active = 0;
+    __set_PRIMASK(primask);
+
+    // The callback may queue the next chunk; it lands behind what is queued
+    if (cb) cb(HAL_OK, ctx);
+
+    __disable_irq();
+    oled_spi_start();
+    __set_PRIMASK(primask);
+}
+
+uint8_t oled_spi_submit(const i2c_bus_xfer *xfer) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (count >= OLED_SPI_QUEUE_LEN) {
+        __set_PRIMASK(primask);
+        return 0;
+    }
+    queue[(head + count) % OLED_SPI_QUEUE_LEN] = *xfer;
+    count++;
+    oled_spi_start();
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+static void oled_spi_done(HAL_StatusTypeDef status, void *ctx) {
+    (void)status;
+    *(volatile uint8_t *)ctx = 1;
+}
+
+HAL_StatusTypeDef oled_spi_write(uint8_t control, uint8_t *buf, uint16_t len) {
+    volatile uint8_t done = 0;
+    i2c_bus_xfer x = { 0, control, I2C_BUS_WRITE, buf, len, oled_spi_done, (void *)&done };
+
+    if (len == 0) return HAL_OK;
+    while (!oled_spi_submit(&x)) __WFI();
+    while (!done) __WFI();
+    return HAL_OK;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef OLED_SPI_H
+#define OLED_SPI_H
+
+#include "oled.h"
+#include "i2c_bus.h"
+
+// 4-wire SPI transport for SSD1306 modules sold in the SPI variant:
+// SCK/MOSI on SPI1, chip select, D/C and reset on GPIOs. oled.c keeps
+// building i2c_bus_xfer descriptors; addr and dir are ignored and the
+// control byte (0x00 command, 0x40 data) sets the D/C level instead.
+// Transfers are queued and sent by DMA1 channel 3, completions arrive in
+// interrupt context exactly like those of the I2C bus layer.
+
+// Highest SCK the controller accepts (SSD1306 serial clock cycle 100 ns)
+#ifndef OLED_SPI_MAX_HZ
+#define OLED_SPI_MAX_HZ  10000000U
+#endif
+
+#ifndef OLED_SPI_QUEUE_LEN
+#define OLED_SPI_QUEUE_LEN 4
+#endif
+
+// SPI1 SCK/MOSI (AF0) and the control lines
+#define OLED_SPI_PORT        GPIOB
+#define OLED_SPI_SCK_PIN     GPIO_PIN_3
+#define OLED_SPI_MOSI_PIN    GPIO_PIN_5
+#define OLED_SPI_CTRL_PORT   GPIOA
+#define OLED_SPI_DC_PIN      GPIO_PIN_8
+#define OLED_SPI_CS_PIN      GPIO_PIN_11
+#define OLED_SPI_RES_PIN     GPIO_PIN_12
+
+// Set up SPI1, DMA1 channel 3 and the control pins, then pulse RES unless
+// reset is 0 (warm boot: the controller keeps its configuration)
+void oled_spi_init(uint8_t reset);
+// Queue a transfer; 1 if queued, 0 if the queue is full. Safe from IRQs.
+uint8_t oled_spi_submit(const i2c_bus_xfer *xfer);
+// Queue a transfer and sleep until it is out
+HAL_StatusTypeDef oled_spi_write(uint8_t control, uint8_t *buf, uint16_t len);
+// DMA1 channel 3 transfer complete, called from DMA1_Channel2_3_IRQHandler
+void oled_spi_dma_irq(void);
+
+#endif
@@ -0,0 +1,47 @@
+#include "oled_text.h"
+
+typedef struct {
+    uint8_t x;
+    uint8_t page;
+    uint8_t width;
+    uint8_t scale;
+    char shown[OLED_TEXT_FIELD_LEN];
+} oled_text_field_t;
+
+static oled_text_field_t fields[OLED_TEXT_MAX_FIELDS];
+
+void oled_text_field(uint8_t id, uint8_t x, uint8_t page, uint8_t width) {
+    oled_text_field_scaled(id, x, page, width, 1);
+}
+
+void oled_text_field_scaled(uint8_t id, uint8_t x, uint8_t page, uint8_t width, uint8_t scale) {
+    if (id >= OLED_TEXT_MAX_FIELDS) return;
+    if (width > OLED_TEXT_FIELD_LEN) width = OLED_TEXT_FIELD_LEN;
+
+    oled_text_field_t *f = &fields[id];
+    f->x = x;
+    f->page = page;
+    f->width = width;
+    f->scale = scale;
+    for (uint8_t i = 0; i < OLED_TEXT_FIELD_LEN; i++)
+        f->shown[i] = 0;  // Never equal to a drawable character
+}
+
+void oled_text_update(uint8_t id, const char *str) {
+    if (id >= OLED_TEXT_MAX_FIELDS) return;
+
+    oled_text_field_t *f = &fields[id];
+    uint8_t x = f->x;
+    for (uint8_t i = 0; i < f->width; i++, x += OLED_CELL_WIDTH * f->scale) {
+        char c = *str ? *str++ : ' ';
+        if (f->shown[i] == c) continue;
+        f->shown[i] = c;
+        oled_putc_scaled(x, f->page, c, f->scale);
+    }
+}
+
+void oled_text_reset(void) {
+    for (uint8_t id = 0; id < OLED_TEXT_MAX_FIELDS; id++)
+        for (uint8_t i = 0; i < OLED_TEXT_FIELD_LEN; i++)
+            fields[id].shown[i] = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef OLED_TEXT_H
+#define OLED_TEXT_H
+
+#include "oled.h"
+
+#define OLED_TEXT_MAX_FIELDS 4
+#define OLED_TEXT_FIELD_LEN  12   // Characters per field (6 px each)
+
+// Field-oriented text layer. Each field remembers the string it last drew
+// and only re-renders the character cells that differ, so with the dirty
+// tracker in oled.c the I2C traffic scales with the number of changed glyphs.
+// Strings shorter than the field width are padded with blanks.
+void oled_text_field(uint8_t id, uint8_t x, uint8_t page, uint8_t width);
+// Same, drawn with oled_putc_scaled(); the field covers scale pages from page.
+void oled_text_field_scaled(uint8_t id, uint8_t x, uint8_t page, uint8_t width, uint8_t scale);
+void oled_text_update(uint8_t id, const char *str);
+
+// Forget what the fields show, e.g. after oled_clear(); the next update of
+// every field redraws all its cells.
+void oled_text_reset(void);
+
+#endif
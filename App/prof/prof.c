@@ -0,0 +1,116 @@
+/**
+ * @file prof.c
+ * @brief Cycle-count profiling of hot paths on TIM2 + TIM21
+ */
+
+#include "prof.h"
+
+#if PROF
+
+Prof_Stat prof_table[PROF_PHASES];
+static uint32_t started[PROF_PHASES];
+#if PROF_LATENCY
+static uint8_t probe_level;
+static uint16_t probe_lfsr = 0xACE1;
+#endif
+
+void prof_init(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+    RCC->APB2ENR |= RCC_APB2ENR_TIM21EN;
+
+    // TIM2: free running, update event on every wrap as TRGO
+    TIM2->CR1 = 0;
+    TIM2->PSC = 0;
+    TIM2->ARR = 0xFFFF;
+    TIM2->CR2 = TIM_CR2_MMS_1;
+    // TIM21: external clock mode 1 on ITR0 (TIM2 TRGO), counts the wraps
+    TIM21->CR1 = 0;
+    TIM21->PSC = 0;
+    TIM21->ARR = 0xFFFF;
+    TIM21->SMCR = TIM_SMCR_SMS;         // TS = 000: ITR0
+    TIM21->CNT = 0;
+    TIM2->CNT = 0;
+    TIM21->CR1 = TIM_CR1_CEN;
+    TIM2->CR1 = TIM_CR1_CEN;
+
+    for (uint8_t p = 0; p < PROF_PHASES; p++)
+    {
+        prof_table[p].min = UINT32_MAX;
+        prof_table[p].max = 0;
+        prof_table[p].sum = 0;
+        prof_table[p].count = 0;
+    }
+
+#if PROF_LATENCY
+    // Channel 1 frozen: only the compare flag, no pin
+    TIM2->CCMR1 = 0;
+    TIM2->CCR1 = PROF_LATENCY_MIN;
+    TIM2->SR = 0;
+    TIM2->DIER = TIM_DIER_CC1IE;
+    probe_level = 0;
+    HAL_NVIC_SetPriority(TIM2_IRQn, probe_level, 0);
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+#endif
+}
+
+uint32_t prof_now(void)
+{
+    uint16_t hi = TIM21->CNT;
+    uint16_t lo = TIM2->CNT;
+    uint16_t hi2 = TIM21->CNT;
+
+    // A wrap between the reads: the low half read after it belongs to hi2
+    if (hi != hi2)
+    {
+        lo = TIM2->CNT;
+        hi = hi2;
+    }
+    return ((uint32_t)hi << 16) | lo;
+}
+
+void prof_begin(Prof_Phase p)
+{
+    started[p] = prof_now();
+}
+
+static void prof_fold(Prof_Phase p, uint32_t cycles)
+{
+    Prof_Stat *s = &prof_table[p];
+
+    if (cycles < s->min) s->min = cycles;
+    if (cycles > s->max) s->max = cycles;
+    if (s->sum + cycles < s->sum)
+    {
+        // Keep the average, lose some history
+        s->sum >>= 1;
+        s->count >>= 1;
+    }
+    s->sum += cycles;
+    s->count++;
+}
+
+void prof_end(Prof_Phase p)
+{
+    prof_fold(p, prof_now() - started[p]);
+}
+
+#if PROF_LATENCY
+void prof_latency_irq(void)
+{
+    // First thing: the compare matched that many cycles ago
+    uint16_t late = (uint16_t)(TIM2->CNT - TIM2->CCR1);
+
+    TIM2->SR = (uint32_t)~TIM_SR_CC1IF;
+    prof_fold((Prof_Phase)(PROF_LATENCY_0 + probe_level), late);
+
+    // Galois LFSR for the next gap; the next level takes effect on the
+    // next entry, this one finishes where it is
+    probe_lfsr = (uint16_t)((probe_lfsr >> 1) ^ (-(probe_lfsr & 1U) & 0xB400U));
+    TIM2->CCR1 = (uint16_t)(TIM2->CNT + PROF_LATENCY_MIN + (probe_lfsr & 0x3FFFU));
+    probe_level = (probe_level + 1) & ((1U << __NVIC_PRIO_BITS) - 1);
+    HAL_NVIC_SetPriority(TIM2_IRQn, probe_level, 0);
+}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file prof.h
+ * @brief Cycle-count profiling of hot paths on TIM2 + TIM21
+ *
+ * The Cortex-M0+ has no DWT cycle counter, so TIM2 counts APB1 clocks
+ * (HCLK, the APB dividers are 1) and TIM21 counts TIM2 overflows, which
+ * makes a 32-bit cycle counter. Counts stay in core cycles across the
+ * clock profiles; only STOP mode, where both timers halt, is left out.
+ *
+ * Per-phase statistics live in prof_table[]: read it from the debugger
+ * (Live Expressions) or request it over the telemetry link ('P').
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+#include "stm32l0xx_hal.h"
+
+// 1: markers are compiled in (default in the Debug and Bench configurations)
+#ifndef PROF
+#if defined(DEBUG) || (defined(BENCH) && BENCH)
+#define PROF 1
+#else
+#define PROF 0
+#endif
+#endif
+
+/**
+ * 1: a TIM2 compare interrupt probes the entry latency of the four NVIC
+ * levels in turn (plan in main.h). It fires at pseudo-random points
+ * PROF_LATENCY_MIN..+16383 cycles apart, so it lands inside masked
+ * sections and other handlers as often as a real source would, and reads
+ * how long it waited past its compare: hardware entry and the first load
+ * included. Needs PROF. The probe itself runs some 60 cycles on each
+ * level, which the other sources of that level see on top; waits past
+ * 65535 cycles alias, a bound of 2 ms at 32 MHz
+ */
+#ifndef PROF_LATENCY
+#define PROF_LATENCY 0
+#endif
+#define PROF_LATENCY_MIN 2000U
+
+#if PROF_LATENCY && !PROF
+#error "PROF_LATENCY keeps its figures in the PROF table"
+#endif
+
+typedef enum {
+    PROF_SENSOR_READ = 0,   // BME280_read()
+    PROF_PRINT_VALUES,      // print_sensor_values()
+    PROF_DISPLAY,           // oled_display_async(), up to the first DMA start
+#if PROF_LATENCY
+    PROF_LATENCY_0,         // Entry latency at level 0 .. 3
+    PROF_LATENCY_1,
+    PROF_LATENCY_2,
+    PROF_LATENCY_3,
+#endif
+    PROF_PHASES
+} Prof_Phase;
+
+/** Statistics of one phase, in core cycles */
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;           // Halved together with count before it overflows
+    uint32_t count;
+} Prof_Stat;
+
+#if PROF
+extern Prof_Stat prof_table[PROF_PHASES];
+
+/**
+ * @brief Start the counter and clear the table.
+ */
+void prof_init(void);
+
+/**
+ * @brief Current 32-bit cycle count.
+ */
+uint32_t prof_now(void);
+
+/**
+ * @brief Mark the start of a phase.
+ */
+void prof_begin(Prof_Phase p);
+
+/**
+ * @brief Mark the end of a phase and fold its length into the table.
+ */
+void prof_end(Prof_Phase p);
+
+#if PROF_LATENCY
+/**
+ * @brief Take the probe's compare event; called from TIM2_IRQHandler.
+ */
+void prof_latency_irq(void);
+#endif
+
+#define PROF_INIT()     prof_init()
+#define PROF_BEGIN(p)   prof_begin(p)
+#define PROF_END(p)     prof_end(p)
+#else
+#define PROF_INIT()     ((void)0)
+#define PROF_BEGIN(p)   ((void)0)
+#define PROF_END(p)     ((void)0)
+#endif
+
+#endif // PROF_H
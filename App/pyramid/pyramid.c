@@ -0,0 +1,181 @@
+/**
+ * @file pyramid.c
+ * @brief Quarter-hour and hourly aggregates on top of the history samples
+ *
+ * The open quarter is a running sum and running extremes per channel.
+ * The quarter ring holds exactly one hour, so the hour bucket is merged
+ * from the ring when its last quarter closes and no second set of sums is
+ * needed. Bucket extremes are stored as 8-bit distances from the mean,
+ * which takes 4 bytes per channel instead of 6 for three int16 values.
+ */
+
+#include "pyramid.h"
+#include "logger.h"
+
+static int32_t sum[HISTORY_CHANNELS];
+static int16_t lo[HISTORY_CHANNELS];
+static int16_t hi[HISTORY_CHANNELS];
+static uint8_t samples;         // In the open quarter
+
+static Pyramid_Bucket quarters[PYRAMID_HOUR_QUARTERS];
+static uint8_t quarter_head;    // Slot the next quarter goes to
+static uint8_t quarter_count;   // Closed quarters in the ring
+static uint8_t hour_quarters;   // Closed quarters of the open hour
+
+static uint8_t pyramid_span_width(int32_t d)
+{
+    return d > 255 ? 255 : (uint8_t)d;
+}
+
+static void pyramid_span(Pyramid_Span *s, int16_t mean, int16_t min, int16_t max)
+{
+    s->mean = mean;
+    s->below = pyramid_span_width((int32_t)mean - min);
+    s->above = pyramid_span_width((int32_t)max - mean);
+}
+
+int16_t pyramid_min(const Pyramid_Span *s)
+{
+    return s->mean - s->below;
+}
+
+int16_t pyramid_max(const Pyramid_Span *s)
+{
+    return s->mean + s->above;
+}
+
+void pyramid_init(void)
+{
+    samples = 0;
+    quarter_head = 0;
+    quarter_count = 0;
+    hour_quarters = 0;
+}
+
+// Closed quarter by age, 0 for the oldest in the ring
+static const Pyramid_Bucket *pyramid_quarter(uint8_t index)
+{
+    uint8_t slot = quarter_head + PYRAMID_HOUR_QUARTERS - quarter_count + index;
+    return &quarters[slot % PYRAMID_HOUR_QUARTERS];
+}
+
+// Merge the quarters of the closed hour
+static void pyramid_close_hour(void)
+{
+    Pyramid_Bucket b;
+    uint8_t first = quarter_count - hour_quarters;
+
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+        int32_t s = 0;
+        int16_t min = INT16_MAX, max = INT16_MIN;
+        for (uint8_t i = first; i < quarter_count; i++)
+        {
+            const Pyramid_Span *q = &pyramid_quarter(i)->ch[ch];
+            s += q->mean;
+            if (pyramid_min(q) < min) min = pyramid_min(q);
+            if (pyramid_max(q) > max) max = pyramid_max(q);
+        }
+        pyramid_span(&b.ch[ch], (int16_t)(s / hour_quarters), min, max);
+    }
+    hour_quarters = 0;
+    logger_add(&b);
+}
+
+static void pyramid_close_quarter(void)
+{
+    Pyramid_Bucket *b = &quarters[quarter_head];
+
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        pyramid_span(&b->ch[ch], (int16_t)(sum[ch] / samples), lo[ch], hi[ch]);
+    quarter_head = quarter_head + 1 == PYRAMID_HOUR_QUARTERS ? 0 : quarter_head + 1;
+    if (quarter_count < PYRAMID_HOUR_QUARTERS) quarter_count++;
+    hour_quarters++;
+    samples = 0;
+}
+
+uint8_t pyramid_add(const BME280_Measurement *m)
+{
+    int16_t q[HISTORY_CHANNELS];
+    history_quantize(m, q);
+
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+        if (samples == 0)
+        {
+            sum[ch] = lo[ch] = hi[ch] = q[ch];
+            continue;
+        }
+        sum[ch] += q[ch];
+        if (q[ch] < lo[ch]) lo[ch] = q[ch];
+        if (q[ch] > hi[ch]) hi[ch] = q[ch];
+    }
+    if (++samples < PYRAMID_QUARTER_SAMPLES) return 0;
+
+    pyramid_close_quarter();
+    if (hour_quarters < PYRAMID_HOUR_QUARTERS) return PYRAMID_CLOSED_QUARTER;
+    pyramid_close_hour();
+    return PYRAMID_CLOSED_QUARTER | PYRAMID_CLOSED_HOUR;
+}
+
+uint8_t pyramid_flush(void)
+{
+    if (samples) pyramid_close_quarter();
+    if (!hour_quarters) return 0;
+    pyramid_close_hour();
+    return 1;
+}
+
+uint16_t pyramid_count(Pyramid_Tier tier)
+{
+    return tier == PYRAMID_HOUR ? logger_count() : quarter_count;
+}
+
+uint8_t pyramid_read(Pyramid_Tier tier, uint16_t index, Pyramid_Bucket *out)
+{
+    if (tier == PYRAMID_HOUR) return logger_read(index, out, NULL);
+    if (index >= quarter_count) return 0;
+    *out = *pyramid_quarter((uint8_t)index);
+    return 1;
+}
+
+void pyramid_image(Pyramid_Image *img)
+{
+    img->ring = quarters;
+    img->head = quarter_head;
+    img->count = quarter_count;
+}
+
+static void pyramid_fold(History_Stats *st, int32_t *s, uint16_t n, const Pyramid_Span *b)
+{
+    if (n == 0)
+    {
+        st->min = pyramid_min(b);
+        st->max = pyramid_max(b);
+        st->trend = -b->mean;       // Oldest, the newest is added at the end
+    }
+    if (pyramid_min(b) < st->min) st->min = pyramid_min(b);
+    if (pyramid_max(b) > st->max) st->max = pyramid_max(b);
+    *s += b->mean;
+}
+
+uint8_t pyramid_stats(History_Channel ch, History_Stats *out)
+{
+    Pyramid_Bucket b;
+    uint16_t hours = logger_count();
+    uint16_t n = 0;
+    int32_t s = 0;
+
+    if (ch >= HISTORY_CHANNELS) return 0;
+    for (uint16_t i = 0; i < hours && logger_read(i, &b, NULL); i++)
+        pyramid_fold(out, &s, n++, &b.ch[ch]);
+    for (uint8_t i = quarter_count - hour_quarters; i < quarter_count; i++)
+    {
+        b = *pyramid_quarter(i);
+        pyramid_fold(out, &s, n++, &b.ch[ch]);
+    }
+    if (n == 0) return 0;
+    out->mean = (int16_t)(s / (int32_t)n);
+    out->trend += b.ch[ch].mean;
+    return 1;
+}
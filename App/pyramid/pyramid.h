@@ -0,0 +1,126 @@
+/**
+ * @file pyramid.h
+ * @brief Quarter-hour and hourly aggregates on top of the history samples
+ *
+ * Tier 0 is the history ring itself (history.h). Every
+ * PYRAMID_QUARTER_SAMPLES history samples close one quarter bucket, kept
+ * in a RAM ring that holds one hour; every PYRAMID_HOUR_QUARTERS quarters
+ * close one hour bucket, which goes to the EEPROM log (logger.h). Each
+ * bucket keeps the mean and extremes of the tier below, so views read a
+ * tier instead of aggregating samples.
+ */
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include "history.h"
+
+/** History samples per quarter bucket: 15 at 1-minute samples */
+#ifndef PYRAMID_QUARTER_SAMPLES
+#define PYRAMID_QUARTER_SAMPLES 15
+#endif
+
+/** Quarter buckets per hour bucket, and the length of the quarter ring */
+#define PYRAMID_HOUR_QUARTERS   4
+
+/** Mean and extremes of one channel over a bucket, in its stored units */
+typedef struct {
+    int16_t mean;
+    uint8_t below;      // mean - min, saturated at 255
+    uint8_t above;      // max - mean, saturated at 255
+} Pyramid_Span;
+
+/** One closed bucket */
+typedef struct {
+    Pyramid_Span ch[HISTORY_CHANNELS];
+} Pyramid_Bucket;
+
+typedef enum {
+    PYRAMID_QUARTER = 0,
+    PYRAMID_HOUR
+} Pyramid_Tier;
+
+/** Quarter ring state, for bulk dumps that decode on the host */
+typedef struct {
+    const Pyramid_Bucket *ring; // PYRAMID_HOUR_QUARTERS slots
+    uint8_t head;               // Slot the next quarter goes to
+    uint8_t count;              // Closed quarters, ending before head
+} Pyramid_Image;
+
+/** pyramid_add() results */
+#define PYRAMID_CLOSED_QUARTER  0x01
+#define PYRAMID_CLOSED_HOUR     0x02
+
+/**
+ * @brief Drop the open buckets and the quarter ring.
+ *
+ * The hour tier lives in the log and survives; logger_init() has to run
+ * first.
+ */
+void pyramid_init(void);
+
+/**
+ * @brief Feed the sample just passed to history_add().
+ *
+ * Costs a few additions per channel; closing a quarter folds the open
+ * sums into a bucket, closing an hour merges the quarters of the ring and
+ * queues the result with logger_add().
+ *
+ * @param m Measurement
+ * @return PYRAMID_CLOSED_* bits for the buckets this sample closed
+ */
+uint8_t pyramid_add(const BME280_Measurement *m);
+
+/**
+ * @brief Close the open quarter and hour early and queue the partial hour.
+ *
+ * For a supply about to go away; follow with logger_flush(). The next
+ * hour bucket then closes PYRAMID_HOUR_QUARTERS quarters later.
+ *
+ * @return 1 if a bucket was queued, 0 if nothing was open
+ */
+uint8_t pyramid_flush(void);
+
+/**
+ * @brief Closed buckets held by a tier.
+ */
+uint16_t pyramid_count(Pyramid_Tier tier);
+
+/**
+ * @brief Read a closed bucket.
+ *
+ * @param tier Tier
+ * @param index 0 for the oldest bucket, pyramid_count() - 1 for the newest
+ * @param out Destination
+ * @return 1 on success, 0 if @p index is out of range
+ */
+uint8_t pyramid_read(Pyramid_Tier tier, uint16_t index, Pyramid_Bucket *out);
+
+/**
+ * @brief Lowest and highest value of a bucket channel.
+ */
+int16_t pyramid_min(const Pyramid_Span *s);
+int16_t pyramid_max(const Pyramid_Span *s);
+
+/**
+ * @brief Aggregates over the logged hours and the closed quarters of the
+ *        open hour.
+ *
+ * The mean weighs every bucket alike; the trend is the newest bucket mean
+ * minus the oldest. Reads each hour bucket once, so it is meant for views
+ * that redraw when a bucket closes.
+ *
+ * @param ch Channel
+ * @param out Destination
+ * @return 1 on success, 0 if no bucket is closed yet
+ */
+uint8_t pyramid_stats(History_Channel ch, History_Stats *out);
+
+/**
+ * @brief Describe the quarter ring in place.
+ *
+ * @param img Destination; img->ring points at the live ring
+ */
+void pyramid_image(Pyramid_Image *img);
+
+#endif // PYRAMID_H
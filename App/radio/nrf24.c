@@ -0,0 +1,175 @@
+/**
+ * @file nrf24.c
+ * @brief nRF24L01+ transmitter on SPI1 (register-level, polled)
+ *
+ * Polled full-duplex transfers in mode 0, MSB first, like the BME280 SPI
+ * transport; a payload is 33 bytes at most. Every command clocks the
+ * STATUS register back in its first byte, which is all the send loop
+ * polls.
+ */
+
+#include "nrf24.h"
+#include "radio.h"
+
+#if RADIO
+
+#define NRF24_R_REGISTER    0x00
+#define NRF24_W_REGISTER    0x20
+#define NRF24_W_TX_PAYLOAD  0xA0
+#define NRF24_FLUSH_TX      0xE1
+#define NRF24_NOP           0xFF
+
+#define NRF24_CONFIG        0x00
+#define NRF24_EN_AA         0x01
+#define NRF24_EN_RXADDR     0x02
+#define NRF24_SETUP_AW      0x03
+#define NRF24_SETUP_RETR    0x04
+#define NRF24_RF_CH         0x05
+#define NRF24_RF_SETUP      0x06
+#define NRF24_STATUS        0x07
+#define NRF24_OBSERVE_TX    0x08
+#define NRF24_RX_ADDR_P0    0x0A
+#define NRF24_TX_ADDR       0x10
+#define NRF24_DYNPD         0x1C
+#define NRF24_FEATURE       0x1D
+
+// All three interrupts masked, 2-byte CRC, PTX
+#define NRF24_CONFIG_OFF    0x7C
+#define NRF24_PWR_UP        0x02
+#define NRF24_RF_250K_0DBM  0x26
+#define NRF24_EN_DPL        0x04
+#define NRF24_TX_DS         0x20
+#define NRF24_MAX_RT        0x10
+
+typedef char nrf24_ard_step[NRF24_ARD_US % 250 == 0 && NRF24_ARD_US >= 250 ? 1 : -1];
+
+// Smallest SCK divider (2^(BR+1)) that keeps SCK within the module limit
+static uint32_t nrf24_br(void)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+    uint32_t br = 0;
+    while (br < 7 && (pclk >> (br + 1)) > NRF24_SPI_MAX_HZ) br++;
+    return br << SPI_CR1_BR_Pos;
+}
+
+static uint8_t nrf24_xfer(uint8_t out)
+{
+    while (!(SPI1->SR & SPI_SR_TXE));
+    *(volatile uint8_t *)&SPI1->DR = out;
+    while (!(SPI1->SR & SPI_SR_RXNE));
+    return (uint8_t)SPI1->DR;
+}
+
+// One command with @p len bytes after it; returns STATUS
+static uint8_t nrf24_command(uint8_t cmd, const uint8_t *out, uint8_t *in, uint8_t len)
+{
+    SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | nrf24_br();
+    SPI1->CR1 |= SPI_CR1_SPE;
+    HAL_GPIO_WritePin(NRF24_SPI_PORT, NRF24_CSN_PIN, GPIO_PIN_RESET);
+    uint8_t status = nrf24_xfer(cmd);
+    for (uint8_t i = 0; i < len; i++)
+    {
+        uint8_t b = nrf24_xfer(out ? out[i] : NRF24_NOP);
+        if (in) in[i] = b;
+    }
+    while (SPI1->SR & SPI_SR_BSY);
+    HAL_GPIO_WritePin(NRF24_SPI_PORT, NRF24_CSN_PIN, GPIO_PIN_SET);
+    SPI1->CR1 &= ~SPI_CR1_SPE;
+    return status;
+}
+
+static void nrf24_write(uint8_t reg, uint8_t value)
+{
+    nrf24_command(NRF24_W_REGISTER | reg, &value, NULL, 1);
+}
+
+static uint8_t nrf24_read(uint8_t reg)
+{
+    uint8_t value;
+    nrf24_command(NRF24_R_REGISTER | reg, NULL, &value, 1);
+    return value;
+}
+
+uint8_t nrf24_init(uint8_t channel, const uint8_t *address)
+{
+    GPIO_InitTypeDef gpio = {0};
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_SPI1_CLK_ENABLE();
+
+    gpio.Pin = NRF24_SPI_SCK_PIN | NRF24_SPI_MISO_PIN | NRF24_SPI_MOSI_PIN;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    gpio.Alternate = GPIO_AF0_SPI1;
+    HAL_GPIO_Init(NRF24_SPI_PORT, &gpio);
+
+    HAL_GPIO_WritePin(NRF24_SPI_PORT, NRF24_CSN_PIN, GPIO_PIN_SET);
+    HAL_GPIO_WritePin(NRF24_SPI_PORT, NRF24_CE_PIN, GPIO_PIN_RESET);
+    gpio.Pin = NRF24_CSN_PIN | NRF24_CE_PIN;
+    gpio.Mode = GPIO_MODE_OUTPUT_PP;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    gpio.Alternate = 0;
+    HAL_GPIO_Init(NRF24_SPI_PORT, &gpio);
+
+    // Ready 100 ms after its supply came up, long before this runs
+    nrf24_write(NRF24_CONFIG, NRF24_CONFIG_OFF);
+    nrf24_write(NRF24_SETUP_AW, 0x03);
+    if (nrf24_read(NRF24_SETUP_AW) != 0x03) return 0;
+
+    nrf24_write(NRF24_EN_AA, 0x01);
+    nrf24_write(NRF24_EN_RXADDR, 0x01);
+    nrf24_write(NRF24_SETUP_RETR, ((NRF24_ARD_US / 250 - 1) << 4) | NRF24_ARC);
+    nrf24_write(NRF24_RF_CH, channel & 0x7F);
+    nrf24_write(NRF24_RF_SETUP, NRF24_RF_250K_0DBM);
+    // The ACK comes back on pipe 0, so it listens on the TX address
+    nrf24_command(NRF24_W_REGISTER | NRF24_TX_ADDR, address, NULL, 5);
+    nrf24_command(NRF24_W_REGISTER | NRF24_RX_ADDR_P0, address, NULL, 5);
+    nrf24_write(NRF24_FEATURE, NRF24_EN_DPL);
+    nrf24_write(NRF24_DYNPD, 0x01);
+    nrf24_command(NRF24_FLUSH_TX, NULL, NULL, 0);
+    nrf24_write(NRF24_STATUS, NRF24_TX_DS | NRF24_MAX_RT);
+    return 1;
+}
+
+void nrf24_power_up(void)
+{
+    nrf24_write(NRF24_CONFIG, NRF24_CONFIG_OFF | NRF24_PWR_UP);
+    HAL_Delay(NRF24_STARTUP_MS);
+}
+
+void nrf24_power_down(void)
+{
+    nrf24_write(NRF24_CONFIG, NRF24_CONFIG_OFF);
+}
+
+uint8_t nrf24_send(const uint8_t *buf, uint8_t len, uint8_t *attempts)
+{
+    uint8_t status;
+
+    nrf24_command(NRF24_W_TX_PAYLOAD, buf, NULL, len);
+    // A CE pulse of 10 µs or more sends it; the retransmits follow on their own
+    HAL_GPIO_WritePin(NRF24_SPI_PORT, NRF24_CE_PIN, GPIO_PIN_SET);
+    for (volatile uint32_t n = SystemCoreClock / 100000U + 1; n; n--);
+    HAL_GPIO_WritePin(NRF24_SPI_PORT, NRF24_CE_PIN, GPIO_PIN_RESET);
+
+    uint32_t start = HAL_GetTick();
+    do
+    {
+        status = nrf24_command(NRF24_NOP, NULL, NULL, 0);
+    } while (!(status & (NRF24_TX_DS | NRF24_MAX_RT)) && HAL_GetTick() - start < NRF24_TX_TIMEOUT_MS);
+
+    if (status & NRF24_TX_DS)
+    {
+        *attempts = (nrf24_read(NRF24_OBSERVE_TX) & 0x0F) + 1;
+    }
+    else
+    {
+        *attempts = NRF24_ARC + 1;
+        nrf24_command(NRF24_FLUSH_TX, NULL, NULL, 0);
+    }
+    nrf24_write(NRF24_STATUS, NRF24_TX_DS | NRF24_MAX_RT);
+    return (status & NRF24_TX_DS) != 0;
+}
+
+#endif // RADIO
@@ -0,0 +1,80 @@
+/**
+ * @file nrf24.h
+ * @brief nRF24L01+ transmitter on SPI1 (register-level, polled)
+ *
+ * The module hangs off the SPI1 pins the BME280 and panel SPI options use
+ * (SCK PB3, MISO PB4, MOSI PB5), with CSN and CE on the two free port B
+ * pins. IRQ is left unconnected: the status register is polled, and all
+ * interrupt sources are masked so the pin stays high.
+ *
+ * Fixed set-up: 250 kbit/s for range, 0 dBm, 2-byte CRC, 5-byte address,
+ * dynamic payload length and auto-acknowledge on pipe 0, NRF24_ARC
+ * retransmits NRF24_ARD_US apart. The registers survive power-down, so
+ * they are written once; a burst only toggles PWR_UP.
+ */
+
+#ifndef NRF24_H
+#define NRF24_H
+
+#include "stm32l0xx_hal.h"
+
+/** Highest SCK the module accepts */
+#ifndef NRF24_SPI_MAX_HZ
+#define NRF24_SPI_MAX_HZ    8000000U
+#endif
+
+#define NRF24_SPI_PORT      GPIOB
+#define NRF24_SPI_SCK_PIN   GPIO_PIN_3
+#define NRF24_SPI_MISO_PIN  GPIO_PIN_4
+#define NRF24_SPI_MOSI_PIN  GPIO_PIN_5
+#define NRF24_CSN_PIN       GPIO_PIN_0
+#define NRF24_CE_PIN        GPIO_PIN_1
+
+#define NRF24_PAYLOAD_MAX   32
+
+/** Hardware retransmits per send, and the wait for an ACK before each */
+#define NRF24_ARC           3
+#define NRF24_ARD_US        500     // Shortest that fits an ACK at 250 kbit/s
+
+#define NRF24_STARTUP_MS    2       // Power-down to standby, Tpd2stby 1.5 ms
+#define NRF24_SETTLE_US     130     // Standby to TX, Tstby2a
+#define NRF24_TX_TIMEOUT_MS 15      // Well past NRF24_ARC + 1 full attempts
+
+/** Air time of a packet with @p len payload bytes: preamble, address,
+ *  9-bit packet control, payload and CRC at 4 µs a bit */
+#define NRF24_AIR_US(len)   (4U * (8U * (1U + 5U + (len) + 2U) + 9U))
+
+/**
+ * @brief Set up the pins and SPI1, configure the module and leave it
+ *        powered down.
+ *
+ * @param channel RF channel, 2400 + @p channel MHz
+ * @param address 5-byte address, sent LSB first
+ * @return 1 if the module answers, 0 if none is fitted
+ */
+uint8_t nrf24_init(uint8_t channel, const uint8_t *address);
+
+/**
+ * @brief Power up and wait out the start-up; standby draws ~26 µA.
+ */
+void nrf24_power_up(void);
+
+/**
+ * @brief Power down, ~1 µA.
+ */
+void nrf24_power_down(void);
+
+/**
+ * @brief Send one packet and wait for its ACK.
+ *
+ * Module powered up. The hardware retries up to NRF24_ARC times on its
+ * own; a packet that still finds no ACK is flushed.
+ *
+ * @param buf Payload
+ * @param len 1..NRF24_PAYLOAD_MAX bytes
+ * @param attempts Transmissions it took, acknowledged or not
+ * @return 1 if acknowledged, 0 if not
+ */
+uint8_t nrf24_send(const uint8_t *buf, uint8_t len, uint8_t *attempts);
+
+#endif // NRF24_H
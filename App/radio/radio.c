@@ -0,0 +1,197 @@
+/**
+ * @file radio.c
+ * @brief Batched uplink of the quarter-hour buckets over an nRF24L01+
+ *
+ * pending counts the newest closed quarters not yet acknowledged; the
+ * burst encodes from the oldest of them and drops each packet's buckets
+ * from the count once it is acknowledged. The hour for the budget and the
+ * on-time report is PYRAMID_HOUR_QUARTERS quarters, in step with the hour
+ * buckets.
+ */
+
+#include "radio.h"
+
+#if RADIO
+
+#include "bme280_spi.h"
+#include "clock.h"
+#include "nrf24.h"
+#include "oled.h"
+#include "pyramid.h"
+#include "supply.h"
+#include <string.h>
+
+#if BME280_SPI || OLED_SPI
+#error "RADIO needs SPI1, which BME280_SPI or OLED_SPI already takes"
+#endif
+
+#if RADIO_QUARTERS < 1 || RADIO_QUARTERS > PYRAMID_HOUR_QUARTERS
+#error "RADIO_QUARTERS must leave the burst's buckets in the quarter ring"
+#endif
+
+#define RADIO_ESCAPE        0x80    // int8 never used as a delta: int16 mean follows
+
+// The full bucket goes out byte for byte as it sits in RAM and the log
+typedef char radio_bucket_packed[sizeof(Pyramid_Bucket) == 4 * HISTORY_CHANNELS ? 1 : -1];
+typedef char radio_bucket_fits[RADIO_HEADER_LEN + sizeof(Pyramid_Bucket) <= NRF24_PAYLOAD_MAX ? 1 : -1];
+
+static const uint8_t address[5] = RADIO_ADDRESS;
+
+static Radio_Stats stats;
+static uint8_t ready;
+static uint8_t pending;         // Newest closed quarters not acknowledged yet
+static uint8_t due;             // Quarters since the last burst
+static uint8_t hour_quarters;
+static uint32_t hour_us;        // On-time in the hour so far
+static uint8_t seq;
+static uint8_t payload[NRF24_PAYLOAD_MAX];
+
+// One transmission: settling, air time and the ACK wait, or the
+// retransmit delay where no ACK came
+static uint32_t radio_attempt_us(uint8_t len)
+{
+    return NRF24_SETTLE_US + NRF24_AIR_US(len) + NRF24_ARD_US;
+}
+
+static uint32_t radio_budget_us(void)
+{
+    Supply_Tier tier = supply_tier();
+    return tier >= SUPPLY_TIER_DARK ? 0 : RADIO_BUDGET_US >> tier;
+}
+
+static uint8_t radio_delta_len(int16_t mean, int16_t prev)
+{
+    int16_t d = (int16_t)(mean - prev);
+    return d >= -127 && d <= 127 ? 3 : 5;
+}
+
+// Oldest pending bucket in full, the ones after it as deltas while they
+// fit; returns the length and the buckets it took in *taken
+static uint8_t radio_encode(uint8_t *taken)
+{
+    uint16_t count = pyramid_count(PYRAMID_QUARTER);
+    uint16_t index = count - pending;
+    Pyramid_Bucket b, prev;
+    uint8_t len = RADIO_HEADER_LEN;
+
+    pyramid_read(PYRAMID_QUARTER, index++, &prev);
+    memcpy(&payload[len], &prev, sizeof(prev));
+    len += sizeof(prev);
+    while (index < count && pyramid_read(PYRAMID_QUARTER, index, &b))
+    {
+        uint8_t need = 0;
+        for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+            need += radio_delta_len(b.ch[ch].mean, prev.ch[ch].mean);
+        if (len + need > NRF24_PAYLOAD_MAX) break;
+        for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        {
+            int16_t mean = b.ch[ch].mean;
+            if (radio_delta_len(mean, prev.ch[ch].mean) == 3)
+            {
+                payload[len++] = (uint8_t)(mean - prev.ch[ch].mean);
+            }
+            else
+            {
+                payload[len++] = RADIO_ESCAPE;
+                payload[len++] = (uint8_t)mean;
+                payload[len++] = (uint8_t)((uint16_t)mean >> 8);
+            }
+            payload[len++] = b.ch[ch].below;
+            payload[len++] = b.ch[ch].above;
+        }
+        prev = b;
+        index++;
+    }
+
+    // Quarters closed after the newest bucket in the packet
+    uint32_t age = (uint32_t)(count - index) * history_aggregates()->period_s * PYRAMID_QUARTER_SAMPLES / 60U;
+    payload[0] = (uint8_t)((RADIO_NODE << 4) | (seq & 0x0F));
+    payload[1] = age > UINT8_MAX ? UINT8_MAX : (uint8_t)age;
+    *taken = (uint8_t)(index - (count - pending));
+    return len;
+}
+
+static void radio_charge(uint32_t us)
+{
+    stats.on_us += us;
+    hour_us += us;
+}
+
+// 1 once acknowledged, 0 if nobody answered or the budget ran out
+static uint8_t radio_deliver(uint8_t len, uint32_t budget)
+{
+    for (uint8_t n = 0; n <= RADIO_RETRIES; n++)
+    {
+        uint8_t attempts;
+        if (hour_us + (NRF24_ARC + 1) * radio_attempt_us(len) > budget)
+        {
+            stats.over_budget++;
+            return 0;
+        }
+        if (n) stats.resends++;
+        uint8_t ok = nrf24_send(payload, len, &attempts);
+        radio_charge(attempts * radio_attempt_us(len));
+        if (ok) return 1;
+    }
+    stats.failures++;
+    return 0;
+}
+
+static void radio_burst(void)
+{
+    uint32_t budget = radio_budget_us();
+    uint16_t count = pyramid_count(PYRAMID_QUARTER);
+
+    if (pending > count) pending = (uint8_t)count;
+    if (!pending) return;
+    // Not even one packet in its worst case: stay powered down
+    if (hour_us + (NRF24_ARC + 1) * radio_attempt_us(NRF24_PAYLOAD_MAX) > budget)
+    {
+        stats.over_budget++;
+        return;
+    }
+
+    // SPI at 1 MHz is plenty, and the waits burn less than at 32 MHz
+    Clock_Profile was = clock_get_profile();
+    clock_set_profile(CLOCK_PROFILE_BUS);
+    nrf24_power_up();
+    stats.bursts++;
+    while (pending)
+    {
+        uint8_t taken;
+        uint8_t len = radio_encode(&taken);
+        if (!radio_deliver(len, budget)) break;
+        stats.packets++;
+        seq++;
+        pending -= taken;
+    }
+    nrf24_power_down();
+    clock_set_profile(was);
+}
+
+void radio_init(void)
+{
+    ready = nrf24_init(RADIO_CHANNEL, address);
+}
+
+void radio_quarter_closed(void)
+{
+    if (pending < PYRAMID_HOUR_QUARTERS) pending++;
+    else stats.dropped++;
+    if (++hour_quarters == PYRAMID_HOUR_QUARTERS)
+    {
+        hour_quarters = 0;
+        stats.on_us_hour = hour_us;
+        hour_us = 0;
+    }
+    if (++due < RADIO_QUARTERS) return;
+    due = 0;
+    if (ready) radio_burst();
+}
+
+const Radio_Stats *radio_get_stats(void)
+{
+    return &stats;
+}
+
+#endif // RADIO
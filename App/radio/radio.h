@@ -0,0 +1,120 @@
+/**
+ * @file radio.h
+ * @brief Batched uplink of the quarter-hour buckets over an nRF24L01+
+ *
+ * Nothing is sent per sample. Every RADIO_QUARTERS closed quarters the
+ * radio powers up once and sends, back to back, the quarter buckets
+ * (pyramid.h) closed since the last acknowledged packet, then powers down
+ * again. At the defaults that is one burst of two packets an hour, a few
+ * ms of RF time, against a transmitter that draws more than the panel
+ * while it is on.
+ *
+ * A packet carries the buckets as the log stores them, so the gateway
+ * decodes them with the log's layout: the oldest one in full, each later
+ * one as a delta to the one before, which is how the history ring stores
+ * samples too. Little endian:
+ *
+ * | Offset | Size | Field                                               |
+ * |--------|------|-----------------------------------------------------|
+ * | 0      | 1    | RADIO_NODE in the high nibble, sequence in the low  |
+ * | 1      | 1    | Age of the packet's newest bucket, minutes (max 255)|
+ * | 2      | 12   | Oldest bucket, a Pyramid_Bucket as logged           |
+ * | 14     | ...  | Each later bucket, per channel: mean delta, below,  |
+ * |        |      | above                                               |
+ *
+ * The mean is an int8 difference to the previous bucket's mean, or 0x80
+ * followed by the int16 mean itself when the step is larger. A bucket
+ * takes 9 bytes when all its steps fit, so a packet holds up to three.
+ * Its length is the nRF24 dynamic payload length. The age counts back
+ * from when the packet was sent; the burst runs as a quarter closes, so
+ * before a backlog it is 0. A packet that is sent again keeps its
+ * sequence number, for the gateway to drop a copy whose ACK was lost.
+ *
+ * The energy budget bounds what the link may cost: a packet only goes
+ * out while its worst case, every transmission unacknowledged, fits in
+ * the RF on-time left for the hour. The budget is RADIO_BUDGET_US at full
+ * supply, halved for every supply tier below, and nothing at all in
+ * SUPPLY_TIER_DARK. A packet the hardware gives up on is sent again up
+ * to RADIO_RETRIES times. Whatever stays unsent waits for the next burst;
+ * the quarter ring holds an hour of them, older ones are dropped.
+ *
+ * On-time counts the TX settling, the air time and the ACK wait of every
+ * transmission, from the fixed set-up in nrf24.h; standby and power-down
+ * are left to ENERGY_BASE_UA. The counters are in Radio_Stats, and the
+ * charge rides on the energy estimate (energy.h).
+ *
+ * Needs SPI1, so RADIO excludes BME280_SPI and OLED_SPI.
+ */
+
+#ifndef RADIO_H
+#define RADIO_H
+
+#include "stm32l0xx_hal.h"
+
+/** 1: build the uplink */
+#ifndef RADIO
+#define RADIO 0
+#endif
+
+/** Quarters per burst, 1..4: RADIO_QUARTERS x 15 minutes at 1-minute samples */
+#ifndef RADIO_QUARTERS
+#define RADIO_QUARTERS  4
+#endif
+
+/** This unit, 0..15, and the link it transmits on */
+#ifndef RADIO_NODE
+#define RADIO_NODE      1
+#endif
+#ifndef RADIO_CHANNEL
+#define RADIO_CHANNEL   76          // 2476 MHz, above most Wi-Fi
+#endif
+#define RADIO_ADDRESS   { 0xE7, 0x5A, 0x17, 0x4B, 0xC3 }
+
+/** RF on-time per hour at full supply: 100 ms, ~0.35 µAh at 12.5 mA */
+#ifndef RADIO_BUDGET_US
+#define RADIO_BUDGET_US 100000U
+#endif
+
+/** Resends of a packet the hardware retransmits could not deliver */
+#ifndef RADIO_RETRIES
+#define RADIO_RETRIES   2
+#endif
+
+#define RADIO_HEADER_LEN 2
+
+/** Uplink counters since radio_init() */
+typedef struct {
+    uint32_t on_us;             // RF on-time
+    uint32_t on_us_hour;        // ... during the last complete hour
+    uint16_t bursts;
+    uint16_t packets;           // Acknowledged
+    uint16_t resends;
+    uint16_t failures;          // Bursts ended by a packet nobody acknowledged
+    uint16_t over_budget;       // Bursts cut short or skipped for the budget
+    uint16_t dropped;           // Buckets gone from the ring before they were sent
+} Radio_Stats;
+
+#if RADIO
+/**
+ * @brief Configure the module and power it down; after pyramid_init().
+ *
+ * Without a module the uplink stays off.
+ */
+void radio_init(void);
+
+/**
+ * @brief Account for a quarter closed by pyramid_add(), and run the burst
+ *        when one is due.
+ *
+ * Blocks for the burst, a few ms per packet, from CLOCK_PROFILE_BUS; the
+ * clock profile it was called in is restored.
+ */
+void radio_quarter_closed(void);
+
+/**
+ * @brief Live counters.
+ */
+const Radio_Stats *radio_get_stats(void);
+#endif
+
+#endif // RADIO_H
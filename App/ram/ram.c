@@ -0,0 +1,41 @@
+/**
+ * @file ram.c
+ * @brief Stack high-water mark and RAM budget
+ */
+
+#include "ram.h"
+
+extern uint8_t _sdata;          // Symbols defined in the linker script
+extern uint8_t _end;
+extern uint8_t _estack;
+extern uint8_t _Min_Heap_Size;
+extern uint8_t _Min_Stack_Size;
+
+// Lowest word the stack may reach without running into the heap
+static const uint32_t *ram_floor(void)
+{
+    uintptr_t p = (uintptr_t)&_end + sysmem_heap_used();
+    return (const uint32_t *)((p + 3) & ~(uintptr_t)3);
+}
+
+uint16_t ram_stack_peak(void)
+{
+    const uint32_t *p = ram_floor();
+    const uint32_t *top = (const uint32_t *)&_estack;
+
+    while (p < top && *p == RAM_PAINT)
+        p++;
+    return (uint16_t)((const uint8_t *)top - (const uint8_t *)p);
+}
+
+void ram_report(Ram_Report *r)
+{
+    r->static_bytes = (uint16_t)(&_end - &_sdata);
+    r->heap_reserved = (uint16_t)(uintptr_t)&_Min_Heap_Size;
+    r->heap_used = (uint16_t)sysmem_heap_used();
+    r->stack_reserved = (uint16_t)(uintptr_t)&_Min_Stack_Size;
+    r->stack_peak = ram_stack_peak();
+
+    uint16_t free = (uint16_t)(&_estack - (const uint8_t *)ram_floor());
+    r->unused = free - r->stack_peak;
+}
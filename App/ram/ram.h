@@ -0,0 +1,49 @@
+/**
+ * @file ram.h
+ * @brief Stack high-water mark and RAM budget
+ *
+ * The startup code paints every word from _end (top of .bss) up to the
+ * initial stack pointer with RAM_PAINT before main() runs. The deepest
+ * the stack has ever reached is the lowest word above the heap that no
+ * longer holds the pattern. A frame that reserves stack without writing
+ * all of it can hide below the mark, so keep some margin when shrinking
+ * _Min_Stack_Size.
+ *
+ * From GDB: print ram_stack_peak(), or call ram_report() into a buffer.
+ */
+
+#ifndef RAM_H
+#define RAM_H
+
+#include <stdint.h>
+
+#define RAM_PAINT   0xC5C5C5C5U     // Must match startup_stm32l011k4tx.s
+
+/** RAM use in bytes */
+typedef struct {
+    uint16_t static_bytes;      // .data + .bss
+    uint16_t heap_reserved;     // _Min_Heap_Size
+    uint16_t heap_used;         // Taken through _sbrk()
+    uint16_t stack_reserved;    // _Min_Stack_Size
+    uint16_t stack_peak;        // Deepest stack use since reset
+    uint16_t unused;            // Never touched: between the heap and the stack peak
+} Ram_Report;
+
+/**
+ * @brief Deepest stack use since reset, in bytes.
+ *
+ * Scans up from the heap end, so it costs a pass over the free RAM.
+ */
+uint16_t ram_stack_peak(void);
+
+/**
+ * @brief Fill in the whole budget.
+ */
+void ram_report(Ram_Report *r);
+
+/**
+ * @brief Heap bytes taken through _sbrk(); implemented in sysmem.c.
+ */
+uint32_t sysmem_heap_used(void);
+
+#endif // RAM_H
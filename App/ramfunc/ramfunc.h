@@ -0,0 +1,54 @@
+/**
+ * @file ramfunc.h
+ * @brief Opt-in placement of hot routines in SRAM
+ *
+ * In the BURST profile the flash runs with one wait state. The prefetch
+ * buffer (enabled by clock.c in that profile) hides most of it on
+ * straight-line code, but every taken branch still pays for the refill.
+ * SRAM has no wait states, so a routine copied there by the .data loop of
+ * the startup code runs at full speed; the linker script already collects
+ * .RamFunc into .data.
+ *
+ * Every byte moved costs the same byte of RAM for good, so each group is
+ * enabled on its own through the RAMFUNC bit mask. The Bench configuration
+ * reports the bytes taken ("# ramfunc") next to the cycle counts, to weigh
+ * the two against each other. SRAM is out of BL range from flash: calls
+ * in are long calls, calls back out (the libgcc division and 64-bit
+ * helpers, static helpers the compiler did not inline) go through linker
+ * veneers. The font and calibration tables are read as data and stay in
+ * flash.
+ */
+
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+#define RAMFUNC_COMP    0x01    // BME280 compensation formulas (bme280_comp.c)
+#define RAMFUNC_RENDER  0x02    // Glyph blit into the frame buffer (oled.c)
+#define RAMFUNC_FORMAT  0x04    // Fixed-point number formatter (format.c)
+
+// Groups placed in SRAM; 0 leaves everything in flash
+#ifndef RAMFUNC
+#define RAMFUNC 0
+#endif
+
+#define RAMFUNC_ATTR    __attribute__((section(".RamFunc"), long_call, noinline))
+
+#if RAMFUNC & RAMFUNC_COMP
+#define RAMFUNC_COMP_FN     RAMFUNC_ATTR
+#else
+#define RAMFUNC_COMP_FN
+#endif
+
+#if RAMFUNC & RAMFUNC_RENDER
+#define RAMFUNC_RENDER_FN   RAMFUNC_ATTR
+#else
+#define RAMFUNC_RENDER_FN
+#endif
+
+#if RAMFUNC & RAMFUNC_FORMAT
+#define RAMFUNC_FORMAT_FN   RAMFUNC_ATTR
+#else
+#define RAMFUNC_FORMAT_FN
+#endif
+
+#endif // RAMFUNC_H
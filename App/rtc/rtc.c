@@ -0,0 +1,269 @@
+/**
+ * @file rtc.c
+ * @brief Minimal register-level RTC driver for the STM32L011
+ *
+ * Only the parts of the RTC needed by the firmware are implemented. Registers
+ * are accessed directly through CMSIS definitions instead of the HAL RTC
+ * module, which keeps the flash cost to a few dozen instructions.
+ *
+ * The RTC runs from LSI, or from LSE with RTC_LSE. The wake-up timer uses
+ * RTCCLK/16 (~2.3 or 2.048 kHz), which gives sub-millisecond resolution and
+ * periods of up to ~28 s.
+ *
+ * The calendar runs in 24-hour format with the shadow registers bypassed,
+ * so it reads correctly right after a STOP wake-up without waiting for RSF;
+ * a read is repeated until two passes agree instead. Timestamps are Unix
+ * seconds, converted from the BCD date with a month table (the years
+ * 2000-2099 the RTC covers have a leap year every fourth year).
+ */
+
+#include "rtc.h"
+#include "main.h"
+
+// ck_apre = RTCCLK / (PREDIV_A + 1) = 1 kHz (LSI) or 1.024 kHz (LSE) for the
+// subsecond counter, ck_spre = ck_apre / (PREDIV_S + 1) = 1 Hz
+#define RTC_LSI_PRER    ((36U << RTC_PRER_PREDIV_A_Pos) | 999U)
+#define RTC_LSE_PRER    ((31U << RTC_PRER_PREDIV_A_Pos) | 1023U)
+
+typedef char rtc_lsi_prer_check[37U * 1000U == RTC_LSI_HZ ? 1 : -1];
+typedef char rtc_lse_prer_check[32U * 1024U == RTC_LSE_HZ ? 1 : -1];
+
+#define RTC_DAY_S       86400U
+
+// Days before the start of each month in a common year
+static const uint16_t rtc_month_days[12] = {
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+static void rtc_unlock(void)
+{
+    RTC->WPR = 0xCA;
+    RTC->WPR = 0x53;
+}
+
+static void rtc_lock(void)
+{
+    RTC->WPR = 0xFF;
+}
+
+static void rtc_clear_flag(uint32_t flag)
+{
+    // Flags are rc_w0: write ones everywhere else so no other flag is lost
+    RTC->ISR = ~(flag | RTC_ISR_INIT) | (RTC->ISR & RTC_ISR_INIT);
+}
+
+static void rtc_enter_init(void)
+{
+    RTC->ISR |= RTC_ISR_INIT;
+    while (!(RTC->ISR & RTC_ISR_INITF));
+}
+
+static void rtc_exit_init(void)
+{
+    RTC->ISR &= ~RTC_ISR_INIT;
+}
+
+#if RTC_LSE
+static uint8_t rtc_start_lse(void)
+{
+    uint32_t start = HAL_GetTick();
+
+    RCC->CSR |= RCC_CSR_LSEON;
+    while (!(RCC->CSR & RCC_CSR_LSERDY))
+    {
+        if (HAL_GetTick() - start >= RTC_LSE_TIMEOUT_MS)
+        {
+            RCC->CSR &= ~RCC_CSR_LSEON;     // No crystal; telemetry_init() retries
+            return 0;
+        }
+    }
+    return 1;
+}
+#endif
+
+void rtc_init(void)
+{
+    __HAL_RCC_PWR_CLK_ENABLE();
+    PWR->CR |= PWR_CR_DBP;
+
+    // The LSI also clocks the IWDG and the LPTIM tick, it stays on either way
+    RCC->CSR |= RCC_CSR_LSION;
+    while (!(RCC->CSR & RCC_CSR_LSIRDY));
+
+    // No source selected yet only after a power-on
+    uint32_t current = RCC->CSR & RCC_CSR_RTCSEL;
+    uint32_t source = RCC_CSR_RTCSEL_LSI;
+#if RTC_LSE
+    if (current == RCC_CSR_RTCSEL_LSE || (current == 0 && rtc_start_lse()))
+        source = RCC_CSR_RTCSEL_LSE;
+#endif
+    if (current != source)
+    {
+        // Changing the RTC clock source requires a backup domain reset
+        if (current != 0)
+        {
+            RCC->CSR |= RCC_CSR_RTCRST;
+            RCC->CSR &= ~RCC_CSR_RTCRST;
+        }
+        RCC->CSR = (RCC->CSR & ~RCC_CSR_RTCSEL) | source;
+    }
+    RCC->CSR |= RCC_CSR_RTCEN;
+
+    // Prescalers still at their reset value, or set for the other source;
+    // the date and time are kept, a fresh calendar is at 2000-01-01 already
+    uint32_t prer = source == RCC_CSR_RTCSEL_LSE ? RTC_LSE_PRER : RTC_LSI_PRER;
+    if (RTC->PRER != prer)
+    {
+        rtc_unlock();
+        rtc_enter_init();
+        RTC->PRER = prer & RTC_PRER_PREDIV_S;   // Two writes, synchronous first
+        RTC->PRER = prer;
+        rtc_exit_init();
+        RTC->CR |= RTC_CR_BYPSHAD;
+        rtc_lock();
+    }
+
+    // Wake-up timer line, rising edge, interrupt mode
+    EXTI->IMR |= EXTI_IMR_IM20;
+    EXTI->RTSR |= EXTI_RTSR_RT20;
+
+    HAL_NVIC_SetPriority(RTC_IRQn, IRQ_PRIO_TIMING, 0);
+    HAL_NVIC_EnableIRQ(RTC_IRQn);
+}
+
+void rtc_start_wakeup(uint16_t ms)
+{
+    uint32_t reload = ((uint32_t)ms * (rtc_clock_hz() / 16)) / 1000U;
+    if (reload == 0) reload = 1;
+    if (reload > 0x10000) reload = 0x10000;
+
+    rtc_unlock();
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    while (!(RTC->ISR & RTC_ISR_WUTWF));
+
+    RTC->WUTR = reload - 1;
+    RTC->CR &= ~RTC_CR_WUCKSEL;                      // 000: RTCCLK/16
+    rtc_clear_flag(RTC_ISR_WUTF);
+    RTC->CR |= RTC_CR_WUTE | RTC_CR_WUTIE;
+    rtc_lock();
+
+    EXTI->PR = EXTI_PR_PIF20;
+}
+
+void rtc_stop_wakeup(void)
+{
+    rtc_unlock();
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    rtc_lock();
+}
+
+uint32_t rtc_clock_hz(void)
+{
+    return (RCC->CSR & RCC_CSR_RTCSEL) == RCC_CSR_RTCSEL_LSE ? RTC_LSE_HZ : RTC_LSI_HZ;
+}
+
+static uint8_t rtc_from_bcd(uint32_t bcd)
+{
+    return (uint8_t)((bcd >> 4) * 10 + (bcd & 0x0F));
+}
+
+static uint32_t rtc_to_bcd(uint32_t v)
+{
+    return ((v / 10) << 4) | (v % 10);
+}
+
+// Counters without shadowing: the second may roll over between the reads
+static void rtc_read(uint32_t *ssr, uint32_t *tr, uint32_t *dr)
+{
+    do
+    {
+        *ssr = RTC->SSR;
+        *tr = RTC->TR;
+        *dr = RTC->DR;
+    } while (*ssr != RTC->SSR || *tr != RTC->TR || *dr != RTC->DR);
+}
+
+static uint32_t rtc_to_unix(uint32_t tr, uint32_t dr)
+{
+    uint32_t y = rtc_from_bcd((dr >> RTC_DR_YU_Pos) & 0xFF);
+    uint32_t m = rtc_from_bcd((dr >> RTC_DR_MU_Pos) & 0x1F);
+    uint32_t d = rtc_from_bcd(dr & 0x3F);
+
+    // (y + 3) / 4 leap days before year y, 2000 included
+    uint32_t days = y * 365 + (y + 3) / 4 + rtc_month_days[m - 1] + d - 1;
+    if (m > 2 && (y & 3) == 0) days++;
+
+    uint32_t s = rtc_from_bcd((tr >> RTC_TR_HU_Pos) & 0x3F) * 3600U +
+                 rtc_from_bcd((tr >> RTC_TR_MNU_Pos) & 0x7F) * 60U +
+                 rtc_from_bcd(tr & 0x7F);
+    return RTC_EPOCH_2000 + days * RTC_DAY_S + s;
+}
+
+uint32_t rtc_time(void)
+{
+    uint32_t ssr, tr, dr;
+    rtc_read(&ssr, &tr, &dr);
+    return rtc_to_unix(tr, dr);
+}
+
+void rtc_now(rtc_stamp *t)
+{
+    uint32_t ssr, tr, dr;
+    rtc_read(&ssr, &tr, &dr);
+
+    // SSR counts down from PREDIV_S within each second
+    uint32_t div = (RTC->PRER & RTC_PRER_PREDIV_S) + 1;
+    t->seconds = rtc_to_unix(tr, dr);
+    t->fraction = (uint16_t)(((div - 1 - ssr) << 16) / div);
+}
+
+uint32_t rtc_elapsed_ms(const rtc_stamp *from, const rtc_stamp *to)
+{
+    int32_t frac = (int32_t)to->fraction - from->fraction;
+    if (to->seconds < from->seconds || (to->seconds == from->seconds && frac < 0))
+        return 0;
+    return (to->seconds - from->seconds) * 1000U + (uint32_t)(frac * 1000 / 65536);
+}
+
+void rtc_set_time(uint32_t seconds)
+{
+    uint32_t t = seconds < RTC_EPOCH_2000 ? 0 : seconds - RTC_EPOCH_2000;
+    uint32_t days = t / RTC_DAY_S, s = t % RTC_DAY_S;
+    uint32_t weekday = (days + 5) % 7 + 1;     // 2000-01-01 was a Saturday (6)
+
+    uint32_t y = 0;
+    while (y < 99 && days >= ((y & 3) ? 365U : 366U))
+    {
+        days -= (y & 3) ? 365U : 366U;
+        y++;
+    }
+    uint32_t leap = (y & 3) == 0;
+    uint32_t m = 1;
+    while (m < 12 && days >= rtc_month_days[m] + (m >= 2 ? leap : 0U))
+        m++;
+    uint32_t d = days - rtc_month_days[m - 1] - (m > 2 ? leap : 0U) + 1;
+
+    rtc_unlock();
+    rtc_enter_init();
+    RTC->TR = (rtc_to_bcd(s / 3600) << RTC_TR_HU_Pos) |
+              (rtc_to_bcd(s / 60 % 60) << RTC_TR_MNU_Pos) |
+              rtc_to_bcd(s % 60);
+    RTC->DR = (rtc_to_bcd(y) << RTC_DR_YU_Pos) | (weekday << RTC_DR_WDU_Pos) |
+              (rtc_to_bcd(m) << RTC_DR_MU_Pos) | rtc_to_bcd(d);
+    rtc_exit_init();
+    rtc_lock();
+}
+
+__weak void rtc_wakeup_callback(void)
+{
+}
+
+void rtc_irq_handler(void)
+{
+    if (RTC->ISR & RTC_ISR_WUTF)
+    {
+        rtc_clear_flag(RTC_ISR_WUTF);
+        EXTI->PR = EXTI_PR_PIF20;
+        rtc_wakeup_callback();
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef RTC_H
+#define RTC_H
+
+#include "stm32l0xx_hal.h"
+
+#define RTC_LSI_HZ      37000U              // Nominal LSI frequency (±10 % over temperature)
+#define RTC_LSE_HZ      32768U
+
+// 1: clock the RTC from the 32.768 kHz crystal (the one the telemetry
+// LPUART uses), falling back to the LSI if it does not start
+#ifndef RTC_LSE
+#define RTC_LSE 0
+#endif
+#define RTC_LSE_TIMEOUT_MS  2000            // Crystal start-up allowance
+
+// Calendar start after a backup domain reset, 2000-01-01 00:00:00 UTC
+#define RTC_EPOCH_2000  946684800U
+
+/** Point in time read from the calendar */
+typedef struct {
+    uint32_t seconds;       // Unix time, UTC
+    uint16_t fraction;      // 1/65536 s units into that second
+} rtc_stamp;
+
+// Backup registers, kept over every reset but a power-on one (and the
+// backup domain reset rtc_init() does on a clock source change)
+#define RTC_BKP_RESET_LOG       (RTC->BKP0R)    // watchdog.c: last reset causes
+#define RTC_BKP_RESET_COUNT     (RTC->BKP1R)    // watchdog.c: reset counters
+#define RTC_BKP_SUPERVISION     (RTC->BKP2R)    // watchdog.c: task running, error flag
+#define RTC_BKP_PANEL           (RTC->BKP3R)    // main.c: panel configured by an earlier boot
+
+/**
+ * @brief Start the RTC and its calendar.
+ *
+ * The RTC registers are programmed directly (the HAL RTC module is not part
+ * of this project). A running RTC, and with it the calendar, survives a
+ * system reset untouched. After a power-on the source is chosen: the LSE
+ * with RTC_LSE if it starts within RTC_LSE_TIMEOUT_MS, the LSI otherwise.
+ * A unit that fell back stays on the LSI until the next power-on, since
+ * moving to another source resets the backup domain.
+ *
+ * The prescalers give 1 Hz to the calendar and ~1 ms steps to the
+ * subsecond counter from either source. A fresh calendar starts at
+ * RTC_EPOCH_2000 and keeps counting from there until rtc_set_time().
+ */
+void rtc_init(void);
+
+/**
+ * @brief RTC clock actually selected by rtc_init().
+ *
+ * @return RTC_LSE_HZ or RTC_LSI_HZ
+ */
+uint32_t rtc_clock_hz(void);
+
+/**
+ * @brief Current calendar time.
+ *
+ * Keeps counting through STOP and every reset but a power-on one.
+ *
+ * @return Unix time in seconds (2000-01-01 .. 2099-12-31)
+ */
+uint32_t rtc_time(void);
+
+/**
+ * @brief Current time with the subsecond fraction, for latency measurement.
+ *
+ * @param t Destination
+ */
+void rtc_now(rtc_stamp *t);
+
+/**
+ * @brief Time between two stamps.
+ *
+ * @param from Earlier stamp
+ * @param to Later stamp
+ * @return Milliseconds from @p from to @p to, 0 if @p to is earlier
+ */
+uint32_t rtc_elapsed_ms(const rtc_stamp *from, const rtc_stamp *to);
+
+/**
+ * @brief Set the calendar.
+ *
+ * The subsecond counter restarts at the beginning of the second.
+ *
+ * @param seconds Unix time in seconds, from RTC_EPOCH_2000 up to the end
+ *        of 2099 (earlier values are taken as RTC_EPOCH_2000)
+ */
+void rtc_set_time(uint32_t seconds);
+
+/**
+ * @brief Configure the periodic wake-up timer.
+ *
+ * The wake-up timer auto-reloads, so the RTC interrupt fires every @p ms
+ * milliseconds until rtc_stop_wakeup() is called. It keeps running in STOP
+ * mode and wakes the core through EXTI line 20.
+ *
+ * @param ms Wake-up period in milliseconds (1 – 28000)
+ */
+void rtc_start_wakeup(uint16_t ms);
+
+/**
+ * @brief Disable the wake-up timer and its interrupt.
+ */
+void rtc_stop_wakeup(void);
+
+/**
+ * @brief Called from RTC_IRQHandler() on every wake-up timer event.
+ *
+ * Weak default does nothing; override it to hook the wake-up tick.
+ */
+void rtc_wakeup_callback(void);
+
+/**
+ * @brief RTC interrupt service routine body (wake-up timer flag handling).
+ */
+void rtc_irq_handler(void);
+
+#endif // RTC_H
@@ -0,0 +1,84 @@
+/**
+ * @file sampler.c
+ * @brief Adaptive sample interval driven by the observed rate of change
+ *
+ * Every skipped sample saves a conversion, its I2C traffic and the display
+ * flush that follows. In a stable room the interval settles at the longest
+ * one (SAMPLER_MAX_PERIOD by default) after six quiet samples.
+ */
+
+#include "sampler.h"
+
+static BME280_Measurement reference;
+static uint8_t have_reference;
+static uint16_t min_period = 1;
+static uint16_t max_period = SAMPLER_MAX_PERIOD;
+static uint16_t period = 1;
+static uint16_t countdown = 1;
+
+// All three channels fit in int32_t, including Q24.8 pressure
+static uint32_t sampler_abs_diff(int32_t a, int32_t b)
+{
+    return (uint32_t)(a > b ? a - b : b - a);
+}
+
+void sampler_reset(void)
+{
+    have_reference = 0;
+    period = min_period;
+    countdown = min_period;
+}
+
+void sampler_set_min_period(uint16_t ticks)
+{
+    if (ticks == 0) ticks = 1;
+    if (ticks > max_period) ticks = max_period;
+    min_period = ticks;
+    if (period < min_period) period = min_period;
+    if (countdown > period) countdown = period;
+}
+
+void sampler_set_max_period(uint16_t ticks)
+{
+    if (ticks < min_period) ticks = min_period;
+    max_period = ticks;
+    if (period > max_period) period = max_period;
+    if (countdown > period) countdown = period;
+}
+
+void sampler_retry(void)
+{
+    countdown = 1;
+}
+
+uint8_t sampler_due(void)
+{
+    if (--countdown) return 0;
+    countdown = period;
+    return 1;
+}
+
+uint8_t sampler_update(const BME280_Measurement *m)
+{
+    uint8_t moved = have_reference &&
+        (sampler_abs_diff(m->temperature, reference.temperature) > SAMPLER_DELTA_TEMP ||
+         sampler_abs_diff((int32_t)m->humidity, (int32_t)reference.humidity) > SAMPLER_DELTA_HUM ||
+         sampler_abs_diff((int32_t)m->pressure, (int32_t)reference.pressure) > SAMPLER_DELTA_PRESS);
+
+    if (!have_reference)
+        moved = 1;
+    if (moved)
+        period = min_period;
+    else if (period < max_period)
+        period = period * 2 > max_period ? max_period : period * 2;
+
+    reference = *m;
+    have_reference = 1;
+    countdown = period;
+    return moved;
+}
+
+uint16_t sampler_period(void)
+{
+    return period;
+}
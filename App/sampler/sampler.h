@@ -0,0 +1,89 @@
+/**
+ * @file sampler.h
+ * @brief Adaptive sample interval driven by the observed rate of change
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "bme280.h"
+
+/** Longest interval between samples by default, in scheduler ticks */
+#ifndef SAMPLER_MAX_PERIOD
+#define SAMPLER_MAX_PERIOD  60
+#endif
+
+/** Temperature change that counts as movement, 0.01 °C */
+#ifndef SAMPLER_DELTA_TEMP
+#define SAMPLER_DELTA_TEMP  10          // 0.1 °C
+#endif
+
+/** Humidity change that counts as movement, Q22.10 %RH */
+#ifndef SAMPLER_DELTA_HUM
+#define SAMPLER_DELTA_HUM   (1U << 9)   // 0.5 %RH
+#endif
+
+/** Pressure change that counts as movement, Q24.8 Pa */
+#ifndef SAMPLER_DELTA_PRESS
+#define SAMPLER_DELTA_PRESS (10U << 8)  // 0.1 hPa
+#endif
+
+/**
+ * @brief Go back to sampling at the shortest interval.
+ *
+ * Also forgets the reference sample, so the next sampler_update() only
+ * records it. Call after start-up and after sensor errors.
+ */
+void sampler_reset(void);
+
+/**
+ * @brief Set the shortest interval, e.g. to save power on a weak supply.
+ *
+ * Moved samples and errors fall back to this interval instead of one tick.
+ *
+ * @param ticks Interval in scheduler ticks, 1 up to the longest interval
+ */
+void sampler_set_min_period(uint16_t ticks);
+
+/**
+ * @brief Set the longest interval quiet samples back off to.
+ *
+ * @param ticks Interval in scheduler ticks, at least the shortest one
+ */
+void sampler_set_max_period(uint16_t ticks);
+
+/**
+ * @brief Make the next tick due, for a read that has to be repeated.
+ *
+ * The interval and the reference sample are kept, so a retried glitch
+ * does not reset the back-off the way sampler_reset() does.
+ */
+void sampler_retry(void);
+
+/**
+ * @brief Count one scheduler tick.
+ *
+ * @return 1 if a sample is due on this tick, 0 otherwise
+ */
+uint8_t sampler_due(void);
+
+/**
+ * @brief Adapt the interval to a new sample.
+ *
+ * The interval doubles, up to the longest interval, while every channel
+ * stays within its delta of the previous sample, and drops to the shortest
+ * interval as soon as any channel moves further.
+ *
+ * @param m Sample just taken
+ * @return 1 if the sample moved beyond the deltas (or is the first one)
+ */
+uint8_t sampler_update(const BME280_Measurement *m);
+
+/**
+ * @brief Current interval between samples.
+ *
+ * @return Interval in scheduler ticks
+ */
+uint16_t sampler_period(void);
+
+#endif // SAMPLER_H
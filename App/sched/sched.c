@@ -0,0 +1,201 @@
+/**
+ * @file sched.c
+ * @brief Tick-based cooperative scheduler with STOP mode idle
+ *
+ * The scheduler tick comes from the RTC wake-up timer, which keeps counting
+ * in STOP mode. Between ticks the MCU sits in STOP with the low-power
+ * regulator, so the average current is dominated by the short awake window
+ * instead of the 32 MHz core spinning in HAL_Delay().
+ *
+ * HAL_GetTick() runs from LPTIM1 (see tick.c) and keeps counting in STOP,
+ * so timeouts stay valid across sleep; with TICK_LPTIM disabled it falls
+ * back to SysTick, which is suspended while stopped.
+ *
+ * Interrupt handlers hand work to the loop as events: a bit in a mask,
+ * dispatched in priority order to a handler from a static table, so an
+ * event costs one bit of RAM and a table slot, and nothing is queued.
+ */
+
+#include "sched.h"
+#include "rtc.h"
+#include "clock.h"
+#include "watchdog.h"
+#include "tick.h"
+#include "trace.h"
+
+typedef struct {
+    sched_task_fn fn;
+    uint16_t period;
+    uint16_t countdown;
+} sched_task;
+
+static sched_task tasks[SCHED_MAX_TASKS];
+static uint8_t task_count;
+static volatile uint16_t pending_ticks;
+static volatile uint8_t pending_events;    // Bit per Sched_Event
+static sched_task_fn handlers[SCHED_EV_COUNT];
+
+typedef char sched_events_check[SCHED_EV_COUNT <= 8 ? 1 : -1];
+static sched_task_fn deferred;
+static uint32_t deferred_at;
+
+void rtc_wakeup_callback(void)
+{
+    pending_ticks++;
+}
+
+__weak uint8_t sched_busy(void)
+{
+    return 0;
+}
+
+
+void sched_defer(sched_task_fn fn, uint32_t at_ms)
+{
+    deferred = fn;
+    deferred_at = at_ms;
+}
+
+static uint8_t sched_deferred_due(void)
+{
+    return deferred && (int32_t)(HAL_GetTick() - deferred_at) >= 0;
+}
+
+// Tasks run under the watchdog's budget; every event and the deferred
+// call count as one more task each
+static void sched_call(sched_task_fn fn, uint8_t id)
+{
+#if WATCHDOG
+    uint32_t start = HAL_GetTick();
+    watchdog_task_begin(id);
+    fn();
+    watchdog_task_end(HAL_GetTick() - start);
+#else
+    fn();
+#endif
+}
+
+sched_task_fn sched_on(Sched_Event ev, sched_task_fn fn)
+{
+    sched_task_fn old = handlers[ev];
+    handlers[ev] = fn;
+    return old;
+}
+
+void sched_post(Sched_Event ev)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    pending_events |= 1U << ev;
+    __set_PRIMASK(primask);
+}
+
+void sched_dispatch(void)
+{
+    while (pending_events)
+    {
+        __disable_irq();
+        uint8_t ev = 0;
+        while (!(pending_events & (1U << ev)))
+            ev++;
+        pending_events &= ~(1U << ev);
+        __enable_irq();
+
+        if (handlers[ev])
+            sched_call(handlers[ev], SCHED_MAX_TASKS + ev);
+    }
+}
+
+void sched_init(uint16_t tick_ms)
+{
+    task_count = 0;
+    pending_ticks = 1;  // Run every task once right away
+
+    // VREFINT off in STOP, and do not wait for it on wake-up
+    HAL_PWREx_EnableUltraLowPower();
+    HAL_PWREx_EnableFastWakeUp();
+#ifdef DEBUG
+    HAL_DBGMCU_EnableDBGStopMode();
+#endif
+
+    rtc_init();
+    rtc_start_wakeup(tick_ms);
+}
+
+uint8_t sched_add_task(sched_task_fn fn, uint16_t period)
+{
+    if (task_count >= SCHED_MAX_TASKS || period == 0) return 0;
+    tasks[task_count].fn = fn;
+    tasks[task_count].period = period;
+    tasks[task_count].countdown = 1;
+    task_count++;
+    return 1;
+}
+
+static void sched_idle(void)
+{
+    // DMA and I2C stop in STOP mode, let in-flight transfers finish first
+    while (sched_busy())
+        __WFI();
+
+    __disable_irq();
+    if (pending_ticks || pending_events || sched_deferred_due())
+    {
+        __enable_irq();
+        return;
+    }
+    if (deferred)
+    {
+#if TICK_LPTIM
+        tick_wakeup_at(deferred_at);
+#else
+        // SysTick stops in STOP mode, wait for the deadline in Sleep
+        __enable_irq();
+        __WFI();
+        return;
+#endif
+    }
+
+    TRACE_POINT(TRACE_SLEEP);
+    clock_prepare_stop();
+    HAL_SuspendTick();
+    HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+    __enable_irq();  // The wake-up interrupt is taken here
+
+    clock_restore();
+    HAL_ResumeTick();
+    TRACE_VALUE(TRACE_WAKE, HAL_GetTick());
+    TRACE_VALUE(TRACE_CLOCK, SystemCoreClock / 1000U);
+}
+
+void sched_run(void)
+{
+    while (1)
+    {
+        sched_dispatch();
+        while (pending_ticks)
+        {
+            __disable_irq();
+            pending_ticks--;
+            __enable_irq();
+
+            for (uint8_t i = 0; i < task_count; i++)
+            {
+                if (--tasks[i].countdown == 0)
+                {
+                    tasks[i].countdown = tasks[i].period;
+                    sched_dispatch();
+                    sched_call(tasks[i].fn, i);
+                }
+            }
+        }
+        sched_dispatch();
+        if (sched_deferred_due())
+        {
+            sched_task_fn fn = deferred;
+            deferred = 0;
+            sched_call(fn, SCHED_MAX_TASKS + SCHED_EV_COUNT);
+        }
+        sched_idle();
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "stm32l0xx_hal.h"
+
+#define SCHED_MAX_TASKS 6
+
+typedef void (*sched_task_fn)(void);
+
+/**
+ * Events posted from interrupt handlers, in priority order: pending events
+ * are dispatched lowest number first, ahead of the tick tasks and between
+ * them. The list is the project's; handlers are bound with sched_on().
+ */
+typedef enum {
+    SCHED_EV_BROWNOUT = 0,  ///< VDD fell through the PVD level (supply.c)
+    SCHED_EV_BUTTON,        ///< A button press was recorded (button.c)
+    SCHED_EV_DISPLAY,       ///< A flush completed with a redraw waiting
+    SCHED_EV_COMMAND,       ///< A telemetry command arrived (telemetry.c)
+    SCHED_EV_COUNT
+} Sched_Event;
+
+/**
+ * @brief Initialize the scheduler and start the RTC wake-up tick.
+ *
+ * @param tick_ms Scheduler tick period in milliseconds
+ */
+void sched_init(uint16_t tick_ms);
+
+/**
+ * @brief Register a periodic task.
+ *
+ * Tasks run in registration order on every tick where they are due, so a
+ * sequence like read → format → display can be registered as separate tasks
+ * with the same period.
+ *
+ * @param fn Task function
+ * @param period Period in scheduler ticks (1 = every tick)
+ * @return 1 if the task was added, 0 if the task table is full
+ */
+uint8_t sched_add_task(sched_task_fn fn, uint16_t period);
+
+/**
+ * @brief Run a function once at a given time, outside the tick.
+ *
+ * For the second half of a task that has to wait for hardware, e.g. a
+ * sensor conversion: the task starts it, defers the rest and returns, and
+ * the core sleeps until the deadline instead of waiting in the task. With
+ * TICK_LPTIM the LPTIM1 compare wakes the core from STOP at the deadline;
+ * without it the scheduler stays in Sleep mode while a call is deferred.
+ * There is one slot; a new call replaces the one pending.
+ *
+ * @param fn Function to run; runs under the watchdog like a task (index
+ *           SCHED_MAX_TASKS + SCHED_EV_COUNT). NULL cancels the pending
+ *           call.
+ * @param at_ms Earliest run time on the HAL_GetTick() scale
+ */
+void sched_defer(sched_task_fn fn, uint32_t at_ms);
+
+/**
+ * @brief Run the scheduler forever.
+ *
+ * Runs all due tasks, then enters STOP mode with the low-power regulator
+ * until the next RTC wake-up. The clock profile in use is restored with
+ * clock_restore() after every wake-up. With WATCHDOG every task run
+ * is checked against WATCHDOG_TASK_BUDGET_MS (watchdog.h).
+ */
+void sched_run(void);
+
+/**
+ * @brief Report whether a peripheral transfer is still in flight.
+ *
+ * Called before entering STOP mode. While it returns non-zero the core only
+ * enters Sleep mode (WFI), so DMA and I2C keep running. Weak default returns 0.
+ *
+ * @return Non-zero if STOP mode must be postponed
+ */
+uint8_t sched_busy(void);
+
+/**
+ * @brief Bind the handler of an event.
+ *
+ * Handlers run to completion in the scheduler loop, under the watchdog
+ * like a task (index SCHED_MAX_TASKS + event); a higher-priority event
+ * posted meanwhile is taken right after the handler returns.
+ *
+ * @param ev Event
+ * @param fn Handler, or NULL to drop the event
+ * @return The handler bound before
+ */
+sched_task_fn sched_on(Sched_Event ev, sched_task_fn fn);
+
+/**
+ * @brief Mark an event pending without waiting for the next tick.
+ *
+ * Safe from interrupt context; the interrupt wakes the core from STOP and
+ * the scheduler dispatches the event before idling again. Posts made
+ * before the handler is called collapse into one.
+ *
+ * @param ev Event
+ */
+void sched_post(Sched_Event ev);
+
+/**
+ * @brief Run the handlers of all pending events, highest priority first.
+ *
+ * sched_run() calls it on its own; exported for the Bench build, which
+ * times a post and its dispatch.
+ */
+void sched_dispatch(void);
+
+#endif // SCHED_H
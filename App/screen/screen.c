@@ -0,0 +1,50 @@
+/**
+ * @file screen.c
+ * @brief Screen manager: one active view, drawn on activation and refreshed per sample
+ */
+
+#include "screen.h"
+#include "oled.h"
+#include "oled_text.h"
+
+static const screen_view *table;
+static uint8_t view_count;
+static uint8_t current;
+
+void screen_init(const screen_view *views, uint8_t count)
+{
+    table = views;
+    view_count = count;
+    current = count;    // Nothing to leave yet
+    screen_show(0);
+}
+
+void screen_show(uint8_t index)
+{
+    if (index >= view_count) return;
+    if (current < view_count && table[current].leave)
+        table[current].leave();
+    current = index;
+
+    oled_frame_begin();
+    oled_clear();
+    oled_text_reset();
+    table[index].enter();
+    oled_frame_end();
+}
+
+void screen_step(int8_t step)
+{
+    uint8_t next = current + view_count + step;
+    screen_show(next % view_count);
+}
+
+uint8_t screen_current(void)
+{
+    return current;
+}
+
+uint8_t screen_update(void)
+{
+    return table[current].update ? table[current].update() : 0;
+}
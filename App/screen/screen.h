@@ -0,0 +1,58 @@
+/**
+ * @file screen.h
+ * @brief Screen manager: one active view, drawn on activation and refreshed per sample
+ *
+ * Views are kept as a table of callbacks. Only the active view draws, so
+ * the others cost nothing until they are shown; a view builds its layout
+ * and fills its content in enter() when it becomes active. A switch
+ * redraws the frame buffer inside oled_frame_begin()/oled_frame_end(), so
+ * only the pages that differ from the previous view go out on the bus.
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    void (*enter)(void);        ///< Draw the whole view into the cleared buffer
+    uint8_t (*update)(void);    ///< Refresh after a new sample, 1 if it drew; may be NULL
+    void (*leave)(void);        ///< Called before another view is shown; may be NULL
+} screen_view;
+
+/**
+ * @brief Set the view table and show the first view.
+ *
+ * @param views Table, must stay valid
+ * @param count Number of views
+ */
+void screen_init(const screen_view *views, uint8_t count);
+
+/**
+ * @brief Make a view active and draw it.
+ *
+ * @param index View to show; out of range is ignored
+ */
+void screen_show(uint8_t index);
+
+/**
+ * @brief Step to the following or the previous view, wrapping around.
+ *
+ * @param step +1 or -1
+ */
+void screen_step(int8_t step);
+
+/**
+ * @brief Index of the active view.
+ */
+uint8_t screen_current(void);
+
+/**
+ * @brief Let the active view refresh its content.
+ *
+ * @return 1 if the view drew anything, 0 otherwise
+ */
+uint8_t screen_update(void);
+
+#endif // SCREEN_H
@@ -0,0 +1,132 @@
+/**
+ * @file supply.c
+ * @brief Supply voltage measurement through VREFINT and degradation tiers
+ *
+ * VDD = VREFINT_CAL_MV * VREFINT_CAL / VREFINT_DATA. This is the only
+ * runtime division in the firmware; it runs once per measurement, so the
+ * libgcc routine is cheaper than a reciprocal table.
+ */
+
+#include "supply.h"
+#include "main.h"
+#include "sched.h"
+
+#define SUPPLY_TIMEOUT_MS 5
+
+static const uint16_t tier_mv[SUPPLY_TIER_COUNT] = {
+    0xFFFF, SUPPLY_SAVE_MV, SUPPLY_DIM_MV, SUPPLY_DARK_MV
+};
+
+static Supply_Tier tier;
+static uint16_t last_mv;
+
+static uint8_t supply_wait(volatile uint32_t *reg, uint32_t mask, uint32_t value)
+{
+    uint32_t start = HAL_GetTick();
+    while ((*reg & mask) != value)
+    {
+        if (HAL_GetTick() - start > SUPPLY_TIMEOUT_MS) return 0;
+    }
+    return 1;
+}
+
+// Calibrate, enable and run one conversion; 0 if any step times out
+static uint32_t supply_convert(void)
+{
+    ADC1->CR |= ADC_CR_ADCAL;
+    if (!supply_wait(&ADC1->CR, ADC_CR_ADCAL, 0)) return 0;
+
+    ADC1->ISR = ADC_ISR_ADRDY;
+    ADC1->CR |= ADC_CR_ADEN;
+    if (!supply_wait(&ADC1->ISR, ADC_ISR_ADRDY, ADC_ISR_ADRDY)) return 0;
+
+    // The ultra-low-power mode keeps VREFINT off in STOP; wait for it to settle
+    if (!supply_wait(&SYSCFG->CFGR3, SYSCFG_CFGR3_VREFINT_RDYF, SYSCFG_CFGR3_VREFINT_RDYF)) return 0;
+
+    ADC1->CR |= ADC_CR_ADSTART;
+    if (!supply_wait(&ADC1->ISR, ADC_ISR_EOC, ADC_ISR_EOC)) return 0;
+    return ADC1->DR;
+}
+
+uint16_t supply_measure_mv(void)
+{
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    __HAL_RCC_SYSCFG_CLK_ENABLE();
+
+    // PCLK/2, low-frequency mode below 3.5 MHz (MSI profiles)
+    ADC1->CFGR2 = ADC_CFGR2_CKMODE_0 | ADC_CFGR2_OVSE |
+                  ADC_CFGR2_OVSR_1 | ADC_CFGR2_OVSR_0 | ADC_CFGR2_OVSS_2;     // 16x, >> 4
+    ADC->CCR = ADC_CCR_VREFEN | (SystemCoreClock < 7000000U ? ADC_CCR_LFMEN : 0);
+    ADC1->SMPR = ADC_SMPR_SMP;         // 160.5 cycles, VREFINT needs >= 10 us
+    ADC1->CHSELR = ADC_CHSELR_CHSEL17;
+
+    ADC1->CR = ADC_CR_ADVREGEN;
+    HAL_Delay(1);                      // tADCVREG_STUP is 20 us
+
+    uint32_t raw = supply_convert();
+
+    if (ADC1->CR & ADC_CR_ADEN)
+    {
+        ADC1->CR |= ADC_CR_ADDIS;
+        supply_wait(&ADC1->CR, ADC_CR_ADEN, 0);
+    }
+    ADC1->CR = 0;
+    ADC->CCR = 0;
+    __HAL_RCC_ADC1_CLK_DISABLE();
+
+    if (raw == 0) return 0;
+    return (uint16_t)((VREFINT_CAL_MV * *VREFINT_CAL_ADDR + raw / 2) / raw);
+}
+
+Supply_Tier supply_update(void)
+{
+    uint16_t mv = supply_measure_mv();
+    if (mv == 0) return tier;      // Keep the tier on a failed measurement
+    last_mv = mv;
+
+    // Drop as far as needed at once, climb one tier at a time with hysteresis
+    while (tier < SUPPLY_TIER_DARK && mv < tier_mv[tier + 1])
+        tier++;
+    while (tier > SUPPLY_TIER_NORMAL && mv >= tier_mv[tier] + SUPPLY_HYSTERESIS_MV)
+        tier--;
+    return tier;
+}
+
+Supply_Tier supply_tier(void)
+{
+    return tier;
+}
+
+uint16_t supply_last_mv(void)
+{
+    return last_mv;
+}
+
+#if SUPPLY_PVD
+void supply_pvd_init(void)
+{
+    PWR_PVDTypeDef pvd = {
+        .PVDLevel = SUPPLY_PVD_LEVEL,
+        .Mode = PWR_PVD_MODE_IT_RISING_FALLING,
+    };
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_ConfigPVD(&pvd);
+    HAL_PWR_EnablePVD();
+    HAL_NVIC_SetPriority(PVD_IRQn, IRQ_PRIO_TIMING, 0);
+    HAL_NVIC_EnableIRQ(PVD_IRQn);
+}
+
+uint8_t supply_pvd_low(void)
+{
+    return (PWR->CSR & PWR_CSR_PVDO) != 0;
+}
+
+void supply_pvd_irq_handler(void)
+{
+    __HAL_PWR_PVD_EXTI_CLEAR_FLAG();
+    // Either edge lands here; PVDO tells a drop from a recovery
+    if (supply_pvd_low())
+        sched_post(SCHED_EV_BROWNOUT);
+}
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file supply.h
+ * @brief Supply voltage measurement through VREFINT and degradation tiers
+ */
+
+#ifndef SUPPLY_H
+#define SUPPLY_H
+
+#include "stm32l0xx_hal.h"
+
+/** Runtime operating tiers, from full service to display off */
+typedef enum {
+    SUPPLY_TIER_NORMAL = 0,
+    SUPPLY_TIER_SAVE,       // Slower sampling, lowest-charge sensor profile
+    SUPPLY_TIER_DIM,        // ... and the display capped at low contrast
+    SUPPLY_TIER_DARK,       // ... and the display off
+    SUPPLY_TIER_COUNT
+} Supply_Tier;
+
+/** Tier entry thresholds: the tier applies below this VDD, in mV */
+#ifndef SUPPLY_SAVE_MV
+#define SUPPLY_SAVE_MV    2700
+#endif
+#ifndef SUPPLY_DIM_MV
+#define SUPPLY_DIM_MV     2500
+#endif
+#ifndef SUPPLY_DARK_MV
+#define SUPPLY_DARK_MV    2200
+#endif
+
+/** A tier is only left once VDD is this far above its threshold */
+#define SUPPLY_HYSTERESIS_MV 50
+
+/**
+ * 1: the PVD posts SCHED_EV_BROWNOUT when VDD falls through
+ * SUPPLY_PVD_LEVEL, so the RAM batches reach EEPROM before the supply is
+ * gone; 0: the EEPROM log only flushes on entering SUPPLY_TIER_DARK
+ */
+#ifndef SUPPLY_PVD
+#define SUPPLY_PVD 1
+#endif
+
+/**
+ * PVD level, falling edge: level 1 is 2.08 V typical, below the dark tier
+ * and 0.4 V above the 1.65 V EEPROM programming minimum (BOR is left off
+ * in the option bytes, the PDR sits lower still)
+ */
+#ifndef SUPPLY_PVD_LEVEL
+#define SUPPLY_PVD_LEVEL  PWR_PVDLEVEL_1
+#endif
+
+#define VREFINT_CAL_ADDR  ((const uint16_t *)0x1FF80078)  // Raw VREFINT at 3.0 V, 30 °C
+#define VREFINT_CAL_MV    3000U
+
+/**
+ * @brief Measure VDD.
+ *
+ * Powers the ADC up, samples VREFINT with 16x hardware oversampling against
+ * the factory calibration and powers everything down again. Takes a few
+ * milliseconds, dominated by the VREFINT start-up after STOP, so call it
+ * rarely and from an existing wake-up. The ADC is driven at register level
+ * (the HAL ADC module is not part of this project).
+ *
+ * @return VDD in mV, or 0 if the ADC did not respond
+ */
+uint16_t supply_measure_mv(void);
+
+/**
+ * @brief Measure VDD and update the tier.
+ *
+ * @return Tier after this measurement
+ */
+Supply_Tier supply_update(void);
+
+/**
+ * @brief Tier selected by the last supply_update().
+ */
+Supply_Tier supply_tier(void);
+
+/**
+ * @brief VDD from the last supply_update(), in mV (0 before the first one).
+ */
+uint16_t supply_last_mv(void);
+
+#if SUPPLY_PVD
+/**
+ * @brief Arm the PVD interrupt on both edges of SUPPLY_PVD_LEVEL.
+ *
+ * The ultra-low-power mode switches VREFINT, and with it the PVD, off in
+ * STOP, so the supply is watched while the core runs, which is when
+ * current is drawn. Needs sched_init() for the event.
+ */
+void supply_pvd_init(void);
+
+/**
+ * @brief Report whether VDD is below SUPPLY_PVD_LEVEL right now.
+ */
+uint8_t supply_pvd_low(void);
+
+/**
+ * @brief PVD interrupt (EXTI line 16): posts SCHED_EV_BROWNOUT on a drop.
+ */
+void supply_pvd_irq_handler(void);
+#endif
+
+#endif // SUPPLY_H
@@ -0,0 +1,472 @@
+/**
+ * @file telemetry.c
+ * @brief Binary measurement frames and bulk dumps on LPUART1 (PA2 TX, PA3 RX)
+ *
+ * LPUART1 and DMA1 channel 2 are programmed at register level; the HAL UART
+ * module is not part of this project.
+ */
+
+#include "telemetry.h"
+#include "eeprom.h"
+#include "energy.h"
+#include "factory.h"
+#include "i2c_bus.h"
+#include "history.h"
+#include "logger.h"
+#include "main.h"
+#include "modbus.h"
+#include "pyramid.h"
+#include "prof.h"
+#include "rtc.h"
+#include "sched.h"
+#include "tick.h"
+#include "trace.h"
+#include <string.h>
+
+#define TELEMETRY_DMA_REQUEST   5       // CSELR C2S: LPUART1_TX
+#define LSE_HZ                  32768U
+
+static uint8_t frame[TELEMETRY_FRAME_LEN];
+static uint8_t seq;
+static uint8_t staged;                  // frame holds a frame not yet sent
+static volatile uint8_t sending;
+static volatile uint8_t dump_requested;
+static volatile uint8_t time_bytes;     // Bytes of a 'T' argument still to come
+static volatile uint8_t time_received;
+static volatile uint32_t time_value;
+static volatile uint8_t config_bytes;   // Bytes of a 'C' argument still to come
+static volatile uint8_t config_received;
+static volatile uint8_t config_requested;
+static uint8_t config_rx[CONFIG_RECORD_BYTES];
+#if PROF
+static volatile uint8_t prof_requested;
+#define PROF_REQUESTED  prof_requested
+#else
+#define PROF_REQUESTED  0
+#endif
+#if TRACE
+static volatile uint8_t trace_requested;
+#define TRACE_REQUESTED trace_requested
+#else
+#define TRACE_REQUESTED 0
+#endif
+#if FACTORY
+#define FACTORY_RX(c)   factory_rx(c)
+#else
+#define FACTORY_RX(c)   0
+#endif
+
+// A transfer is a chain of buffers, one DMA run each
+static telemetry_segment segs[TELEMETRY_SEGMENTS];
+static uint8_t seg_next, seg_count;
+static uint8_t dump_header[TELEMETRY_DUMP_HEADER_LEN];
+static uint8_t dump_crc[2];
+
+static void telemetry_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void telemetry_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+void telemetry_init(void)
+{
+    GPIO_InitTypeDef gpio = {0};
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+    PWR->CR |= PWR_CR_DBP;
+    RCC->CSR |= RCC_CSR_LSEON;
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    gpio.Pin = GPIO_PIN_2 | GPIO_PIN_3;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Pull = GPIO_PULLUP;            // Keeps an unconnected RX idle
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    gpio.Alternate = GPIO_AF6_LPUART1;
+    HAL_GPIO_Init(GPIOA, &gpio);
+
+    RCC->CCIPR |= RCC_CCIPR_LPUART1SEL;         // 11: LSE
+    RCC->APB1ENR |= RCC_APB1ENR_LPUART1EN;
+    LPUART1->CR1 = 0;
+    LPUART1->BRR = (256U * LSE_HZ + TELEMETRY_BAUD / 2) / TELEMETRY_BAUD;
+    // The LSE keeps the receiver running in STOP; a command byte wakes
+    // the core through EXTI line 28
+    LPUART1->CR1 = USART_CR1_TE | USART_CR1_RE | USART_CR1_RXNEIE | USART_CR1_UESM | USART_CR1_UE;
+    EXTI->IMR |= EXTI_IMR_IM28;
+
+    HAL_NVIC_SetPriority(LPUART1_IRQn, IRQ_PRIO_BUS, 0);
+    HAL_NVIC_EnableIRQ(LPUART1_IRQn);
+}
+
+void telemetry_queue(const BME280_Measurement *m, uint8_t status)
+{
+#if MODBUS
+    // Only polls get an answer; a frame would collide with a reply
+    (void)m;
+    (void)status;
+    return;
+#endif
+    // The DMA reads frame[] while it is on the wire; skip the number so
+    // the host still sees the drop
+    if (sending)
+    {
+        seq++;
+        return;
+    }
+
+    frame[0] = TELEMETRY_SYNC;
+    frame[1] = seq++;
+    telemetry_put32(&frame[2], (uint32_t)m->temperature);
+    telemetry_put32(&frame[6], m->pressure);
+    telemetry_put32(&frame[10], m->humidity);
+    frame[14] = status;
+    telemetry_put32(&frame[15], energy_charge_uah());
+    // Tracking runs at tens of Hz; the host takes the rate from ms stamps
+    telemetry_put32(&frame[19], status & TELEMETRY_STATUS_TRACK ? HAL_GetTick() : rtc_time());
+    telemetry_put16(&frame[23], eeprom_crc16(frame, TELEMETRY_FRAME_LEN - 2));
+    staged = 1;
+}
+
+// Load the next segment into the channel; 0 when all are out
+static uint8_t telemetry_next_segment(void)
+{
+    if (seg_next == seg_count) return 0;
+
+    DMA1_Channel2->CCR = 0;
+    DMA1_Channel2->CMAR = (uint32_t)segs[seg_next].data;
+    DMA1_Channel2->CNDTR = segs[seg_next].len;
+    seg_next++;
+    // Memory to peripheral, bytes, no DMA interrupts: TC on the LPUART
+    // marks the end, after the last stop bit instead of the last DMA write
+    DMA1_Channel2->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+    return 1;
+}
+
+// Header and CRC in RAM, the rings and the log region sent where they are
+static void telemetry_build_dump(void)
+{
+    History_Image img;
+    Pyramid_Image pyr;
+    history_image(&img);
+    pyramid_image(&pyr);
+
+    uint8_t *h = dump_header;
+    h[0] = TELEMETRY_DUMP_SYNC;
+    h[1] = TELEMETRY_DUMP_VERSION;
+    telemetry_put16(&h[2], TELEMETRY_DUMP_HEADER_LEN - 4 + HISTORY_BYTES + EEPROM_LOG_SIZE +
+                           sizeof(Pyramid_Bucket) * PYRAMID_HOUR_QUARTERS);
+    h[4] = HISTORY_CHANNELS;
+    h[5] = LOGGER_RECORDS_PER_BLOCK;
+    telemetry_put16(&h[6], HISTORY_BYTES);
+    telemetry_put16(&h[8], img.head);
+    telemetry_put16(&h[10], img.used);
+    telemetry_put16(&h[12], img.count);
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+        telemetry_put16(&h[14 + 2 * ch], (uint16_t)img.oldest[ch]);
+    telemetry_put16(&h[20], EEPROM_LOG_SIZE);
+    h[22] = LOGGER_BLOCK_BYTES;
+    h[23] = PYRAMID_HOUR_QUARTERS;
+    telemetry_put32(&h[24], img.newest_time);
+    telemetry_put16(&h[28], img.period_s);
+    telemetry_put16(&h[30], logger_period());
+    h[32] = pyr.count;
+    h[33] = pyr.head;
+
+    const uint8_t *log = eeprom_ptr(EEPROM_LOG);
+    uint16_t crc = eeprom_crc16(dump_header, TELEMETRY_DUMP_HEADER_LEN);
+    crc = eeprom_crc16_update(crc, img.ring, HISTORY_BYTES);
+    crc = eeprom_crc16_update(crc, log, EEPROM_LOG_SIZE);
+    crc = eeprom_crc16_update(crc, pyr.ring, sizeof(Pyramid_Bucket) * PYRAMID_HOUR_QUARTERS);
+    telemetry_put16(dump_crc, crc);
+
+    segs[0].data = dump_header;
+    segs[0].len = TELEMETRY_DUMP_HEADER_LEN;
+    segs[1].data = img.ring;
+    segs[1].len = HISTORY_BYTES;
+    segs[2].data = log;
+    segs[2].len = EEPROM_LOG_SIZE;
+    segs[3].data = (const uint8_t *)pyr.ring;
+    segs[3].len = sizeof(Pyramid_Bucket) * PYRAMID_HOUR_QUARTERS;
+    segs[4].data = dump_crc;
+    segs[4].len = sizeof(dump_crc);
+    seg_count = 5;
+}
+
+// Send the chain in segs[]; the bus DMA channel is already lent
+static void telemetry_start(void)
+{
+    seg_next = 0;
+
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C2S) |
+                        (TELEMETRY_DMA_REQUEST << DMA_CSELR_C2S_Pos);
+    DMA1_Channel2->CPAR = (uint32_t)&LPUART1->TDR;
+    telemetry_next_segment();
+
+    LPUART1->ICR = USART_ICR_TCCF;
+    LPUART1->CR3 |= USART_CR3_DMAT;
+    LPUART1->CR1 |= USART_CR1_TCIE;
+}
+
+#if PROF
+// Two header bytes, the table as it is in RAM (little endian), CRC
+static void telemetry_build_profile(void)
+{
+    dump_header[0] = TELEMETRY_PROF_SYNC;
+    dump_header[1] = PROF_PHASES;
+
+    uint16_t crc = eeprom_crc16(dump_header, 2);
+    crc = eeprom_crc16_update(crc, (const uint8_t *)prof_table, sizeof(prof_table));
+    telemetry_put16(dump_crc, crc);
+
+    segs[0].data = dump_header;
+    segs[0].len = 2;
+    segs[1].data = (const uint8_t *)prof_table;
+    segs[1].len = sizeof(prof_table);
+    segs[2].data = dump_crc;
+    segs[2].len = sizeof(dump_crc);
+    seg_count = 3;
+}
+#endif
+
+#if TRACE
+// Sync byte, the ring as it is in RAM (little endian), CRC. Recording is
+// held until the last byte is out, so the block is one consistent snapshot.
+static void telemetry_build_trace(void)
+{
+    trace_hold(1);
+    dump_header[0] = TELEMETRY_TRACE_SYNC;
+
+    uint16_t crc = eeprom_crc16(dump_header, 1);
+    crc = eeprom_crc16_update(crc, (const uint8_t *)&trace_ring, sizeof(trace_ring));
+    telemetry_put16(dump_crc, crc);
+
+    segs[0].data = dump_header;
+    segs[0].len = 1;
+    segs[1].data = (const uint8_t *)&trace_ring;
+    segs[1].len = sizeof(trace_ring);
+    segs[2].data = dump_crc;
+    segs[2].len = sizeof(dump_crc);
+    seg_count = 3;
+}
+#endif
+
+// Four header bytes, the record where it is (EEPROM or flash), CRC
+static void telemetry_build_config(void)
+{
+    const Config_Record *cfg = config_get();
+
+    dump_header[0] = TELEMETRY_CONFIG_SYNC;
+    dump_header[1] = CONFIG_VERSION;
+    dump_header[2] = config_stored();
+    dump_header[3] = sizeof(Config_Record);
+
+    uint16_t crc = eeprom_crc16(dump_header, 4);
+    crc = eeprom_crc16_update(crc, cfg, sizeof(Config_Record));
+    telemetry_put16(dump_crc, crc);
+
+    segs[0].data = dump_header;
+    segs[0].len = 4;
+    segs[1].data = (const uint8_t *)cfg;
+    segs[1].len = sizeof(Config_Record);
+    segs[2].data = dump_crc;
+    segs[2].len = sizeof(dump_crc);
+    seg_count = 3;
+}
+
+uint8_t telemetry_take_config(Config_Record *out)
+{
+#if MODBUS
+    return modbus_take_config(out);
+#endif
+    if (!config_received) return 0;
+    memcpy(out, config_rx, sizeof(*out));
+    config_received = 0;
+    config_requested = 1;
+    return 1;
+}
+
+uint8_t telemetry_send(const telemetry_segment *chain, uint8_t count)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t ok = !sending && count <= TELEMETRY_SEGMENTS &&
+                 (RCC->CSR & RCC_CSR_LSERDY) && i2c_bus_lend_dma();
+    if (ok)
+    {
+        sending = 1;
+        memcpy(segs, chain, count * sizeof(*chain));
+        seg_count = count;
+        telemetry_start();
+    }
+    __set_PRIMASK(primask);
+    return ok;
+}
+
+void telemetry_poll(void)
+{
+#if MODBUS
+    modbus_poll();
+#endif
+    if (time_received)
+    {
+        time_received = 0;
+        rtc_set_time(time_value);
+    }
+    if ((!staged && !dump_requested && !config_requested && !PROF_REQUESTED && !TRACE_REQUESTED) ||
+        sending ||
+        !(RCC->CSR & RCC_CSR_LSERDY)) return;
+    if (!i2c_bus_lend_dma()) return;
+
+    sending = 1;
+    if (dump_requested)
+    {
+        // A dump goes first; a staged frame waits behind it
+        dump_requested = 0;
+        telemetry_build_dump();
+    }
+    else if (config_requested)
+    {
+        config_requested = 0;
+        telemetry_build_config();
+    }
+#if PROF
+    else if (prof_requested)
+    {
+        prof_requested = 0;
+        telemetry_build_profile();
+    }
+#endif
+#if TRACE
+    else if (trace_requested)
+    {
+        trace_requested = 0;
+        telemetry_build_trace();
+    }
+#endif
+    else
+    {
+        staged = 0;
+        segs[0].data = frame;
+        segs[0].len = TELEMETRY_FRAME_LEN;
+        seg_count = 1;
+    }
+    telemetry_start();
+}
+
+uint8_t telemetry_busy(void)
+{
+#if MODBUS && !TICK_LPTIM
+    // The request gap is timed with HAL_GetTick(), and SysTick stops in
+    // STOP. LPTIM1 keeps counting there and each byte wakes the core.
+    if (modbus_receiving()) return 1;
+#endif
+    return sending;
+}
+
+uint8_t telemetry_write_blocking(const void *buf, uint16_t len, uint32_t lse_wait_ms)
+{
+    const uint8_t *p = buf;
+    uint32_t start = HAL_GetTick();
+
+    while (!(RCC->CSR & RCC_CSR_LSERDY))
+        if (HAL_GetTick() - start >= lse_wait_ms) return 0;
+    while (sending) __WFI();
+
+    while (len--)
+    {
+        while (!(LPUART1->ISR & USART_ISR_TXE));
+        LPUART1->TDR = *p++;
+    }
+    while (!(LPUART1->ISR & USART_ISR_TC));
+    return 1;
+}
+
+#if !MODBUS
+// A byte of the single-byte command protocol, or of a command argument
+static void telemetry_command(uint8_t c)
+{
+    if (time_bytes)
+    {
+        // Little endian, the last byte received ends up on top
+        time_value = (time_value >> 8) | ((uint32_t)c << 24);
+        if (--time_bytes == 0)
+        {
+            time_received = 1;
+            sched_post(SCHED_EV_COMMAND);
+        }
+    }
+    else if (config_bytes)
+    {
+        config_rx[sizeof(config_rx) - config_bytes] = c;
+        if (--config_bytes == 0)
+        {
+            config_received = 1;
+            sched_post(SCHED_EV_COMMAND);
+        }
+    }
+    else if (c == TELEMETRY_CMD_TIME) time_bytes = 4;
+    else if (c == TELEMETRY_CMD_CONFIG) config_bytes = sizeof(config_rx);
+    else if (c == TELEMETRY_CMD_CONFIG_GET)
+    {
+        config_requested = 1;
+        sched_post(SCHED_EV_COMMAND);
+    }
+    else if (c == TELEMETRY_CMD_DUMP)
+    {
+        dump_requested = 1;
+        sched_post(SCHED_EV_COMMAND);
+    }
+#if PROF
+    else if (c == TELEMETRY_CMD_PROFILE)
+    {
+        prof_requested = 1;
+        sched_post(SCHED_EV_COMMAND);
+    }
+#endif
+#if TRACE
+    else if (c == TELEMETRY_CMD_TRACE)
+    {
+        trace_requested = 1;
+        sched_post(SCHED_EV_COMMAND);
+    }
+#endif
+}
+#endif
+
+void telemetry_irq_handler(void)
+{
+    uint32_t isr = LPUART1->ISR;
+
+    if (isr & (USART_ISR_RXNE | USART_ISR_ORE))
+    {
+        uint8_t c = (uint8_t)LPUART1->RDR;
+        LPUART1->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF;
+#if MODBUS
+        modbus_rx(c);
+#else
+        if (!FACTORY_RX(c)) telemetry_command(c);
+#endif // MODBUS
+    }
+
+    if (!(isr & USART_ISR_TC) || !(LPUART1->CR1 & USART_CR1_TCIE)) return;
+
+    LPUART1->ICR = USART_ICR_TCCF;
+    if (telemetry_next_segment()) return;
+
+    LPUART1->CR1 &= ~USART_CR1_TCIE;
+    LPUART1->CR3 &= ~USART_CR3_DMAT;
+    DMA1_Channel2->CCR = 0;
+    DMA1->IFCR = DMA_IFCR_CGIF2;
+    sending = 0;
+#if TRACE
+    trace_hold(0);
+#endif
+    i2c_bus_return_dma();
+}
@@ -0,0 +1,221 @@
+/**
+ * @file telemetry.h
+ * @brief Binary measurement frames and bulk dumps on LPUART1 (PA2 TX, PA3 RX)
+ *
+ * LPUART1 runs from the LSE at 9600 8N1, so its baud rate does not move
+ * with the clock profiles. A frame goes out through DMA while the core
+ * sleeps; the LPUART TC interrupt ends it.
+ *
+ * Frame format (TELEMETRY_FRAME_LEN bytes, all fields little endian):
+ *
+ * | Offset | Size | Field                                           |
+ * |--------|------|-------------------------------------------------|
+ * | 0      | 1    | Sync, TELEMETRY_SYNC (0xA5)                     |
+ * | 1      | 1    | Sequence number, wraps; gaps are dropped frames |
+ * | 2      | 4    | Temperature, int32, 0.01 degC                   |
+ * | 6      | 4    | Pressure, uint32, Q24.8 Pa                      |
+ * | 10     | 4    | Humidity, uint32, Q22.10 %RH                    |
+ * | 14     | 1    | Status, TELEMETRY_STATUS_* bits                 |
+ * | 15     | 4    | Charge used since reset, uint32, µAh (energy.h) |
+ * | 19     | 4    | Sample time, uint32, Unix seconds (rtc.h) or,   |
+ * |        |      | with TELEMETRY_STATUS_TRACK, HAL_GetTick() ms   |
+ * | 23     | 2    | CRC-16/CCITT-FALSE over bytes 0..22             |
+ *
+ * A host decoder resynchronises by looking for the sync byte and checking
+ * the CRC of the 25 bytes starting there; Tools/telemetry.py does that.
+ *
+ * TELEMETRY_CMD_TIME ('T') followed by four bytes of Unix time, little
+ * endian, sets the RTC calendar; Tools/dump.py --set-time sends it.
+ *
+ * Sending TELEMETRY_CMD_DUMP ('D') makes the unit answer with one dump
+ * block holding the RAM history ring, the EEPROM log region of hour
+ * buckets and the quarter bucket ring as they are stored; Tools/dump.py requests and decodes it. Frames queued during
+ * a dump are dropped. Block layout, little endian:
+ *
+ * | Offset  | Size | Field                                          |
+ * |---------|------|------------------------------------------------|
+ * | 0       | 1    | Sync, TELEMETRY_DUMP_SYNC (0x5A)               |
+ * | 1       | 1    | Format version, TELEMETRY_DUMP_VERSION         |
+ * | 2       | 2    | Length N of the rest, not counting the CRC     |
+ * | 4       | 1    | History channels                               |
+ * | 5       | 1    | Log records per block                          |
+ * | 6       | 2    | History ring size R in bytes                   |
+ * | 8       | 6    | History head, used (codes) and sample count    |
+ * | 14      | 6    | Oldest history sample, int16 per channel       |
+ * | 20      | 2    | Log region size L in bytes                     |
+ * | 22      | 1    | Log block size                                 |
+ * | 23      | 1    | Quarter ring slots S                           |
+ * | 24      | 4    | Newest history sample, Unix seconds            |
+ * | 28      | 2    | History sample spacing, s                      |
+ * | 30      | 2    | Log record spacing, s                          |
+ * | 32      | 1    | Closed quarters in the ring                    |
+ * | 33      | 1    | Quarter ring head, the slot written next       |
+ * | 34      | R    | History ring (see history.h for the codes)     |
+ * | 34 + R  | L    | Log region (see logger.c for the blocks)       |
+ * | 34+R+L  | 12 S | Quarter ring, Pyramid_Bucket per slot          |
+ * | 4 + N   | 2    | CRC-16/CCITT-FALSE over bytes 0 .. 3 + N       |
+ *
+ * The data is read while it is sent; a history or log write landing in
+ * the middle of a dump shows as a CRC error and the host asks again.
+ *
+ * With PROF enabled, TELEMETRY_CMD_PROFILE ('P') returns the profiling
+ * table (prof.h): sync TELEMETRY_PROF_SYNC (0x5B), the phase count, then
+ * per phase min, max, sum and count as uint32 cycles, then the CRC over
+ * everything before it. Tools/dump.py --profile decodes it.
+ *
+ * TELEMETRY_CMD_CONFIG ('C') followed by a Config_Record (config.h,
+ * CONFIG_RECORD_BYTES), little endian, stores and applies a new runtime
+ * configuration; TELEMETRY_CMD_CONFIG_GET ('G') only reads it back. Both
+ * answer with the configuration in use: sync TELEMETRY_CONFIG_SYNC
+ * (0x5D), CONFIG_VERSION, 1 if it is stored in EEPROM or 0 for the
+ * defaults, the record size, the record, then the CRC over everything
+ * before it. Tools/config.py sends and decodes them.
+ *
+ * With TRACE enabled, TELEMETRY_CMD_TRACE ('R') returns the event trace
+ * (trace.h): sync TELEMETRY_TRACE_SYNC (0x5C), the Trace_Ring struct as it
+ * is in RAM, then the CRC over everything before it. Tools/trace.py
+ * decodes it into a timeline.
+ *
+ * In the Factory build (factory.h) the link takes reference frames and
+ * the write command of the calibration session at start-up; the commands
+ * above work once the session has ended.
+ *
+ * With MODBUS enabled (modbus.h) the link answers Modbus-RTU polls
+ * instead: no frames are streamed and the single-byte commands above are
+ * not recognised.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "bme280.h"
+#include "config.h"
+
+// 0: no telemetry; PA2 and the LSE are left alone
+#ifndef TELEMETRY
+#define TELEMETRY 1
+#endif
+
+#define TELEMETRY_SYNC          0xA5
+#define TELEMETRY_FRAME_LEN     25
+#define TELEMETRY_BAUD          9600    // Fastest standard rate below LSE / 3
+
+#define TELEMETRY_CMD_DUMP      'D'
+#define TELEMETRY_DUMP_SYNC     0x5A
+#define TELEMETRY_DUMP_VERSION  3
+#define TELEMETRY_DUMP_HEADER_LEN 34
+
+#define TELEMETRY_CMD_PROFILE   'P'
+#define TELEMETRY_CMD_TIME      'T'
+#define TELEMETRY_PROF_SYNC     0x5B
+#define TELEMETRY_CMD_TRACE     'R'
+#define TELEMETRY_TRACE_SYNC    0x5C
+#define TELEMETRY_CMD_CONFIG    'C'
+#define TELEMETRY_CMD_CONFIG_GET 'G'
+#define TELEMETRY_CONFIG_SYNC   0x5D
+
+/** Status byte layout */
+#define TELEMETRY_STATUS_SENSOR_OK      0x01        // Measurement is current
+#define TELEMETRY_STATUS_TIER_Pos       1           // Supply_Tier, 2 bits
+#define TELEMETRY_STATUS_TIER_Msk       (0x3 << TELEMETRY_STATUS_TIER_Pos)
+#define TELEMETRY_STATUS_TREND_Pos      3           // Forecast_Trend, 3 bits
+#define TELEMETRY_STATUS_TREND_Msk      (0x7 << TELEMETRY_STATUS_TREND_Pos)
+#define TELEMETRY_STATUS_ALARM          0x40        // A threshold alarm is active
+#define TELEMETRY_STATUS_TRACK          0x80        // Tracking mode, time field in ms
+
+/** One buffer of a transfer, sent in place by one DMA run */
+typedef struct {
+    const uint8_t *data;
+    uint16_t len;
+} telemetry_segment;
+
+/** Most segments in one transfer */
+#define TELEMETRY_SEGMENTS      5
+
+/**
+ * @brief Start the LSE and set up LPUART1 for transmission.
+ *
+ * Does not wait for the crystal, which can take a second or more to start;
+ * frames are dropped until it is running. Call after rtc_init(), which may
+ * reset the backup domain and with it the LSE enable.
+ */
+void telemetry_init(void);
+
+/**
+ * @brief Queue a frame with a measurement.
+ *
+ * The frame is staged in RAM and goes out from telemetry_poll(). A frame
+ * that is still waiting is replaced, and its sequence number shows up as a
+ * gap on the host.
+ *
+ * @param m Measurement
+ * @param status TELEMETRY_STATUS_* bits
+ */
+void telemetry_queue(const BME280_Measurement *m, uint8_t status);
+
+/**
+ * @brief Start the staged frame if the LSE runs and the DMA channel is free.
+ *
+ * A time received with TELEMETRY_CMD_TIME is applied to the RTC here
+ * first. A requested dump goes before the staged frame. DMA1 channel 2 is
+ * borrowed from the I2C bus layer for the length of the transfer (see
+ * i2c_bus_lend_dma()), so it waits for I2C traffic to end. A received
+ * command posts SCHED_EV_COMMAND, so the poll bound to it answers without
+ * waiting for the next tick.
+ */
+void telemetry_poll(void);
+
+/**
+ * @brief Take a configuration received with TELEMETRY_CMD_CONFIG.
+ *
+ * The caller stores and applies it; the answer carrying the result goes
+ * out from the next telemetry_poll().
+ *
+ * @param out Destination
+ * @return 1 if a new configuration was waiting
+ */
+uint8_t telemetry_take_config(Config_Record *out);
+
+/**
+ * @brief Start a chain of buffers, outside the frame stream.
+ *
+ * Safe to call from interrupts: if the link is idle, the LSE runs and the
+ * bus DMA channel can be lent, the chain is copied and the first segment
+ * starts at once. The buffers are read while they are sent and must stay
+ * untouched until telemetry_busy() returns 0. For replies that answer a
+ * protocol of their own, such as modbus.h.
+ *
+ * @param chain Segments, in order
+ * @param count Number of segments, up to TELEMETRY_SEGMENTS
+ * @return 1 if the transfer started, 0 if the caller has to retry
+ */
+uint8_t telemetry_send(const telemetry_segment *chain, uint8_t count);
+
+/**
+ * @brief Check whether a frame is on the wire.
+ *
+ * DMA does not run in STOP mode, so the scheduler must not stop while this
+ * returns 1.
+ */
+uint8_t telemetry_busy(void);
+
+/**
+ * @brief Send bytes with the core polling TXE, outside the frame stream.
+ *
+ * For start-up reports (see bench.h) before the scheduler runs: waits up
+ * to @p lse_wait_ms for the LSE, then for any DMA transfer to finish.
+ *
+ * @param buf Bytes to send
+ * @param len Number of bytes
+ * @param lse_wait_ms How long to wait for the crystal to start
+ * @return 1 if sent, 0 if the LSE did not start in time
+ */
+uint8_t telemetry_write_blocking(const void *buf, uint16_t len, uint32_t lse_wait_ms);
+
+/**
+ * @brief LPUART1 interrupt service routine body: command bytes and the
+ * end of each transfer segment.
+ */
+void telemetry_irq_handler(void);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,182 @@
+/**
+ * @file tick.c
+ * @brief Tickless HAL timebase on LPTIM1
+ *
+ * Overrides the weak HAL tick functions. LPTIM1 free-runs from LSI/32 and
+ * keeps counting in STOP, so HAL_GetTick() stays valid across sleep and no
+ * periodic interrupt is needed: the counter is extended to 32 bits in the
+ * auto-reload interrupt (every ~57 s), and the compare interrupt is only
+ * armed for the next deadline someone is waiting on.
+ *
+ * Counter ticks are 0.864865 ms; conversions use 886/1024 (ticks -> ms) and
+ * 1184/1024 (ms -> ticks), well inside the ±10 % LSI tolerance.
+ *
+ * LPTIM registers are programmed directly, the HAL LPTIM module is not part
+ * of this project.
+ */
+
+#include "tick.h"
+#include "main.h"
+
+#if TICK_LPTIM
+
+#define TICK_MS_Q10       886U      // ms per counter tick, Q10
+#define TICK_PER_MS_Q10   1184U     // counter ticks per ms, Q10
+#define TICK_WRAP_MS      56704U    // (65536 * TICK_MS_Q10) >> 10, no remainder
+#define TICK_MAX_DELTA    0xFF00U   // Longest compare distance, in ticks
+
+static volatile uint32_t base_ms;   // Time at the last counter wrap
+static uint8_t started;
+
+static uint8_t armed;               // A compare is pending for armed_at
+static uint32_t armed_at;
+static volatile uint8_t cmp_busy;   // CMP write not yet synchronized (CMPOK)
+static uint8_t cmp_queued;
+static uint16_t cmp_next;
+
+// CNT is clocked asynchronously; two equal reads in a row are valid
+static uint32_t tick_read_cnt(void)
+{
+    uint32_t a, b = LPTIM1->CNT;
+    do
+    {
+        a = b;
+        b = LPTIM1->CNT;
+    } while (a != b);
+    return a;
+}
+
+static void tick_write_cmp(uint16_t value)
+{
+    // CMP may only be written again once the previous write reached the
+    // LPTIM clock domain; park the value until CMPOK instead of spinning
+    if (cmp_busy)
+    {
+        cmp_next = value;
+        cmp_queued = 1;
+        return;
+    }
+    cmp_busy = 1;
+    LPTIM1->CMP = value;
+}
+
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
+{
+    (void)TickPriority;
+
+    // Called again on every HAL_RCC_ClockConfig(); LSI is not affected
+    if (started) return HAL_OK;
+
+    RCC->CSR |= RCC_CSR_LSION;
+    while (!(RCC->CSR & RCC_CSR_LSIRDY));
+
+    RCC->CCIPR = (RCC->CCIPR & ~RCC_CCIPR_LPTIM1SEL) | RCC_CCIPR_LPTIM1SEL_0;   // LSI
+    __HAL_RCC_LPTIM1_CLK_ENABLE();
+
+    LPTIM1->CR = 0;
+    LPTIM1->CFGR = LPTIM_CFGR_PRESC_2 | LPTIM_CFGR_PRESC_0;                     // /32
+    LPTIM1->IER = LPTIM_IER_ARRMIE | LPTIM_IER_CMPMIE | LPTIM_IER_CMPOKIE;      // Only while disabled
+    LPTIM1->CR = LPTIM_CR_ENABLE;
+    LPTIM1->ARR = 0xFFFF;
+    while (!(LPTIM1->ISR & LPTIM_ISR_ARROK));
+    LPTIM1->ICR = LPTIM_ICR_ARROKCF;
+    LPTIM1->CR |= LPTIM_CR_CNTSTRT;
+
+    // LPTIM1 wakes the core from STOP through EXTI line 29
+    EXTI->IMR |= EXTI_IMR_IM29;
+
+    // The plan in main.h sets the level; TickPriority is SysTick's
+    HAL_NVIC_SetPriority(LPTIM1_IRQn, IRQ_PRIO_TIMING, 0);
+    HAL_NVIC_EnableIRQ(LPTIM1_IRQn);
+    uwTickPrio = IRQ_PRIO_TIMING;
+    started = 1;
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t cnt = tick_read_cnt();
+    uint32_t ms = base_ms;
+    // A wrap that happened after the mask was set has not been counted yet
+    if ((LPTIM1->ISR & LPTIM_ISR_ARRM) && cnt < 0x8000)
+        ms += TICK_WRAP_MS;
+    __set_PRIMASK(primask);
+    return ms + ((cnt * TICK_MS_Q10) >> 10);
+}
+
+void HAL_IncTick(void)
+{
+}
+
+void HAL_SuspendTick(void)
+{
+}
+
+void HAL_ResumeTick(void)
+{
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    uint32_t start = HAL_GetTick();
+
+    // Same rounding as the HAL: wait at least the requested time
+    if (Delay < HAL_MAX_DELAY) Delay++;
+    while (HAL_GetTick() - start < Delay)
+    {
+        tick_wakeup_at(start + Delay);
+        __WFI();
+    }
+}
+
+void tick_wakeup_at(uint32_t at_ms)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (armed && (int32_t)(at_ms - armed_at) >= 0)
+    {
+        __set_PRIMASK(primask);
+        return;     // An earlier wake-up is already on its way
+    }
+
+    int32_t delta = (int32_t)(at_ms - HAL_GetTick());
+    uint32_t ticks = delta > 0 ? (((uint32_t)delta * TICK_PER_MS_Q10) >> 10) + 1 : 1;
+    if (delta > 0xFFFF || ticks > TICK_MAX_DELTA) ticks = TICK_MAX_DELTA;
+
+    armed = 1;
+    armed_at = at_ms;
+    tick_write_cmp((uint16_t)(tick_read_cnt() + ticks));
+    __set_PRIMASK(primask);
+}
+
+void tick_irq_handler(void)
+{
+    uint32_t isr = LPTIM1->ISR;
+
+    if (isr & LPTIM_ISR_ARRM)
+    {
+        LPTIM1->ICR = LPTIM_ICR_ARRMCF;
+        base_ms += TICK_WRAP_MS;
+    }
+    if (isr & LPTIM_ISR_CMPOK)
+    {
+        LPTIM1->ICR = LPTIM_ICR_CMPOKCF;
+        cmp_busy = 0;
+        if (cmp_queued)
+        {
+            cmp_queued = 0;
+            tick_write_cmp(cmp_next);
+        }
+    }
+    if (isr & LPTIM_ISR_CMPM)
+    {
+        // The waiter is awake now; the next wait arms again
+        LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+        armed = 0;
+    }
+}
+
+#endif // TICK_LPTIM
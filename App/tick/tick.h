@@ -0,0 +1,42 @@
+/**
+ * @file tick.h
+ * @brief Tickless HAL timebase on LPTIM1
+ */
+
+#ifndef TICK_H
+#define TICK_H
+
+#include "stm32l0xx_hal.h"
+#include "rtc.h"
+
+/** 1: HAL_GetTick() runs from LPTIM1 on LSI and SysTick is never started */
+#ifndef TICK_LPTIM
+#define TICK_LPTIM 1
+#endif
+
+#define TICK_LPTIM_HZ   (RTC_LSI_HZ / 32)   // LSI / 32 = 1156.25 Hz
+
+#if TICK_LPTIM
+/**
+ * @brief Make sure the core wakes from WFI/STOP no later than @p at_ms.
+ *
+ * Waits are loops around __WFI() that recheck HAL_GetTick(); there is no
+ * 1 kHz interrupt to break them, so each wait arms its deadline before
+ * sleeping. Only the earliest armed deadline is kept; anyone waiting longer
+ * re-arms on its next iteration. Early wake-ups are harmless. Safe in
+ * interrupt context.
+ *
+ * @param at_ms Deadline on the HAL_GetTick() scale
+ */
+void tick_wakeup_at(uint32_t at_ms);
+
+/**
+ * @brief LPTIM1 interrupt body, called from LPTIM1_IRQHandler().
+ */
+void tick_irq_handler(void);
+#else
+// SysTick wakes the core every millisecond anyway
+static inline void tick_wakeup_at(uint32_t at_ms) { (void)at_ms; }
+#endif
+
+#endif // TICK_H
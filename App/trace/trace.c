@@ -0,0 +1,40 @@
+/**
+ * @file trace.c
+ * @brief Binary event trace ring for latency debugging
+ */
+
+#include "trace.h"
+
+#if TRACE
+
+Trace_Ring trace_ring = { TRACE_MAGIC, TRACE_LEN, 0, { 0 } };
+static volatile uint8_t held;
+
+static void trace_put(Trace_Id id, uint32_t v)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!held)
+    {
+        trace_ring.entries[trace_ring.head & (TRACE_LEN - 1)] = ((uint32_t)id << 24) | (v & 0xFFFFFFU);
+        trace_ring.head++;
+    }
+    __set_PRIMASK(primask);
+}
+
+void trace_point(Trace_Id id)
+{
+    trace_put(id, prof_now());
+}
+
+void trace_value(Trace_Id id, uint32_t v)
+{
+    trace_put(id, v);
+}
+
+void trace_hold(uint8_t hold)
+{
+    held = hold;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @file trace.h
+ * @brief Binary event trace ring for latency debugging
+ *
+ * Trace points drop a 32-bit entry into a RAM ring: the Trace_Id in the
+ * top byte and, below it, the low 24 bits of the PROF cycle counter
+ * (prof.h) or, for the value entries, a 24-bit value. The cycle counter
+ * halts in STOP and counts core cycles at whatever clock runs, so the
+ * ring also records each wake-up with its HAL_GetTick() time and every
+ * clock change with the new HCLK in kHz; the host rebuilds a wall-clock
+ * timeline from those (Tools/trace.py). A point costs a call, the
+ * counter read and a masked store, a few dozen cycles.
+ *
+ * Read the ring with the debugger (trace_ring, e.g. gdb "dump binary
+ * value trace.bin trace_ring") or over telemetry with TELEMETRY_CMD_TRACE.
+ * With TRACE at 0 the points and the ring compile out.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "prof.h"
+
+// 1: trace points compiled in; needs the PROF cycle counter
+#ifndef TRACE
+#define TRACE 0
+#endif
+
+// Entries kept, a power of two; 4 bytes of RAM each
+#ifndef TRACE_LEN
+#define TRACE_LEN 64
+#endif
+
+#if TRACE && !PROF
+#error "TRACE needs PROF=1 for its time stamps"
+#endif
+
+typedef char trace_len_check[TRACE_LEN >= 2 && !(TRACE_LEN & (TRACE_LEN - 1)) ? 1 : -1];
+
+#define TRACE_MAGIC 0x31435254U     // "TRC1" in memory
+
+typedef enum {
+    TRACE_WAKE = 1,         // Out of STOP; value: HAL_GetTick() ms
+    TRACE_CLOCK,            // Clock profile applied; value: HCLK in kHz
+    TRACE_SLEEP,            // Entering STOP
+    TRACE_SENSOR_START,     // Conversions triggered
+    TRACE_SENSOR_DONE,      // Sample read and compensated
+    TRACE_I2C_START,        // Transfer put on the wire
+    TRACE_I2C_DONE,         // Transfer completed
+    TRACE_I2C_ERROR,        // Transfer failed or timed out
+    TRACE_RENDER,           // Screen redraw started
+    TRACE_RENDER_END,
+    TRACE_FLUSH,            // Asynchronous flush started
+    TRACE_FLUSH_DONE
+} Trace_Id;
+
+/** The ring as it sits in RAM; also the payload of a telemetry trace block */
+typedef struct {
+    uint32_t magic;         // TRACE_MAGIC, to find it in a memory dump
+    uint16_t len;           // TRACE_LEN
+    uint16_t head;          // Entries written since start-up, modulo 2^16
+    uint32_t entries[TRACE_LEN];
+} Trace_Ring;
+
+#if TRACE
+extern Trace_Ring trace_ring;
+
+/**
+ * @brief Record a point stamped with the cycle counter. Interrupt safe.
+ */
+void trace_point(Trace_Id id);
+
+/**
+ * @brief Record a value entry (low 24 bits of v). Interrupt safe.
+ */
+void trace_value(Trace_Id id, uint32_t v);
+
+/**
+ * @brief Stop or resume recording, so a dump sees a still ring.
+ */
+void trace_hold(uint8_t hold);
+
+#define TRACE_POINT(id)     trace_point(id)
+#define TRACE_VALUE(id, v)  trace_value((id), (v))
+#else
+#define TRACE_POINT(id)     ((void)0)
+#define TRACE_VALUE(id, v)  ((void)0)
+#endif
+
+#endif // TRACE_H
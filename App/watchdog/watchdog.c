@@ -0,0 +1,157 @@
+/**
+ * @file watchdog.c
+ * @brief IWDG supervision of the scheduler tasks and a reset-cause log
+ *
+ * The IWDG is programmed at register level; the HAL IWDG module is not
+ * part of this project. It runs from the LSI with a /64 prescaler.
+ *
+ * Backup register use (rtc.h):
+ * - RTC_BKP_RESET_LOG: the last WATCHDOG_LOG_LEN log entries, newest in
+ *   the low byte
+ * - RTC_BKP_RESET_COUNT: watchdog and error resets in the low half,
+ *   other warm resets in the high half
+ * - RTC_BKP_SUPERVISION: index + 1 of the task running (0 between tasks),
+ *   and WATCHDOG_SUP_ERROR once watchdog_fail() ran
+ */
+
+#include "watchdog.h"
+#include "rtc.h"
+
+#define WATCHDOG_PRESCALER_DIV  64
+#define WATCHDOG_PR             4       // /64
+#define WATCHDOG_RELOAD         ((uint32_t)WATCHDOG_TIMEOUT_MS * (RTC_LSI_HZ / WATCHDOG_PRESCALER_DIV) / 1000U)
+
+typedef char watchdog_reload_check[WATCHDOG_RELOAD >= 1 && WATCHDOG_RELOAD <= 0xFFF ? 1 : -1];
+
+#define WATCHDOG_SUP_TASK_Msk   0xFFU
+#define WATCHDOG_SUP_ERROR      0x100U
+
+#define IWDG_KEY_RELOAD         0xAAAA
+#define IWDG_KEY_ACCESS         0x5555
+#define IWDG_KEY_START          0xCCCC
+
+static uint8_t decoded;
+static Watchdog_Cause cause;
+static uint8_t cause_task;      // Task running at a watchdog reset + 1
+static uint16_t overruns;
+static uint16_t worst_ms;
+
+Watchdog_Cause watchdog_reset_cause(void)
+{
+    if (decoded) return cause;
+    decoded = 1;
+
+    uint32_t csr = RCC->CSR;
+    uint32_t sup = RTC_BKP_SUPERVISION;
+
+    // Every reset also sets PINRSTF (the pin is driven low internally),
+    // so it only counts when nothing else is flagged
+    if (csr & RCC_CSR_PORRSTF)
+        cause = WATCHDOG_CAUSE_POWER_ON;
+    else if (csr & RCC_CSR_IWDGRSTF)
+        cause = WATCHDOG_CAUSE_WATCHDOG;
+    else if (csr & RCC_CSR_LPWRRSTF)
+        cause = WATCHDOG_CAUSE_LOW_POWER;
+    else if (csr & RCC_CSR_SFTRSTF)
+        cause = sup & WATCHDOG_SUP_ERROR ? WATCHDOG_CAUSE_ERROR : WATCHDOG_CAUSE_SOFTWARE;
+    else if (csr & (RCC_CSR_OBLRSTF | RCC_CSR_WWDGRSTF))
+        cause = WATCHDOG_CAUSE_OTHER;
+    else
+        cause = WATCHDOG_CAUSE_PIN;
+
+    if (cause == WATCHDOG_CAUSE_WATCHDOG || cause == WATCHDOG_CAUSE_ERROR)
+        cause_task = (uint8_t)(sup & WATCHDOG_SUP_TASK_Msk);
+    if (cause_task > 0x0F) cause_task = 0x0F;
+    return cause;
+}
+
+uint8_t watchdog_warm(void)
+{
+    return watchdog_reset_cause() != WATCHDOG_CAUSE_POWER_ON;
+}
+
+void watchdog_start(void)
+{
+    Watchdog_Cause c = watchdog_reset_cause();
+
+    // The backup domain lost its contents on power-on, start clean
+    if (c == WATCHDOG_CAUSE_POWER_ON)
+    {
+        RTC_BKP_RESET_LOG = 0;
+        RTC_BKP_RESET_COUNT = 0;
+    }
+    RTC_BKP_RESET_LOG = (RTC_BKP_RESET_LOG << 8) | (uint32_t)(cause_task << 4) | c;
+
+    uint32_t count = RTC_BKP_RESET_COUNT;
+    if (c == WATCHDOG_CAUSE_WATCHDOG || c == WATCHDOG_CAUSE_ERROR)
+    {
+        if ((count & 0xFFFF) != 0xFFFF) count++;
+    }
+    else if (c != WATCHDOG_CAUSE_POWER_ON)
+    {
+        if ((count >> 16) != 0xFFFF) count += 0x10000;
+    }
+    RTC_BKP_RESET_COUNT = count;
+    RTC_BKP_SUPERVISION = 0;
+    RCC->CSR |= RCC_CSR_RMVF;   // The next reset leaves only its own flags
+
+#ifdef DEBUG
+    __HAL_RCC_DBGMCU_CLK_ENABLE();
+    DBGMCU->APB1FZ |= DBGMCU_APB1_FZ_DBG_IWDG_STOP;
+#endif
+    IWDG->KR = IWDG_KEY_START;
+    IWDG->KR = IWDG_KEY_ACCESS;
+    IWDG->PR = WATCHDOG_PR;
+    IWDG->RLR = WATCHDOG_RELOAD;
+    while (IWDG->SR);
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+void watchdog_task_begin(uint8_t task)
+{
+    RTC_BKP_SUPERVISION = task + 1U;
+}
+
+void watchdog_task_end(uint32_t elapsed_ms)
+{
+    RTC_BKP_SUPERVISION = 0;
+    if (elapsed_ms > worst_ms)
+        worst_ms = elapsed_ms > 0xFFFF ? 0xFFFF : (uint16_t)elapsed_ms;
+    if (elapsed_ms > WATCHDOG_TASK_BUDGET_MS)
+    {
+        if (overruns != 0xFFFF) overruns++;
+        return;
+    }
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+void watchdog_fail(void)
+{
+    __disable_irq();
+    // May run before rtc_init(); the task index is already in place
+    __HAL_RCC_PWR_CLK_ENABLE();
+    PWR->CR |= PWR_CR_DBP;
+    RTC_BKP_SUPERVISION |= WATCHDOG_SUP_ERROR;
+    NVIC_SystemReset();
+}
+
+uint8_t watchdog_log(uint8_t i)
+{
+    if (i >= WATCHDOG_LOG_LEN) return 0;
+    return (uint8_t)(RTC_BKP_RESET_LOG >> (8 * i));
+}
+
+uint16_t watchdog_resets(void)
+{
+    return (uint16_t)RTC_BKP_RESET_COUNT;
+}
+
+uint16_t watchdog_overruns(void)
+{
+    return overruns;
+}
+
+uint16_t watchdog_worst_ms(void)
+{
+    return worst_ms;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file watchdog.h
+ * @brief IWDG supervision of the scheduler tasks and a reset-cause log
+ *
+ * The independent watchdog is only refreshed when a scheduler task
+ * returns within its budget, so a task that hangs (a stuck bus wait, a
+ * runaway loop) or keeps overrunning resets the unit instead of freezing
+ * it. The task that was running, and the cause of every reset, are kept
+ * in RTC backup registers, which survive everything but a power-on reset
+ * and cost no EEPROM wear.
+ */
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "stm32l0xx_hal.h"
+
+/** IWDG supervision; once started the IWDG cannot be stopped again */
+#ifndef WATCHDOG
+#define WATCHDOG 1
+#endif
+
+/**
+ * IWDG timeout at the nominal LSI frequency. It has to cover one
+ * scheduler tick spent in STOP plus the slowest task: the IWDG keeps
+ * counting in STOP, and the LSI may run up to half again as fast.
+ */
+#ifndef WATCHDOG_TIMEOUT_MS
+#define WATCHDOG_TIMEOUT_MS     4000
+#endif
+
+/** A task taking longer than this does not refresh the IWDG */
+#ifndef WATCHDOG_TASK_BUDGET_MS
+#define WATCHDOG_TASK_BUDGET_MS 500
+#endif
+
+/** Reset causes kept in the log */
+#define WATCHDOG_LOG_LEN        4
+
+typedef enum
+{
+    WATCHDOG_CAUSE_POWER_ON = 0,    ///< Power-on or brown-out; the log starts over
+    WATCHDOG_CAUSE_PIN,             ///< NRST pin
+    WATCHDOG_CAUSE_SOFTWARE,        ///< NVIC_SystemReset()
+    WATCHDOG_CAUSE_WATCHDOG,        ///< IWDG: a task hung or kept missing its budget
+    WATCHDOG_CAUSE_ERROR,           ///< Error_Handler() through watchdog_fail()
+    WATCHDOG_CAUSE_LOW_POWER,       ///< Illegal low-power mode entry
+    WATCHDOG_CAUSE_OTHER            ///< Option byte load or window watchdog
+} Watchdog_Cause;
+
+/** Log entry: cause in the low nibble, task running at the reset + 1 in the high one */
+#define WATCHDOG_ENTRY_CAUSE(e) ((Watchdog_Cause)((e) & 0x0F))
+#define WATCHDOG_ENTRY_TASK(e)  ((e) >> 4)
+
+/**
+ * @brief Cause of the last reset.
+ *
+ * Decoded on the first call from the RCC reset flags and the supervision
+ * register, so it is valid before watchdog_start().
+ */
+Watchdog_Cause watchdog_reset_cause(void);
+
+/**
+ * @brief Report whether the peripherals kept their power over the reset.
+ *
+ * @return 1 after any reset but a power-on one
+ */
+uint8_t watchdog_warm(void);
+
+/**
+ * @brief Log the reset cause and start the IWDG.
+ *
+ * Call after rtc_init() (sched_init()), right before sched_run(); slow
+ * start-up work such as bench_run() has to come before it.
+ */
+void watchdog_start(void);
+
+/**
+ * @brief Record the task about to run, for the log of a watchdog reset.
+ *
+ * @param task Task index
+ */
+void watchdog_task_begin(uint8_t task);
+
+/**
+ * @brief Check the running task against its budget and refresh the IWDG if it met it.
+ *
+ * @param elapsed_ms Time the task took
+ */
+void watchdog_task_end(uint32_t elapsed_ms);
+
+/**
+ * @brief Reset now, logging WATCHDOG_CAUSE_ERROR; replaces the spin in Error_Handler().
+ */
+void watchdog_fail(void) __attribute__((noreturn));
+
+/**
+ * @brief One entry of the reset log.
+ *
+ * @param i 0 for the latest reset, up to WATCHDOG_LOG_LEN - 1
+ * @return Log entry, see WATCHDOG_ENTRY_CAUSE() and WATCHDOG_ENTRY_TASK()
+ */
+uint8_t watchdog_log(uint8_t i);
+
+/**
+ * @brief Watchdog and error resets since power-on, saturating.
+ */
+uint16_t watchdog_resets(void);
+
+/**
+ * @brief Tasks that missed their budget since this reset, saturating.
+ */
+uint16_t watchdog_overruns(void);
+
+/**
+ * @brief Longest task run since this reset, in ms.
+ */
+uint16_t watchdog_worst_ms(void);
+
+#endif // WATCHDOG_H
@@ -42,6 +42,37 @@ extern "C" {
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
 
+/*
+ * Interrupt priority plan. The M0+ has 4 levels and 0 preempts the rest;
+ * same-level handlers never nest. A source waits at most for the longest
+ * IRQ-masked section, the longest handler running on its own level and
+ * every handler above it. So short handlers whose lateness skews a time
+ * go up, long ones go down:
+ *
+ *   0 TIMING  LPTIM1 (timebase), RTC (sample wake-up), PVD (brownout):
+ *             a few dozen cycles each, they stamp or post and return
+ *   1 ALARM   EXTI0_1, the alarm acknowledge: silencing the buzzer never
+ *             waits on a bus handler
+ *   2 BUS     I2C1, DMA1 channels 2/3, LPUART1: they hand the shared DMA
+ *             channel to each other, so they share a level and keep the
+ *             non-nesting they were written for. An LPUART RX byte has
+ *             one character time (1.04 ms at 9600 Bd) before it overruns,
+ *             far above the I2C and DMA handlers; the longest handler on
+ *             the level is a Modbus reply start (CRC of up to 250 bytes)
+ *   3 UI      EXTI4_15, the buttons: debounced in ms anyway
+ *
+ * I2C1 and DMA1_Channel2_3 are CubeMX vectors: their level also lives in
+ * the .ioc (NVIC section), keep both in step. SysTick is not used, the
+ * timebase is LPTIM1 (App/tick), so TICK_INT_PRIORITY does not apply.
+ *
+ * Build with PROF_LATENCY=1 (App/prof) to measure the entry latency of
+ * each level under load: the profile dump ('P') then lists irq_latency0..3.
+ */
+#define IRQ_PRIO_TIMING   0
+#define IRQ_PRIO_ALARM    1
+#define IRQ_PRIO_BUS      2
+#define IRQ_PRIO_UI       3
+
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
@@ -53,6 +84,7 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+void SystemClock_Config(void);
 
 /* USER CODE END EFP */
 
@@ -51,7 +51,12 @@ void HardFault_Handler(void);
 void SVC_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void DMA1_Channel2_3_IRQHandler(void);
+void I2C1_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void RTC_IRQHandler(void);
+void LPTIM1_IRQHandler(void);
+void LPUART1_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -24,6 +24,38 @@
 
 #include "bme280.h"
 #include "oled.h"
+#include "oled_text.h"
+#include "oled_power.h"
+#include "sched.h"
+#include "i2c_bus.h"
+#include "format.h"
+#include "clock.h"
+#include "sampler.h"
+#include "hyst.h"
+#include "filter.h"
+#include "calib.h"
+#include "config.h"
+#include "supply.h"
+#include "history.h"
+#include "pyramid.h"
+#include "graph.h"
+#include "forecast.h"
+#include "telemetry.h"
+#include "modbus.h"
+#include "logger.h"
+#include "energy.h"
+#include "radio.h"
+#include "prof.h"
+#include "trace.h"
+#include "bench.h"
+#include "factory.h"
+#include "alarm.h"
+#include "screen.h"
+#include "button.h"
+#include "watchdog.h"
+#include "rtc.h"
+#include "altitude.h"
+#include <string.h>
 
 /* USER CODE END Includes */
 
@@ -35,6 +67,50 @@
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
 
+#define SAMPLE_PERIOD_MS 1000
+
+#define FIELD_TEMP       0
+#define FIELD_HUMIDITY   1
+#define FIELD_PRESSURE   2
+#define FIELD_ENERGY     3
+
+// Views in screen_step() order; only the live one without the buttons
+#define VIEW_LIVE        0
+#define VIEW_BIG         1
+#define VIEW_MINMAX      2
+#define VIEW_GRAPH       3
+#define VIEW_DIAG        4
+
+// Tracking view: the sensor converts continuously and the height above
+// the point where the view was entered is shown with every sample. With
+// the buttons it follows the diagnostics view, without them it is the
+// only view.
+#ifndef TRACK
+#define TRACK 0
+#endif
+#define VIEW_TRACK       (BUTTONS ? 5 : 1)
+#define TRACK_PERIOD_MS  32     // 31 Hz; one frame is 26 ms on the wire at 9600 baud
+
+// Text rows below the doubled temperature; 32-row panels lose the chart and
+// pack humidity/energy and pressure/trend into the two pages left
+#define ROW_HUMIDITY     (OLED_PAGES < 8 ? 2 : 3)
+#define ROW_PRESSURE     (OLED_PAGES < 8 ? 3 : 4)
+
+// Display hysteresis, in the 0.01 units the fields are printed in
+#define HYST_TEMP        5      // 0.05 degC
+#define HYST_HUMIDITY    20     // 0.2 %RH
+#define HYST_PRESSURE    5      // 0.05 hPa
+#define FILTER_SHIFT     2      // EMA alpha 1/4 on every channel
+
+#define SUPPLY_CHECK_SAMPLES 32 // VDD is measured on every 32nd sensor wake-up
+#define SUPPLY_SAVE_PERIOD   10 // Shortest sample interval from SUPPLY_TIER_SAVE on, ticks
+
+#define HISTORY_PERIOD       60     // One history record per minute (ticks)
+#define FORECAST_DIVIDER     10     // History records per forecast sample (10 min)
+#define LOG_PERIOD           (HISTORY_PERIOD * PYRAMID_QUARTER_SAMPLES * PYRAMID_HOUR_QUARTERS)
+
+#define PANEL_MAGIC          0x55D1306U // In RTC_BKP_PANEL once oled_init() ran
+
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -44,6 +120,7 @@
 
 /* Private variables ---------------------------------------------------------*/
 I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_tx;
 
 /* USER CODE BEGIN PV */
 
@@ -52,6 +129,7 @@ I2C_HandleTypeDef hi2c1;
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_I2C1_Init(void);
 /* USER CODE BEGIN PFP */
 
@@ -60,52 +138,789 @@ static void MX_I2C1_Init(void);
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
-void print_sensor_values(int16_t temp_i, int16_t temp_f,
-                              int16_t hum_i,  int16_t hum_f,
-                              int16_t press_i, int16_t press_f) {
-    char line[22];
-    uint8_t idx;
-
-    idx = 0;
-    if (temp_i < 0) { line[idx++] = '-'; temp_i = -temp_i; }
-    if (temp_i >= 100) line[idx++] = '0' + (temp_i / 100);
-    if (temp_i >= 10)  line[idx++] = '0' + ((temp_i / 10) % 10);
-    line[idx++] = '0' + (temp_i % 10);
-    line[idx++] = '.';
-    line[idx++] = '0' + (temp_f / 10);
-    line[idx++] = '0' + (temp_f % 10);
-    line[idx++] = '\x60';
-    line[idx++] = 'C';
-    line[idx] = '\0';
-    oled_print(0, 0, line);
-
-    idx = 0;
-    if (hum_i >= 100) line[idx++] = '0' + (hum_i / 100);
-    if (hum_i >= 10)  line[idx++] = '0' + ((hum_i / 10) % 10);
-    line[idx++] = '0' + (hum_i % 10);
-    line[idx++] = '.';
-    line[idx++] = '0' + (hum_f / 10);
-    line[idx++] = '0' + (hum_f % 10);
-    line[idx++] = '%';
-    line[idx++] = 'R';
-    line[idx] = '\0';
-    oled_print(0, 1, line);
-
-    idx = 0;
-    if (press_i >= 1000) line[idx++] = '0' + (press_i / 1000);
-    if (press_i >= 100)  line[idx++] = '0' + ((press_i / 100) % 10);
-    if (press_i >= 10)   line[idx++] = '0' + ((press_i / 10) % 10);
-    line[idx++] = '0' + (press_i % 10);
-    line[idx++] = '.';
-    line[idx++] = '0' + (press_f / 10);
-    line[idx++] = '0' + (press_f % 10);
-    line[idx++] = 'h';
-    line[idx++] = 'P';
-    line[idx++] = 'a';
-    line[idx] = '\0';
-    oled_print(0, 2, line);
+// sensors[0] is the indoor sensor on the board, sensors[1] the optional
+// outdoor one at the other address (its SDO strapped the other way)
+static BME280_Dev sensors[BME280_SENSORS];
+static BME280_Measurement measurement;
+#if BME280_SENSORS > 1
+static BME280_Measurement outdoor;
+static uint8_t outdoor_ready;
+static hyst_value shown_outdoor;    // 0.01 degC
+#endif
+
+// Set once measurement holds a reading worth showing
+static uint8_t measured;
+
+// Time from HAL_Init() until the first reading was on the panel, 0 until
+// then; the completion of the flush that carries it takes the time
+static volatile uint16_t first_value_ms;
+static volatile uint8_t first_value_flush;
+
+// Fields and their hysteresis; the display ignores changes within the band
+static hyst_value shown_temp;       // 0.01 degC
+static hyst_value shown_humidity;   // 0.01 %RH
+static hyst_value shown_pressure;   // 0.01 hPa
+
+static void print_field(uint8_t id, int32_t value, uint8_t width, const char *unit) {
+    char line[OLED_TEXT_FIELD_LEN + 1];
+    // Fixed widths keep the digits in place for the partial refresh
+    uint8_t n = format_fixed(line, value, 2, width);
+    format_str(line + n, unit);
+    oled_text_update(id, line);
+}
+
+// Returns 0 when every field stays within its band and nothing was drawn
+uint8_t print_sensor_values(const BME280_Measurement *m) {
+    uint8_t changed = 0;
+
+    if (hyst_update(&shown_temp, m->temperature)) {
+        print_field(FIELD_TEMP, shown_temp.shown, 6, "`C");          // '`' is the degree glyph
+        changed = 1;
+    }
+    if (hyst_update(&shown_humidity, format_rh_centi(m->humidity))) {
+        print_field(FIELD_HUMIDITY, shown_humidity.shown, 6, "%R");
+        changed = 1;
+    }
+    // Sea-level pressure once a station altitude is calibrated
+    if (hyst_update(&shown_pressure, format_hpa_centi(calib_sea_level(m->pressure)))) {
+        print_field(FIELD_PRESSURE, shown_pressure.shown, 7, "hPa");
+        changed = 1;
+    }
+#if BME280_SENSORS > 1
+    // The outdoor temperature takes the place of the charge counter
+    if (outdoor_ready && hyst_update(&shown_outdoor, outdoor.temperature)) {
+        print_field(FIELD_ENERGY, shown_outdoor.shown, 6, "`C");
+        changed = 1;
+    }
+#endif
+    return changed;
+}
+
+// Software smoothing of the raw readings, ahead of the sampler and display
+static filter_value filter_temp;
+static filter_value filter_humidity;
+static filter_value filter_pressure;
+
+static void filter_measurement(BME280_Measurement *m) {
+    m->temperature = filter_update(&filter_temp, m->temperature);
+    m->humidity = (uint32_t)filter_update(&filter_humidity, (int32_t)m->humidity);
+    m->pressure = (uint32_t)filter_update(&filter_pressure, (int32_t)m->pressure);
+}
+
+static void filter_reset_all(void) {
+    filter_reset(&filter_temp);
+    filter_reset(&filter_humidity);
+    filter_reset(&filter_pressure);
+}
+
+// Cleared on any sensor failure; the next sample period re-runs the init
+static uint8_t sensor_ready;
+// Reads in a row that failed the plausibility checks; at SENSOR_RETRIES
+// the sensor is initialized again, before that each one is retried
+#define SENSOR_RETRIES      3
+static uint8_t invalid_reads;
+// Set when measurement holds a sample the display has not shown yet
+static uint8_t sample_fresh;
+// Set when the buffer holds changes that have not been flushed
+static uint8_t display_pending;
+
+static uint8_t supply_countdown = 1;
+
+#if BME280_SENSORS == 1
+static uint32_t shown_uah = UINT32_MAX;
+#endif
+static Forecast_Trend shown_trend;
+static uint16_t closed_quarters;    // Pyramid quarter buckets closed so far
+
+// The start-up layout: doubled temperature, humidity, pressure with the
+// tendency glyph, and the temperature chart in pages 5-7
+static void live_enter(void) {
+    oled_text_field_scaled(FIELD_TEMP, 0, 0, 8, 2);
+    oled_text_field(FIELD_HUMIDITY, 0, ROW_HUMIDITY, 10);
+    oled_text_field(FIELD_PRESSURE, 0, ROW_PRESSURE, 11);
+    oled_text_field(FIELD_ENERGY, 72, ROW_HUMIDITY, 9);
+    hyst_invalidate(&shown_temp);
+    hyst_invalidate(&shown_humidity);
+    hyst_invalidate(&shown_pressure);
+#if BME280_SENSORS > 1
+    hyst_invalidate(&shown_outdoor);
+#else
+    shown_uah = UINT32_MAX;     // Redrawn by the next power_task()
+#endif
+    if (measured)
+        print_sensor_values(&measurement);
+    oled_putc(OLED_WIDTH - OLED_CELL_WIDTH, ROW_PRESSURE, forecast_glyph(shown_trend));
+    graph_init(HISTORY_TEMPERATURE);
+}
+
+static uint8_t live_update(void) {
+    return print_sensor_values(&measurement);
+}
+
+#if BUTTONS
+
+// Temperature four times the size, humidity doubled below it on 64-row panels
+static uint8_t big_update(void) {
+    char line[OLED_TEXT_FIELD_LEN + 1];
+    uint8_t changed = 0;
+
+    if (!measured) return 0;
+    if (hyst_update(&shown_temp, measurement.temperature)) {
+        format_fixed(line, format_round10(shown_temp.shown), 1, 5);
+        oled_text_update(FIELD_TEMP, line);
+        changed = 1;
+    }
+    if (OLED_PAGES == 8 && hyst_update(&shown_humidity, format_rh_centi(measurement.humidity))) {
+        uint8_t n = format_fixed(line, format_round10(shown_humidity.shown), 1, 4);
+        format_str(line + n, "%");
+        oled_text_update(FIELD_HUMIDITY, line);
+        changed = 1;
+    }
+    return changed;
+}
+
+static void big_enter(void) {
+    oled_text_field_scaled(FIELD_TEMP, 0, 0, 5, 4);
+    oled_text_field_scaled(FIELD_HUMIDITY, 0, 5, 5, 2);
+    hyst_invalidate(&shown_temp);
+    hyst_invalidate(&shown_humidity);
+    big_update();
+}
+
+// closed_quarters the bucket based views were last drawn with; their
+// content only moves when a bucket closes
+static uint16_t drawn_count;
+
+// Extremes of one channel over the logged hours, in its stored 0.1 units
+// Label, min and max take 16 characters (int16 tenths fit both widths);
+// oled_print() clips what a narrow panel has no columns for
+static void minmax_line(uint8_t page, const char *label, History_Channel ch) {
+    char line[1 + 7 + 8 + 1];
+    History_Stats st;
+    uint8_t n = format_str(line, label);
+
+    if (pyramid_stats(ch, &st)) {
+        n += format_fixed(line + n, st.min, 1, 7);
+        format_fixed(line + n, st.max, 1, 8);
+    } else {
+        format_str(line + n, "      -       -");
+    }
+    oled_print(0, page, line);
+}
+
+static uint8_t minmax_update(void) {
+    if (closed_quarters == drawn_count) return 0;
+    drawn_count = closed_quarters;
+    minmax_line(1, "T", HISTORY_TEMPERATURE);
+    minmax_line(2, "H", HISTORY_HUMIDITY);
+    minmax_line(3, "P", HISTORY_PRESSURE);
+    return 1;
+}
+
+static void minmax_enter(void) {
+    oled_print(0, 0, "     min     max");
+    drawn_count = UINT16_MAX;
+    minmax_update();
+}
+
+// Station pressure per logged hour with its range, in the graph pages
+static uint8_t graph_view_update(void) {
+    if (closed_quarters == drawn_count) return 0;
+    drawn_count = closed_quarters;
+    minmax_line(2, "P", HISTORY_PRESSURE);
+    graph_buckets(HISTORY_PRESSURE, PYRAMID_HOUR);
+    return 1;
+}
+
+static void graph_view_enter(void) {
+    oled_print(0, 0, "Pressure hPa");
+    oled_print(0, 1, "     min     max");
+    drawn_count = UINT16_MAX;
+    graph_view_update();
+}
+
+// Label, a value of up to 12 characters and a unit of up to 3; pages a
+// short panel does not have are skipped, columns are clipped by oled_print()
+static void diag_line(uint8_t page, const char *label, int32_t value, const char *unit) {
+    char line[6 + 12 + 3 + 1];
+    if (page >= OLED_PAGES) return;
+    uint8_t n = format_str(line, label);
+    n += format_fixed(line + n, value, 0, 8);
+    format_str(line + n, unit);
+    oled_print(0, page, line);
+}
+
+// Refreshed with every sample; unchanged glyphs cost no bus traffic
+static uint8_t diag_update(void) {
+    const i2c_bus_counters *c = i2c_bus_get_counters();
+    diag_line(0, "Supply", supply_last_mv(), "mV");
+    diag_line(1, "Tier  ", supply_tier(), "");
+    diag_line(2, "I2Cerr", c->errors + c->timeouts, "");
+    diag_line(3, "Convs ", (int32_t)BME280_conversion_count(), "");
+    diag_line(4, "Charge", (int32_t)energy_charge_uah(), "uAh");
+    diag_line(5, "Period", sampler_period(), "s");
+    diag_line(6, "Boot  ", first_value_ms, "ms");
+    diag_line(7, "Resets", watchdog_resets(), "");
+    return 1;
+}
+
+static void diag_enter(void) {
+    diag_update();
+}
+#endif
+
+#if TRACK
+static void track_enter(void);
+static uint8_t track_update(void);
+static void track_leave(void);
+#endif
+
+static const screen_view views[] = {
+    [VIEW_LIVE]   = { live_enter, live_update },
+#if BUTTONS
+    [VIEW_BIG]    = { big_enter, big_update },
+    [VIEW_MINMAX] = { minmax_enter, minmax_update },
+    [VIEW_GRAPH]  = { graph_view_enter, graph_view_update },
+    [VIEW_DIAG]   = { diag_enter, diag_update },
+#endif
+#if TRACK
+    [VIEW_TRACK]  = { track_enter, track_update, track_leave },
+#endif
+};
+
+// Every tier keeps the savings of the ones above it; the configuration
+// sets what full supply gets
+static void apply_supply_tier(Supply_Tier tier) {
+    const Config_Record *cfg = config_get();
+    uint8_t save = tier >= SUPPLY_TIER_SAVE && cfg->sample_min < SUPPLY_SAVE_PERIOD;
+    sampler_set_min_period(save ? SUPPLY_SAVE_PERIOD : cfg->sample_min);
+    const BME280_Profile *profile = tier >= SUPPLY_TIER_SAVE ? &BME280_PROFILE_WEATHER : config_profile();
+    if (sensor_ready)
+        BME280_set_profile(&sensors[0], profile);
+#if BME280_SENSORS > 1
+    if (outdoor_ready)
+        BME280_set_profile(&sensors[1], profile);
+#endif
+    uint8_t dim = tier >= SUPPLY_TIER_DIM && cfg->contrast > OLED_POWER_CONTRAST_DIM;
+    oled_power_set_limit(tier >= SUPPLY_TIER_DARK ? 0 : dim ? OLED_POWER_CONTRAST_DIM : cfg->contrast);
+    // The supply may not last until the batch is full
+    if (tier >= SUPPLY_TIER_DARK)
+        logger_flush();
+}
+
+#if ALARM
+static int32_t alarm_limit(int16_t v) {
+    return v == CONFIG_ALARM_OFF_LOW ? ALARM_OFF_LOW : v == CONFIG_ALARM_OFF_HIGH ? ALARM_OFF_HIGH : v;
+}
+#endif
+
+// Hands the configuration to the modules that hold its settings
+static void apply_config(void) {
+    const Config_Record *cfg = config_get();
+    sampler_set_min_period(1);      // Lets the longest interval drop below the shortest
+    sampler_set_max_period(cfg->sample_max);
+    oled_power_set_timeouts(cfg->dim_ticks, cfg->off_ticks);
+#if ALARM
+    alarm_set_limits(ALARM_CH_TEMP, alarm_limit(cfg->alarm_temp_low),
+                     alarm_limit(cfg->alarm_temp_high), cfg->alarm_temp_hyst);
+    alarm_set_limits(ALARM_CH_HUMIDITY, alarm_limit(cfg->alarm_humidity_low),
+                     alarm_limit(cfg->alarm_humidity_high), cfg->alarm_humidity_hyst);
+#endif
+    apply_supply_tier(supply_tier());
+}
+
+// Triggers the conversions of all ready sensors; a failed start is
+// retried by the read. Returns when the last one is complete.
+static uint32_t start_conversions(void) {
+    BME280_start(&sensors[0]);
+    uint32_t ready_at = BME280_ready_at(&sensors[0]);
+#if BME280_SENSORS > 1
+    // The outdoor sensor is re-initialized on its own when it fails,
+    // without holding up the indoor one
+    if (!outdoor_ready) {
+        outdoor_ready = BME280_init(&sensors[1], BME280_MODE_FORCED);
+        if (outdoor_ready)
+            BME280_set_profile(&sensors[1], BME280_get_profile(&sensors[0]));
+    }
+    if (outdoor_ready) {
+        BME280_start(&sensors[1]);
+        if ((int32_t)(BME280_ready_at(&sensors[1]) - ready_at) > 0)
+            ready_at = BME280_ready_at(&sensors[1]);
+    }
+#endif
+    return ready_at;
+}
+
+#if BME280_SENSORS > 1 && !BME280_AVERAGE_SHIFT
+// Both conversions were started together and share one wait
+static BME280_Status read_sensors(void) {
+    BME280_Measurement m[BME280_SENSORS];
+    BME280_Status st[BME280_SENSORS];
+
+    BME280_read_all(sensors, outdoor_ready ? 2 : 1, m, st);
+    if (outdoor_ready) {
+        if (st[1] == BME280_OK)
+            outdoor = m[1];
+        else if (st[1] != BME280_ERR_INVALID)   // A glitch keeps the last value
+            outdoor_ready = 0;
+    }
+    if (st[0] == BME280_OK)
+        measurement = m[0];
+    return st[0];
+}
+#endif
+
+static void display_task(void);
+static void sensor_finish(void);
+
+#if BME280_AVERAGE_SHIFT
+// The conversions of a sample are spread over the sample period, each
+// one started right after the previous read, so the sensor is active in
+// short bursts and the core sleeps in between
+#define AVERAGE_COUNT       (1U << BME280_AVERAGE_SHIFT)
+#define AVERAGE_SPACING_MS  (SAMPLE_PERIOD_MS >> BME280_AVERAGE_SHIFT)
+
+static BME280_Raw average_sum[BME280_SENSORS];
+static BME280_Status average_status;
+static uint8_t average_left;
+static uint32_t average_next;
+#if BME280_SENSORS > 1
+static uint8_t average_outdoor;     // The outdoor sensor took every conversion
+#endif
+
+static void average_step(void) {
+    BME280_Raw raw;
+    average_status = BME280_read_raw(&sensors[0], &raw);
+    if (average_status == BME280_OK)
+        BME280_raw_add(&average_sum[0], &raw);
+#if BME280_SENSORS > 1
+    if (average_outdoor) {
+        if (BME280_read_raw(&sensors[1], &raw) == BME280_OK)
+            BME280_raw_add(&average_sum[1], &raw);
+        else
+            average_outdoor = outdoor_ready = 0;
+    }
+#endif
+    if (average_status == BME280_OK && --average_left) {
+        uint32_t ready_at = start_conversions();
+        average_next += AVERAGE_SPACING_MS;
+        sched_defer(average_step, (int32_t)(ready_at - average_next) > 0 ? ready_at : average_next);
+        return;
+    }
+    sensor_finish();
+}
+
+static void average_begin(void) {
+    memset(average_sum, 0, sizeof(average_sum));
+    average_left = AVERAGE_COUNT;
+    average_next = start_conversions();
+#if BME280_SENSORS > 1
+    average_outdoor = outdoor_ready;
+#endif
+    sched_defer(average_step, average_next);
+}
+
+// The mean goes through the compensation once
+static BME280_Status average_finish(void) {
+    if (average_status != BME280_OK) return average_status;
+    BME280_raw_mean(&average_sum[0], BME280_AVERAGE_SHIFT);
+    BME280_compensate(&sensors[0], &average_sum[0], &measurement);
+#if BME280_SENSORS > 1
+    if (average_outdoor) {
+        BME280_raw_mean(&average_sum[1], BME280_AVERAGE_SHIFT);
+        BME280_compensate(&sensors[1], &average_sum[1], &outdoor);
+    }
+#endif
+    return BME280_OK;
+}
+#endif
+
+#if TELEMETRY
+static uint8_t telemetry_status(void) {
+    return (sensor_ready ? TELEMETRY_STATUS_SENSOR_OK : 0) |
+           (supply_tier() << TELEMETRY_STATUS_TIER_Pos) |
+           (forecast_trend() << TELEMETRY_STATUS_TREND_Pos) |
+           (ALARM && alarm_active() ? TELEMETRY_STATUS_ALARM : 0);
+}
+#endif
+
+#if TRACK
+static uint8_t tracking;
+static uint8_t track_referenced;    // Altitude reference taken from the first sample
+static uint32_t track_next;         // Deadline of the next read
+static uint32_t track_window;       // Start of the second being counted
+static uint8_t track_count;
+static uint8_t track_rate;          // Samples shown in the last full second
+static uint8_t shown_rate;
+
+// The gaming preset converts in 13.3 ms at most and t_sb adds 0.5 ms, so
+// the sensor has a new result ready well inside every TRACK_PERIOD_MS and
+// each read fetches fresh data without polling the measuring bit. Reads
+// follow fixed deadlines; one that comes late starts them over.
+static void track_task(void) {
+    uint32_t now = HAL_GetTick();
+    track_next += TRACK_PERIOD_MS;
+    if ((int32_t)(track_next - now) <= 0)
+        track_next = now + TRACK_PERIOD_MS;
+    sched_defer(track_task, track_next);
+
+    BME280_Measurement m;
+    BME280_Status status = BME280_read(&sensors[0], &m);
+    if (status == BME280_ERR_INVALID && ++invalid_reads < SENSOR_RETRIES)
+        return;                 // The next deadline reads again
+    if (status != BME280_OK) {
+        // sensor_task() re-initializes it and sensor_finish() comes back here
+        tracking = 0;
+        sched_defer(NULL, 0);
+        sensor_ready = 0;
+        sampler_reset();
+        return;
+    }
+    invalid_reads = 0;
+    calib_apply(&m);
+#if ALARM
+    if (alarm_check(&m))
+        oled_power_activity();
+#endif
+    if (!track_referenced) {
+        altitude_set_reference(m.pressure, m.temperature);
+        track_referenced = 1;
+    }
+    measurement = m;
+    measured = 1;
+    sample_fresh = 1;
+
+    track_count++;
+    if (now - track_window >= 1000) {
+        track_rate = track_count;
+        track_count = 0;
+        track_window += 1000;
+        if (now - track_window >= 1000)
+            track_window = now;
+        oled_power_activity();  // The panel stays lit while tracking
+    }
+#if TELEMETRY
+    telemetry_queue(&measurement, telemetry_status() | TELEMETRY_STATUS_TRACK);
+#endif
+    display_task();
+}
+
+// Normal mode at Fm from the PLL profile; a pending sensor_finish() is
+// replaced by the first read
+static void track_start(void) {
+    BME280_set_profile(&sensors[0], &BME280_PROFILE_GAMING);
+    BME280_set_mode(&sensors[0], BME280_MODE_NORMAL);
+    clock_set_profile(CLOCK_PROFILE_BURST);
+    tracking = 1;
+    track_referenced = 0;
+    track_count = 0;
+    track_rate = 0;
+    track_window = HAL_GetTick();
+    track_next = track_window + TRACK_PERIOD_MS;
+    sched_defer(track_task, track_next);
+}
+
+// Relative height in the doubled field, the measured rate below it
+static void track_enter(void) {
+    oled_text_field_scaled(FIELD_TEMP, 0, 0, 8, 2);
+    oled_text_field(FIELD_HUMIDITY, 0, ROW_HUMIDITY, 6);
+    oled_print(0, ROW_PRESSURE, "Height, rate");
+    shown_rate = UINT8_MAX;
+    if (sensor_ready)
+        track_start();
+}
+
+static uint8_t track_update(void) {
+    char line[OLED_TEXT_FIELD_LEN + 1];
+    if (!tracking) return 0;
+
+    // mm to cm, printed as m with two decimals
+    uint8_t n = format_fixed(line, format_round10(altitude_relative(measurement.pressure)), 2, 7);
+    format_str(line + n, "m");
+    oled_text_update(FIELD_TEMP, line);
+    if (track_rate != shown_rate) {
+        shown_rate = track_rate;
+        n = format_fixed(line, shown_rate, 0, 3);
+        format_str(line + n, "Hz");
+        oled_text_update(FIELD_HUMIDITY, line);
+    }
+    return 1;
+}
+
+// Back to forced conversions at the profile of the supply tier
+static void track_leave(void) {
+    if (!tracking) return;
+    tracking = 0;
+    sched_defer(NULL, 0);
+    BME280_set_mode(&sensors[0], BME280_MODE_FORCED);
+    apply_supply_tier(supply_tier());
+    sampler_reset();
+    filter_reset_all();
+}
+#endif
+
+// Second half of sensor_task(), once the conversions are complete: the
+// read is a plain burst, so it runs from MSI; the render and flush go
+// back to the PLL for Fm I2C
+static void sensor_finish(void) {
+    clock_set_profile(CLOCK_PROFILE_BUS);
+    BME280_Status status = BME280_OK;
+    if (sensor_ready) {
+        PROF_BEGIN(PROF_SENSOR_READ);
+#if BME280_AVERAGE_SHIFT
+        status = average_finish();
+#elif BME280_SENSORS > 1
+        status = read_sensors();
+#else
+        status = BME280_read(&sensors[0], &measurement);
+#endif
+        PROF_END(PROF_SENSOR_READ);
+        TRACE_POINT(TRACE_SENSOR_DONE);
+    }
+
+    if (!sensor_ready) {
+        invalid_reads = 0;
+        sensor_ready = BME280_init(&sensors[0], BME280_MODE_FORCED);
+        if (sensor_ready)
+            apply_supply_tier(supply_tier());   // init restores the default profile
+#if TRACK
+        if (sensor_ready && screen_current() == VIEW_TRACK)
+            track_start();
+#endif
+        sampler_reset();
+        filter_reset_all();
+    } else if (status == BME280_ERR_INVALID && ++invalid_reads < SENSOR_RETRIES) {
+        // Garbage from a glitch: nothing is compensated, drawn or sent, and
+        // the read is repeated on the next tick instead of a period later
+        sampler_retry();
+        clock_set_profile(CLOCK_PROFILE_BURST);
+        return;
+    } else if (status != BME280_OK) {
+        // A bus failure, or a sensor that keeps returning garbage, e.g.
+        // after it reset on its own: initialize it again
+        sensor_ready = 0;
+        sampler_reset();
+    } else {
+        invalid_reads = 0;
+        calib_apply(&measurement);
+#if ALARM
+        // Ahead of the filter lag and the render; a new alarm lights the panel
+        if (alarm_check(&measurement))
+            oled_power_activity();
+#endif
+        filter_measurement(&measurement);
+        if (sampler_update(&measurement))
+            oled_power_activity();
+        measured = 1;
+        sample_fresh = 1;
+    }
+#if TELEMETRY
+    telemetry_queue(&measurement, telemetry_status());
+#endif
+
+    // Piggybacks on the sensor wake-up, already running from MSI
+    if (--supply_countdown == 0) {
+        supply_countdown = SUPPLY_CHECK_SAMPLES;
+        Supply_Tier tier = supply_tier();
+        if (supply_update() != tier)
+            apply_supply_tier(supply_tier());
+    }
+    clock_set_profile(CLOCK_PROFILE_BURST);
+    display_task();     // The new sample goes out before the core sleeps
+}
+
+// Pipelined cycle: trigger the conversions, hand the core back to the
+// scheduler and take the results in sensor_finish(). The conversion time
+// passes in STOP, or under a flush still on the bus (display_task runs
+// next), instead of in a wait loop.
+static void sensor_task(void) {
+#if TRACK
+    if (tracking) return;
+#endif
+    if (!sampler_due()) return;
+    if (sensor_ready) {
+        TRACE_POINT(TRACE_SENSOR_START);
+#if BME280_AVERAGE_SHIFT
+        average_begin();
+#else
+        sched_defer(sensor_finish, start_conversions());
+#endif
+    } else {
+        sensor_finish();    // Re-initializes the sensor
+    }
+}
+
+// Set by a view switch that could not be flushed right away
+static uint8_t view_changed;
+
+// Only redraws after a new sample; quiet ticks cost no I2C traffic
+static void display_task(void) {
+    if (!sample_fresh && !view_changed) return;
+    if (sample_fresh) {
+        sample_fresh = 0;
+        PROF_BEGIN(PROF_PRINT_VALUES);
+        TRACE_POINT(TRACE_RENDER);
+        if (screen_update())
+            display_pending = 1;
+        TRACE_POINT(TRACE_RENDER_END);
+        PROF_END(PROF_PRINT_VALUES);
+    }
+
+    // While the panel sleeps the dirty tracker accumulates the changes and
+    // the first flush after oled_wake() sends only those
+    if (display_pending && oled_is_awake()) {
+        // Armed ahead of the start, the flush may complete before it returns
+        if (measured && !first_value_ms && !oled_is_busy())
+            first_value_flush = 1;
+        PROF_BEGIN(PROF_DISPLAY);
+        TRACE_POINT(TRACE_FLUSH);
+        if (oled_display_async())
+            display_pending = view_changed = 0;
+        PROF_END(PROF_DISPLAY);
+    }
+}
+
+// Interrupt context. A view switch that found the bus busy goes out next.
+void oled_flush_cplt_callback(void) {
+    TRACE_POINT(TRACE_FLUSH_DONE);
+    if (first_value_flush) {
+        first_value_flush = 0;
+        first_value_ms = (uint16_t)HAL_GetTick();
+    }
+    if (view_changed)
+        sched_post(SCHED_EV_DISPLAY);
+#if TRACK && TELEMETRY
+    // The frame of the sample waits for the flush to hand back the DMA
+    if (tracking)
+        sched_post(SCHED_EV_COMMAND);
+#endif
+}
+
+#if BUTTONS
+// Presses are taken right after their EXTI wake-up. The first press on a
+// dark panel only lights it again.
+static void button_event(void) {
+    uint8_t pressed = button_take();
+    if (!pressed) return;
+
+    uint8_t awake = oled_is_awake();
+    oled_power_activity();
+    if (!awake) return;
+    if (pressed & BUTTON_BIT(BUTTON_NEXT))
+        screen_step(1);
+    if (pressed & BUTTON_BIT(BUTTON_PREV))
+        screen_step(-1);
+    display_pending = view_changed = 1;
+    display_task();
+}
+#endif
+
+static void power_task(void) {
+    oled_power_tick();
+    energy_update();
+#if BME280_SENSORS == 1
+    // Flushed with the next sample, no wake-up of its own
+    if (screen_current() == VIEW_LIVE && energy_charge_uah() != shown_uah) {
+        char line[OLED_TEXT_FIELD_LEN + 1];
+        shown_uah = energy_charge_uah();
+        uint8_t n = format_fixed(line, (int32_t)shown_uah, 0, 6);
+        format_str(line + n, "uAh");
+        oled_text_update(FIELD_ENERGY, line);
+        display_pending = 1;
+    }
+#endif
+}
+
+// Records the latest sample; the sampler keeps it at most a minute old.
+// Closed buckets move up the pyramid, the hour ones into the EEPROM log
+static void history_task(void) {
+    static uint8_t forecast_skip;
+
+    if (!sensor_ready) return;
+    history_add(&measurement);
+    uint8_t closed = pyramid_add(&measurement);
+    if (closed)
+        closed_quarters++;
+#if RADIO
+    if (closed & PYRAMID_CLOSED_QUARTER)
+        radio_quarter_closed();
+#endif
+    // The other views leave the chart alone; entering one with it redraws
+    // it from the history
+    uint8_t view = screen_current();
+    if (view == VIEW_LIVE)
+        graph_add(&measurement);
+    // Tendency glyph in the last cell of the pressure line
+    if (forecast_skip) {
+        forecast_skip--;
+    } else {
+        forecast_skip = FORECAST_DIVIDER - 1;
+        Forecast_Trend trend = forecast_add(&measurement);
+        if (trend != shown_trend) {
+            shown_trend = trend;
+            if (view == VIEW_LIVE)
+                oled_putc(OLED_WIDTH - OLED_CELL_WIDTH, ROW_PRESSURE, forecast_glyph(trend));
+        }
+    }
+    display_pending = 1;
+}
+
+#if SUPPLY_PVD
+// VDD is falling toward brown-out: everything still in RAM goes to EEPROM
+// now, a block of 8 words in about 26 ms. At ~1.5 mA that takes ~100 uF
+// on VDD to stay above 1.65 V when the supply vanishes at once; a
+// discharging cell crosses the level slowly and needs no extra capacitor
+static void brownout_event(void) {
+    if (!supply_pvd_low()) return;      // Back above the level already
+    pyramid_flush();
+    logger_flush();
 }
+#endif
 
+#if TELEMETRY && MODBUS
+static const void *modbus_measurement(void) {
+    return &measurement;
+}
+
+static const void *modbus_history(void) {
+    return history_aggregates();
+}
+
+#if RADIO
+static const void *modbus_radio(void) {
+    return radio_get_stats();
+}
+#endif
+
+// Input registers; the replies are sent straight from these structs
+static const Modbus_Block modbus_map[] = {
+    { 0x0000, sizeof(BME280_Measurement) / 2, modbus_measurement },
+    { 0x0100, sizeof(History_Aggregates) / 2, modbus_history },
+#if RADIO
+    { 0x0200, sizeof(Radio_Stats) / 2, modbus_radio },
+#endif
+};
+#endif
+
+#if TELEMETRY
+// Waits for the display flush to hand back the shared DMA channel
+static void telemetry_task(void) {
+    Config_Record cfg;
+    if (telemetry_take_config(&cfg)) {
+        config_set(&cfg);
+        apply_config();
+    }
+    telemetry_poll();
+}
+#endif
+
+// DMA and I2C stop in STOP mode; an in-flight flush has to finish first
+uint8_t sched_busy(void) {
+#if TELEMETRY
+    if (telemetry_busy()) return 1;
+#endif
+    return oled_is_busy() || i2c_bus_busy();
+}
 
 /* USER CODE END 0 */
 
@@ -138,12 +953,102 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_I2C1_Init();
   /* USER CODE BEGIN 2 */
 
-  BME280_init(&hi2c1);
-  oled_init();
-  oled_clear();
+  // The panel init sequence runs while the sensor reloads its NVM. After
+  // a watchdog or error reset the sensor kept its power and calibration,
+  // so it is taken over without the soft reset. The first conversion is
+  // started right away and runs through the rest of the start-up; the
+  // first sensor_task() keeps it and only sleeps out what is left.
+  // Everything up to that runs from the MSI, the PLL comes up for the
+  // first flush.
+  uint8_t warm = watchdog_warm();
+  BME280_setup(&sensors[0], BME280_ADDRESS, 1);
+#if BME280_SENSORS > 1
+  BME280_setup(&sensors[1], BME280_ADDRESS_ALT, 0);
+#endif
+  if (!warm)
+    BME280_reset(&sensors[0]);
+  // The magic separates a panel configured before the reset from one that
+  // never got that far
+  if (warm && RTC_BKP_PANEL == PANEL_MAGIC)
+    oled_resume();
+  else
+    oled_init();
+  sensor_ready = warm ? BME280_resume(&sensors[0], BME280_MODE_FORCED) :
+                        BME280_init(&sensors[0], BME280_MODE_FORCED);
+  if (sensor_ready)
+    BME280_start(&sensors[0]);
+  hyst_init(&shown_temp, HYST_TEMP);
+  hyst_init(&shown_humidity, HYST_HUMIDITY);
+  hyst_init(&shown_pressure, HYST_PRESSURE);
+#if BME280_SENSORS > 1
+  hyst_init(&shown_outdoor, HYST_TEMP);
+#endif
+  filter_init(&filter_temp, FILTER_SHIFT);
+  filter_init(&filter_humidity, FILTER_SHIFT);
+  filter_init(&filter_pressure, FILTER_SHIFT);
+
+  PROF_INIT();
+  calib_load();
+  config_load();
+  history_init(HISTORY_PERIOD * SAMPLE_PERIOD_MS / 1000);
+  forecast_init();
+  screen_init(views, sizeof(views) / sizeof(views[0]));
+  logger_init(LOG_PERIOD * SAMPLE_PERIOD_MS / 1000);
+  pyramid_init();
+#if RADIO
+  radio_init();
+#endif
+  clock_init();
+  energy_init();
+#if ALARM
+  alarm_init();
+#endif
+#if BUTTONS
+  button_init();
+#endif
+  apply_config();
+  sched_init(SAMPLE_PERIOD_MS);
+  RTC_BKP_PANEL = PANEL_MAGIC;    // Backup domain writable from rtc_init() on
+  sched_add_task(sensor_task, 1);
+  sched_add_task(display_task, 1);
+  sched_add_task(power_task, 1);
+  sched_add_task(history_task, HISTORY_PERIOD);
+#if TELEMETRY
+  telemetry_init();     // After sched_init(): the RTC setup may reset the LSE
+#if MODBUS
+  modbus_init(modbus_map, sizeof(modbus_map) / sizeof(modbus_map[0]));
+#endif
+  sched_add_task(telemetry_task, 1);
+  sched_on(SCHED_EV_COMMAND, telemetry_task);
+#endif
+#if BUTTONS
+  sched_on(SCHED_EV_BUTTON, button_event);
+#endif
+  sched_on(SCHED_EV_DISPLAY, display_task);
+#if SUPPLY_PVD
+  sched_on(SCHED_EV_BROWNOUT, brownout_event);
+  supply_pvd_init();
+#endif
+#if TRACK && !BUTTONS
+  screen_show(VIEW_TRACK);
+#endif
+#if BENCH
+  bench_run();
+#endif
+#if FACTORY
+  // The session leaves the sensor at a profile of its own; the first
+  // sample initializes it again for the supply tier
+  if (sensor_ready)
+    factory_run(&sensors[0]);
+  sensor_ready = 0;
+#endif
+#if WATCHDOG
+  watchdog_start();     // Last: the tasks refresh it from here on
+#endif
 
   /* USER CODE END 2 */
 
@@ -151,22 +1056,7 @@ int main(void)
   /* USER CODE BEGIN WHILE */
   while (1)
   {
-	  BME280_read_data(&hi2c1);
-
-      oled_clear();
-
-      print_sensor_values(
-          BME280_get_temperature_integer(),
-          BME280_get_temperature_fraction(),
-          BME280_get_humidity_integer(),
-          BME280_get_humidity_fraction(),
-          BME280_get_pressure_integer(),
-          BME280_get_pressure_fraction()
-      );
-
-      oled_display();
-
-      HAL_Delay(1000);
+      sched_run();
 
     /* USER CODE END WHILE */
 
@@ -187,18 +1077,16 @@ void SystemClock_Config(void)
 
   /** Configure the main internal regulator output voltage
   */
-  __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+  __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE3);
 
   /** Initializes the RCC Oscillators according to the specified parameters
   * in the RCC_OscInitTypeDef structure.
   */
-  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSI;
-  RCC_OscInitStruct.HSIState = RCC_HSI_ON;
-  RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
-  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
-  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSI;
-  RCC_OscInitStruct.PLL.PLLMUL = RCC_PLLMUL_4;
-  RCC_OscInitStruct.PLL.PLLDIV = RCC_PLLDIV_2;
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_MSI;
+  RCC_OscInitStruct.MSIState = RCC_MSI_ON;
+  RCC_OscInitStruct.MSICalibrationValue = 0;
+  RCC_OscInitStruct.MSIClockRange = RCC_MSIRANGE_5;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_NONE;
   if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
   {
     Error_Handler();
@@ -208,12 +1096,12 @@ void SystemClock_Config(void)
   */
   RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
                               |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
-  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_MSI;
   RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
   RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
   RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
 
-  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_1) != HAL_OK)
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
   {
     Error_Handler();
   }
@@ -269,10 +1157,35 @@ static void MX_I2C1_Init(void)
   }
   /* USER CODE BEGIN I2C1_Init 2 */
 
+  // Replace the fixed 100 kHz CubeMX timing with one computed for PCLK1
+  i2c_bus_init(&hi2c1);
+  // Fm is out of reach of the 2 MHz start-up clock; the bus runs at the
+  // fastest speed it allows until the first switch to the PLL
+  if (i2c_bus_set_speed(I2C_BUS_DEFAULT_SPEED) != HAL_OK && i2c_bus_retune() != HAL_OK)
+  {
+    Error_Handler();
+  }
+
   /* USER CODE END I2C1_Init 2 */
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel2_3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 2, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -313,6 +1226,9 @@ void Error_Handler(void)
 {
   /* USER CODE BEGIN Error_Handler_Debug */
   /* User can add his own implementation to report the HAL error return state */
+#if WATCHDOG
+  watchdog_fail();
+#endif
   __disable_irq();
   while (1)
   {
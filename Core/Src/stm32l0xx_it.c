@@ -22,6 +22,15 @@
 #include "stm32l0xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "rtc.h"
+#include "tick.h"
+#include "telemetry.h"
+#include "i2c_bus.h"
+#include "oled_spi.h"
+#include "alarm.h"
+#include "button.h"
+#include "supply.h"
+#include "prof.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -56,6 +65,8 @@
 
 /* External variables --------------------------------------------------------*/
 
+extern DMA_HandleTypeDef hdma_i2c1_tx;
+extern I2C_HandleTypeDef hi2c1;
 /* USER CODE BEGIN EV */
 
 /* USER CODE END EV */
@@ -140,6 +151,120 @@ void SysTick_Handler(void)
 /* please refer to the startup file (startup_stm32l0xx.s).                    */
 /******************************************************************************/
 
+/**
+  * @brief This function handles DMA1 channel 2 and channel 3 interrupts.
+  */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Channel2_3_IRQn 0 */
+
+  /* USER CODE END DMA1_Channel2_3_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_i2c1_tx);
+  /* USER CODE BEGIN DMA1_Channel2_3_IRQn 1 */
+#if OLED_SPI
+  oled_spi_dma_irq();
+#endif
+
+  /* USER CODE END DMA1_Channel2_3_IRQn 1 */
+}
+
+/**
+  * @brief This function handles I2C1 event global interrupt / I2C1 wake-up interrupt through EXTI line 23.
+  */
+void I2C1_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C1_IRQn 0 */
+
+#if I2C_BUS_LL
+  i2c_bus_irq();
+#else
+  /* USER CODE END I2C1_IRQn 0 */
+  if (hi2c1.Instance->ISR & (I2C_FLAG_BERR | I2C_FLAG_ARLO | I2C_FLAG_OVR)) {
+    HAL_I2C_ER_IRQHandler(&hi2c1);
+  } else {
+    HAL_I2C_EV_IRQHandler(&hi2c1);
+  }
+  /* USER CODE BEGIN I2C1_IRQn 1 */
+#endif
+
+  /* USER CODE END I2C1_IRQn 1 */
+}
+
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles RTC global interrupt through EXTI lines 17, 19 and 20.
+  * The RTC is driven at register level (App/rtc), outside of CubeMX.
+  */
+void RTC_IRQHandler(void)
+{
+  rtc_irq_handler();
+}
+
+#if TICK_LPTIM
+/**
+  * @brief This function handles LPTIM1 global interrupt through EXTI line 29.
+  * LPTIM1 is the HAL timebase (App/tick), outside of CubeMX.
+  */
+void LPTIM1_IRQHandler(void)
+{
+  tick_irq_handler();
+}
+#endif
+
+#if TELEMETRY
+/**
+  * @brief This function handles LPUART1 global interrupt / LPUART1 wake-up interrupt through EXTI line 28.
+  * LPUART1 carries the telemetry frames (App/telemetry), outside of CubeMX.
+  */
+void LPUART1_IRQHandler(void)
+{
+  telemetry_irq_handler();
+}
+#endif
+
+#if ALARM
+/**
+  * @brief This function handles EXTI line 0 and line 1 interrupts.
+  * The alarm acknowledge button (App/alarm) is configured outside of CubeMX.
+  */
+void EXTI0_1_IRQHandler(void)
+{
+  alarm_irq_handler();
+}
+#endif
+
+#if SUPPLY_PVD
+/**
+  * @brief This function handles PVD interrupt through EXTI line 16.
+  * The PVD (App/supply) is configured outside of CubeMX.
+  */
+void PVD_IRQHandler(void)
+{
+  supply_pvd_irq_handler();
+}
+#endif
+
+#if BUTTONS
+/**
+  * @brief This function handles EXTI line 4 to 15 interrupts.
+  * The front-panel buttons (App/button) are configured outside of CubeMX.
+  */
+void EXTI4_15_IRQHandler(void)
+{
+  button_irq_handler();
+}
+#endif
+
+#if PROF_LATENCY
+/**
+  * @brief This function handles TIM2 global interrupt.
+  * TIM2 channel 1 is the interrupt latency probe (App/prof), outside of CubeMX.
+  */
+void TIM2_IRQHandler(void)
+{
+  prof_latency_irq();
+}
+#endif
+
 /* USER CODE END 1 */
@@ -77,3 +77,19 @@ void *_sbrk(ptrdiff_t incr)
 
   return (void *)prev_heap_end;
 }
+
+/**
+ * @brief Bytes handed out by _sbrk() so far; newlib never gives them back,
+ *        so this is also the heap high-water mark
+ * @return Heap size in use
+ */
+uint32_t sysmem_heap_used(void)
+{
+  extern uint8_t _end; /* Symbol defined in the linker script */
+
+  if (NULL == __sbrk_heap_end)
+  {
+    return 0;
+  }
+  return (uint32_t)(__sbrk_heap_end - &_end);
+}
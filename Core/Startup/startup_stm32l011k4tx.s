@@ -105,6 +105,21 @@ LoopFillZerobss:
   cmp r2, r4
   bcc FillZerobss
 
+/* Paint the free RAM from _end up to the stack pointer with RAM_PAINT
+   (App/ram/ram.h) so ram_stack_peak() can find the high-water mark. */
+  ldr r2, =_end
+  mov r4, sp
+  ldr r3, =0xC5C5C5C5
+  b LoopPaintStack
+
+PaintStack:
+  str  r3, [r2]
+  adds r2, r2, #4
+
+LoopPaintStack:
+  cmp r2, r4
+  bcc PaintStack
+
 /* Call static constructors */
     bl __libc_init_array
 /* Call the application's entry point.*/
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Read the report of a Bench build and compare it with a baseline.
+
+A firmware built in the Bench configuration runs its suite once after
+reset and prints one CSV row per case over the telemetry port (format in
+App/bench/bench.h); binary telemetry frames follow the report. Reset the
+board after starting this script. The sensor noise rows are listed
+separately, cheapest setting first, to pick the one that meets a noise
+target for the least charge.
+
+Set the port up first, e.g.
+    stty -F /dev/ttyACM0 9600 raw -echo
+
+Usage:
+    Tools/bench.py [--save out.csv] [--baseline old.csv] port
+"""
+
+import argparse
+import csv
+import sys
+
+FIELDS = ('case', 'n', 'cycles', 'us')
+
+
+def read_report(stream):
+    rows, noise, clock, ramfunc = [], [], None, 0
+    for raw in stream:
+        line = raw.decode('ascii', 'replace').strip()
+        if line.startswith('# bench'):
+            rows, noise, clock = [], [], int(line.split()[3])  # A reset restarts it
+        elif line.startswith('# ramfunc') and clock is not None:
+            ramfunc = int(line.split()[2])
+        elif line == '# end' and clock is not None:
+            return clock, ramfunc, rows, noise
+        elif clock is not None and line.startswith('noise,') and line.count(',') == 6:
+            _, name, n, p_sd, t_sd, us, nc = line.split(',')
+            noise.append((name, int(n), float(p_sd), float(t_sd), int(us), int(nc)))
+        elif clock is not None and line.count(',') == 3:
+            name, n, cycles, us = line.split(',')
+            rows.append({'case': name, 'n': int(n), 'cycles': int(cycles),
+                         'us': float(us)})
+    raise SystemExit('report incomplete')
+
+
+def load(path):
+    with open(path, newline='') as f:
+        return {r['case']: int(r['cycles']) for r in csv.DictReader(f)}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('port', help='serial device of the telemetry link')
+    ap.add_argument('--save', help='write the report here as CSV')
+    ap.add_argument('--baseline', help='CSV saved from an earlier run')
+    args = ap.parse_args()
+
+    with open(args.port, 'rb') as port:
+        clock, ramfunc, rows, noise = read_report(port)
+    base = load(args.baseline) if args.baseline else {}
+
+    print('# HCLK %d Hz, %d bytes of code in SRAM' % (clock, ramfunc))
+    print('case,n,cycles,us' + (',change' if base else ''))
+    for r in rows:
+        line = '%(case)s,%(n)d,%(cycles)d,%(us).2f' % r
+        if r['case'] in base and base[r['case']]:
+            line += ',%+.1f%%' % (100.0 * (r['cycles'] - base[r['case']]) / base[r['case']])
+        print(line)
+
+    # Cheapest setting first for each noise level
+    if noise:
+        print('# sensor noise, sorted by charge per result')
+        print('setting,n,p_noise_pa,t_noise_c,latency_ms,charge_uc')
+        for name, n, p_sd, t_sd, us, nc in sorted(noise, key=lambda r: r[5]):
+            print('%s,%d,%.2f,%.3f,%.1f,%.2f' % (name, n, p_sd, t_sd, us / 1000, nc / 1000))
+
+    if args.save:
+        with open(args.save, 'w', newline='') as f:
+            w = csv.DictWriter(f, FIELDS)
+            w.writeheader()
+            w.writerows(rows)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,181 @@
+/*
+ * Bosch reference compensation, as printed in the BME280 datasheet
+ * (BST-BME280-DS002, sections 4.2.3, 8.1 and 8.2), on a BME280_Calib.
+ *
+ * The integer functions are the datasheet code with only the names of
+ * the calibration fields changed; bme280_comp.c must match them bit for
+ * bit. The double functions are the floating-point variant the integer
+ * code approximates, the yardstick for the error sweeps. Left shifts of
+ * negative values are kept as printed, so build with -fwrapv.
+ */
+
+#ifndef BOSCH_REF_H
+#define BOSCH_REF_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "bme280_comp.h"
+
+static inline int32_t ref_t_fine(const BME280_Calib *c, int32_t adc_T)
+{
+    int32_t var1, var2;
+    var1 = ((((adc_T >> 3) - ((int32_t)c->dig_T1 << 1))) * ((int32_t)c->dig_T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((int32_t)c->dig_T1)) * ((adc_T >> 4) - ((int32_t)c->dig_T1))) >> 12) *
+            ((int32_t)c->dig_T3)) >> 14;
+    return var1 + var2;
+}
+
+static inline int32_t ref_temperature(int32_t t_fine)
+{
+    return (t_fine * 5 + 128) >> 8;
+}
+
+// Q24.8 Pa
+static inline uint32_t ref_pressure64(const BME280_Calib *c, int32_t adc_P, int32_t t_fine)
+{
+    int64_t var1, var2, p;
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)c->dig_P6;
+    var2 = var2 + ((var1 * (int64_t)c->dig_P5) << 17);
+    var2 = var2 + (((int64_t)c->dig_P4) << 35);
+    var1 = ((var1 * var1 * (int64_t)c->dig_P3) >> 8) + ((var1 * (int64_t)c->dig_P2) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)c->dig_P1) >> 33;
+    if (var1 == 0) return 0;
+    p = 1048576 - adc_P;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)c->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t)c->dig_P8) * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + (((int64_t)c->dig_P7) << 4);
+    return (uint32_t)p;
+}
+
+// Whole Pa
+static inline uint32_t ref_pressure32(const BME280_Calib *c, int32_t adc_P, int32_t t_fine)
+{
+    int32_t var1, var2;
+    uint32_t p;
+    var1 = (((int32_t)t_fine) >> 1) - (int32_t)64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)c->dig_P6);
+    var2 = var2 + ((var1 * ((int32_t)c->dig_P5)) << 1);
+    var2 = (var2 >> 2) + (((int32_t)c->dig_P4) << 16);
+    var1 = (((c->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)c->dig_P2) * var1) >> 1)) >> 18;
+    var1 = ((((32768 + var1)) * ((int32_t)c->dig_P1)) >> 15);
+    if (var1 == 0) return 0;
+    p = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+    if (p < 0x80000000) p = (p << 1) / ((uint32_t)var1);
+    else p = (p / (uint32_t)var1) * 2;
+    var1 = (((int32_t)c->dig_P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((int32_t)(p >> 2)) * ((int32_t)c->dig_P8)) >> 13;
+    p = (uint32_t)((int32_t)p + ((var1 + var2 + c->dig_P7) >> 4));
+    return p;
+}
+
+// Q22.10 %RH
+static inline uint32_t ref_humidity(const BME280_Calib *c, int32_t adc_H, int32_t t_fine)
+{
+    int32_t v_x1_u32r;
+    v_x1_u32r = (t_fine - ((int32_t)76800));
+    v_x1_u32r = (((((adc_H << 14) - (((int32_t)c->dig_H4) << 20) - (((int32_t)c->dig_H5) * v_x1_u32r)) +
+                   ((int32_t)16384)) >> 15) *
+                 (((((((v_x1_u32r * ((int32_t)c->dig_H6)) >> 10) *
+                      (((v_x1_u32r * ((int32_t)c->dig_H3)) >> 11) + ((int32_t)32768))) >> 10) +
+                    ((int32_t)2097152)) * ((int32_t)c->dig_H2) + 8192) >> 14));
+    v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * ((int32_t)c->dig_H1)) >> 4));
+    v_x1_u32r = (v_x1_u32r < 0 ? 0 : v_x1_u32r);
+    v_x1_u32r = (v_x1_u32r > 419430400 ? 419430400 : v_x1_u32r);
+    return (uint32_t)(v_x1_u32r >> 12);
+}
+
+// degC
+static inline double ref_temperature_double(const BME280_Calib *c, int32_t adc_T)
+{
+    double var1, var2;
+    var1 = (((double)adc_T) / 16384.0 - ((double)c->dig_T1) / 1024.0) * ((double)c->dig_T2);
+    var2 = ((((double)adc_T) / 131072.0 - ((double)c->dig_T1) / 8192.0) *
+            (((double)adc_T) / 131072.0 - ((double)c->dig_T1) / 8192.0)) * ((double)c->dig_T3);
+    return (var1 + var2) / 5120.0;
+}
+
+// Pa
+static inline double ref_pressure_double(const BME280_Calib *c, int32_t adc_P, int32_t t_fine)
+{
+    double var1, var2, p;
+    var1 = ((double)t_fine / 2.0) - 64000.0;
+    var2 = var1 * var1 * ((double)c->dig_P6) / 32768.0;
+    var2 = var2 + var1 * ((double)c->dig_P5) * 2.0;
+    var2 = (var2 / 4.0) + (((double)c->dig_P4) * 65536.0);
+    var1 = (((double)c->dig_P3) * var1 * var1 / 524288.0 + ((double)c->dig_P2) * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * ((double)c->dig_P1);
+    if (var1 == 0.0) return 0;
+    p = 1048576.0 - (double)adc_P;
+    p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+    var1 = ((double)c->dig_P9) * p * p / 2147483648.0;
+    var2 = p * ((double)c->dig_P8) / 32768.0;
+    return p + (var1 + var2 + ((double)c->dig_P7)) / 16.0;
+}
+
+// %RH, unclamped
+static inline double ref_humidity_double(const BME280_Calib *c, int32_t adc_H, int32_t t_fine)
+{
+    double var_H;
+    var_H = (((double)t_fine) - 76800.0);
+    var_H = (adc_H - (((double)c->dig_H4) * 64.0 + ((double)c->dig_H5) / 16384.0 * var_H)) *
+            (((double)c->dig_H2) / 65536.0 *
+             (1.0 + ((double)c->dig_H6) / 67108864.0 * var_H * (1.0 + ((double)c->dig_H3) / 67108864.0 * var_H)));
+    return var_H * (1.0 - ((double)c->dig_H1) * var_H / 524288.0);
+}
+
+/*
+ * The datasheet's worked example (section 8.1 and the Bosch API test
+ * data) for T and P; the humidity coefficients are those of a production
+ * part, as the datasheet gives none.
+ */
+static const BME280_Calib ref_sample_calib = {
+    .dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000,
+    .dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140,
+    .dig_P6 = -7, .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000,
+    .dig_H1 = 75, .dig_H2 = 362, .dig_H3 = 0, .dig_H4 = 324, .dig_H5 = 50, .dig_H6 = 30,
+};
+
+// xorshift32: the same sets on every run and every host
+static inline uint32_t ref_rand(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+// v moved by up to 5 %, at least 2 counts
+static inline int32_t ref_jitter(int32_t v, uint32_t *s)
+{
+    int32_t span = abs(v) / 20 + 2;
+    return v + (int32_t)(ref_rand(s) % (uint32_t)(2 * span + 1)) - span;
+}
+
+// Sample set with every coefficient moved
+
+static inline void ref_perturbed_calib(BME280_Calib *c, uint32_t *seed)
+{
+    *c = ref_sample_calib;
+    c->dig_T1 = (uint16_t)ref_jitter(c->dig_T1, seed);
+    c->dig_T2 = (int16_t)ref_jitter(c->dig_T2, seed);
+    c->dig_T3 = (int16_t)ref_jitter(c->dig_T3, seed);
+    c->dig_P1 = (uint16_t)ref_jitter(c->dig_P1, seed);
+    c->dig_P2 = (int16_t)ref_jitter(c->dig_P2, seed);
+    c->dig_P3 = (int16_t)ref_jitter(c->dig_P3, seed);
+    c->dig_P4 = (int16_t)ref_jitter(c->dig_P4, seed);
+    c->dig_P5 = (int16_t)ref_jitter(c->dig_P5, seed);
+    c->dig_P6 = (int16_t)ref_jitter(c->dig_P6, seed);
+    c->dig_P7 = (int16_t)ref_jitter(c->dig_P7, seed);
+    c->dig_P8 = (int16_t)ref_jitter(c->dig_P8, seed);
+    c->dig_P9 = (int16_t)ref_jitter(c->dig_P9, seed);
+    c->dig_H1 = (uint8_t)ref_jitter(c->dig_H1, seed);
+    c->dig_H2 = (int16_t)ref_jitter(c->dig_H2, seed);
+    c->dig_H3 = (uint8_t)(ref_rand(seed) % 4);
+    c->dig_H4 = (int16_t)ref_jitter(c->dig_H4, seed);
+    c->dig_H5 = (int16_t)ref_jitter(c->dig_H5, seed);
+    c->dig_H6 = (int8_t)ref_jitter(c->dig_H6, seed);
+}
+
+#endif
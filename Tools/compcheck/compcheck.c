@@ -0,0 +1,310 @@
+/*
+ * Host check of the BME280 compensation in App/bme280/bme280_comp.c.
+ *
+ * bme280_comp.c is compiled unchanged and run three ways:
+ *
+ *   golden  the datasheet's worked example from the raw calibration
+ *           registers on: coefficient decode (the H4/H5 nibbles shared in
+ *           0xE5 included), t_fine, temperature and pressure
+ *   sweep   every adc_T, and every adc_P and adc_H at t_fine from -40 to
+ *           85 degC, on the sample calibration and on perturbed copies of
+ *           it: each result must equal the Bosch integer reference
+ *           (bosch_ref.h) bit for bit, through the split entry points
+ *           with cached terms as well as the one-call ones. Alongside, the
+ *           largest difference to the datasheet's double-precision formulas
+ *           within the specified range (-40..85 degC, 300..1100 hPa,
+ *           0..100 %RH)
+ *   bench   ns per call of each entry point and of the reference, on
+ *           random inputs. The reference is inlined into the loop and the
+ *           host has 64-bit division in hardware, so the figures show what
+ *           caching the t_fine terms saves, not what the M0+ spends; its
+ *           cycle counts come from the Bench build (App/bench)
+ *
+ * Build from the repository root. -fwrapv keeps the reference's shifts of
+ * negative values and any overflow a perturbed set causes defined:
+ *
+ *     cc -O2 -fwrapv -o compcheck -ITools/compcheck -IApp/bme280 \
+ *         -IApp/ramfunc Tools/compcheck/compcheck.c App/bme280/bme280_comp.c -lm
+ *
+ * Add -DBME280_PRESSURE_INT32=1 to check the 32-bit pressure variant
+ * against the datasheet's 32-bit formula instead.
+ *
+ * Usage:
+ *     compcheck [-n sets] [-t step] [-a stride] [-b calls]
+ *         -n  calibration sets, the sample one and n-1 perturbed (4)
+ *         -t  t_fine grid step in degC (1)
+ *         -a  adc_P stride; 1 sweeps all 2^20 values (1)
+ *         -b  calls per benchmark entry, 0 skips the benchmark (4000000)
+ *
+ * Output is CSV: check, set, cases, mismatches, largest error and its
+ * unit, then the benchmark lines. The exit code is 1 on any mismatch.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bme280_comp.h"
+#include "bosch_ref.h"
+
+#define ADC_T_RANGE     (1L << 20)
+#define ADC_P_RANGE     (1L << 20)
+#define ADC_H_RANGE     (1L << 16)
+#define T_FINE_PER_DEGC 5120
+
+#define BENCH_INPUTS    4096
+
+static unsigned long failures;
+
+// Registers 0x88..0xA1 and 0xE1..0xE7 that decode to ref_sample_calib
+static const uint8_t sample_calib1[BME280_CALIB1_LEN] = {
+    0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC,                     // T1..T3
+    0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B, 0x27, 0x0B, 0x8C, 0x00,
+    0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17,         // P1..P9
+    0x00, 0x4B,                                             // 0xA0, H1
+};
+static const uint8_t sample_calib2[BME280_CALIB2_LEN] = {
+    0x6A, 0x01, 0x00, 0x14, 0x24, 0x03, 0x1E,               // H2, H3, H4/H5, H6
+};
+
+static void report(const char *check, int set, unsigned long cases, unsigned long bad,
+                   double err, const char *unit)
+{
+    printf("%s,%d,%lu,%lu,%.4f,%s\n", check, set, cases, bad, err, unit);
+    failures += bad;
+}
+
+static void mismatch(const char *what, int32_t adc, int32_t t_fine, uint32_t got, uint32_t want)
+{
+    fprintf(stderr, "compcheck: %s adc %ld t_fine %ld: %lu, reference %lu\n",
+            what, (long)adc, (long)t_fine, (unsigned long)got, (unsigned long)want);
+}
+
+// Pressure of the selected variant in Pa, and its Bosch reference
+#if BME280_PRESSURE_INT32
+#define REF_PRESSURE(c, adc, t) (ref_pressure32(c, adc, t) << 8)
+#define PRESSURE_NAME "pressure32"
+#else
+#define REF_PRESSURE(c, adc, t) ref_pressure64(c, adc, t)
+#define PRESSURE_NAME "pressure64"
+#endif
+
+static void check_golden(void)
+{
+    BME280_Calib c;
+    BME280_Coeffs k;
+    unsigned long bad = 0;
+
+    BME280_calib_parse(&c, sample_calib1, sample_calib2);
+    bad += c.dig_T1 != ref_sample_calib.dig_T1 || c.dig_T2 != ref_sample_calib.dig_T2 ||
+           c.dig_T3 != ref_sample_calib.dig_T3;
+    bad += c.dig_P1 != ref_sample_calib.dig_P1 || c.dig_P2 != ref_sample_calib.dig_P2 ||
+           c.dig_P3 != ref_sample_calib.dig_P3 || c.dig_P4 != ref_sample_calib.dig_P4 ||
+           c.dig_P5 != ref_sample_calib.dig_P5 || c.dig_P6 != ref_sample_calib.dig_P6 ||
+           c.dig_P7 != ref_sample_calib.dig_P7 || c.dig_P8 != ref_sample_calib.dig_P8 ||
+           c.dig_P9 != ref_sample_calib.dig_P9;
+    bad += c.dig_H1 != ref_sample_calib.dig_H1 || c.dig_H2 != ref_sample_calib.dig_H2 ||
+           c.dig_H3 != ref_sample_calib.dig_H3 || c.dig_H4 != ref_sample_calib.dig_H4 ||
+           c.dig_H5 != ref_sample_calib.dig_H5 || c.dig_H6 != ref_sample_calib.dig_H6;
+    if (bad) fprintf(stderr, "compcheck: calibration registers decode wrong\n");
+
+    // Datasheet section 8.1 worked example: 25.08 degC and 100653.27 Pa of
+    // the double formula; the 64-bit integer result has to land within
+    // 0.05 Pa of it, the 32-bit one is 100656 Pa
+    BME280_coeffs_derive(&k, &c);
+    int32_t t_fine = BME280_comp_t_fine(&k, 519888);
+    uint32_t p = BME280_comp_pressure(&k, 415148, t_fine);
+#if BME280_PRESSURE_INT32
+    int p_ok = p == 100656U << 8;
+#else
+    int p_ok = fabs(p / 256.0 - 100653.27) <= 0.05;
+#endif
+    if (t_fine != 128422) {
+        fprintf(stderr, "compcheck: golden t_fine %ld, datasheet 128422\n", (long)t_fine);
+        bad++;
+    }
+    if (BME280_comp_temperature(t_fine) != 2508) {
+        fprintf(stderr, "compcheck: golden temperature %ld, datasheet 2508\n",
+                (long)BME280_comp_temperature(t_fine));
+        bad++;
+    }
+    if (!p_ok) {
+        fprintf(stderr, "compcheck: golden pressure %.2f Pa, datasheet %s\n", p / 256.0,
+                BME280_PRESSURE_INT32 ? "100656" : "100653.27");
+        bad++;
+    }
+    report("golden", 0, 4, bad, 0.0, "-");
+}
+
+static void check_temperature(int set, const BME280_Calib *c, const BME280_Coeffs *k)
+{
+    unsigned long bad = 0;
+    double err = 0.0;
+
+    for (int32_t adc = 0; adc < ADC_T_RANGE; adc++) {
+        int32_t t_fine = BME280_comp_t_fine(k, adc);
+        int32_t t = BME280_comp_temperature(t_fine);
+        int32_t want = ref_t_fine(c, adc);
+        if (t_fine != want || t != ref_temperature(want)) {
+            if (!bad) mismatch("temperature", adc, 0, (uint32_t)t_fine, (uint32_t)want);
+            bad++;
+            continue;
+        }
+        double exact = ref_temperature_double(c, adc);
+        if (exact >= -40.0 && exact <= 85.0 && fabs(t / 100.0 - exact) > err)
+            err = fabs(t / 100.0 - exact);
+    }
+    report("temperature", set, ADC_T_RANGE, bad, err, "degC");
+}
+
+// A t_fine on the grid, its low bits moved off the whole degree
+static int32_t grid_t_fine(int i, int step)
+{
+    return (-40 + i * step) * T_FINE_PER_DEGC + (int32_t)((i * 1237L) % T_FINE_PER_DEGC);
+}
+
+static void check_pressure(int set, const BME280_Calib *c, const BME280_Coeffs *k,
+                           int step, int stride)
+{
+    unsigned long cases = 0, bad = 0;
+    double err = 0.0;
+
+    for (int i = 0; -40 + i * step <= 85; i++) {
+        int32_t t_fine = grid_t_fine(i, step);
+        BME280_TfineTerms terms;
+        BME280_comp_pressure_terms(k, t_fine, &terms);
+        for (int32_t adc = 0; adc < ADC_P_RANGE; adc += stride) {
+            uint32_t p = BME280_comp_pressure_adc(k, &terms, adc);
+            uint32_t want = REF_PRESSURE(c, adc, t_fine);
+            cases++;
+            if (p != want || ((adc & 63) == 0 && BME280_comp_pressure(k, adc, t_fine) != want)) {
+                if (!bad) mismatch(PRESSURE_NAME, adc, t_fine, p, want);
+                bad++;
+                continue;
+            }
+            double exact = ref_pressure_double(c, adc, t_fine);
+            if (exact >= 30000.0 && exact <= 110000.0 && fabs(p / 256.0 - exact) > err)
+                err = fabs(p / 256.0 - exact);
+        }
+    }
+    report(PRESSURE_NAME, set, cases, bad, err, "Pa");
+}
+
+static void check_humidity(int set, const BME280_Calib *c, const BME280_Coeffs *k, int step)
+{
+    unsigned long cases = 0, bad = 0;
+    double err = 0.0;
+
+    for (int i = 0; -40 + i * step <= 85; i++) {
+        int32_t t_fine = grid_t_fine(i, step);
+        BME280_TfineTerms terms;
+        BME280_comp_humidity_terms(k, t_fine, &terms);
+        for (int32_t adc = 0; adc < ADC_H_RANGE; adc++) {
+            uint32_t h = BME280_comp_humidity_adc(k, &terms, adc);
+            uint32_t want = ref_humidity(c, adc, t_fine);
+            cases++;
+            if (h != want || ((adc & 63) == 0 && BME280_comp_humidity(k, adc, t_fine) != want)) {
+                if (!bad) mismatch("humidity", adc, t_fine, h, want);
+                bad++;
+                continue;
+            }
+            double exact = ref_humidity_double(c, adc, t_fine);
+            if (exact >= 0.0 && exact <= 100.0 && fabs(h / 1024.0 - exact) > err)
+                err = fabs(h / 1024.0 - exact);
+        }
+    }
+    report("humidity", set, cases, bad, err, "%RH");
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile uint32_t sink;
+
+#define BENCH(name, expr) do {                                          \
+        uint32_t acc = 0;                                               \
+        double t0 = now_ns();                                           \
+        for (long n = 0; n < calls; n++) {                              \
+            int32_t adc = adcs[n & (BENCH_INPUTS - 1)];                 \
+            int32_t t_fine = t_fines[n & (BENCH_INPUTS - 1)];           \
+            (void)t_fine;                                               \
+            acc += (uint32_t)(expr);                                    \
+        }                                                               \
+        sink = acc;                                                     \
+        printf("bench,%s,%ld,%.2f,ns/op\n", name, calls, (now_ns() - t0) / calls); \
+    } while (0)
+
+static void bench(long calls)
+{
+    static int32_t adcs[BENCH_INPUTS], t_fines[BENCH_INPUTS];
+    const BME280_Calib *c = &ref_sample_calib;
+    BME280_Coeffs k;
+    BME280_TfineTerms pt, ht;
+    uint32_t seed = 0x2545F491;
+
+    BME280_coeffs_derive(&k, c);
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        adcs[i] = (int32_t)(250000 + ref_rand(&seed) % 300000);
+        t_fines[i] = (int32_t)(ref_rand(&seed) % (125 * T_FINE_PER_DEGC)) - 40 * T_FINE_PER_DEGC;
+    }
+    BME280_comp_pressure_terms(&k, t_fines[0], &pt);
+    BME280_comp_humidity_terms(&k, t_fines[0], &ht);
+
+    BENCH("comp_t_fine", BME280_comp_t_fine(&k, adc));
+    BENCH("ref_t_fine", ref_t_fine(c, adc));
+    BENCH("comp_pressure", BME280_comp_pressure(&k, adc, t_fine));
+    BENCH("comp_pressure_adc", BME280_comp_pressure_adc(&k, &pt, adc));
+#if BME280_PRESSURE_INT32
+    BENCH("ref_pressure32", ref_pressure32(c, adc, t_fine));
+#else
+    BENCH("ref_pressure64", ref_pressure64(c, adc, t_fine));
+#endif
+    BENCH("comp_humidity", BME280_comp_humidity(&k, adc >> 4, t_fine));
+    BENCH("comp_humidity_adc", BME280_comp_humidity_adc(&k, &ht, adc >> 4));
+    BENCH("ref_humidity", ref_humidity(c, adc >> 4, t_fine));
+}
+
+int main(int argc, char **argv)
+{
+    int sets = 4, step = 1, stride = 1, opt;
+    long calls = 4000000;
+    uint32_t seed = 0x9E3779B9;
+
+    while ((opt = getopt(argc, argv, "n:t:a:b:")) != -1) {
+        switch (opt) {
+        case 'n': sets = atoi(optarg); break;
+        case 't': step = atoi(optarg); break;
+        case 'a': stride = atoi(optarg); break;
+        case 'b': calls = atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n sets] [-t step] [-a stride] [-b calls]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (step < 1) step = 1;
+    if (stride < 1) stride = 1;
+
+    printf("check,set,cases,mismatches,max_error,unit\n");
+    check_golden();
+    for (int set = 0; set < sets; set++) {
+        BME280_Calib c;
+        BME280_Coeffs k;
+        if (set) ref_perturbed_calib(&c, &seed);
+        else c = ref_sample_calib;
+        BME280_coeffs_derive(&k, &c);
+        check_temperature(set, &c, &k);
+        check_pressure(set, &c, &k, step, stride);
+        check_humidity(set, &c, &k, step);
+        fflush(stdout);
+    }
+    if (calls > 0) bench(calls);
+
+    printf("# %lu mismatches\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * Bound of the 32-bit pressure variant (BME280_PRESSURE_INT32=1) against
+ * the 64-bit formula it replaces.
+ *
+ * bme280_comp.c is compiled with the 32-bit variant and compared with the
+ * Bosch 64-bit reference (bosch_ref.h) over every adc_P at every t_fine
+ * of a grid from -40 to 85 degC, on the datasheet's sample calibration
+ * and on perturbed copies of it. Only pressures the sensor is specified
+ * for count, 300..1100 hPa by the 64-bit result. The largest difference
+ * must stay within the bound bme280_comp.h documents, 8 Pa.
+ *
+ * Build from the repository root:
+ *
+ *     cc -O2 -fwrapv -DBME280_PRESSURE_INT32=1 -o pressure32 -ITools/compcheck \
+ *         -IApp/bme280 -IApp/ramfunc Tools/compcheck/pressure32.c \
+ *         App/bme280/bme280_comp.c
+ *
+ * Usage:
+ *     pressure32 [-n sets] [-t step]
+ *         -n  calibration sets, the sample one and n-1 perturbed (20)
+ *         -t  t_fine grid step in degC (1)
+ *
+ * Output is CSV, one line per set: cases in range, largest difference in
+ * Pa and where it occurs, then the overall largest. The exit code is 1
+ * if it exceeds the bound.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bme280_comp.h"
+#include "bosch_ref.h"
+
+#if !BME280_PRESSURE_INT32
+#error "Build with -DBME280_PRESSURE_INT32=1"
+#endif
+
+#define ADC_P_RANGE     (1L << 20)
+#define T_FINE_PER_DEGC 5120
+#define P_MIN_Q8        (30000L * 256)
+#define P_MAX_Q8        (110000L * 256)
+#define BOUND_PA        8.0
+
+int main(int argc, char **argv)
+{
+    int sets = 20, step = 1, opt;
+    uint32_t seed = 0x9E3779B9;
+    double worst = 0.0;
+
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+        case 'n': sets = atoi(optarg); break;
+        case 't': step = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n sets] [-t step]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (step < 1) step = 1;
+
+    printf("set,cases,max_diff_pa,adc_P,t_fine\n");
+    for (int set = 0; set < sets; set++) {
+        BME280_Calib c;
+        BME280_Coeffs k;
+        unsigned long cases = 0;
+        double diff = 0.0;
+        int32_t at_adc = 0, at_t_fine = 0;
+
+        if (set) ref_perturbed_calib(&c, &seed);
+        else c = ref_sample_calib;
+        BME280_coeffs_derive(&k, &c);
+
+        for (int i = 0; -40 + i * step <= 85; i++) {
+            // Low bits off the whole degree, as compcheck does
+            int32_t t_fine = (-40 + i * step) * T_FINE_PER_DEGC +
+                             (int32_t)((i * 1237L) % T_FINE_PER_DEGC);
+            BME280_TfineTerms terms;
+            BME280_comp_pressure_terms(&k, t_fine, &terms);
+            for (int32_t adc = 0; adc < ADC_P_RANGE; adc++) {
+                uint32_t p64 = ref_pressure64(&c, adc, t_fine);
+                if (p64 < P_MIN_Q8 || p64 > P_MAX_Q8) continue;
+                double d = ((double)BME280_comp_pressure_adc(&k, &terms, adc) - p64) / 256.0;
+                if (d < 0) d = -d;
+                cases++;
+                if (d > diff) {
+                    diff = d;
+                    at_adc = adc;
+                    at_t_fine = t_fine;
+                }
+            }
+        }
+        printf("%d,%lu,%.2f,%ld,%ld\n", set, cases, diff, (long)at_adc, (long)at_t_fine);
+        fflush(stdout);
+        if (diff > worst) worst = diff;
+    }
+
+    printf("# largest difference %.2f Pa, bound %.0f Pa%s\n", worst, BOUND_PA,
+           worst > BOUND_PA ? ", EXCEEDED" : "");
+    return worst > BOUND_PA;
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Read or change the runtime configuration block of a unit.
+
+Sends the config read command ('G'), or with field=value arguments the
+current configuration with those fields replaced ('C' and the record),
+and prints the configuration the unit answers with (layout in
+App/telemetry/telemetry.h, fields in App/config/config.h). The unit
+stores a new configuration in data EEPROM, brings out-of-range fields
+into range and applies it at once; it survives resets until replaced.
+
+Alarm limits are in 0.01 units (degC, %RH); 'off' disables a side.
+
+Set the port up first, e.g.
+    stty -F /dev/ttyACM0 9600 raw -echo
+
+Usage:
+    Tools/config.py port                              (print)
+    Tools/config.py port sample_max=120 profile=weather
+"""
+
+import argparse
+import struct
+
+from dump import read_block
+
+CONFIG_SYNC = 0x5D
+CONFIG_VERSION = 1
+RECORD = '<BBBBHHhhhhhh'
+FIELDS = ('profile', 'sample_min', 'sample_max', 'contrast', 'dim_ticks', 'off_ticks',
+          'alarm_temp_low', 'alarm_temp_high', 'alarm_temp_hyst',
+          'alarm_humidity_low', 'alarm_humidity_high', 'alarm_humidity_hyst')
+PROFILES = ('default', 'weather', 'humidity', 'indoor_nav', 'gaming')
+OFF_LOW, OFF_HIGH = -0x8000, 0x7FFF
+
+
+def config_length(buf):
+    return 4 + buf[3] + 2
+
+
+def read_config(port, command):
+    port.write(command)
+    block = read_block(port, CONFIG_SYNC, config_length)
+    if block[1] != CONFIG_VERSION or block[3] != struct.calcsize(RECORD):
+        raise SystemExit('unknown config version %d' % block[1])
+    return bool(block[2]), dict(zip(FIELDS, struct.unpack_from(RECORD, block, 4)))
+
+
+def parse(field, text):
+    if field == 'profile' and text in PROFILES:
+        return PROFILES.index(text)
+    if text == 'off' and field.startswith('alarm_') and field.endswith('_low'):
+        return OFF_LOW
+    if text == 'off' and field.startswith('alarm_') and field.endswith('_high'):
+        return OFF_HIGH
+    return int(text, 0)
+
+
+def show(stored, cfg):
+    print('# %s' % ('stored in EEPROM' if stored else 'compile-time defaults'))
+    for f in FIELDS:
+        v = cfg[f]
+        if f == 'profile':
+            v = PROFILES[v] if v < len(PROFILES) else v
+        elif f.startswith('alarm_') and v in (OFF_LOW, OFF_HIGH):
+            v = 'off'
+        print('%s=%s' % (f, v))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('port', help='serial device of the telemetry link')
+    ap.add_argument('set', nargs='*', metavar='field=value',
+                    help='fields to change: ' + ', '.join(FIELDS))
+    args = ap.parse_args()
+
+    with open(args.port, 'r+b', buffering=0) as port:
+        stored, cfg = read_config(port, b'G')
+        if args.set:
+            for item in args.set:
+                field, _, text = item.partition('=')
+                if field not in FIELDS or not text:
+                    ap.error('bad field=value: %s' % item)
+                cfg[field] = parse(field, text)
+            record = struct.pack(RECORD, *(cfg[f] for f in FIELDS))
+            stored, cfg = read_config(port, b'C' + record)
+            if not stored:
+                raise SystemExit('the unit did not store the configuration')
+    show(stored, cfg)
+
+
+if __name__ == '__main__':
+    main()
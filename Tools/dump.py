@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""Fetch and decode a bulk dump of the history ring, the EEPROM log and
+the quarter bucket ring.
+
+Sends the dump command ('D') over the telemetry port and reads one dump
+block (layout in App/telemetry/telemetry.h). The 1-minute history ring is
+decoded from its 4-bit delta codes, the log of hour buckets from its
+CRC-checked blocks, oldest first; the quarter-hour buckets follow. Values
+are in the history units: 0.1 degC, 0.1 %RH, 0.1 hPa; buckets print mean,
+min and max per channel. Sample times come from the unit's RTC: history
+samples count back from the newest one, log records forward from the time
+of their block. Quarter buckets carry no time.
+
+With --set-time it first sets the unit's RTC to the host clock ('T').
+
+With --profile it sends 'P' instead and prints the cycle statistics of
+a firmware built with PROF=1 (App/prof/prof.h); with PROF_LATENCY=1 as
+well, the irq_latency rows are the entry latency of each interrupt
+priority level in cycles (plan in Core/Inc/main.h).
+
+Set the port up first, e.g.
+    stty -F /dev/ttyACM0 9600 raw -echo
+
+Usage:
+    Tools/dump.py [--set-time] [--raw out.bin] port     (or a saved dump with --file)
+    Tools/dump.py --profile port
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+from telemetry import crc16
+
+DUMP_SYNC = 0x5A
+DUMP_VERSION = 3
+HEADER_LEN = 34
+ESCAPE = 0x8
+LOG_UNUSED = -0x8000
+BUCKET_CHANNEL = 4      # Pyramid_Span: int16 mean, uint8 below, uint8 above
+CHANNELS = ('temperature', 'humidity', 'pressure')
+PROF_SYNC = 0x5B
+PROF_PHASES = ('sensor_read', 'print_values', 'display',
+               'irq_latency0', 'irq_latency1', 'irq_latency2', 'irq_latency3')
+
+
+def dump_length(buf):
+    return 4 + struct.unpack_from('<H', buf, 2)[0] + 2
+
+
+def profile_length(buf):
+    return 2 + 16 * buf[1] + 2
+
+
+def read_block(stream, sync=DUMP_SYNC, length=dump_length, timeout=5.0):
+    buf = bytearray()
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        chunk = stream.read(256)
+        if chunk:
+            buf += chunk
+        while buf and buf[0] != sync:
+            del buf[0]          # Telemetry frames sent before the block
+        if len(buf) >= 4:
+            total = length(buf)
+            if len(buf) >= total:
+                block = bytes(buf[:total])
+                if crc16(block[:-2]) == struct.unpack_from('<H', block, total - 2)[0]:
+                    return block
+                del buf[0]
+        if not chunk:
+            time.sleep(0.05)
+    raise SystemExit('no valid block received')
+
+
+def decode_history(block):
+    nch, _, ring_len, head, used, count = struct.unpack_from('<BBHHHH', block, 4)
+    oldest = list(struct.unpack_from('<%dh' % nch, block, 14))
+    newest_time, period = struct.unpack_from('<IH', block, 24)
+    ring = block[HEADER_LEN:HEADER_LEN + ring_len]
+    codes = ring_len * 2
+
+    def code(i):
+        b = ring[i >> 1]
+        return b >> 4 if i & 1 else b & 0x0F
+
+    samples = [list(oldest)] if count else []
+    pos = (head + codes - used) % codes
+    v = list(oldest)
+    for _ in range(count - 1):
+        for ch in range(nch):
+            c = code(pos)
+            pos = (pos + 1) % codes
+            if c == ESCAPE:
+                x = 0
+                for _ in range(4):
+                    x = (x << 4) | code(pos)
+                    pos = (pos + 1) % codes
+                v[ch] = x - 0x10000 if x & 0x8000 else x
+            else:
+                v[ch] += (c & 0x7) - (c & 0x8)
+        samples.append(list(v))
+    return [(newest_time - (count - 1 - i) * period, s) for i, s in enumerate(samples)]
+
+
+def decode_log(block):
+    nch, per_block, ring_len = struct.unpack_from('<BBH', block, 4)
+    log_len, block_len = struct.unpack_from('<HB', block, 20)
+    period = struct.unpack_from('<H', block, 30)[0]
+    base = HEADER_LEN + ring_len
+    region = block[base:base + log_len]
+
+    blocks = []
+    for off in range(0, log_len - block_len + 1, block_len):
+        b = region[off:off + block_len]
+        if crc16(b[:-2]) != struct.unpack_from('<H', b, block_len - 2)[0]:
+            continue        # Erased, torn or never written
+        stamp, seq = struct.unpack_from('<IH', b, 0)
+        records = [(stamp + r * period, bucket(b, 6 + BUCKET_CHANNEL * nch * r, nch))
+                   for r in range(per_block)]
+        blocks.append((seq, records))
+    if not blocks:
+        return []
+
+    # Sequence numbers wrap at 16 bits. The log is one run of consecutive
+    # numbers; blocks left over from an older pass start runs of their own
+    seqs = {s for s, _ in blocks}
+    def run(start):
+        n = 0
+        while (start + n) & 0xFFFF in seqs:
+            n += 1
+        return n
+    starts = [s for s in seqs if (s - 1) & 0xFFFF not in seqs] or [blocks[0][0]]
+    first = max(starts, key=run)
+    length = run(first)
+    blocks = [b for b in blocks if (b[0] - first) & 0xFFFF < length]
+    blocks.sort(key=lambda b: (b[0] - first) & 0xFFFF)
+    return [r for _, records in blocks for r in records if r[1][0][0] != LOG_UNUSED]
+
+
+def decode_quarters(block):
+    nch, _, ring_len = struct.unpack_from('<BBH', block, 4)
+    log_len = struct.unpack_from('<H', block, 20)[0]
+    slots, count, head = block[23], block[32], block[33]
+    base = HEADER_LEN + ring_len + log_len
+    size = BUCKET_CHANNEL * nch
+    return [(None, bucket(block, base + size * ((head + slots - count + i) % slots), nch))
+            for i in range(count)]
+
+
+def bucket(buf, off, nch):
+    """(mean, min, max) per channel of a Pyramid_Bucket."""
+    out = []
+    for ch in range(nch):
+        mean, below, above = struct.unpack_from('<hBB', buf, off + BUCKET_CHANNEL * ch)
+        out.append((mean, mean - below, mean + above))
+    return out
+
+
+def show(title, samples):
+    print('# %s: %d samples' % (title, len(samples)))
+    print('index,time,' + ','.join(CHANNELS))
+    for i, (stamp, s) in enumerate(samples):
+        print('%d,%s,%s' % (i, time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime(stamp)),
+                            ','.join('%.1f' % (x / 10) for x in s)))
+
+
+def show_buckets(title, buckets):
+    print('# %s: %d buckets' % (title, len(buckets)))
+    print('index,time,' + ','.join('%s,%s_min,%s_max' % (c, c, c) for c in CHANNELS))
+    for i, (stamp, b) in enumerate(buckets):
+        stamp = time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime(stamp)) if stamp is not None else ''
+        print('%d,%s,%s' % (i, stamp, ','.join('%.1f' % (x / 10) for s in b for x in s)))
+
+
+def show_profile(block):
+    print('phase,count,min,avg,max')
+    for i in range(block[1]):
+        lo, hi, total, count = struct.unpack_from('<4I', block, 2 + 16 * i)
+        name = PROF_PHASES[i] if i < len(PROF_PHASES) else 'phase%d' % i
+        if count:
+            print('%s,%d,%d,%d,%d' % (name, count, lo, total // count, hi))
+        else:
+            print('%s,0,,,' % name)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('port', nargs='?', help='serial device of the telemetry link')
+    ap.add_argument('--file', help='decode a dump saved with --raw instead')
+    ap.add_argument('--raw', help='also save the raw dump block here')
+    ap.add_argument('--profile', action='store_true',
+                    help='fetch the profiling table instead of a dump')
+    ap.add_argument('--set-time', action='store_true',
+                    help='set the unit\'s RTC to the host clock first')
+    args = ap.parse_args()
+
+    if args.set_time:
+        if not args.port:
+            ap.error('--set-time needs a port')
+        with open(args.port, 'r+b', buffering=0) as port:
+            port.write(b'T' + struct.pack('<I', int(time.time())))
+
+    if args.profile:
+        if not args.port:
+            ap.error('--profile needs a port')
+        with open(args.port, 'r+b', buffering=0) as port:
+            port.write(b'P')
+            show_profile(read_block(port, PROF_SYNC, profile_length))
+        return
+
+    if args.file:
+        with open(args.file, 'rb') as f:
+            block = read_block(f, timeout=0.1)
+    elif args.port:
+        with open(args.port, 'r+b', buffering=0) as port:
+            port.write(b'D')
+            block = read_block(port)
+    else:
+        ap.error('need a port or --file')
+
+    if block[1] != DUMP_VERSION:
+        raise SystemExit('unknown dump version %d' % block[1])
+    if args.raw:
+        with open(args.raw, 'wb') as f:
+            f.write(block)
+    show('history', decode_history(block))
+    show_buckets('log', decode_log(block))
+    show_buckets('quarters', decode_quarters(block))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Calibrate a unit running the Factory build against a reference sensor.
+
+Streams reference readings to the unit as reference frames (layout in
+App/factory/factory.h) for a few seconds after its start-up, then sends
+the write command ('W') and prints the fitted calibration it answers
+with. The unit pairs every frame with its own readings and fits an
+offset per channel, and a slope where the references span enough.
+
+References come from --ref, held for the whole session (a chamber at a
+known set point), or as lines on stdin, one per reading of the reference
+instrument: temperature [degC], humidity [%RH], pressure [hPa], with '-'
+for a channel the instrument does not measure. Lines are sent as they
+arrive, at most one per frame time.
+
+Start the session within 3 s of resetting the unit. Set the port up
+first, e.g.
+    stty -F /dev/ttyACM0 9600 raw -echo
+
+Usage:
+    Tools/factory.py --ref 23.50,45.2,1013.25 port
+    reference-logger | Tools/factory.py port
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+from dump import read_block
+from telemetry import crc16
+
+REF_SYNC = 0xA6
+RESULT_SYNC = 0x5E
+RECORD = '<hhhhbbbB'
+FIT_BITS = (('temperature', 0x01), ('humidity', 0x02), ('pressure', 0x04))
+FRAME_TIME = 16 * 10 / 9600.0       # 16 bytes of 10 bits at 9600 baud
+
+
+def parse_ref(text):
+    fields = [f.strip() for f in text.replace(',', ' ').split()]
+    if len(fields) != 3:
+        raise ValueError('need temperature, humidity and pressure')
+    return [None if f == '-' else float(f) for f in fields]
+
+
+def frame(ref):
+    t, h, p = ref
+    mask = sum(bit for (_, bit), v in zip(FIT_BITS, (t, h, p)) if v is not None)
+    body = struct.pack('<BBiII', REF_SYNC, mask,
+                       round((t or 0) * 100), round((p or 0) * 100 * 256), round((h or 0) * 1024))
+    return body + struct.pack('<H', crc16(body))
+
+
+def result_length(buf):
+    return 10 + buf[3] + 2
+
+
+def show(block):
+    fitted, stored, size = block[1], block[2], block[3]
+    if size != struct.calcsize(RECORD):
+        raise SystemExit('unknown calibration record size %d' % size)
+    points = struct.unpack_from('<HHH', block, 4)
+    t, h, p, alt, ts, hs, ps, marks = struct.unpack_from(RECORD, block, 10)
+    rows = (('temperature', '%.2f degC' % (t / 100.0), ts),
+            ('humidity', '%.3f %%RH' % (h / 1024.0), hs),
+            ('pressure', '%.2f hPa' % (p / 100.0), ps))
+    print('# %s' % ('stored in EEPROM' if stored else 'not stored'))
+    for (name, bit), n, (_, offset, slope) in zip(FIT_BITS, points, rows):
+        state = 'fitted' if fitted & bit else 'kept' + (' (factory)' if marks & bit else '')
+        print('%-12s %5d pairs  offset %-14s slope %+.3f %%  %s'
+              % (name, n, offset, slope * 100.0 / 4096, state))
+    print('altitude     %d m' % alt)
+    return fitted, stored
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('port', help='serial device of the telemetry link')
+    ap.add_argument('--ref', type=parse_ref, metavar='T,RH,P',
+                    help='hold this reference instead of reading stdin')
+    ap.add_argument('--seconds', type=float, default=5.0, help='session length (default 5)')
+    args = ap.parse_args()
+
+    with open(args.port, 'r+b', buffering=0) as port:
+        end = time.time() + args.seconds
+        sent = 0
+        while time.time() < end:
+            if args.ref is None:
+                line = sys.stdin.readline()
+                if not line:
+                    break
+                if not line.strip() or line.startswith('#'):
+                    continue
+                ref = parse_ref(line)
+            else:
+                ref = args.ref
+            port.write(frame(ref))
+            sent += 1
+            time.sleep(FRAME_TIME)
+        port.write(b'W')
+        print('# %d reference frames sent' % sent, file=sys.stderr)
+        fitted, stored = show(read_block(port, RESULT_SYNC, result_length))
+    if not fitted or not stored:
+        raise SystemExit('calibration not stored')
+
+
+if __name__ == '__main__':
+    main()
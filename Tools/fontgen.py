@@ -0,0 +1,318 @@
+#!/usr/bin/env python3
+"""Generate App/oled/font.h from a 5x8 font description, BDF font or PNG sheet.
+
+The output is an ASCII-indexed map over the printable range (0x20..0x7E)
+into a packed glyph table, both const so they stay in flash. Characters
+left out of the font (or of the subset) map to FONT5X8_NONE and cost no
+glyph storage.
+
+Sources:
+    *.txt   one glyph per line, see Tools/font5x8.txt
+    *.bdf   bitmap font; glyphs are placed on a baseline at row 6 and
+            clipped to 5x8
+    *.png   sheet of 6x8 cells (5 columns plus a gutter), 16 per row from
+            0x20; pixels differing from the top-left one are set. Needs
+            Pillow
+
+Subsets:
+    --chars " 0123456789.-"     exactly these characters
+    --ui                        the characters of every string and
+                                character literal under App/ and Core/Src,
+                                plus what format.c emits (UI_ALWAYS)
+
+--rle stores each glyph as a mask byte, bit n set when column n repeats
+the column before it (the one before column 0 being blank), followed by
+the columns that do not. oled.c decodes it on the fly. It pays off for
+fonts with wide blank or flat strokes; the report shows both encodings.
+
+Usage:
+    Tools/fontgen.py [--ui | --chars STR] [--rle] [-v] [-o App/oled/font.h] [font]
+"""
+
+import argparse
+import ast
+import os
+import re
+import sys
+
+FIRST, LAST = 0x20, 0x7E
+NONE = 0xFF
+WIDTH, HEIGHT = 5, 8
+BASELINE = 6            # Lowest row above the descender, as in font5x8.txt
+DEGREE = 0x60           # Where the degree sign lives; oled_putc() maps 0xB0
+
+# Produced at run time by format.c and the views, not spelled as literals
+UI_ALWAYS = ' 0123456789.-'
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(HERE)
+UI_DIRS = [os.path.join(ROOT, 'App'), os.path.join(ROOT, 'Core', 'Src')]
+
+
+def fail(path, lineno, what):
+    sys.exit('%s:%d: %s' % (path, lineno, what))
+
+
+def parse_txt(path):
+    glyphs = {}
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            fields = line.split()
+            code = int(fields[0], 0)
+            try:
+                cols = [int(v, 16) for v in fields[1:6]]
+            except ValueError:
+                cols = []
+            if len(cols) != 5 or not FIRST <= code <= LAST:
+                fail(path, lineno, 'bad glyph line')
+            glyphs[code] = (cols, ' '.join(fields[6:]))
+    return glyphs
+
+
+def parse_bdf(path):
+    glyphs = {}
+    clipped = []
+    code = bbx = rows = None
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            fields = line.split()
+            if not fields:
+                continue
+            key = fields[0]
+            if rows is not None and key != 'ENDCHAR':
+                rows.append(key)            # Hex, padded to whole bytes
+            elif key == 'STARTCHAR':
+                code = bbx = None
+            elif key == 'ENCODING':
+                code = int(fields[1])
+                if code == 0xB0:
+                    code = DEGREE
+            elif key == 'BBX':
+                bbx = [int(v) for v in fields[1:5]]
+            elif key == 'BITMAP':
+                if bbx is None:
+                    fail(path, lineno, 'BITMAP without BBX')
+                rows = []
+            elif key == 'ENDCHAR':
+                if code is not None and rows is not None and FIRST <= code <= LAST:
+                    cols, lost = bdf_columns(bbx, rows)
+                    glyphs[code] = (cols, '')
+                    if lost:
+                        clipped.append(code)
+                rows = None
+    if clipped:
+        print('%s: clipped to %dx%d: %s' % (path, WIDTH, HEIGHT,
+              ''.join(chr(c) for c in sorted(clipped))), file=sys.stderr)
+    return glyphs
+
+
+def bdf_columns(bbx, rows):
+    """Column bytes of a BDF bitmap, and whether pixels fell off the cell."""
+    w, h, xoff, yoff = bbx
+    cols = [0] * WIDTH
+    lost = False
+    for r, hexrow in enumerate(rows):
+        bits, width = int(hexrow, 16), 4 * len(hexrow)
+        y = BASELINE - (yoff + h - 1 - r)
+        for i in range(w):
+            if not bits >> (width - 1 - i) & 1:
+                continue
+            x = xoff + i
+            if 0 <= x < WIDTH and 0 <= y < HEIGHT:
+                cols[x] |= 1 << y
+            else:
+                lost = True
+    return cols, lost
+
+
+def parse_png(path):
+    try:
+        from PIL import Image
+    except ImportError:
+        sys.exit('%s: PNG sheets need Pillow (pip install pillow)' % path)
+    img = Image.open(path).convert('RGB')
+    bg = img.getpixel((0, 0))
+    cell_w, cell_h = WIDTH + 1, HEIGHT
+    per_row = img.width // cell_w
+    glyphs = {}
+    for code in range(FIRST, LAST + 1):
+        n = code - FIRST
+        x0, y0 = (n % per_row) * cell_w, (n // per_row) * cell_h
+        if y0 + cell_h > img.height:
+            break
+        cols = [0] * WIDTH
+        for x in range(WIDTH):
+            for y in range(HEIGHT):
+                if img.getpixel((x0 + x, y0 + y)) != bg:
+                    cols[x] |= 1 << y
+        glyphs[code] = (cols, '')
+    return glyphs
+
+
+def parse(path):
+    ext = os.path.splitext(path)[1].lower()
+    if ext == '.bdf':
+        return parse_bdf(path)
+    if ext == '.png':
+        return parse_png(path)
+    return parse_txt(path)
+
+
+LITERAL = re.compile(r'"(?:[^"\\\n]|\\.)*"|\'(?:[^\'\\\n]|\\.)+\'')
+
+
+def ui_chars(dirs):
+    """Characters of the string and character literals in the C sources."""
+    chars = set(UI_ALWAYS)
+    for d in dirs:
+        for base, _, files in os.walk(d):
+            for name in files:
+                if not name.endswith(('.c', '.h')) or name == 'font.h':
+                    continue
+                with open(os.path.join(base, name), encoding='latin-1') as f:
+                    for line in f:
+                        if line.lstrip().startswith('#include'):
+                            continue
+                        for lit in LITERAL.findall(line):
+                            try:
+                                text = ast.literal_eval(lit if lit[0] == '"' else '"%s"' % lit[1:-1])
+                            except (ValueError, SyntaxError):
+                                continue
+                            chars.update(text)
+    codes = set()
+    for c in chars:
+        code = ord(c)
+        if code == 0xB0:
+            code = DEGREE
+        if FIRST <= code <= LAST:
+            codes.add(code)
+    return codes
+
+
+def rle(cols):
+    """Mask byte of repeated columns, then the columns that differ."""
+    mask, out, prev = 0, [], 0
+    for i, b in enumerate(cols):
+        if b == prev:
+            mask |= 1 << i
+        else:
+            out.append(b)
+        prev = b
+    return [mask] + out
+
+
+def c_rows(values, indent='    ', per_row=16):
+    lines = []
+    for i in range(0, len(values), per_row):
+        lines.append(indent + ','.join('0x%02X' % v for v in values[i:i + per_row]) + ',')
+    if lines:
+        lines[-1] = lines[-1].rstrip(',')
+    return lines
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('font', nargs='?', default=os.path.join(HERE, 'font5x8.txt'))
+    ap.add_argument('-o', '--output', default=os.path.join(ROOT, 'App', 'oled', 'font.h'))
+    subset = ap.add_mutually_exclusive_group()
+    subset.add_argument('--chars', help='only include these characters')
+    subset.add_argument('--ui', action='store_true',
+                        help='only include the characters the firmware sources use')
+    ap.add_argument('--rle', action='store_true', help='store the glyphs run-length coded')
+    ap.add_argument('-v', '--verbose', action='store_true', help='report every glyph')
+    args = ap.parse_args()
+
+    glyphs = parse(args.font)
+    how = ''
+    if args.chars is not None:
+        keep = {ord(c) for c in args.chars}
+        how = ' --chars'
+    elif args.ui:
+        keep = ui_chars(UI_DIRS)
+        how = ' --ui'
+        missing = sorted(keep - set(glyphs))
+        if missing:
+            print('not in %s: %s' % (os.path.basename(args.font),
+                  ''.join(chr(c) for c in missing)), file=sys.stderr)
+    else:
+        keep = set(glyphs)
+    glyphs = {k: v for k, v in glyphs.items() if k in keep}
+    codes = sorted(glyphs)
+    if len(codes) >= NONE:
+        sys.exit('too many glyphs')
+
+    index = {code: i for i, code in enumerate(codes)}
+    coded = [rle(glyphs[code][0]) for code in codes]
+    stream = sum(len(c) for c in coded)
+    offset_size = 1 if stream <= 0xFF else 2
+    map_bytes = LAST - FIRST + 1
+    packed_bytes = WIDTH * len(codes)
+    rle_bytes = stream + offset_size * len(codes)
+
+    out = []
+    out.append('// Generated by Tools/fontgen.py%s%s from %s - do not edit.'
+               % (how, ' --rle' if args.rle else '',
+                  os.path.relpath(args.font, ROOT).replace(os.sep, '/')))
+    out.append('// %d glyphs: %d bytes of glyph data + %d bytes of map.'
+               % (len(codes), rle_bytes if args.rle else packed_bytes, map_bytes))
+    out.append('#include <stdint.h>')
+    out.append('')
+    out.append('#define FONT5X8_FIRST 0x%02X' % FIRST)
+    out.append('#define FONT5X8_LAST  0x%02X' % LAST)
+    out.append('#define FONT5X8_NONE  0x%02X' % NONE)
+    out.append('#define FONT5X8_RLE   %d' % (1 if args.rle else 0))
+    out.append('')
+    out.append('// Printable ASCII -> font5x8 row, FONT5X8_NONE if not in the font')
+    out.append('const uint8_t font5x8_map[%d] = {' % map_bytes)
+    out.extend(c_rows([index.get(c, NONE) for c in range(FIRST, LAST + 1)]))
+    out.append('};')
+    out.append('')
+    if args.rle:
+        kind = 'uint8_t' if offset_size == 1 else 'uint16_t'
+        out.append('// Row -> start of its glyph in font5x8_rle')
+        out.append('const %s font5x8_offset[%d] = {' % (kind, len(codes)))
+        offsets, pos = [], 0
+        for c in coded:
+            offsets.append(pos)
+            pos += len(c)
+        out.append('    ' + ','.join(str(o) for o in offsets))
+        out.append('};')
+        out.append('')
+        out.append('// Mask of columns repeating the one before, then the other columns')
+        out.append('const uint8_t font5x8_rle[%d] = {' % stream)
+        for n, code in enumerate(codes):
+            comment = glyphs[code][1] or repr(chr(code))
+            sep = ',' if n + 1 < len(codes) else ' '
+            out.append('    %s%s // %s' % (','.join('0x%02X' % b for b in coded[n]), sep, comment))
+        out.append('};')
+    else:
+        out.append('const uint8_t font5x8[%d][5] = {' % len(codes))
+        for n, code in enumerate(codes):
+            cols, comment = glyphs[code]
+            sep = ',' if n + 1 < len(codes) else ' '
+            out.append('    {%s}%s // %s' % (','.join('0x%02X' % b for b in cols), sep,
+                                             comment or repr(chr(code))))
+        out.append('};')
+
+    with open(args.output, 'w', newline='\n') as f:
+        f.write('\n'.join(out) + '\n')
+
+    # Flash cost per asset and per glyph; the scaled digits of
+    # oled_putc_scaled() reuse this table and add no data of their own
+    if args.verbose:
+        for code, c in zip(codes, coded):
+            print('  %-4r packed %d B  rle %d + %d B' % (chr(code), WIDTH, len(c), offset_size))
+    n = max(len(codes), 1)
+    print('font5x8        %4d glyphs  packed %4d B (%.1f B/glyph)  rle %4d B (%.1f B/glyph)'
+          % (len(codes), packed_bytes, packed_bytes / n, rle_bytes, rle_bytes / n))
+    print('               using %-6s %4d B glyphs + %3d B map = %5d B'
+          % ('rle' if args.rle else 'packed', rle_bytes if args.rle else packed_bytes,
+             map_bytes, (rle_bytes if args.rle else packed_bytes) + map_bytes))
+    print('scaled (2x-4x) %4d glyphs  %5d B' % (len(codes), 0))
+
+
+if __name__ == '__main__':
+    main()
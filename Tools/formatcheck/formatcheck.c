@@ -0,0 +1,186 @@
+/*
+ * Host check of the division-free arithmetic in App/format.
+ *
+ * format.c is compiled unchanged and every helper is compared, bit for
+ * bit, with the plain `/` and `%` it stands in for, over its whole input
+ * domain:
+ *
+ *   format_div10, format_div100    every uint32_t
+ *   format_split100, format_round10
+ *                                  every int32_t, INT32_MIN included
+ *   format_rh_centi, format_rh_deci
+ *                                  every Q22.10 humidity the compensation
+ *                                  returns, 0..100 %RH
+ *   format_hpa_centi, format_hpa_deci
+ *                                  every uint32_t
+ *   format_fixed                   against snprintf() for 0..3 decimals,
+ *                                  every value within +-10^6 and a stride
+ *                                  across the rest of int32_t
+ *
+ * Build from the repository root:
+ *
+ *     cc -O2 -o formatcheck -IApp/format -IApp/ramfunc \
+ *         Tools/formatcheck/formatcheck.c App/format/format.c
+ *
+ * Usage:
+ *     formatcheck [-s stride]
+ *         -s  step through the 32-bit domains instead of taking every
+ *             value; the full run takes a few minutes (1)
+ *
+ * Output is CSV: helper, cases, mismatches. The exit code is 1 on any
+ * mismatch.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "format.h"
+
+#define RH_Q10_MAX      (100U << 10)    // bme280_comp.h clamps to 100 %RH
+#define FIXED_DENSE     1000000
+#define FIXED_SPARSE    9973            // Prime, so every last digit comes up
+
+static unsigned long failures;
+static uint64_t stride = 1;
+
+static void report(const char *name, uint64_t cases, uint64_t bad)
+{
+    printf("%s,%llu,%llu\n", name, (unsigned long long)cases, (unsigned long long)bad);
+    fflush(stdout);
+    failures += bad;
+}
+
+static void mismatch(const char *name, long long in, long long got, long long want)
+{
+    fprintf(stderr, "formatcheck: %s(%lld) = %lld, expected %lld\n", name, in, got, want);
+}
+
+#define CHECK(name, in, got, want) do {                                 \
+        long long g_ = (long long)(got), w_ = (long long)(want);        \
+        cases++;                                                        \
+        if (g_ != w_) {                                                 \
+            if (!bad) mismatch(name, (long long)(in), g_, w_);          \
+            bad++;                                                      \
+        }                                                               \
+    } while (0)
+
+static void check_unsigned(void)
+{
+    uint64_t cases = 0, bad = 0;
+    for (uint64_t n = 0; n <= UINT32_MAX; n += stride)
+        CHECK("format_div10", n, format_div10((uint32_t)n), (uint32_t)n / 10);
+    report("format_div10", cases, bad);
+
+    cases = bad = 0;
+    for (uint64_t n = 0; n <= UINT32_MAX; n += stride)
+        CHECK("format_div100", n, format_div100((uint32_t)n), (uint32_t)n / 100);
+    report("format_div100", cases, bad);
+
+    cases = bad = 0;
+    for (uint64_t n = 0; n <= UINT32_MAX; n += stride) {
+        uint32_t p = (uint32_t)n;
+        CHECK("format_hpa_centi", n, format_hpa_centi(p), (int32_t)(p / 256));
+        CHECK("format_hpa_deci", n, format_hpa_deci(p), (int32_t)(p / 256 / 10));
+    }
+    report("format_hpa", cases, bad);
+}
+
+static void check_signed(void)
+{
+    uint64_t cases = 0, bad = 0;
+    for (int64_t v = INT32_MIN; v <= INT32_MAX; v += (int64_t)stride) {
+        int32_t value = (int32_t)v, frac;
+        int32_t whole = format_split100(value, &frac);
+        CHECK("format_split100", v, whole, value / 100);
+        CHECK("format_split100 frac", v, frac, value % 100);
+    }
+    report("format_split100", cases, bad);
+
+    cases = bad = 0;
+    for (int64_t v = INT32_MIN; v <= INT32_MAX; v += (int64_t)stride) {
+        // Half away from zero; int64 so the +-5 cannot overflow
+        int64_t want = (v < 0 ? v - 5 : v + 5) / 10;
+        CHECK("format_round10", v, format_round10((int32_t)v), want);
+    }
+    report("format_round10", cases, bad);
+}
+
+static void check_humidity(void)
+{
+    uint64_t cases = 0, bad = 0;
+    for (uint32_t h = 0; h <= RH_Q10_MAX; h++) {
+        CHECK("format_rh_centi", h, format_rh_centi(h), h / 1024 * 100 + h % 1024 * 100 / 1024);
+        CHECK("format_rh_deci", h, format_rh_deci(h), h / 1024 * 10 + h % 1024 * 10 / 1024);
+    }
+    report("format_rh", cases, bad);
+}
+
+// snprintf() of the same value, sign and digits from / and %
+static void fixed_ref(char *out, int32_t value, uint8_t decimals, uint8_t width)
+{
+    static const uint32_t scale[] = { 1, 10, 100, 1000 };
+    char body[24];
+    uint32_t mag = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+    const char *sign = value < 0 ? "-" : "";
+
+    if (decimals)
+        snprintf(body, sizeof(body), "%s%lu.%0*lu", sign, (unsigned long)(mag / scale[decimals]),
+                 decimals, (unsigned long)(mag % scale[decimals]));
+    else
+        snprintf(body, sizeof(body), "%s%lu", sign, (unsigned long)mag);
+    snprintf(out, 32, "%*s", width, body);
+}
+
+static void check_fixed_one(int32_t value, uint64_t *cases, uint64_t *bad)
+{
+    for (uint8_t decimals = 0; decimals <= 3; decimals++) {
+        char got[24], want[32];
+        uint8_t len = format_fixed(got, value, decimals, 6);
+        fixed_ref(want, value, decimals, 6);
+        (*cases)++;
+        if (strcmp(got, want) != 0 || len != strlen(want)) {
+            if (!*bad)
+                fprintf(stderr, "formatcheck: format_fixed(%ld, %u) = \"%s\", expected \"%s\"\n",
+                        (long)value, decimals, got, want);
+            (*bad)++;
+        }
+    }
+}
+
+static void check_fixed(void)
+{
+    uint64_t cases = 0, bad = 0;
+    for (int32_t v = -FIXED_DENSE; v <= FIXED_DENSE; v++)
+        check_fixed_one(v, &cases, &bad);
+    for (int64_t v = INT32_MIN; v <= INT32_MAX; v += FIXED_SPARSE * (int64_t)stride)
+        check_fixed_one((int32_t)v, &cases, &bad);
+    check_fixed_one(INT32_MAX, &cases, &bad);
+    report("format_fixed", cases, bad);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+        case 's': stride = strtoull(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-s stride]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (stride < 1) stride = 1;
+
+    printf("helper,cases,mismatches\n");
+    check_unsigned();
+    check_signed();
+    check_humidity();
+    check_fixed();
+
+    printf("# %lu mismatches\n", failures);
+    return failures != 0;
+}
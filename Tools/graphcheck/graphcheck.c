@@ -0,0 +1,325 @@
+/*
+ * Host check of the sweep sparkline in App/graph.
+ *
+ * graph.c and history.c are compiled unchanged; oled_put_column() is a
+ * mock panel holding the chart pages, so the check sees every column the
+ * chart writes. A room-like signal runs through history_add() and
+ * graph_add(): slow warming and cooling, sensor noise, and now and then a
+ * step, as when a window opens. The reference is every sample added and
+ * the chart contract from graph.h:
+ *
+ *   - a quiet sample writes two columns, the sample at the cursor and the
+ *     gap after it; anything more is a redraw
+ *   - a redraw happens exactly when the sample falls outside the scale or
+ *     the history range needs less than half of it
+ *   - after a redraw the panel shows the newest OLED_WIDTH - 1 samples of
+ *     the history from column 0, the rest blank
+ *   - every column is one vertical run from the previous sample to its
+ *     own, within half a row of the exact scale, and joins the run of the
+ *     column before it
+ *
+ * The scale is rebuilt with the headroom rule graph.c documents, in plain
+ * arithmetic; rows are compared with the exact quotient, not the Q16
+ * factor.
+ *
+ * Build from the repository root; Tools/oledsim comes first on the
+ * include path for its stand-in stm32l0xx_hal.h:
+ *
+ *     cc -O2 -o graphcheck -ITools/oledsim -IApp/graph -IApp/history \
+ *         -IApp/pyramid -IApp/oled -IApp/bme280 -IApp/format -IApp/ramfunc \
+ *         -IApp/rtc Tools/graphcheck/graphcheck.c App/graph/graph.c \
+ *         App/history/history.c App/format/format.c
+ *
+ * The default ring holds fewer samples than the panel has columns; build
+ * with e.g. -DHISTORY_BYTES=512 to make the sweep wrap, or with a panel
+ * variant's OLED_ and GRAPH_ settings.
+ *
+ * Usage:
+ *     graphcheck [-n samples] [-c channel] [-s seed]
+ *         -n  samples to add (300)
+ *         -c  charted channel: 0 temperature, 1 humidity, 2 pressure (0)
+ *         -s  random seed (1)
+ *
+ * Output is CSV, one line per redraw: sample, reason, window, scale low
+ * and span; then a summary line. The first mismatch is reported on stderr
+ * and the exit code is 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "graph.h"
+
+#define ROW_SLACK       (0.5 + 1.0 / 64)    // Q16 rounding of the row factor
+
+// Mock panel: the chart pages, and the columns one call wrote
+static uint8_t panel[OLED_WIDTH][GRAPH_PAGES];
+static int columns_written, bad_write;
+
+void oled_put_column(uint8_t x, uint8_t page, const uint8_t *bytes, uint8_t pages)
+{
+    if (x >= OLED_WIDTH || page != GRAPH_FIRST_PAGE || pages != GRAPH_PAGES) {
+        bad_write = 1;
+        return;
+    }
+    memcpy(panel[x], bytes, GRAPH_PAGES);
+    columns_written++;
+}
+
+// graph_buckets() is not exercised; its pyramid reads find nothing
+uint16_t pyramid_count(Pyramid_Tier tier)
+{
+    (void)tier;
+    return 0;
+}
+
+uint8_t pyramid_read(Pyramid_Tier tier, uint16_t index, Pyramid_Bucket *out)
+{
+    (void)tier;
+    (void)index;
+    (void)out;
+    return 0;
+}
+
+int16_t pyramid_min(const Pyramid_Span *s)
+{
+    (void)s;
+    return 0;
+}
+
+int16_t pyramid_max(const Pyramid_Span *s)
+{
+    (void)s;
+    return 0;
+}
+
+static uint32_t now;
+
+uint32_t rtc_time(void)
+{
+    return now;
+}
+
+static uint32_t rnd;
+
+static uint32_t sim_rand(uint32_t n)
+{
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd % n;
+}
+
+static int channel;
+static int16_t *samples;        // Every sample added, the charted channel
+static int total;
+
+// Reference chart: the scale, and for each column the sample it shows and
+// the one its run starts from (-1 for a blank column)
+static int32_t ref_lo, ref_span;
+static int ref_cursor;
+static int col_sample[OLED_WIDTH], col_from[OLED_WIDTH];
+
+static int fail(const char *what, int x)
+{
+    fprintf(stderr, "graphcheck: sample %d: %s", total - 1, what);
+    if (x >= 0) fprintf(stderr, " at column %d", x);
+    fprintf(stderr, "\n");
+    return 1;
+}
+
+// Headroom of a quarter of the range on either side, GRAPH_MIN_SPAN at least
+static int32_t ref_span_for(int32_t range)
+{
+    int32_t span = range + 2 * (range / 4 + 1);
+    return span < GRAPH_MIN_SPAN ? GRAPH_MIN_SPAN : span;
+}
+
+static void ref_window(int *start, int16_t *lo, int16_t *hi)
+{
+    *start = total - history_count();
+    *lo = INT16_MAX;
+    *hi = INT16_MIN;
+    for (int i = *start; i < total; i++) {
+        if (samples[i] < *lo) *lo = samples[i];
+        if (samples[i] > *hi) *hi = samples[i];
+    }
+}
+
+static void ref_redraw(void)
+{
+    int start, shown;
+    int16_t lo, hi;
+
+    ref_window(&start, &lo, &hi);
+    ref_span = ref_span_for(hi - lo);
+    ref_lo = lo - (ref_span - (hi - lo)) / 2;
+    shown = total - start < OLED_WIDTH - 1 ? total - start : OLED_WIDTH - 1;
+    for (int x = 0; x < OLED_WIDTH; x++) {
+        int i = total - shown + x;
+        col_sample[x] = x < shown ? i : -1;
+        col_from[x] = x < shown ? (x ? i - 1 : i) : -1;
+    }
+    ref_cursor = shown;
+}
+
+static void ref_plot(void)
+{
+    int prev = ref_cursor ? ref_cursor - 1 : OLED_WIDTH - 1;
+
+    col_sample[ref_cursor] = total - 1;
+    col_from[ref_cursor] = col_sample[prev] == total - 2 ? total - 2 : total - 1;
+    if (++ref_cursor == OLED_WIDTH) ref_cursor = 0;
+    col_sample[ref_cursor] = col_from[ref_cursor] = -1;
+}
+
+// Row of a sample on the reference scale, exact
+static double ref_row(int i)
+{
+    return (double)(samples[i] - ref_lo) * (GRAPH_ROWS - 1) / ref_span;
+}
+
+// The lit rows of a panel column: -1 if blank, -2 if not one run
+static int column_run(int x, int *bottom, int *top)
+{
+    int lit = 0;
+    *bottom = *top = -1;
+    for (int r = 0; r < GRAPH_ROWS; r++) {
+        int row = GRAPH_ROWS - 1 - r;
+        if (!(panel[x][row >> 3] & (1 << (row & 7)))) continue;
+        if (*top >= 0 && *top != r - 1) return -2;
+        if (*bottom < 0) *bottom = r;
+        *top = r;
+        lit++;
+    }
+    return lit ? 0 : -1;
+}
+
+static int check_panel(void)
+{
+    for (int x = 0; x < OLED_WIDTH; x++) {
+        int bottom, top, run = column_run(x, &bottom, &top);
+        if (col_sample[x] < 0) {
+            if (run != -1) return fail("column should be blank", x);
+            continue;
+        }
+        if (run == -2) return fail("column is not one run", x);
+        if (run == -1) return fail("sample column is blank", x);
+
+        double a = ref_row(col_sample[x]), b = ref_row(col_from[x]);
+        double lo = a < b ? a : b, hi = a < b ? b : a;
+        if (bottom < lo - ROW_SLACK || bottom > lo + ROW_SLACK ||
+            top < hi - ROW_SLACK || top > hi + ROW_SLACK) {
+            fprintf(stderr, "graphcheck: sample %d: column %d spans rows %d..%d, expected %.2f..%.2f\n",
+                    total - 1, x, bottom, top, lo, hi);
+            return 1;
+        }
+
+        // Joined: a run starting from the previous sample meets its column
+        int prev = x ? x - 1 : OLED_WIDTH - 1, pb, pt;
+        if (col_from[x] != col_sample[x] && col_sample[prev] == col_from[x] &&
+            column_run(prev, &pb, &pt) == 0 && (bottom > pt || top < pb))
+            return fail("step not joined to the column before", x);
+    }
+    return 0;
+}
+
+// Room-like raw signal: a drift that turns now and then, noise, and a rare
+// step; per sample, in the channel's raw units
+typedef struct {
+    int32_t value, drift, noise, step, lo, hi;
+    int turn;
+} Sim_Signal;
+
+static void sim_signal(Sim_Signal *s)
+{
+    if (--s->turn <= 0) {
+        s->drift = (int32_t)sim_rand(3) - 1;
+        s->turn = 40 + (int)sim_rand(80);
+    }
+    s->value += s->drift * s->noise / 2 + (int32_t)sim_rand((uint32_t)(2 * s->noise + 1)) - s->noise;
+    if (sim_rand(100) == 0) s->value += (sim_rand(2) ? 1 : -1) * s->step;
+    if (s->value < s->lo) s->value = s->lo;
+    if (s->value > s->hi) s->value = s->hi;
+}
+
+int main(int argc, char **argv)
+{
+    int n = 300, opt, redraws = 0;
+    // 0.01 degC, Q22.10 %RH and Q24.8 Pa, as bme280.h delivers them
+    Sim_Signal sig[HISTORY_CHANNELS] = {
+        [HISTORY_TEMPERATURE] = { 2150, 0, 4, 150, -4000, 8500, 0 },
+        [HISTORY_HUMIDITY]    = { 45 * 1024, 0, 60, 8 * 1024, 0, 100 * 1024, 0 },
+        [HISTORY_PRESSURE]    = { 101325 * 256, 0, 1024, 100 * 256, 30000 * 256, 110000 * 256, 0 },
+    };
+
+    rnd = 1;
+    while ((opt = getopt(argc, argv, "n:c:s:")) != -1) {
+        switch (opt) {
+        case 'n': n = atoi(optarg); break;
+        case 'c': channel = atoi(optarg); break;
+        case 's': rnd = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples] [-c channel] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!rnd) rnd = 1;
+    if (channel < 0 || channel >= HISTORY_CHANNELS) {
+        fprintf(stderr, "graphcheck: no channel %d\n", channel);
+        return 2;
+    }
+    samples = malloc(sizeof(int16_t) * (n > 0 ? n : 1));
+    if (!samples) return 2;
+
+    history_init(60);
+    graph_init((History_Channel)channel);
+    ref_redraw();
+    ref_span = 0;               // No samples, no scale
+    if (bad_write || check_panel()) return fail("empty chart not blank", -1);
+
+    printf("sample,reason,window,scale_lo,scale_span\n");
+    for (total = 0; total < n; ) {
+        BME280_Measurement m;
+        int16_t q[HISTORY_CHANNELS];
+        for (int ch = 0; ch < HISTORY_CHANNELS; ch++) sim_signal(&sig[ch]);
+        m.temperature = sig[HISTORY_TEMPERATURE].value;
+        m.humidity = (uint32_t)sig[HISTORY_HUMIDITY].value;
+        m.pressure = (uint32_t)sig[HISTORY_PRESSURE].value;
+        now += 60;
+
+        history_add(&m);
+        history_quantize(&m, q);
+        samples[total++] = q[channel];
+
+        // The redraw graph.h promises, decided on the reference scale
+        int start;
+        int16_t lo, hi, v = q[channel];
+        const char *reason = NULL;
+        ref_window(&start, &lo, &hi);
+        if (!ref_span) reason = "first";
+        else if (v < ref_lo || v > ref_lo + ref_span) reason = "outside";
+        else if (ref_span_for(hi - lo) * 2 < ref_span) reason = "shrunk";
+
+        columns_written = 0;
+        graph_add(&m);
+        if (bad_write) return fail("column written outside the chart", -1);
+        if (reason) {
+            ref_redraw();
+            redraws++;
+            printf("%d,%s,%d,%ld,%ld\n", total - 1, reason, total - start, (long)ref_lo, (long)ref_span);
+            if (columns_written <= 2) return fail("redraw expected, sample plotted", -1);
+        } else {
+            ref_plot();
+            if (columns_written != 2) return fail("sample plotted, redraw not expected", -1);
+        }
+        if (check_panel()) return 1;
+    }
+
+    printf("# %d samples of channel %d, %d redraws, window of %u at the end, all matched\n",
+           n, channel, redraws, history_count());
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Host check of the delta-encoded history ring in App/history.
+ *
+ * history.c is compiled unchanged and fed random samples: slow drifts,
+ * steps just inside and just outside the 4-bit delta range, and jumps
+ * that need the escape. A plain array of every sample is the reference.
+ * After each history_add() the window must be exactly the longest run of
+ * newest samples whose records fit the ring (the base outside it), and
+ *
+ *   - history_walk() must return those samples, oldest first
+ *   - history_stats() min, max, mean and trend must equal the ones
+ *     computed from the array, for every channel
+ *   - history_image() must describe the same window
+ *
+ * Build from the repository root; Tools/oledsim comes first on the
+ * include path for its stand-in stm32l0xx_hal.h:
+ *
+ *     cc -O2 -o historycheck -ITools/oledsim -IApp/history -IApp/bme280 \
+ *         -IApp/format -IApp/ramfunc -IApp/rtc \
+ *         Tools/historycheck/historycheck.c App/history/history.c \
+ *         App/format/format.c
+ *
+ * Smaller rings build the same way with e.g. -DHISTORY_BYTES=32.
+ *
+ * Usage:
+ *     historycheck [-n samples] [-s seed]
+ *         -n  samples to add (4000)
+ *         -s  random seed (1)
+ *
+ * Output is one summary line; the first mismatch is reported on stderr
+ * and the exit code is 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "history.h"
+
+#define HISTORY_CODES   (HISTORY_BYTES * 2)
+
+static int16_t *samples;        // Every sample added, quantized
+static int total;
+
+static uint32_t now;
+
+uint32_t rtc_time(void)
+{
+    return now;
+}
+
+static uint32_t rnd;
+
+static uint32_t sim_rand(uint32_t n)
+{
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd % n;
+}
+
+// Quantization from the header's units with / and %, not format.c
+static void ref_quantize(const BME280_Measurement *m, int16_t *q)
+{
+    int32_t t = m->temperature;
+    q[HISTORY_TEMPERATURE] = (int16_t)(t < 0 ? (t - 5) / 10 : (t + 5) / 10);
+    q[HISTORY_HUMIDITY] = (int16_t)(m->humidity * 10 / 1024);
+    q[HISTORY_PRESSURE] = (int16_t)(m->pressure / 256 / 10);
+}
+
+// Codes of the record of sample i, stored as deltas to sample i - 1
+static int ref_record_codes(int i)
+{
+    int codes = 0;
+    for (int ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        int d = samples[i * HISTORY_CHANNELS + ch] - samples[(i - 1) * HISTORY_CHANNELS + ch];
+        codes += d >= -7 && d <= 7 ? 1 : 5;
+    }
+    return codes;
+}
+
+// First sample of the window: the base, then records while they fit
+static int ref_window_start(void)
+{
+    int start = total - 1, used = 0;
+    while (start > 0 && used + ref_record_codes(start) <= HISTORY_CODES) {
+        used += ref_record_codes(start);
+        start--;
+    }
+    return start;
+}
+
+static int walked, walk_bad, walk_start;
+
+static void check_walk(const int16_t *values, void *ctx)
+{
+    (void)ctx;
+    for (int ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        int16_t want = samples[(walk_start + walked) * HISTORY_CHANNELS + ch];
+        if (values[ch] != want && !walk_bad) {
+            fprintf(stderr, "historycheck: sample %d: walk %d of channel %d is %d, expected %d\n",
+                    total - 1, walked, ch, values[ch], want);
+            walk_bad = 1;
+        }
+    }
+    walked++;
+}
+
+static int check_window(void)
+{
+    int start = ref_window_start(), count = total - start;
+    History_Image img;
+
+    if (history_count() != count) {
+        fprintf(stderr, "historycheck: sample %d: count %u, expected %d\n",
+                total - 1, history_count(), count);
+        return 1;
+    }
+
+    walked = walk_bad = 0;
+    walk_start = start;
+    history_walk(check_walk, NULL);
+    if (walk_bad) return 1;
+    if (walked != count) {
+        fprintf(stderr, "historycheck: sample %d: walk visited %d, expected %d\n",
+                total - 1, walked, count);
+        return 1;
+    }
+
+    for (int ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        int16_t min = INT16_MAX, max = INT16_MIN;
+        int32_t sum = 0;
+        for (int i = start; i < total; i++) {
+            int16_t v = samples[i * HISTORY_CHANNELS + ch];
+            if (v < min) min = v;
+            if (v > max) max = v;
+            sum += v;
+        }
+        History_Stats st;
+        int16_t mean = (int16_t)(sum / count);
+        int16_t trend = samples[(total - 1) * HISTORY_CHANNELS + ch] - samples[start * HISTORY_CHANNELS + ch];
+        if (!history_stats((History_Channel)ch, &st) || st.min != min || st.max != max ||
+            st.mean != mean || st.trend != trend) {
+            fprintf(stderr, "historycheck: sample %d channel %d: stats %d/%d/%d/%d, expected %d/%d/%d/%d\n",
+                    total - 1, ch, st.min, st.max, st.mean, st.trend, min, max, mean, trend);
+            return 1;
+        }
+    }
+
+    history_image(&img);
+    if (img.count != count || img.newest_time != now) {
+        fprintf(stderr, "historycheck: sample %d: image count %u time %u\n",
+                total - 1, img.count, (unsigned)img.newest_time);
+        return 1;
+    }
+    for (int ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        if (img.oldest[ch] != samples[start * HISTORY_CHANNELS + ch]) {
+            fprintf(stderr, "historycheck: sample %d: image base of channel %d is %d\n",
+                    total - 1, ch, img.oldest[ch]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Next step of one raw channel: mostly within the 4-bit range, sometimes
+// on its edge, now and then far outside it
+static int32_t sim_step(int32_t unit)
+{
+    switch (sim_rand(16)) {
+    case 0:
+        return ((int32_t)sim_rand(2001) - 1000) * unit;
+    case 1:
+        return (sim_rand(2) ? 8 : -8) * unit;
+    case 2:
+        return (sim_rand(2) ? 7 : -7) * unit;
+    default:
+        return ((int32_t)sim_rand(5) - 2) * unit + (int32_t)sim_rand((uint32_t)unit);
+    }
+}
+
+static int32_t clamp(int32_t v, int32_t lo, int32_t hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+int main(int argc, char **argv)
+{
+    int n = 4000, opt, steps_escaped = 0;
+    BME280_Measurement m = { 2150, 101325U * 256, 45U * 1024 };
+    History_Stats st;
+
+    rnd = 1;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+        case 'n': n = atoi(optarg); break;
+        case 's': rnd = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!rnd) rnd = 1;
+    samples = malloc(sizeof(int16_t) * HISTORY_CHANNELS * (n > 0 ? n : 1));
+    if (!samples) return 2;
+
+    history_init(60);
+    if (history_count() != 0 || history_stats(HISTORY_TEMPERATURE, &st)) {
+        fprintf(stderr, "historycheck: empty history reports samples\n");
+        return 1;
+    }
+
+    for (total = 0; total < n; ) {
+        // One stored unit is 10 raw counts of temperature, 102.4 of
+        // humidity and 2560 of pressure
+        m.temperature = clamp(m.temperature + sim_step(10), -4000, 8500);
+        m.humidity = (uint32_t)clamp((int32_t)m.humidity + sim_step(103), 0, 100 * 1024);
+        m.pressure = (uint32_t)clamp((int32_t)m.pressure + sim_step(2560), 30000 * 256, 110000 * 256);
+        now += 60;
+
+        history_add(&m);
+        ref_quantize(&m, &samples[total * HISTORY_CHANNELS]);
+        total++;
+        if (total > 1 && ref_record_codes(total - 1) > HISTORY_CHANNELS) steps_escaped++;
+        if (check_window()) return 1;
+    }
+
+    printf("# %d samples, %d with escaped steps, window of %u at the end, all matched\n",
+           n, steps_escaped, history_count());
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * Host check of the wear-leveled EEPROM log in App/logger.
+ *
+ * logger.c and eeprom.c are compiled unchanged on top of a mock data
+ * EEPROM (this directory's stm32l0xx_hal.h). A random sequence of
+ * operations runs against it:
+ *
+ *   add      logger_add() of a random hour bucket, the clock an hour on
+ *   flush    logger_flush() of a part-filled batch
+ *   reboot   RAM state lost, logger_init() finds the head again
+ *   error    the next word programmed fails, the logger keeps running
+ *   tear     power fails at the next word programmed: that word holds
+ *            garbage, the rest of the block stays as it was, and the
+ *            unit reboots
+ *
+ * The reference is the list of blocks the logger reported written and
+ * the batch it holds in RAM, mirrored from the contract in logger.h.
+ * After every operation the log must read back, record for record and
+ * time for time, as a run of those blocks ending at the newest; only
+ * the ring's length may bound the run, less the one slot a failed write
+ * can cost. Return values and the number of block writes must match the
+ * mirror too.
+ *
+ * Build from the repository root; this directory comes first so its
+ * stm32l0xx_hal.h replaces the real one:
+ *
+ *     cc -O2 -o loggercheck -ITools/loggercheck -IApp/logger -IApp/eeprom \
+ *         -IApp/pyramid -IApp/history -IApp/bme280 -IApp/ramfunc -IApp/rtc \
+ *         Tools/loggercheck/loggercheck.c App/logger/logger.c App/eeprom/eeprom.c
+ *
+ * Other batch sizes build the same way with e.g.
+ * -DLOGGER_RECORDS_PER_BLOCK=1.
+ *
+ * Usage:
+ *     loggercheck [-n operations] [-s seed]
+ *         -n  operations to run (20000)
+ *         -s  random seed (1)
+ *
+ * Output is one summary line; the first mismatch is reported on stderr
+ * and the exit code is 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "eeprom.h"
+
+#define LOG_PERIOD      3600
+#define LOG_BLOCKS      ((int)(EEPROM_LOG_SIZE / LOGGER_BLOCK_BYTES))
+#define LOG_CAPACITY    (LOG_BLOCKS * LOGGER_RECORDS_PER_BLOCK)
+
+uint8_t loggercheck_eeprom[LOGGERCHECK_EEPROM_SIZE];   // Erased data EEPROM reads 0
+
+static uint32_t now = 946684800U;
+
+uint32_t rtc_time(void)
+{
+    return now;
+}
+
+static uint32_t rnd;
+
+static uint32_t sim_rand(uint32_t n)
+{
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd % n;
+}
+
+// Mock EEPROM: a fault is armed for the word `countdown` programs ahead
+enum { FAULT_NONE, FAULT_ERROR, FAULT_TEAR };
+static int fault, fault_countdown, fired, torn;
+static unsigned writes;         // eeprom_write() calls, one per Unlock
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Unlock(void)
+{
+    writes++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Lock(void)
+{
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Program(uint32_t TypeProgram, uint32_t Address, uint32_t Data)
+{
+    // eeprom.c passes the address as 32 bits; the offset survives that
+    uint32_t offset = Address - (uint32_t)DATA_EEPROM_BASE;
+    if (TypeProgram != FLASH_TYPEPROGRAMDATA_WORD || (offset & 3) ||
+        offset >= LOGGERCHECK_EEPROM_SIZE) {
+        fprintf(stderr, "loggercheck: bad program at offset %u\n", (unsigned)offset);
+        exit(2);
+    }
+    if (torn) return HAL_ERROR;     // Power is gone
+    if (fault != FAULT_NONE && fault_countdown-- == 0) {
+        fired = fault;
+        fault = FAULT_NONE;
+        if (fired == FAULT_TEAR) {
+            uint32_t garbage = ~Data ^ (sim_rand(0x10000) << 8);
+            memcpy(&loggercheck_eeprom[offset], &garbage, 4);
+            torn = 1;
+        }
+        return HAL_ERROR;
+    }
+    memcpy(&loggercheck_eeprom[offset], &Data, 4);
+    return HAL_OK;
+}
+
+// Reference: blocks the logger reported written, and its RAM batch
+typedef struct {
+    uint32_t time;
+    uint8_t n;
+    Logger_Record records[LOGGER_RECORDS_PER_BLOCK];
+} Ref_Block;
+
+static Ref_Block *ref;
+static int ref_count, ref_size;
+static Ref_Block ref_pending;
+
+static void ref_commit(void)
+{
+    if (ref_count == ref_size) {
+        ref_size = ref_size ? ref_size * 2 : 256;
+        ref = realloc(ref, sizeof(*ref) * ref_size);
+        if (!ref) exit(2);
+    }
+    ref[ref_count++] = ref_pending;
+    ref_pending.n = 0;
+}
+
+static unsigned expect_writes;
+
+// The block write the mirror expects next: 0 if the armed fault hit it
+static int ref_write(void)
+{
+    expect_writes++;
+    if (fired && writes == expect_writes) return 0;
+    ref_commit();
+    return 1;
+}
+
+static int step;
+
+static int fail(const char *what)
+{
+    fprintf(stderr, "loggercheck: operation %d: %s\n", step, what);
+    return 1;
+}
+
+// The log against a run of reference blocks ending at the newest one
+static int check_log(void)
+{
+    static Logger_Record got[LOG_CAPACITY + 1];
+    static uint32_t got_time[LOG_CAPACITY + 1];
+    Logger_Record r;
+    uint16_t count = logger_count();
+
+    if (count > LOG_CAPACITY) return fail("more records than the ring holds");
+    for (uint16_t i = 0; i < count; i++)
+        if (!logger_read(i, &got[i], &got_time[i])) return fail("record inside the log unreadable");
+    if (logger_read(count, &r, NULL)) return fail("record past the end readable");
+
+    int first = ref_count, left = count;
+    while (left > 0 && first > 0) left -= ref[--first].n;
+    if (left != 0) return fail("log is not a whole run of written blocks");
+
+    int blocks = ref_count - first, at = 0;
+    int least = ref_count < LOG_BLOCKS - 1 ? ref_count : LOG_BLOCKS - 1;
+    if (blocks < least) {
+        fprintf(stderr, "loggercheck: operation %d: %d blocks kept of %d written\n",
+                step, blocks, ref_count);
+        return 1;
+    }
+    for (int b = first; b < ref_count; b++) {
+        for (int i = 0; i < ref[b].n; i++, at++) {
+            if (memcmp(&got[at], &ref[b].records[i], sizeof(Logger_Record)) != 0)
+                return fail("record differs from the one added");
+            if (got_time[at] != ref[b].time + (uint32_t)i * LOG_PERIOD)
+                return fail("record time differs");
+        }
+    }
+    return 0;
+}
+
+static void random_record(Logger_Record *r)
+{
+    for (int ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        r->ch[ch].mean = (int16_t)(sim_rand(65535) - 32767);   // Never INT16_MIN
+        r->ch[ch].below = (uint8_t)sim_rand(256);
+        r->ch[ch].above = (uint8_t)sim_rand(256);
+    }
+}
+
+static void reboot(void)
+{
+    torn = 0;
+    ref_pending.n = 0;
+    logger_init(LOG_PERIOD);
+}
+
+int main(int argc, char **argv)
+{
+    int n = 20000, opt;
+    unsigned adds = 0, flushes = 0, reboots = 0, errors = 0, tears = 0;
+
+    rnd = 1;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+        case 'n': n = atoi(optarg); break;
+        case 's': rnd = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n operations] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!rnd) rnd = 1;
+
+    logger_init(LOG_PERIOD);
+    if (logger_count() != 0) return fail("erased EEPROM reads as a log");
+
+    for (step = 0; step < n; step++) {
+        uint32_t op = sim_rand(100);
+        uint8_t ret, want = 1;
+
+        writes = expect_writes = 0;
+        fired = 0;
+        if (op < 70) {
+            Logger_Record r;
+            random_record(&r);
+            now += LOG_PERIOD;
+            ret = logger_add(&r);
+            adds++;
+            // A full batch left by a failed write is retried first; if that
+            // fails again the new record is refused
+            if (ref_pending.n == LOGGER_RECORDS_PER_BLOCK && !ref_write()) {
+                want = 0;
+            } else {
+                if (ref_pending.n == 0) ref_pending.time = now;
+                ref_pending.records[ref_pending.n++] = r;
+                if (ref_pending.n == LOGGER_RECORDS_PER_BLOCK) want = (uint8_t)ref_write();
+            }
+        } else if (op < 80) {
+            ret = logger_flush();
+            flushes++;
+            if (ref_pending.n) want = (uint8_t)ref_write();
+        } else if (op < 85) {
+            reboot();
+            reboots++;
+            ret = want = 1;
+        } else {
+            if (fault == FAULT_NONE) {
+                fault = op < 93 ? FAULT_ERROR : FAULT_TEAR;
+                fault_countdown = (int)sim_rand(LOGGER_BLOCK_BYTES / 4);
+            }
+            ret = want = 1;
+        }
+
+        if (ret != want) return fail(want ? "write reported failed" : "failed write reported done");
+        if (writes != expect_writes) return fail("block writes differ from the batching");
+        if (fired == FAULT_ERROR) errors++;
+        if (fired == FAULT_TEAR) {
+            tears++;
+            reboot();
+        }
+        if (check_log()) return 1;
+    }
+
+    printf("# %d operations: %u adds, %u flushes, %u reboots, %u program errors, %u torn writes; "
+           "%d blocks written, %u records in the log, all matched\n",
+           n, adds, flushes, reboots, errors, tears, ref_count, logger_count());
+    free(ref);
+    return 0;
+}
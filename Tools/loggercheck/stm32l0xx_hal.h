@@ -0,0 +1,24 @@
+/*
+ * Host stand-in for the HAL umbrella header: oledsim's, plus the data
+ * EEPROM eeprom.c programs. The EEPROM is an array in loggercheck.c at
+ * DATA_EEPROM_BASE, and the FLASHEx calls are its mock.
+ */
+
+#ifndef LOGGERCHECK_HAL_H
+#define LOGGERCHECK_HAL_H
+
+#include "../oledsim/stm32l0xx_hal.h"
+
+#define LOGGERCHECK_EEPROM_SIZE 512
+
+extern uint8_t loggercheck_eeprom[LOGGERCHECK_EEPROM_SIZE];
+
+#define DATA_EEPROM_BASE        ((uintptr_t)loggercheck_eeprom)
+#define DATA_EEPROM_END         (DATA_EEPROM_BASE + LOGGERCHECK_EEPROM_SIZE - 1)
+#define FLASH_TYPEPROGRAMDATA_WORD 0x02U
+
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Unlock(void);
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Lock(void);
+HAL_StatusTypeDef HAL_FLASHEx_DATAEEPROM_Program(uint32_t TypeProgram, uint32_t Address, uint32_t Data);
+
+#endif
@@ -0,0 +1,465 @@
+/*
+ * Host simulator of the SSD1306 behind App/oled.
+ *
+ * oled.c and oled_text.c are compiled unchanged against a mock of the bus
+ * layer (i2c_bus.h). Every transfer is decoded into a simulated SSD1306
+ * GRAM, so the output shows what the panel would hold, and the traffic of
+ * each flush is counted: transactions and wire bytes (address and control
+ * byte included, as i2c_bus_wire_us() counts them).
+ *
+ * The scenario mirrors the main screen: the four text fields of main.c
+ * with slowly drifting values and a sweep chart in pages 5-7. At the end
+ * the whole frame is repainted and compared with the incrementally
+ * updated GRAM; any difference means a partial flush left stale pixels,
+ * and the exit code is 1.
+ *
+ * Build from the repository root; this directory must come first so its
+ * stm32l0xx_hal.h replaces the real one:
+ *
+ *     cc -O2 -o oledsim -ITools/oledsim -IApp/oled -IApp/i2c_bus -IApp/format \
+ *         -IApp/ramfunc \
+ *         Tools/oledsim/oledsim.c App/oled/oled.c App/oled/oled_text.c \
+ *         App/format/format.c
+ *
+ * Panel variants build the same way with e.g. -DOLED_HEIGHT=32, or
+ * -DOLED_WIDTH=72 -DOLED_HEIGHT=40.
+ *
+ * Usage:
+ *     oledsim [-n steps] [-a] [-w] [-s every] [-p prefix] [-r frames]
+ *         -a  flush with oled_display_async() through the mock queue
+ *         -w  warm boot: GRAM starts out holding an old frame and the
+ *             panel is taken over with oled_resume() instead of oled_init()
+ *         -s  every so many steps, redraw the whole layout the way a view
+ *             switch does (oled_frame_begin(), clear, fields, oled_frame_end());
+ *             the chart is lost, so only its pages should go out
+ *         -p  write a PBM snapshot of GRAM after every step (prefixNNN.pbm)
+ *         -r  instead of the scenario, run that many async flushes and
+ *             complete their transfers one at a time, with random drawing
+ *             (columns, glyphs, blanks, clears) before each completion.
+ *             Every SIM_SETTLE frames, and at the end, one more flush with
+ *             nothing drawn during it must leave GRAM equal to the frame
+ *             buffer; the output is then one line per such check
+ *
+ * Output is CSV: step, transactions, wire bytes, then a summary line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "oled.h"
+#include "oled_text.h"
+#include "i2c_bus.h"
+#include "format.h"
+
+#define SIM_QUEUE_LEN   8
+
+// Panel model; the controller has 8 GRAM pages of 128 columns whatever the
+// panel shows, and a narrow panel sees columns OLED_COL_OFFSET onwards
+#define SIM_COLS        128
+static uint8_t gram[8][SIM_COLS];
+static uint8_t mode = 0x02;                 // Page addressing after reset
+static uint8_t col_lo, col_hi = SIM_COLS - 1, page_lo, page_hi = 7;
+static uint8_t col, page;
+
+// Traffic since the last sim_take_stats()
+static uint32_t transactions, wire_bytes;
+
+static uint32_t tick;
+
+uint32_t HAL_GetTick(void)
+{
+    return tick++;
+}
+
+// Argument bytes following each SSD1306 command opcode
+static uint8_t sim_cmd_args(uint8_t op)
+{
+    switch (op) {
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+    case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        return 1;
+    case 0x21: case 0x22: case 0xA3:
+        return 2;
+    case 0x29: case 0x2A:
+        return 5;
+    case 0x26: case 0x27:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static void sim_commands(const uint8_t *p, uint16_t len)
+{
+    uint16_t i = 0;
+    while (i < len) {
+        uint8_t op = p[i++];
+        const uint8_t *a = &p[i];
+        uint8_t n = sim_cmd_args(op);
+        if (i + n > len) {
+            fprintf(stderr, "oledsim: command 0x%02X cut short\n", op);
+            return;
+        }
+        i += n;
+
+        if (op == 0x20) {
+            mode = a[0] & 3;
+        } else if (op == 0x21) {
+            col_lo = col = a[0] & 0x7F;
+            col_hi = a[1] & 0x7F;
+        } else if (op == 0x22) {
+            page_lo = page = a[0] & 7;
+            page_hi = a[1] & 7;
+        } else if (op >= 0xB0 && op <= 0xB7 && mode == 0x02) {
+            page = op & 7;
+        } else if (op <= 0x0F && mode == 0x02) {
+            col = (col & 0xF0) | op;
+        } else if (op >= 0x10 && op <= 0x17 && mode == 0x02) {
+            col = (col & 0x0F) | ((op & 0x07) << 4);
+        }
+    }
+}
+
+// GRAM pointer advance as in the datasheet, section 10.1.3
+static void sim_data(const uint8_t *p, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        gram[page][col] = p[i];
+        if (mode == 0x00) {
+            if (col++ == col_hi) {
+                col = col_lo;
+                page = page == page_hi ? page_lo : page + 1;
+            }
+        } else if (mode == 0x01) {
+            if (page++ == page_hi) {
+                page = page_lo;
+                col = col == col_hi ? col_lo : col + 1;
+            }
+        } else if (col < SIM_COLS - 1) {
+            col++;
+        }
+    }
+}
+
+static HAL_StatusTypeDef sim_transfer(uint8_t addr, uint8_t reg, const uint8_t *buf, uint16_t len)
+{
+    if (addr != SSD1306_I2C_ADDR) return HAL_ERROR;
+    transactions++;
+    wire_bytes += len + 2u;
+    if (reg == 0x00) sim_commands(buf, len);
+    else if (reg == 0x40) sim_data(buf, len);
+    return HAL_OK;
+}
+
+// Mock bus layer: blocking calls go straight to the panel, queued ones
+// wait in a ring until sim_drain() runs them in order
+static i2c_bus_xfer queue[SIM_QUEUE_LEN];
+static uint8_t q_head, q_count;
+
+HAL_StatusTypeDef i2c_bus_mem_write(uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+    return sim_transfer(addr, reg, buf, len);
+}
+
+HAL_StatusTypeDef i2c_bus_probe(uint8_t addr)
+{
+    return addr == SSD1306_I2C_ADDR ? HAL_OK : HAL_ERROR;
+}
+
+uint8_t i2c_bus_submit(const i2c_bus_xfer *xfer)
+{
+    if (q_count == SIM_QUEUE_LEN) return 0;
+    queue[(q_head + q_count) % SIM_QUEUE_LEN] = *xfer;
+    q_count++;
+    return 1;
+}
+
+uint8_t i2c_bus_busy(void)
+{
+    return q_count != 0;
+}
+
+// The oldest queued transfer goes out and its completion runs, which may
+// queue the next one
+static void sim_complete_one(void)
+{
+    i2c_bus_xfer x = queue[q_head];
+    q_head = (q_head + 1) % SIM_QUEUE_LEN;
+    q_count--;
+    HAL_StatusTypeDef st = sim_transfer(x.addr, x.reg, x.buf, x.len);
+    if (x.cb) x.cb(st, x.ctx);
+}
+
+static void sim_drain(void)
+{
+    while (q_count) sim_complete_one();
+}
+
+static void sim_flush(int async)
+{
+    if (!async) {
+        oled_display();
+        return;
+    }
+    if (!oled_display_async()) {
+        fprintf(stderr, "oledsim: flush still busy\n");
+        exit(2);
+    }
+    sim_drain();
+    if (oled_is_busy()) {
+        fprintf(stderr, "oledsim: flush did not finish\n");
+        exit(2);
+    }
+}
+
+static void sim_take_stats(uint32_t *t, uint32_t *b)
+{
+    *t = transactions;
+    *b = wire_bytes;
+    transactions = wire_bytes = 0;
+}
+
+static void sim_write_pbm(const char *prefix, int step)
+{
+    char name[256];
+    snprintf(name, sizeof(name), "%s%03d.pbm", prefix, step);
+    FILE *f = fopen(name, "wb");
+    if (!f) {
+        perror(name);
+        exit(2);
+    }
+    fprintf(f, "P4\n%d %d\n", OLED_WIDTH, OLED_HEIGHT);
+    for (int y = 0; y < OLED_HEIGHT; y++) {
+        uint8_t row[(OLED_WIDTH + 7) / 8] = { 0 };
+        for (int x = 0; x < OLED_WIDTH; x++)
+            if (gram[y / 8][OLED_COL_OFFSET + x] & (1 << (y & 7)))
+                row[x / 8] |= 0x80 >> (x & 7);
+        fwrite(row, 1, sizeof(row), f);
+    }
+    fclose(f);
+}
+
+// Same layout as main.c
+enum { FIELD_TEMP, FIELD_HUMIDITY, FIELD_PRESSURE, FIELD_ENERGY };
+#define ROW_HUMIDITY    (OLED_PAGES < 8 ? 2 : 3)
+#define ROW_PRESSURE    (OLED_PAGES < 8 ? 3 : 4)
+
+static void sim_field(uint8_t id, int32_t value, uint8_t decimals, uint8_t width, const char *unit)
+{
+    char line[OLED_TEXT_FIELD_LEN + 1];
+    uint8_t n = format_fixed(line, value, decimals, width);
+    format_str(line + n, unit);
+    oled_text_update(id, line);
+}
+
+// Values drift the way a room does
+#define SIM_TEMP(step)  (2150 + ((step) * 7) % 120 - 60)
+#define SIM_HUM(step)   (4520 + (((step) * 13) % 90) * 10)
+#define SIM_PRES(step)  (101325 + ((step) % 40) * 5)
+
+static void sim_layout(void)
+{
+    oled_text_field_scaled(FIELD_TEMP, 0, 0, 8, 2);
+    oled_text_field(FIELD_HUMIDITY, 0, ROW_HUMIDITY, 10);
+    oled_text_field(FIELD_PRESSURE, 0, ROW_PRESSURE, 11);
+    oled_text_field(FIELD_ENERGY, 72, ROW_HUMIDITY, 9);
+}
+
+// Redraw the fields as the last step left them
+static void sim_switch(int step)
+{
+    oled_frame_begin();
+    oled_clear();
+    oled_text_reset();
+    sim_layout();
+    sim_field(FIELD_TEMP, SIM_TEMP(step & ~1), 2, 6, "`C");
+    sim_field(FIELD_HUMIDITY, SIM_HUM(step - step % 3), 2, 6, "%R");
+    sim_field(FIELD_PRESSURE, SIM_PRES(step - step % 5), 2, 7, "hPa");
+    sim_field(FIELD_ENERGY, step / 4, 0, 6, "uAh");
+    oled_frame_end();
+}
+
+// One step of the scenario
+static void sim_step(int step)
+{
+    int32_t temp = SIM_TEMP(step);
+
+    if (step % 2 == 0) sim_field(FIELD_TEMP, temp, 2, 6, "`C");
+    if (step % 3 == 0) sim_field(FIELD_HUMIDITY, SIM_HUM(step), 2, 6, "%R");
+    if (step % 5 == 0) sim_field(FIELD_PRESSURE, SIM_PRES(step), 2, 7, "hPa");
+    sim_field(FIELD_ENERGY, step / 4, 0, 6, "uAh");
+
+    // Sweep chart: one new column, a blank cursor column ahead of it
+    uint8_t x = step % OLED_WIDTH;
+    uint8_t colbits[3] = { 0, 0, 0 };
+    int32_t row = 23 - (temp - 2090) * 23 / 120;
+    if (row < 0) row = 0;
+    if (row > 23) row = 23;
+    colbits[row / 8] = 1 << (row & 7);
+    oled_put_column(x, 5, colbits, 3);
+    static const uint8_t blank[3] = { 0, 0, 0 };
+    oled_put_column((x + 1) % OLED_WIDTH, 5, blank, 3);
+}
+
+// A full repaint must not change a single GRAM byte: GRAM held buffer[]
+static int sim_stale(void)
+{
+    uint8_t before[8][SIM_COLS];
+    memcpy(before, gram, sizeof(gram));
+    oled_invalidate();
+    oled_display();
+    return memcmp(before, gram, sizeof(gram)) != 0;
+}
+
+static uint32_t rnd = 0x2545F491;
+
+static uint32_t sim_rand(uint32_t n)
+{
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd % n;
+}
+
+// Anything main.c's views draw, at random places. Blanks and clears are
+// frequent, so pages go blank and stop being blank while their flush runs:
+// a page taken blank and drawn on before its bytes are copied out is the
+// case zero-skipping gets wrong if it trusts the blank flag
+static void sim_random_draw(void)
+{
+    uint8_t bytes[3];
+    switch (sim_rand(8)) {
+    case 0: case 1:
+        for (int k = 0; k < 3; k++) bytes[k] = sim_rand(2) ? (uint8_t)sim_rand(256) : 0;
+        oled_put_column(sim_rand(OLED_WIDTH), sim_rand(OLED_PAGES), bytes, 1 + sim_rand(3));
+        break;
+    case 2:
+        bytes[0] = bytes[1] = bytes[2] = 0;
+        oled_put_column(sim_rand(OLED_WIDTH), sim_rand(OLED_PAGES), bytes, 3);
+        break;
+    case 3: case 4:
+        oled_putc(sim_rand(OLED_WIDTH), sim_rand(OLED_PAGES), (char)(' ' + sim_rand(96)));
+        break;
+    case 5:
+        oled_print(sim_rand(OLED_WIDTH), sim_rand(OLED_PAGES), sim_rand(2) ? "21.50`C" : "      ");
+        break;
+    case 6:
+        oled_putc_scaled(sim_rand(OLED_WIDTH), sim_rand(OLED_PAGES), (char)('0' + sim_rand(10)),
+                         2 + sim_rand(OLED_MAX_SCALE - 1));
+        break;
+    default:
+        if (sim_rand(4) == 0) oled_clear();
+        break;
+    }
+}
+
+#define SIM_SETTLE      1000
+
+static int sim_random(int frames)
+{
+    int checks = 0, stale = 0;
+    uint32_t t, b, total_t = 0;
+
+    oled_init();
+    oled_clear();
+    for (int frame = 0; frame < frames; frame++) {
+        for (uint32_t n = sim_rand(4); n; n--) sim_random_draw();
+        if (!oled_display_async()) {
+            fprintf(stderr, "oledsim: flush still busy at frame %d\n", frame);
+            return 1;
+        }
+        while (q_count) {
+            for (uint32_t n = sim_rand(4); n; n--) sim_random_draw();
+            sim_complete_one();
+        }
+        if (oled_is_busy()) {
+            fprintf(stderr, "oledsim: flush did not finish at frame %d\n", frame);
+            return 1;
+        }
+        sim_take_stats(&t, &b);
+        total_t += t;
+
+        if ((frame + 1) % SIM_SETTLE == 0 || frame + 1 == frames) {
+            sim_flush(1);
+            int bad = sim_stale();
+            sim_take_stats(&t, &b);
+            checks++;
+            stale += bad;
+            printf("settle,%d,%s\n", frame + 1, bad ? "stale" : "ok");
+        }
+    }
+    printf("# %d random frames, %.1f transactions per flush, %d settling checks%s\n",
+           frames, frames ? (double)total_t / frames : 0.0, checks,
+           stale ? ", GRAM MISMATCH" : "");
+    return stale != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int steps = 100, async = 0, every = 0, warm = 0, frames = 0, opt;
+    const char *prefix = NULL;
+    uint32_t t, b, total_t = 0, total_b = 0;
+
+    while ((opt = getopt(argc, argv, "n:aws:p:r:")) != -1) {
+        switch (opt) {
+        case 'n': steps = atoi(optarg); break;
+        case 'a': async = 1; break;
+        case 's': every = atoi(optarg); break;
+        case 'w': warm = 1; break;
+        case 'p': prefix = optarg; break;
+        case 'r': frames = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n steps] [-a] [-w] [-s every] [-p prefix] [-r frames]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (frames) return sim_random(frames);
+
+    if (warm) {
+        // Whatever the last boot left, in vertical addressing mode
+        for (int p = 0; p < 8; p++)
+            for (int x = 0; x < OLED_WIDTH; x++)
+                gram[p][OLED_COL_OFFSET + x] = (uint8_t)(x * 37 + p * 11);
+        mode = 0x01;
+        oled_resume();
+    } else {
+        oled_init();
+        oled_clear();
+    }
+    sim_layout();
+    sim_take_stats(&t, &b);
+    printf("step,transactions,wire_bytes\n");
+    printf("init,%u,%u\n", t, b);
+
+    for (int step = 0; step < steps; step++) {
+        if (every && step && step % every == 0) {
+            sim_switch(step - 1);
+            sim_flush(async);
+            sim_take_stats(&t, &b);
+            printf("switch,%u,%u\n", t, b);
+        }
+        sim_step(step);
+        sim_flush(async);
+        sim_take_stats(&t, &b);
+        total_t += t;
+        total_b += b;
+        printf("%d,%u,%u\n", step, t, b);
+        if (prefix) sim_write_pbm(prefix, step);
+    }
+
+    // Reference: a full repaint must not change a single GRAM byte
+    uint8_t before[8][SIM_COLS];
+    memcpy(before, gram, sizeof(gram));
+    oled_invalidate();
+    sim_flush(async);
+    sim_take_stats(&t, &b);
+    int stale = memcmp(before, gram, sizeof(gram)) != 0;
+
+    printf("# %d steps, %.1f transactions and %.1f wire bytes per flush, "
+           "full repaint %u bytes%s\n", steps, steps ? (double)total_t / steps : 0.0,
+           steps ? (double)total_b / steps : 0.0, b, stale ? ", GRAM MISMATCH" : "");
+    return stale;
+}
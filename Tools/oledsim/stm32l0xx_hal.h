@@ -0,0 +1,32 @@
+/*
+ * Host stand-in for the HAL umbrella header: just what oled.c, oled_text.c
+ * and i2c_bus.h use. Found first on the include path, so the real CMSIS
+ * intrinsics (ARM inline assembly) are never seen by the host compiler.
+ */
+
+#ifndef OLEDSIM_HAL_H
+#define OLEDSIM_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    HAL_OK = 0,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+typedef struct I2C_HandleTypeDef I2C_HandleTypeDef;
+
+#define __weak __attribute__((weak))
+
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) { }
+static inline void __enable_irq(void) { }
+static inline void __WFI(void) { }
+
+uint32_t HAL_GetTick(void);
+
+#endif
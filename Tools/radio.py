@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Decode radio uplink packets of units built with RADIO=1.
+
+Reads one packet per line as hex, the way an nRF24 gateway prints a
+received payload (layout in App/radio/radio.h), and prints the quarter
+buckets they carry: mean, min and max per channel in the history units
+(0.1 degC, 0.1 %RH, 0.1 hPa), stamped with the receive time less the
+packet's age. A packet repeating the sequence number of the one before
+from the same node is a resend whose ACK was lost, and is skipped.
+
+Usage:
+    gateway | Tools/radio.py
+    Tools/radio.py < packets.txt
+"""
+
+import struct
+import sys
+import time
+
+from dump import BUCKET_CHANNEL, CHANNELS, bucket
+
+HEADER_LEN = 2
+ESCAPE = 0x80
+QUARTER = 15 * 60
+
+
+def decode(payload):
+    """(node, seq, age in minutes, buckets oldest first)."""
+    nch = len(CHANNELS)
+    node, seq, age = payload[0] >> 4, payload[0] & 0x0F, payload[1]
+    buckets = [bucket(payload, HEADER_LEN, nch)]
+    means = [b[0] for b in buckets[0]]
+    off = HEADER_LEN + BUCKET_CHANNEL * nch
+    while off < len(payload):
+        spans = []
+        for ch in range(nch):
+            d = payload[off]
+            if d == ESCAPE:
+                means[ch] = struct.unpack_from('<h', payload, off + 1)[0]
+                off += 3
+            else:
+                means[ch] += d - 256 if d > 127 else d
+                off += 1
+            below, above = payload[off], payload[off + 1]
+            off += 2
+            spans.append((means[ch], means[ch] - below, means[ch] + above))
+        buckets.append(spans)
+    return node, seq, age, buckets
+
+
+def main():
+    last = {}
+    for line in sys.stdin:
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        now = time.time()
+        try:
+            node, seq, age, buckets = decode(bytes.fromhex(line))
+        except (ValueError, IndexError, struct.error):
+            print('# bad packet: %s' % line, file=sys.stderr)
+            continue
+        if last.get(node) == seq:
+            continue
+        last[node] = seq
+        newest = now - age * 60
+        for i, spans in enumerate(buckets):
+            stamp = newest - (len(buckets) - 1 - i) * QUARTER
+            cells = '  '.join('%s %d (%d..%d)' % (name, *s) for name, s in zip(CHANNELS, spans))
+            print('%s node %d  %s' % (time.strftime('%Y-%m-%d %H:%M', time.localtime(stamp)), node, cells))
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
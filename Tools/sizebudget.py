@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""Report flash and RAM use per module from a GNU ld map file.
+
+Run as the post-build step of every build configuration (see .cproject);
+the build fails when a budget in Tools/size_budget.cfg is exceeded.
+
+Every input section in the memory map is charged to the object it came
+from, grouped by module (App/<module>, Core sources, HAL modules, libc,
+libgcc) and split by the output section it landed in:
+
+    text    .isr_vector, .text
+    rodata  .rodata, exception tables, init/fini arrays
+    data    .data (stored in flash, copied to RAM)
+    bss     .bss
+    reserve ._user_heap_stack (_Min_Heap_Size + _Min_Stack_Size)
+
+flash = text + rodata + data, ram = data + bss (+ reserve for the total).
+The cost of a feature flag is the difference between two builds:
+    Tools/sizebudget.py --diff Release-without.map Release/Project.map
+
+Usage:
+    Tools/sizebudget.py [--budget cfg] [--diff old.map] file.map
+"""
+
+import argparse
+import os
+import re
+import sys
+
+CLASSES = ('text', 'rodata', 'data', 'bss')
+OUTPUT_CLASS = {
+    '.isr_vector': 'text', '.text': 'text',
+    '.rodata': 'rodata', '.ARM.extab': 'rodata', '.ARM': 'rodata',
+    '.preinit_array': 'rodata', '.init_array': 'rodata', '.fini_array': 'rodata',
+    '.data': 'data', '.bss': 'bss', '._user_heap_stack': 'reserve',
+}
+SECTION = re.compile(r'^ (\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+OUTPUT = re.compile(r'^(\.\S+)(?:\s+0x[0-9a-fA-F]+\s+0x([0-9a-fA-F]+))?')
+ADDR_SIZE = re.compile(r'^\s+0x[0-9a-fA-F]+\s+0x([0-9a-fA-F]+)\s*$')
+MEMORY = re.compile(r'^(\w+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)')
+
+
+def module_of(obj):
+    """Short module name for an object path from the map."""
+    obj = obj.replace('\\', '/')
+    m = re.search(r'lib(\w+)\.a\(', obj)
+    if m:
+        return 'lib' + m.group(1)
+    name = os.path.splitext(os.path.basename(obj))[0]
+    if 'App/' in obj:
+        return obj.split('App/')[1].split('/')[0]
+    if name.startswith('stm32l0xx_hal_') and 'Driver' in obj:
+        return 'hal_' + name[len('stm32l0xx_hal_'):]
+    if name == 'stm32l0xx_hal':
+        return 'hal'
+    return name
+
+
+def parse(path):
+    """Return ({module: {class: bytes}}, {region: length}, reserve bytes)."""
+    sizes, memory, reserve, reserve_line = {}, {}, 0, False
+    state, out_class, pending = 'start', None, None
+    with open(path, errors='replace') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            if line.startswith('Memory Configuration'):
+                state = 'memory'
+                continue
+            if line.startswith('Linker script and memory map'):
+                state = 'map'
+                continue
+            if state == 'memory':
+                m = MEMORY.match(line)
+                if m and m.group(1) != 'Name':
+                    memory[m.group(1)] = int(m.group(3), 16)
+                continue
+            if state != 'map':
+                continue
+
+            m = OUTPUT.match(line)
+            if m:
+                out_class = OUTPUT_CLASS.get(m.group(1))
+                if out_class == 'reserve':
+                    reserve_line = m.group(2) is None
+                    if m.group(2):
+                        reserve += int(m.group(2), 16)
+                continue
+            # The heap/stack reservation is a location counter bump with no
+            # input sections; its name is long enough to wrap the size line
+            if out_class == 'reserve':
+                m = ADDR_SIZE.match(line)
+                if m and reserve_line:
+                    reserve += int(m.group(1), 16)
+                reserve_line = False
+                continue
+            if out_class is None:
+                continue
+            # A long input section name sits on a line of its own
+            if re.match(r'^ \S+$', line):
+                pending = line.strip()
+                continue
+            m = SECTION.match(line)
+            if not m or not (m.group(1) or pending):
+                pending = None
+                continue
+            name = m.group(1) or pending
+            pending = None
+            size = int(m.group(3), 16)
+            if size == 0 or name.startswith('*fill*'):
+                continue
+            # font.h is compiled into oled.o; report its tables on their own
+            mod = 'font' if name.startswith('.rodata.font') else module_of(m.group(4).strip())
+            sizes.setdefault(mod, dict.fromkeys(CLASSES, 0))[out_class] += size
+    return sizes, memory, reserve
+
+
+def totals(s):
+    return s['text'] + s['rodata'] + s['data'], s['data'] + s['bss']
+
+
+def load_budget(path):
+    budget = {}
+    with open(path) as f:
+        for line in f:
+            line = line.split('#')[0].split()
+            if len(line) == 3:
+                budget[line[0]] = (int(line[1], 0), int(line[2], 0))
+    return budget
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('map', help='map file written by the linker')
+    ap.add_argument('--budget', help='budget file: <module|total> <flash> <ram> per line')
+    ap.add_argument('--diff', help='map file of a baseline build')
+    args = ap.parse_args()
+
+    sizes, memory, reserve = parse(args.map)
+    if not sizes:
+        raise SystemExit('%s: no memory map found' % args.map)
+    base = parse(args.diff)[0] if args.diff else {}
+    width = max(len(m) for m in sizes)
+
+    print('%-*s %6s %6s %6s %6s %6s %6s' % ((width, 'module') + CLASSES + ('flash', 'ram'))
+          + ('  change' if base else ''))
+    total = dict.fromkeys(CLASSES, 0)
+    for mod in sorted(sizes, key=lambda m: (-totals(sizes[m])[0], m)):
+        s = sizes[mod]
+        for c in CLASSES:
+            total[c] += s[c]
+        flash, ram = totals(s)
+        line = '%-*s %6d %6d %6d %6d %6d %6d' % (width, mod, s['text'], s['rodata'],
+                                                 s['data'], s['bss'], flash, ram)
+        if base:
+            old = totals(base[mod]) if mod in base else (0, 0)
+            line += '  %+d/%+d' % (flash - old[0], ram - old[1])
+        print(line)
+    flash, ram = totals(total)
+    ram_all = ram + reserve
+    print('%-*s %6d %6d %6d %6d %6d %6d  (+%d heap/stack reserve)' % (
+        width, 'total', total['text'], total['rodata'], total['data'], total['bss'],
+        flash, ram, reserve))
+    for region, used in (('FLASH', flash), ('RAM', ram_all)):
+        if region in memory:
+            print('%-5s %6d of %6d bytes (%d free)' % (region, used, memory[region],
+                                                        memory[region] - used))
+
+    if not args.budget:
+        return
+    over = []
+    for mod, (b_flash, b_ram) in load_budget(args.budget).items():
+        if mod == 'total':
+            use = (flash, ram_all)
+        elif mod in sizes:
+            use = totals(sizes[mod])
+        else:
+            continue
+        if use[0] > b_flash:
+            over.append('%s flash %d > %d' % (mod, use[0], b_flash))
+        if use[1] > b_ram:
+            over.append('%s ram %d > %d' % (mod, use[1], b_ram))
+    for o in over:
+        print('error: size budget exceeded: %s' % o, file=sys.stderr)
+    sys.exit(1 if over else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream of App/telemetry.
+
+Frames are 25 bytes, little endian (see App/telemetry/telemetry.h):
+sync 0xA5, sequence, int32 temperature [0.01 degC], uint32 pressure
+[Q24.8 Pa], uint32 humidity [Q22.10 %RH], status, uint32 charge used
+[uAh], uint32 sample time [Unix s, or ms since reset in tracking mode],
+CRC-16/CCITT-FALSE over the first 23 bytes. The decoder hunts for the sync byte and only
+accepts a frame whose CRC matches, so it locks on mid-stream.
+
+The serial port is read as a plain file; set it up first, e.g.
+    stty -F /dev/ttyACM0 9600 raw -echo
+
+Usage:
+    Tools/telemetry.py [--csv] [input]      (default: stdin)
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+FRAME_LEN = 25
+TIERS = ('normal', 'save', 'dim', 'dark')
+TRENDS = ('unknown', 'falling fast', 'falling', 'steady', 'rising', 'rising fast')
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def frames(stream):
+    buf = bytearray()
+    while True:
+        chunk = stream.read(64)
+        if not chunk:
+            return
+        buf += chunk
+        while len(buf) >= FRAME_LEN:
+            if buf[0] != SYNC:
+                del buf[0]
+                continue
+            frame = bytes(buf[:FRAME_LEN])
+            if crc16(frame[:-2]) != struct.unpack_from('<H', frame, FRAME_LEN - 2)[0]:
+                del buf[0]      # A data byte that looked like sync
+                continue
+            del buf[:FRAME_LEN]
+            yield frame
+
+
+def decode(frame):
+    _, seq, t, p, h, status, uah, stamp = struct.unpack_from('<BBiIIBII', frame)
+    trend = (status >> 3) & 7
+    return {
+        'seq': seq,
+        'temperature': t / 100,
+        'pressure': p / 256 / 100,
+        'humidity': h / 1024,
+        'sensor_ok': bool(status & 1),
+        'tier': TIERS[(status >> 1) & 3],
+        'trend': TRENDS[trend] if trend < len(TRENDS) else str(trend),
+        'alarm': bool(status & 0x40),
+        'track': bool(status & 0x80),
+        'charge': uah,
+        'time': stamp,
+    }
+
+
+def iso(d):
+    if d['track']:
+        return '%.3fs' % (d['time'] / 1000)
+    return time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime(d['time']))
+
+
+class Rate:
+    """Sample and frame rate of tracking mode, from the ms stamps.
+
+    Sequence numbers count every sample, also those whose frame was
+    dropped while the previous one was on the wire."""
+
+    def __init__(self):
+        self.start = None
+
+    def update(self, d):
+        if not d['track']:
+            self.start = None
+            return
+        if self.start is None:
+            self.start, self.seq, self.frames = d['time'], d['seq'], 0
+            return
+        self.frames += 1
+        span = (d['time'] - self.start) & 0xFFFFFFFF
+        if span >= 1000:
+            samples = (d['seq'] - self.seq) & 0xFF
+            print('# tracking: %.1f samples/s, %.1f frames/s'
+                  % (samples * 1000 / span, self.frames * 1000 / span), file=sys.stderr)
+            self.start, self.seq, self.frames = d['time'], d['seq'], 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('--csv', action='store_true', help='one CSV line per frame')
+    ap.add_argument('input', nargs='?', help='serial device or capture file')
+    args = ap.parse_args()
+
+    stream = open(args.input, 'rb', buffering=0) if args.input else sys.stdin.buffer
+    last = None
+    rate = Rate()
+    if args.csv:
+        print('seq,time,temperature_c,pressure_hpa,humidity_pct,sensor_ok,tier,trend,alarm,charge_uah')
+    for frame in frames(stream):
+        d = decode(frame)
+        if last is not None and (last + 1) & 0xFF != d['seq']:
+            print('# %d frame(s) dropped' % ((d['seq'] - last - 1) & 0xFF), file=sys.stderr)
+        last = d['seq']
+        rate.update(d)
+        if args.csv:
+            print('%(seq)d,%(iso)s,%(temperature).2f,%(pressure).2f,%(humidity).2f,'
+                  '%(sensor_ok)d,%(tier)s,%(trend)s,%(alarm)d,%(charge)d' % dict(d, iso=iso(d)))
+        else:
+            print('#%(seq)3d  %(iso)s  %(temperature)7.2f C  %(pressure)8.2f hPa  '
+                  '%(humidity)6.2f %%RH  %(charge)6d uAh  %(tier)s  %(trend)s%(flag)s'
+                  % dict(d, iso=iso(d), flag=('' if d['sensor_ok'] else '  (stale)') +
+                         ('  ALARM' if d['alarm'] else '')))
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
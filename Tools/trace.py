@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Fetch and decode the event trace ring of a TRACE=1 build.
+
+Sends the trace command ('R') over the telemetry port and reads one trace
+block (layout in App/telemetry/telemetry.h), or decodes a raw copy of
+trace_ring taken with the debugger, e.g. in gdb:
+    dump binary value trace.bin trace_ring
+
+The entries (App/trace/trace.h) are printed oldest first as a timeline.
+Cycle stamps are turned into time with the HCLK of the last clock entry;
+each wake-up entry re-anchors the timeline to the HAL tick, as the cycle
+counter stands still in STOP. Points before the first clock entry use
+--khz. The stamps are 24 bits wide, so two points more than 2^24 cycles
+apart with no wake-up between them (0.5 s at 32 MHz) come out short.
+
+Usage:
+    Tools/trace.py [--raw out.bin] port     (or a saved ring with --file)
+"""
+
+import argparse
+import struct
+
+from dump import read_block
+from telemetry import crc16
+
+TRACE_SYNC = 0x5C
+TRACE_MAGIC = 0x31435254
+STAMP_MASK = 0xFFFFFF
+EVENTS = (None, 'wake', 'clock', 'sleep', 'sensor_start', 'sensor_done',
+          'i2c_start', 'i2c_done', 'i2c_error', 'render', 'render_end',
+          'flush', 'flush_done')
+WAKE = 1
+CLOCK = 2
+
+
+def trace_length(buf):
+    if len(buf) < 7:
+        return 7        # Not enough yet to see the ring length
+    return 1 + 8 + 4 * struct.unpack_from('<H', buf, 5)[0] + 2
+
+
+def entries(ring):
+    magic, n, head = struct.unpack_from('<IHH', ring, 0)
+    if magic != TRACE_MAGIC:
+        raise SystemExit('no trace ring (magic %08x)' % magic)
+    words = struct.unpack_from('<%dI' % n, ring, 8)
+    # head counts every entry written; slots never written hold id 0
+    ordered = [words[(head + i) % n] for i in range(n)]
+    return [(w >> 24, w & STAMP_MASK) for w in ordered if w >> 24]
+
+
+def timeline(items, khz):
+    t = None            # ms
+    wake = None         # Tick of the last wake-up, unwrapped
+    stamp = None        # Last cycle stamp since the wake-up
+    out = []
+    for eid, v in items:
+        if eid == WAKE:
+            wake = v if wake is None else wake + ((v - wake) & STAMP_MASK)
+            t = float(wake)
+            stamp = None
+        elif eid == CLOCK:
+            khz = v
+        elif stamp is not None:
+            t += ((v - stamp) & STAMP_MASK) / khz
+            stamp = v
+        else:
+            stamp = v
+            if t is None:
+                t = 0.0
+        out.append((t, eid, v))
+    return out
+
+
+def show(events):
+    print('index,time_ms,delta_us,event')
+    last = None
+    for i, (t, eid, v) in enumerate(events):
+        name = EVENTS[eid] if eid < len(EVENTS) else 'id%d' % eid
+        if eid in (WAKE, CLOCK):
+            name += '(%d)' % v
+        ts = '' if t is None else '%.3f' % t
+        delta = '' if t is None or last is None else '%.1f' % ((t - last) * 1000)
+        print('%d,%s,%s,%s' % (i, ts, delta, name))
+        if t is not None:
+            last = t
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('port', nargs='?', help='serial device of the telemetry link')
+    ap.add_argument('--file', help='decode a raw trace_ring image instead')
+    ap.add_argument('--raw', help='also save the received ring here')
+    ap.add_argument('--khz', type=int, default=32000,
+                    help='HCLK before the first clock entry (default 32000)')
+    args = ap.parse_args()
+
+    if args.file:
+        with open(args.file, 'rb') as f:
+            ring = f.read()
+    elif args.port:
+        with open(args.port, 'r+b', buffering=0) as port:
+            port.write(b'R')
+            ring = read_block(port, TRACE_SYNC, trace_length)[1:-2]
+    else:
+        ap.error('need a port or --file')
+
+    if args.raw:
+        with open(args.raw, 'wb') as f:
+            f.write(ring)
+    show(timeline(entries(ring), args.khz))
+
+
+if __name__ == '__main__':
+    main()